@@ -0,0 +1,53 @@
+/**
+ * Host stand-in for the Arduino core, just enough for the MAX30105 library,
+ * the host benchmarks and the unit tests. Time is virtual: it only moves
+ * when the caller delays or when a bus transfer takes time (see Wire.h), so
+ * runs are deterministic and independent of the host's speed.
+ */
+
+#ifndef HOST_ARDUINO_H
+#define HOST_ARDUINO_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <algorithm>
+
+#include "Print.h"
+
+typedef uint8_t byte;
+typedef bool boolean;
+
+#define F(s) (s)
+#define PROGMEM
+#define pgm_read_byte(p) (*(const uint8_t*)(p))
+
+using std::min;
+using std::max;
+
+#define constrain(amt, low, high) ((amt) < (low) ? (low) : ((amt) > (high) ? (high) : (amt)))
+
+// ==================== VIRTUAL CLOCK ====================
+namespace hostclock {
+extern uint64_t nowUs;
+inline void advanceUs(uint64_t us) { nowUs += us; }
+}
+
+inline unsigned long micros() { return (unsigned long)hostclock::nowUs; }
+inline unsigned long millis() { return (unsigned long)(hostclock::nowUs / 1000); }
+inline void delay(unsigned long ms) { hostclock::advanceUs((uint64_t)ms * 1000); }
+inline void delayMicroseconds(unsigned int us) { hostclock::advanceUs(us); }
+inline void yield() {}
+
+// ==================== SERIAL ====================
+class HostSerial : public Print {
+public:
+    void begin(unsigned long) {}
+    using Print::write;
+    size_t write(uint8_t b) override { return fputc(b, stdout) == EOF ? 0 : 1; }
+};
+extern HostSerial Serial;
+
+#endif
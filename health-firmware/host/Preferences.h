@@ -0,0 +1,44 @@
+/**
+ * Host Preferences (ESP32 NVS) stand-in: an in-memory namespace for the
+ * config store tests. puts counts every write so tests can check that NVS
+ * commits are coalesced.
+ */
+
+#ifndef HOST_PREFERENCES_H
+#define HOST_PREFERENCES_H
+
+#include <stdint.h>
+#include <map>
+#include <string>
+
+class Preferences {
+private:
+    std::map<std::string, uint32_t> uints;
+    std::map<std::string, float> floats;
+
+public:
+    uint32_t puts = 0;
+
+    bool begin(const char*, bool) { return true; }
+    void end() {}
+    void clear() {
+        uints.clear();
+        floats.clear();
+    }
+
+    bool isKey(const char* key) { return uints.count(key) || floats.count(key); }
+    float getFloat(const char* key, float def = 0) { return floats.count(key) ? floats[key] : def; }
+    uint32_t getUInt(const char* key, uint32_t def = 0) { return uints.count(key) ? uints[key] : def; }
+    size_t putFloat(const char* key, float v) {
+        floats[key] = v;
+        puts++;
+        return sizeof(v);
+    }
+    size_t putUInt(const char* key, uint32_t v) {
+        uints[key] = v;
+        puts++;
+        return sizeof(v);
+    }
+};
+
+#endif
@@ -0,0 +1,52 @@
+/**
+ * Host Print base class: the subset of the Arduino API the display and
+ * sensor libraries use.
+ */
+
+#ifndef HOST_PRINT_H
+#define HOST_PRINT_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdarg.h>
+#include <string.h>
+
+#define HEX 16
+#define DEC 10
+
+class Print {
+public:
+    virtual ~Print() {}
+    virtual size_t write(uint8_t b) = 0;
+    virtual size_t write(const uint8_t* data, size_t n) {
+        size_t written = 0;
+        while (n--) written += write(*data++);
+        return written;
+    }
+    size_t write(const char* s) { return write((const uint8_t*)s, strlen(s)); }
+
+    size_t print(const char* s) { return write(s); }
+    size_t print(char c) { return write((uint8_t)c); }
+    size_t print(long v, int base = DEC) { return printf(base == HEX ? "%lX" : "%ld", v); }
+    size_t print(unsigned long v, int base = DEC) { return printf(base == HEX ? "%lX" : "%lu", v); }
+    size_t print(int v, int base = DEC) { return print((long)v, base); }
+    size_t print(unsigned int v, int base = DEC) { return print((unsigned long)v, base); }
+    size_t print(unsigned char v, int base = DEC) { return print((unsigned long)v, base); }
+    size_t print(double v, int digits = 2) { return printf("%.*f", digits, v); }
+
+    size_t println() { return write((uint8_t)'\n'); }
+    template <typename T> size_t println(T v) { return print(v) + println(); }
+    template <typename T> size_t println(T v, int fmt) { return print(v, fmt) + println(); }
+
+    size_t printf(const char* fmt, ...) __attribute__((format(printf, 2, 3))) {
+        char buf[256];
+        va_list ap;
+        va_start(ap, fmt);
+        int n = vsnprintf(buf, sizeof(buf), fmt, ap);
+        va_end(ap);
+        if (n < 0) return 0;
+        return write((const uint8_t*)buf, (size_t)n < sizeof(buf) ? n : sizeof(buf) - 1);
+    }
+};
+
+#endif
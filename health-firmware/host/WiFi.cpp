@@ -0,0 +1,100 @@
+#include "WiFi.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+static void setNonBlocking(int fd) { fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK); }
+
+WiFiClient::Socket::~Socket() {
+    if (fd >= 0) ::close(fd);
+}
+
+WiFiClient::WiFiClient(int fd) : sock(std::make_shared<Socket>(fd)) { setNonBlocking(fd); }
+
+void WiFiClient::fill() {
+    if (!sock || sock->fd < 0 || sock->eof || sock->pos < sock->len) return;
+    ssize_t n = recv(sock->fd, sock->buf, sizeof(sock->buf), 0);
+    if (n > 0) {
+        sock->len = (int)n;
+        sock->pos = 0;
+    } else if (n == 0 || (errno != EAGAIN && errno != EWOULDBLOCK)) {
+        sock->eof = true;
+    }
+}
+
+// Still connected while unread data is left, as on the ESP32
+uint8_t WiFiClient::connected() {
+    if (!sock || sock->fd < 0) return 0;
+    fill();
+    return sock->pos < sock->len || !sock->eof;
+}
+
+int WiFiClient::available() {
+    fill();
+    return sock ? sock->len - sock->pos : 0;
+}
+
+int WiFiClient::read() {
+    fill();
+    if (!sock || sock->pos >= sock->len) return -1;
+    return sock->buf[sock->pos++];
+}
+
+size_t WiFiClient::write(const uint8_t* data, size_t n) {
+    if (!sock || sock->fd < 0) return 0;
+    size_t sent = 0;
+    while (sent < n) {
+        ssize_t w = send(sock->fd, data + sent, n - sent, MSG_NOSIGNAL);
+        if (w > 0) {
+            sent += w;
+        } else if (w < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            struct pollfd p = {sock->fd, POLLOUT, 0};
+            poll(&p, 1, 1000);
+        } else {
+            break;
+        }
+    }
+    return sent;
+}
+
+void WiFiClient::stop() {
+    if (!sock || sock->fd < 0) return;
+    ::close(sock->fd);
+    sock->fd = -1;
+    sock.reset();
+}
+
+WiFiServer::~WiFiServer() {
+    if (fd >= 0) ::close(fd);
+}
+
+void WiFiServer::begin() {
+    fd = socket(AF_INET, SOCK_STREAM, 0);
+    int on = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+    struct sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (bind(fd, (struct sockaddr*)&addr, sizeof(addr)) != 0 || listen(fd, 8) != 0) {
+        perror("WiFiServer::begin");
+        ::close(fd);
+        fd = -1;
+        return;
+    }
+    setNonBlocking(fd);
+}
+
+WiFiClient WiFiServer::available() {
+    if (fd < 0) return WiFiClient();
+    int c = accept(fd, nullptr, nullptr);
+    if (c < 0) return WiFiClient();
+    int on = 1;
+    setsockopt(c, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+    return WiFiClient(c);
+}
@@ -0,0 +1,59 @@
+/**
+ * Host WiFiServer/WiFiClient over non-blocking POSIX sockets, so the local
+ * API server runs on Linux against real loopback clients. Clients share
+ * their socket like the ESP32 ones do: copies refer to the same connection
+ * and the last one closes it.
+ */
+
+#ifndef HOST_WIFI_H
+#define HOST_WIFI_H
+
+#include <memory>
+
+#include "Arduino.h"
+
+class WiFiClient : public Print {
+public:
+    WiFiClient() {}
+    explicit WiFiClient(int fd);
+
+    explicit operator bool() const { return sock && sock->fd >= 0; }
+    uint8_t connected();
+    int available();
+    int read();
+    using Print::write;
+    size_t write(uint8_t b) override { return write(&b, 1); }
+    // Blocks until everything is queued in the kernel, like the ESP32 client
+    size_t write(const uint8_t* data, size_t n) override;
+    void stop();
+
+private:
+    struct Socket {
+        int fd;
+        uint8_t buf[512];
+        int len = 0;
+        int pos = 0;
+        bool eof = false;
+        explicit Socket(int fd) : fd(fd) {}
+        ~Socket();
+    };
+    std::shared_ptr<Socket> sock;
+
+    void fill();
+};
+
+class WiFiServer {
+public:
+    explicit WiFiServer(uint16_t port) : port(port), fd(-1) {}
+    ~WiFiServer();
+    void begin();
+    void setNoDelay(bool) {}
+    // Next pending connection, or an empty client
+    WiFiClient available();
+
+private:
+    uint16_t port;
+    int fd;
+};
+
+#endif
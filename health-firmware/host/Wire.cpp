@@ -0,0 +1,90 @@
+#include "Wire.h"
+
+uint64_t hostclock::nowUs = 0;
+HostSerial Serial;
+TwoWire Wire;
+
+void TwoWire::attach(I2cTarget* target) {
+    for (int i = 0; i < MAX_TARGETS; i++) {
+        if (!targets[i]) {
+            targets[i] = target;
+            return;
+        }
+    }
+}
+
+void TwoWire::detach(I2cTarget* target) {
+    for (int i = 0; i < MAX_TARGETS; i++) {
+        if (targets[i] == target) targets[i] = nullptr;
+    }
+}
+
+I2cTarget* TwoWire::find(uint8_t address) {
+    for (int i = 0; i < MAX_TARGETS; i++) {
+        if (targets[i] && targets[i]->i2cAddress() == address) return targets[i];
+    }
+    return nullptr;
+}
+
+// START (or repeated START) + address + payload, each byte 9 clocks, and a
+// STOP unless the master holds the bus for a repeated START.
+void TwoWire::charge(I2cTarget* target, int payloadBytes, bool sendStop) {
+    uint32_t clocks = 1 + 9 * (1 + payloadBytes) + (sendStop ? 1 : 0);
+    uint64_t us = DRIVER_OVERHEAD_US + ((uint64_t)clocks * 1000000 + clockHz - 1) / clockHz;
+    I2cBusStats* all[2] = {&stats, target ? &target->bus : nullptr};
+    for (I2cBusStats* st : all) {
+        if (!st) continue;
+        st->transactions++;
+        st->bytes += 1 + payloadBytes;
+        st->busyUs += us;
+    }
+    hostclock::advanceUs(us);
+}
+
+void TwoWire::beginTransmission(int address) {
+    txAddr = address;
+    txLen = 0;
+    txActive = true;
+}
+
+size_t TwoWire::write(uint8_t b) {
+    if (!txActive || txLen >= BUFFER_LENGTH) return 0;
+    tx[txLen++] = b;
+    return 1;
+}
+
+size_t TwoWire::write(const uint8_t* data, size_t n) {
+    size_t written = 0;
+    while (written < n && write(data[written])) written++;
+    return written;
+}
+
+// Returns the Arduino codes: 0 ok, 2 address NACK
+uint8_t TwoWire::endTransmission(bool sendStop) {
+    txActive = false;
+    I2cTarget* target = find(txAddr);
+    if (!target) {
+        stats.nacks++;
+        charge(nullptr, 0, true);
+        return 2;
+    }
+    charge(target, txLen, sendStop);
+    target->i2cWrite(tx, txLen);
+    return 0;
+}
+
+uint8_t TwoWire::requestFrom(int address, int n, int sendStop) {
+    rxLen = rxPos = 0;
+    if (n < 0) n = 0;
+    if (n > BUFFER_LENGTH) n = BUFFER_LENGTH;
+    I2cTarget* target = find(address);
+    if (!target) {
+        stats.nacks++;
+        charge(nullptr, 0, true);
+        return 0;
+    }
+    charge(target, n, sendStop != 0);
+    target->i2cRead(rx, n);
+    rxLen = n;
+    return n;
+}
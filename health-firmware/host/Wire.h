@@ -0,0 +1,85 @@
+/**
+ * Host TwoWire: routes transactions to emulated I2C targets and charges the
+ * virtual clock for each one, so code under test pays the same bus time it
+ * would on the ESP32 (a blocking Wire driver).
+ *
+ * Cost model per transaction: START, address byte, payload bytes (9 clocks
+ * each with ACK), STOP; a repeated START replaces the STOP + START pair.
+ * Each transaction also pays a fixed driver overhead.
+ */
+
+#ifndef HOST_WIRE_H
+#define HOST_WIRE_H
+
+#include "Arduino.h"
+
+struct I2cBusStats {
+    uint32_t transactions = 0;
+    uint32_t bytes = 0;          // address + payload bytes on the wire
+    uint32_t nacks = 0;
+    uint64_t busyUs = 0;
+};
+
+// An emulated device on the bus
+class I2cTarget {
+public:
+    I2cBusStats bus;             // traffic addressed to this device
+
+    virtual ~I2cTarget() {}
+    virtual uint8_t i2cAddress() const = 0;
+    // Master write; the first byte is normally the register pointer
+    virtual void i2cWrite(const uint8_t* data, int n) = 0;
+    // Master read of n bytes from the current register pointer
+    virtual void i2cRead(uint8_t* data, int n) = 0;
+};
+
+class TwoWire {
+public:
+    static const int BUFFER_LENGTH = 128;    // arduino-esp32 I2C_BUFFER_LENGTH
+    static const uint32_t DRIVER_OVERHEAD_US = 20;
+
+    TwoWire() : clockHz(100000), txAddr(0), txLen(0), rxLen(0), rxPos(0), txActive(false) {}
+
+    void attach(I2cTarget* target);
+    void detach(I2cTarget* target);
+    void resetStats() { stats = I2cBusStats(); }
+    const I2cBusStats& getStats() const { return stats; }
+
+    bool begin() { return true; }
+    bool begin(int, int) { return true; }
+    void end() {}
+    void setClock(uint32_t hz) { clockHz = hz; }
+    uint32_t getClock() const { return clockHz; }
+    void setTimeOut(uint16_t) {}
+
+    // One int overload each, so every integer mix the libraries pass resolves
+    void beginTransmission(int address);
+    size_t write(uint8_t b);
+    size_t write(const uint8_t* data, size_t n);
+    uint8_t endTransmission(bool sendStop = true);
+
+    uint8_t requestFrom(int address, int n, int sendStop = 1);
+    int available() { return rxLen - rxPos; }
+    int read() { return rxPos < rxLen ? rx[rxPos++] : -1; }
+
+private:
+    static const int MAX_TARGETS = 4;
+    I2cTarget* targets[MAX_TARGETS] = {};
+    uint32_t clockHz;
+    I2cBusStats stats;
+
+    uint8_t txAddr;
+    uint8_t tx[BUFFER_LENGTH];
+    int txLen;
+    uint8_t rx[BUFFER_LENGTH];
+    int rxLen;
+    int rxPos;
+    bool txActive;
+
+    I2cTarget* find(uint8_t address);
+    void charge(I2cTarget* target, int payloadBytes, bool sendStop);
+};
+
+extern TwoWire Wire;
+
+#endif
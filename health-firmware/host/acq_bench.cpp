@@ -0,0 +1,264 @@
+/**
+ * MAX30102 acquisition benchmark on the host.
+ *
+ * Runs each FIFO draining strategy against the register emulator through
+ * the unmodified SparkFun MAX30105 library, with a main loop that spends
+ * --loop-us per pass on other work and stalls for --stall-ms every
+ * --stall-every seconds (a blocking HTTPS upload). Reports samples lost,
+ * bus traffic and sample age per strategy.
+ *
+ *   pio run -e native-emu
+ *   .pio/build/native-emu/program --seconds 120 --stall-ms 500
+ *   .pio/build/native-emu/program --csv finger.csv --csv-rate 100
+ */
+
+#include "Arduino.h"
+#include "Wire.h"
+#include "MAX30105.h"
+#include "max30102_emu.h"
+#define MAX30102_I2C_ADDR Max30102Emu::ADDRESS
+#include "max30102_fifo.h"
+
+struct BenchConfig {
+    double seconds = 60;
+    int sps = 100;
+    int average = 4;
+    uint32_t loopUs = 2000;
+    uint32_t stallMs = 400;
+    double stallEveryS = 5;
+    uint32_t clockHz = I2C_SPEED_STANDARD;
+    double heartRate = 72;
+    double spo2 = 97;
+    const char* csvPath = nullptr;
+    double csvRate = 100;
+    const char* only = nullptr;
+};
+
+// ==================== STRATEGIES ====================
+// The benches only count what the firmware's drain hands over
+struct CountingSink {
+    uint32_t gaps = 0;
+    void onGap() { gaps++; }
+    void onSample(uint32_t, uint32_t) {}
+};
+
+class AcqStrategy {
+public:
+    virtual ~AcqStrategy() {}
+    virtual const char* name() const = 0;
+    virtual const char* about() const = 0;
+    // Rollover stays on for the library path, which is how it shipped
+    virtual bool rollover() const { return false; }
+    virtual void begin(MAX30105&, Max30102Emu&, const BenchConfig&) {}
+    // One main-loop pass; returns samples handed to the DSP
+    virtual int poll(MAX30105& sensor, Max30102Emu& emu) = 0;
+};
+
+// The library's own path: check() copies new samples into its 4-deep ring,
+// the caller drains that ring.
+class LibraryCheck : public AcqStrategy {
+public:
+    const char* name() const override { return "check"; }
+    const char* about() const override { return "SparkFun check() every pass"; }
+    bool rollover() const override { return true; }
+    int poll(MAX30105& sensor, Max30102Emu&) override {
+        sensor.check();
+        int n = 0;
+        while (sensor.available()) {
+            sensor.getFIFOIR();
+            sensor.nextSample();
+            n++;
+        }
+        return n;
+    }
+};
+
+// The firmware's drain (include/max30102_fifo.h), polled at most once per
+// `pollUs`
+class BurstDrain : public AcqStrategy {
+public:
+    BurstDrain(const char* id, const char* text, bool paceByFifo)
+        : id(id), text(text), paceByFifo(paceByFifo), pollUs(0) {}
+    const char* name() const override { return id; }
+    const char* about() const override { return text; }
+
+    void begin(MAX30105&, Max30102Emu& emu, const BenchConfig&) override {
+        // The firmware polls once per FIFO sample; the alternative waits
+        // until about half the FIFO has filled.
+        pollUs = (uint32_t)((paceByFifo ? 16e6 : 1e6) / emu.fifoRateHz());
+        fifo = Max30102Fifo();
+    }
+
+    int poll(MAX30105&, Max30102Emu&) override {
+        int got = fifo.poll(pollUs, sink);
+        return got > 0 ? got : 0;
+    }
+
+private:
+    const char* id;
+    const char* text;
+    bool paceByFifo;
+    uint32_t pollUs;
+    Max30102Fifo fifo;
+    CountingSink sink;
+};
+
+// A_FULL interrupt: the chip pulls INT low with 17 samples queued (15 free,
+// the field is 4 bits wide); the loop only touches the bus when the
+// (latched) pin says so.
+class AlmostFullIrq : public AcqStrategy {
+public:
+    const char* name() const override { return "afull-irq"; }
+    const char* about() const override { return "drain on A_FULL (17 queued)"; }
+    void begin(MAX30105& sensor, Max30102Emu&, const BenchConfig&) override {
+        sensor.setFIFOAlmostFull(15);   // free slots left when INT fires
+        sensor.enableAFULL();
+        sensor.getINT1();               // clear PWR_RDY
+    }
+    int poll(MAX30105& sensor, Max30102Emu& emu) override {
+        if (!emu.intAsserted()) return 0;
+        // Drain before clearing the flag: with 32 queued the drain needs
+        // A_FULL to tell full from empty
+        int got = fifo.poll(0, sink);
+        sensor.getINT1();
+        return got;
+    }
+
+private:
+    Max30102Fifo fifo;
+    CountingSink sink;
+};
+
+// ==================== RUN ====================
+struct RunResult {
+    uint32_t delivered = 0;
+    uint32_t queued = 0;     // still in the FIFO at the end
+    Max30102Emu::Stats chip;
+    I2cBusStats bus;
+    double seconds = 0;
+};
+
+static SignalSource* makeSource(const BenchConfig& cfg, SyntheticPpg& ppg, RecordedSignal& rec) {
+    if (cfg.csvPath) return &rec;
+    ppg.heartRateBpm = cfg.heartRate;
+    ppg.spo2 = cfg.spo2;
+    return &ppg;
+}
+
+static bool runOne(AcqStrategy& strategy, const BenchConfig& cfg, SignalSource* source, RunResult& out) {
+    hostclock::nowUs = 0;
+    Max30102Emu emu(source);
+    Wire.attach(&emu);
+    MAX30105 sensor;
+
+    // Same bring-up as MAX30102Sensor::begin()
+    bool ok = sensor.begin(Wire, cfg.clockHz, Max30102Emu::ADDRESS);
+    if (ok) {
+        sensor.setup(0x7F, cfg.average, 2, cfg.sps, 411, 4096);
+        sensor.setPulseAmplitudeGreen(0);
+        sensor.wakeUp();
+        if (!strategy.rollover()) sensor.disableFIFORollover();
+        sensor.clearFIFO();
+        strategy.begin(sensor, emu, cfg);
+        emu.resetStats();
+        Wire.resetStats();
+
+        uint64_t startUs = hostclock::nowUs;
+        uint64_t endUs = startUs + (uint64_t)(cfg.seconds * 1e6);
+        uint64_t stallEveryUs = (uint64_t)(cfg.stallEveryS * 1e6);
+        uint64_t nextStallUs = startUs + stallEveryUs;
+        while (hostclock::nowUs < endUs) {
+            out.delivered += strategy.poll(sensor, emu);
+            delayMicroseconds(cfg.loopUs);
+            if (cfg.stallMs && stallEveryUs && hostclock::nowUs >= nextStallUs) {
+                delay(cfg.stallMs);
+                nextStallUs += stallEveryUs;
+            }
+        }
+        emu.sync();
+        out.chip = emu.getStats();
+        out.queued = emu.queued();
+        out.bus = Wire.getStats();
+        out.seconds = (hostclock::nowUs - startUs) / 1e6;
+    }
+    Wire.detach(&emu);
+    return ok;
+}
+
+static void printRow(const AcqStrategy& s, const RunResult& r) {
+    // Whatever the caller never saw: dropped at the chip, overwritten by
+    // rollover, or popped by check() and then overwritten in its ring
+    uint32_t lost = r.chip.produced - r.delivered - r.queued;
+    double busMs = r.bus.busyUs / 1000.0;
+    printf("%-11s %8u %7u %6.2f%% %7u %8u %8.1f %5.2f%% %6.1f %7.1f %7.1f   %s\n",
+           s.name(), r.delivered, lost, r.chip.produced ? 100.0 * lost / r.chip.produced : 0.0,
+           r.bus.transactions, r.bus.bytes, busMs, 100.0 * busMs / (r.seconds * 1000.0),
+           r.delivered ? (double)r.bus.bytes / r.delivered : 0.0,
+           r.chip.popped ? r.chip.ageUsSum / 1000.0 / r.chip.popped : 0.0, r.chip.ageUsMax / 1000.0,
+           s.about());
+}
+
+static void usage() {
+    puts("acq_bench [--seconds S] [--sps 50|100|...] [--avg 1|2|4|8|16|32] [--loop-us US]\n"
+         "          [--stall-ms MS] [--stall-every S] [--clock HZ] [--hr BPM] [--spo2 PCT]\n"
+         "          [--csv FILE [--csv-rate HZ]] [--strategy NAME]");
+}
+
+int main(int argc, char** argv) {
+    BenchConfig cfg;
+    for (int i = 1; i < argc; i++) {
+        const char* a = argv[i];
+        const char* v = i + 1 < argc ? argv[i + 1] : nullptr;
+        if (!strcmp(a, "--help") || !v) {
+            usage();
+            return strcmp(a, "--help") ? 2 : 0;
+        }
+        i++;
+        if (!strcmp(a, "--seconds")) cfg.seconds = atof(v);
+        else if (!strcmp(a, "--sps")) cfg.sps = atoi(v);
+        else if (!strcmp(a, "--avg")) cfg.average = atoi(v);
+        else if (!strcmp(a, "--loop-us")) cfg.loopUs = atoi(v);
+        else if (!strcmp(a, "--stall-ms")) cfg.stallMs = atoi(v);
+        else if (!strcmp(a, "--stall-every")) cfg.stallEveryS = atof(v);
+        else if (!strcmp(a, "--clock")) cfg.clockHz = atoi(v);
+        else if (!strcmp(a, "--hr")) cfg.heartRate = atof(v);
+        else if (!strcmp(a, "--spo2")) cfg.spo2 = atof(v);
+        else if (!strcmp(a, "--csv")) cfg.csvPath = v;
+        else if (!strcmp(a, "--csv-rate")) cfg.csvRate = atof(v);
+        else if (!strcmp(a, "--strategy")) cfg.only = v;
+        else {
+            usage();
+            return 2;
+        }
+    }
+
+    SyntheticPpg ppg;
+    RecordedSignal rec;
+    if (cfg.csvPath && !rec.load(cfg.csvPath, cfg.csvRate)) {
+        fprintf(stderr, "cannot read red,ir samples from %s\n", cfg.csvPath);
+        return 1;
+    }
+    SignalSource* source = makeSource(cfg, ppg, rec);
+
+    LibraryCheck check;
+    BurstDrain burst("burst", "firmware readFifo(), paced at the FIFO rate", false);
+    BurstDrain lazy("burst-half", "same drain, paced at half a FIFO", true);
+    AlmostFullIrq irq;
+    AcqStrategy* strategies[] = {&check, &burst, &lazy, &irq};
+
+    printf("%.0f s, %d sps / avg %d, I2C %lu Hz, loop %lu us, stall %lu ms every %.1f s, %s\n\n",
+           cfg.seconds, cfg.sps, cfg.average, (unsigned long)cfg.clockHz, (unsigned long)cfg.loopUs,
+           (unsigned long)cfg.stallMs, cfg.stallEveryS, cfg.csvPath ? cfg.csvPath : "synthetic PPG");
+    printf("%-11s %8s %7s %7s %7s %8s %8s %6s %6s %7s %7s\n", "strategy", "samples", "lost", "",
+           "i2c_tx", "bytes", "bus_ms", "bus%", "B/smp", "age_ms", "max_ms");
+    for (AcqStrategy* s : strategies) {
+        if (cfg.only && strcmp(cfg.only, s->name())) continue;
+        RunResult r;
+        if (!runOne(*s, cfg, source, r)) {
+            fprintf(stderr, "%s: MAX30105 begin() failed\n", s->name());
+            return 1;
+        }
+        printRow(*s, r);
+    }
+    return 0;
+}
@@ -0,0 +1,24 @@
+/**
+ * Host stand-in for the ESP-IDF system API: shutdown handlers are recorded
+ * so a test can run them as esp_restart() would.
+ */
+
+#ifndef HOST_ESP_SYSTEM_H
+#define HOST_ESP_SYSTEM_H
+
+typedef void (*shutdown_handler_t)(void);
+typedef int esp_err_t;
+
+namespace hostsystem {
+inline shutdown_handler_t& shutdownHandler() {
+    static shutdown_handler_t handler = nullptr;
+    return handler;
+}
+}
+
+inline esp_err_t esp_register_shutdown_handler(shutdown_handler_t handler) {
+    hostsystem::shutdownHandler() = handler;
+    return 0;
+}
+
+#endif
@@ -0,0 +1,230 @@
+/**
+ * History-sync compression benchmark on the host.
+ *
+ * Builds several nights of synthetic offline backlog (5 s records: slow
+ * HR/SpO2 drift, restless spells, desaturation dips, a few gap placeholders),
+ * formats it into chunks exactly as sendHistoryChunk() does and runs every
+ * chunk through the firmware's GzipEncoder at each level. Reports ratio
+ * against CPU cycles per input byte, checks that zlib inflates every chunk
+ * back to the same JSON, and shows zlib's own levels for reference. The
+ * drain estimate compares one TLS handshake per chunk with one per burst on
+ * a kept-alive connection.
+ *
+ *   pio run -e native-gzip
+ *   .pio/build/native-gzip/program --nights 3 --link-kbps 1000 --tls-ms 700
+ */
+
+#include <chrono>
+#include <string>
+#include <vector>
+#include <zlib.h>
+
+#include "Arduino.h"
+#include "gzip_encoder.h"
+#include "vitals_record.h"
+
+struct BenchConfig {
+    double nights = 3;
+    uint32_t intervalS = 5;      // CLOUD_SYNC_INTERVAL
+    uint32_t chunk = 96;         // BACKLOG_BATCH_RECORDS
+    size_t bufferSize = 16384;   // BACKLOG_BUFFER_SIZE
+    double linkKbps = 1000;      // TLS payload throughput
+    double rttMs = 120;
+    double tlsMs = 700;          // ESP32 handshake incl. certificate checks
+    double burstS = 3;           // RADIO_BURST_MAX_MS
+    uint32_t seed = 12345;
+};
+
+// ==================== SYNTHETIC BACKLOG ====================
+static uint32_t nextRand(uint32_t& seed) {
+    seed = seed * 1103515245 + 12345;
+    return seed >> 8;
+}
+
+static std::vector<VitalsRecord> makeBacklog(const BenchConfig& cfg) {
+    std::vector<VitalsRecord> out;
+    uint32_t n = (uint32_t)(cfg.nights * 8 * 3600 / cfg.intervalS);
+    uint32_t seed = cfg.seed;
+    double hr = 62, spo2 = 96, temp = 36.5;
+    int restless = 0, dip = 0;
+    for (uint32_t i = 0; i < n; i++) {
+        VitalsRecord r = {};
+        r.seq = 1000 + i;
+        r.timestamp = 1700000000 + i * cfg.intervalS;
+        if (nextRand(seed) % 20000 == 0) {
+            r.flags = VR_GAP;
+            out.push_back(r);
+            continue;
+        }
+        if (restless == 0 && nextRand(seed) % 400 == 0) restless = 30 + nextRand(seed) % 90;
+        if (dip == 0 && nextRand(seed) % 600 == 0) dip = 3 + nextRand(seed) % 6;
+        double target = restless ? 78 : 58;
+        hr += (target - hr) * 0.05 + ((int)(nextRand(seed) % 5) - 2) * 0.4;
+        spo2 += ((dip ? 91 : 96) - spo2) * 0.3 + ((int)(nextRand(seed) % 3) - 1) * 0.3;
+        temp += (36.6 - temp) * 0.001 + ((int)(nextRand(seed) % 3) - 1) * 0.01;
+        if (restless) restless--;
+        if (dip) dip--;
+        r.heartRate = (uint8_t)lround(hr);
+        r.hrQuality = restless ? 40 + nextRand(seed) % 40 : 75 + nextRand(seed) % 21;
+        r.spo2 = (uint8_t)lround(spo2);
+        r.spo2Quality = restless ? 35 + nextRand(seed) % 40 : 80 + nextRand(seed) % 16;
+        r.tempCenti = (int16_t)lround(temp * 100);
+        if (r.spo2 < 92) r.flags |= VR_ALERT;
+        out.push_back(r);
+    }
+    return out;
+}
+
+// ==================== MEASUREMENT ====================
+static inline uint64_t cycleCount() {
+#if defined(__x86_64__) || defined(__i386__)
+    return __builtin_ia32_rdtsc();
+#else
+    return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+}
+
+static bool gunzipMatches(const uint8_t* gz, size_t gzLen, const char* json, size_t len) {
+    std::vector<uint8_t> out(len + 1);
+    z_stream zs = {};
+    if (inflateInit2(&zs, 16 + MAX_WBITS) != Z_OK) return false;
+    zs.next_in = (Bytef*)gz;
+    zs.avail_in = (uInt)gzLen;
+    zs.next_out = out.data();
+    zs.avail_out = (uInt)out.size();
+    int rc = inflate(&zs, Z_FINISH);
+    size_t got = zs.total_out;
+    inflateEnd(&zs);
+    return rc == Z_STREAM_END && got == len && memcmp(out.data(), json, len) == 0;
+}
+
+static size_t zlibGzip(const char* json, size_t len, int level, std::vector<uint8_t>& out) {
+    z_stream zs = {};
+    if (deflateInit2(&zs, level, Z_DEFLATED, 16 + MAX_WBITS, 8, Z_DEFAULT_STRATEGY) != Z_OK) return 0;
+    out.resize(deflateBound(&zs, len));
+    zs.next_in = (Bytef*)json;
+    zs.avail_in = (uInt)len;
+    zs.next_out = out.data();
+    zs.avail_out = (uInt)out.size();
+    deflate(&zs, Z_FINISH);
+    size_t n = zs.total_out;
+    deflateEnd(&zs);
+    return n;
+}
+
+struct LevelResult {
+    uint64_t gzBytes = 0;
+    uint64_t cycles = 0;
+    uint32_t mismatches = 0;
+};
+
+static void usage() {
+    puts("gzip_bench [--nights N] [--interval-s S] [--chunk RECORDS] [--link-kbps KBPS]\n"
+         "           [--rtt-ms MS] [--tls-ms MS] [--burst-s S] [--seed N]");
+}
+
+int main(int argc, char** argv) {
+    BenchConfig cfg;
+    for (int i = 1; i < argc; i++) {
+        const char* a = argv[i];
+        const char* v = i + 1 < argc ? argv[i + 1] : nullptr;
+        if (!strcmp(a, "--help") || !v) {
+            usage();
+            return strcmp(a, "--help") ? 2 : 0;
+        }
+        i++;
+        if (!strcmp(a, "--nights")) cfg.nights = atof(v);
+        else if (!strcmp(a, "--interval-s")) cfg.intervalS = atoi(v);
+        else if (!strcmp(a, "--chunk")) cfg.chunk = atoi(v);
+        else if (!strcmp(a, "--link-kbps")) cfg.linkKbps = atof(v);
+        else if (!strcmp(a, "--rtt-ms")) cfg.rttMs = atof(v);
+        else if (!strcmp(a, "--tls-ms")) cfg.tlsMs = atof(v);
+        else if (!strcmp(a, "--burst-s")) cfg.burstS = atof(v);
+        else if (!strcmp(a, "--seed")) cfg.seed = atoi(v);
+        else {
+            usage();
+            return 2;
+        }
+    }
+    if (cfg.chunk == 0 || cfg.intervalS == 0) {
+        usage();
+        return 2;
+    }
+
+    // Same chunking as sendHistoryChunk(): up to `chunk` records, fewer if
+    // the JSON would not fit the batch buffer
+    std::vector<VitalsRecord> backlog = makeBacklog(cfg);
+    std::vector<std::string> chunks;
+    std::vector<char> body(cfg.bufferSize);
+    uint64_t jsonBytes = 0;
+    for (size_t pos = 0; pos < backlog.size();) {
+        uint32_t want = (uint32_t)min((size_t)cfg.chunk, backlog.size() - pos);
+        uint32_t used = 0;
+        size_t len = formatVitalsBatch(&backlog[pos], want, "HEALTH_DEVICE_001", body.data(), body.size(), used);
+        if (used == 0) break;
+        if (len) {
+            chunks.push_back(std::string(body.data(), len));
+            jsonBytes += len;
+        }
+        pos += used;
+    }
+
+    printf("%.1f nights, %zu records, %zu chunks of <= %u records, %.1f KB JSON\n\n", cfg.nights,
+           backlog.size(), chunks.size(), cfg.chunk, jsonBytes / 1024.0);
+    printf("%-8s %10s %7s %10s %9s\n", "encoder", "bytes", "ratio", "cyc/byte", "verified");
+
+    GzipEncoder encoder;
+    std::vector<uint8_t> gz(cfg.bufferSize);
+    uint64_t firmwareBytes = 0;
+    for (int level = 1; level <= 3; level++) {
+        LevelResult r;
+        for (const std::string& c : chunks) {
+            uint64_t c0 = cycleCount();
+            size_t n = encoder.compress((const uint8_t*)c.data(), c.size(), gz.data(), gz.size(), level);
+            r.cycles += cycleCount() - c0;
+            // sendHistoryChunk() falls back to the plain body when gzip does not help
+            if (n == 0 || n >= c.size()) {
+                r.gzBytes += c.size();
+                continue;
+            }
+            r.gzBytes += n;
+            if (!gunzipMatches(gz.data(), n, c.data(), c.size())) r.mismatches++;
+        }
+        if (level == 3) firmwareBytes = r.gzBytes;
+        char name[16];
+        snprintf(name, sizeof(name), "fw L%d", level);
+        printf("%-8s %10llu %7.2f %10.1f %9s\n", name, (unsigned long long)r.gzBytes,
+               r.gzBytes ? (double)jsonBytes / r.gzBytes : 0.0, jsonBytes ? (double)r.cycles / jsonBytes : 0.0,
+               r.mismatches ? "FAIL" : "ok");
+        if (r.mismatches) {
+            fprintf(stderr, "fw L%d: %u chunks did not inflate to their input\n", level, r.mismatches);
+            return 1;
+        }
+    }
+    for (int level : {1, 6, 9}) {
+        std::vector<uint8_t> out;
+        uint64_t bytes = 0, cycles = 0;
+        for (const std::string& c : chunks) {
+            uint64_t c0 = cycleCount();
+            bytes += zlibGzip(c.data(), c.size(), level, out);
+            cycles += cycleCount() - c0;
+        }
+        char name[16];
+        snprintf(name, sizeof(name), "zlib -%d", level);
+        printf("%-8s %10llu %7.2f %10.1f %9s\n", name, (unsigned long long)bytes,
+               bytes ? (double)jsonBytes / bytes : 0.0, jsonBytes ? (double)cycles / jsonBytes : 0.0, "-");
+    }
+
+    // Radio time to drain the backlog at fw L3: one request per chunk, with
+    // a handshake per chunk vs one per burst on the kept-alive connection
+    double transferS = firmwareBytes * 8 / (cfg.linkKbps * 1000) + chunks.size() * cfg.rttMs / 1000;
+    double perChunkS = transferS + chunks.size() * cfg.tlsMs / 1000;
+    double bursts = ceil(transferS / max(cfg.burstS - cfg.tlsMs / 1000, 0.1));
+    double reusedS = transferS + bursts * cfg.tlsMs / 1000;
+    printf("\ndrain at fw L3, %.0f kbps, %.0f ms RTT, %.0f ms TLS handshake:\n", cfg.linkKbps, cfg.rttMs,
+           cfg.tlsMs);
+    printf("  new connection per chunk   %7.1f s radio time\n", perChunkS);
+    printf("  kept alive per %.1f s burst %7.1f s radio time (%.0f handshakes)\n", cfg.burstS, reusedS, bursts);
+    return 0;
+}
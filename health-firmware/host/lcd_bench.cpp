@@ -0,0 +1,328 @@
+/**
+ * LCD rendering benchmark on the host.
+ *
+ * Drives the unmodified LiquidCrystal_I2C library against the virtual
+ * 20x4 LCD. The MAX30102 emulator shares the same 100 kHz bus and is
+ * drained the way the firmware drains it. Simulated vitals change at a
+ * realistic pace, the screens rotate every --rotate seconds, and each
+ * renderer draws the firmware's screens every LCD_UPDATE_INTERVAL (500 ms).
+ * For each renderer it reports:
+ *   - the LCD bus cost and blocking time per update
+ *   - the cost of a screen switch
+ *   - the delay this adds to MAX30102 samples
+ *   - whether the glass ended up showing the intended text (snapshot check)
+ *
+ *   pio run -e native-lcd
+ *   .pio/build/native-lcd/program --seconds 120 --dump
+ */
+
+#include "Arduino.h"
+#include "Wire.h"
+#include "LiquidCrystal_I2C.h"
+#include "MAX30105.h"
+#include "max30102_emu.h"
+#include "lcd_screens.h"
+#define MAX30102_I2C_ADDR Max30102Emu::ADDRESS
+#include "max30102_fifo.h"
+#include "virtual_lcd.h"
+
+// FIFO samples are only counted; the bench measures the shared bus
+struct FifoCounter {
+    void onGap() {}
+    void onSample(uint32_t, uint32_t) {}
+};
+
+static const int COLS = VirtualLcd::COLS;
+static const int ROWS = VirtualLcd::ROWS;
+static_assert(COLS == LCD_COLS && ROWS == LCD_ROWS, "virtual LCD geometry differs from the firmware's");
+
+struct BenchConfig {
+    double seconds = 60;
+    double rotateS = 10;
+    uint32_t loopUs = 2000;
+    uint32_t updateMs = 500;      // LCD_UPDATE_INTERVAL
+    uint32_t clockHz = 100000;
+    bool dump = false;
+    const char* only = nullptr;
+};
+
+// ==================== SIMULATED UI STATE ====================
+// Vitals move at bedside pace: HR most updates, SpO2 and temperature now
+// and then, an alert every minute or so.
+class SimVitals {
+public:
+    int heartRate = 72;
+    int spo2 = 97;
+    float temperature = 36.6f;
+    const char* source = "MAX30102";
+    bool alert = false;
+    bool maxFinger = true;
+    int batteryPct = 86;
+
+    void step() {
+        if (chance(50)) heartRate = constrainInt(heartRate + (int)(next() % 5) - 2, 55, 110);
+        if (chance(10)) spo2 = constrainInt(spo2 + (next() & 1 ? 1 : -1), 92, 99);
+        if (chance(10)) temperature += (next() & 1 ? 0.1f : -0.1f);
+        if (chance(2)) alert = !alert;
+        if (chance(1)) source = source[0] == 'M' ? "SEN11574" : "MAX30102";
+        if (chance(1)) batteryPct = max(0, batteryPct - 1);
+    }
+
+    // updateLCD()'s rows for screen 0 and 1
+    void render(int screen, LcdRows rows) const {
+        if (screen == 0) {
+            LcdVitalsScreen s = {heartRate, spo2, temperature, source, "[MON] ", alert ? "HR HIGH 112" : ""};
+            lcdFormatVitals(s, rows);
+        } else {
+            LcdStatusScreen s = {"4.1", true, millis() / 60000, maxFinger, true, batteryPct};
+            lcdFormatStatus(s, rows);
+        }
+    }
+
+private:
+    uint32_t rng = 0x9E3779B9;
+    uint32_t next() {
+        rng ^= rng << 13;
+        rng ^= rng >> 17;
+        rng ^= rng << 5;
+        return rng;
+    }
+    bool chance(int pct) { return (int)(next() % 100) < pct; }
+    static int constrainInt(int v, int lo, int hi) { return v < lo ? lo : v > hi ? hi : v; }
+};
+
+// ==================== RENDERERS ====================
+class LcdRenderer {
+public:
+    virtual ~LcdRenderer() {}
+    virtual const char* name() const = 0;
+    virtual const char* about() const = 0;
+    virtual void draw(LiquidCrystal_I2C& lcd, const char rows[ROWS][COLS + 1], bool screenChanged) = 0;
+};
+
+// Clear and print everything on every update
+class ClearRedraw : public LcdRenderer {
+public:
+    const char* name() const override { return "clear"; }
+    const char* about() const override { return "clear() + all rows each update"; }
+    void draw(LiquidCrystal_I2C& lcd, const char rows[ROWS][COLS + 1], bool) override {
+        lcd.clear();
+        for (int r = 0; r < ROWS; r++) {
+            lcd.setCursor(0, r);
+            lcd.print(rows[r]);
+        }
+    }
+};
+
+// updateLCD(): clear on a screen switch, otherwise rewrite changed rows in
+// full, padded to 20 (lcdPrintRow)
+class RowRedraw : public LcdRenderer {
+public:
+    const char* name() const override { return "rows"; }
+    const char* about() const override { return "firmware: changed rows, padded"; }
+    void draw(LiquidCrystal_I2C& lcd, const char rows[ROWS][COLS + 1], bool screenChanged) override {
+        if (screenChanged) lcd.clear();
+        for (int r = 0; r < ROWS; r++) {
+            if (!screenChanged && !strcmp(shown[r], rows[r])) continue;
+            char line[COLS + 1];
+            lcdPadRow(line, rows[r]);
+            lcd.setCursor(0, r);
+            lcd.print(line);
+            strcpy(shown[r], rows[r]);
+        }
+    }
+
+private:
+    char shown[ROWS][COLS + 1] = {};
+};
+
+// Character diff against a shadow of the glass. Only runs of changed cells
+// are written. Runs separated by a single unchanged cell are merged,
+// because a setCursor() costs as much as one character. A screen switch
+// is just a bigger diff, with no clear().
+class SpanDiff : public LcdRenderer {
+public:
+    SpanDiff() { memset(shadow, ' ', sizeof(shadow)); }
+    const char* name() const override { return "spans"; }
+    const char* about() const override { return "changed character runs only"; }
+    void draw(LiquidCrystal_I2C& lcd, const char rows[ROWS][COLS + 1], bool) override {
+        for (int r = 0; r < ROWS; r++) {
+            char line[COLS + 1];
+            lcdPadRow(line, rows[r]);
+            int c = 0;
+            while (c < COLS) {
+                if (line[c] == shadow[r][c]) {
+                    c++;
+                    continue;
+                }
+                int end = c + 1;
+                while (end < COLS && (line[end] != shadow[r][end] ||
+                                      (end + 1 < COLS && line[end + 1] != shadow[r][end + 1])))
+                    end++;
+                lcd.setCursor(c, r);
+                for (int i = c; i < end; i++) lcd.write((uint8_t)line[i]);
+                memcpy(shadow[r] + c, line + c, end - c);
+                c = end;
+            }
+        }
+    }
+
+private:
+    char shadow[ROWS][COLS];
+};
+
+// ==================== RUN ====================
+struct RunResult {
+    uint32_t updates = 0;
+    uint32_t mismatches = 0;     // updates after which the glass was wrong
+    uint64_t updateUsSum = 0;
+    uint32_t updateUsMax = 0;
+    uint64_t switchUsSum = 0;
+    uint32_t switches = 0;
+    I2cBusStats lcdBus;
+    I2cBusStats sensorBus;
+    VirtualLcd::Stats lcd;
+    Max30102Emu::Stats chip;
+    uint32_t delivered = 0;
+    double seconds = 0;
+};
+
+static bool runOne(LcdRenderer& renderer, const BenchConfig& cfg, RunResult& out) {
+    hostclock::nowUs = 0;
+    SyntheticPpg ppg;
+    Max30102Emu emu(&ppg);
+    VirtualLcd glass;
+    Wire.attach(&emu);
+    Wire.attach(&glass);
+    Wire.setClock(cfg.clockHz);
+
+    LiquidCrystal_I2C lcd(glass.i2cAddress(), COLS, ROWS);
+    lcd.init();
+    lcd.backlight();
+    MAX30105 sensor;
+    bool ok = sensor.begin(Wire, cfg.clockHz, Max30102Emu::ADDRESS);
+    if (ok) {
+        sensor.setup(0x7F, 4, 2, 100, 411, 4096);
+        sensor.disableFIFORollover();
+        sensor.clearFIFO();
+        emu.resetStats();
+        glass.resetStats();
+        emu.bus = I2cBusStats();
+        glass.bus = I2cBusStats();
+
+        SimVitals vitals;
+        int screen = 0, shownScreen = -1;
+        uint64_t startUs = hostclock::nowUs;
+        uint64_t endUs = startUs + (uint64_t)(cfg.seconds * 1e6);
+        uint64_t lastLcdUs = startUs;
+        Max30102Fifo fifo;
+        FifoCounter sink;
+        uint32_t fifoPeriodUs = (uint32_t)(1e6 / emu.fifoRateHz());
+        uint64_t nextRotateUs = startUs + (uint64_t)(cfg.rotateS * 1e6);
+        while (hostclock::nowUs < endUs) {
+            int got = fifo.poll(fifoPeriodUs, sink);   // readFifo(): one FIFO sample period
+            if (got > 0) out.delivered += got;
+            if (hostclock::nowUs >= nextRotateUs) {
+                screen ^= 1;
+                nextRotateUs += (uint64_t)(cfg.rotateS * 1e6);
+            }
+            if (hostclock::nowUs - lastLcdUs >= cfg.updateMs * 1000ULL) {
+                lastLcdUs = hostclock::nowUs;
+                vitals.step();
+                LcdRows rows;
+                vitals.render(screen, rows);
+                bool switched = screen != shownScreen;
+
+                uint64_t t0 = hostclock::nowUs;
+                renderer.draw(lcd, rows, switched);
+                uint32_t us = (uint32_t)(hostclock::nowUs - t0);
+
+                out.updates++;
+                out.updateUsSum += us;
+                if (us > out.updateUsMax) out.updateUsMax = us;
+                if (switched && shownScreen >= 0) {
+                    out.switches++;
+                    out.switchUsSum += us;
+                }
+                const char* const expect[ROWS] = {rows[0], rows[1], rows[2], rows[3]};
+                if (!glass.matches(expect)) out.mismatches++;
+                if (cfg.dump && switched) printf("%s screen %d at %.1f s\n%s", renderer.name(), screen,
+                                                 (hostclock::nowUs - startUs) / 1e6, glass.snapshot().c_str());
+                shownScreen = screen;
+            }
+            delayMicroseconds(cfg.loopUs);
+        }
+        emu.sync();
+        out.chip = emu.getStats();
+        out.lcd = glass.getStats();
+        out.lcdBus = glass.bus;
+        out.sensorBus = emu.bus;
+        out.seconds = (hostclock::nowUs - startUs) / 1e6;
+        if (cfg.dump) printf("%s final\n%s\n", renderer.name(), glass.snapshot().c_str());
+    }
+    Wire.detach(&emu);
+    Wire.detach(&glass);
+    return ok;
+}
+
+static void printRow(const LcdRenderer& r, const RunResult& res) {
+    double n = res.updates ? res.updates : 1;
+    printf("%-6s %7.1f %7.1f %7.2f %7.2f %7.2f %6.2f%% %7.1f %7.1f %6u %4u %4u   %s\n", r.name(),
+           res.lcdBus.transactions / n, res.lcdBus.bytes / n, res.updateUsSum / n / 1000.0,
+           res.updateUsMax / 1000.0, res.switches ? res.switchUsSum / 1000.0 / res.switches : 0.0,
+           100.0 * res.lcdBus.busyUs / (res.seconds * 1e6),
+           res.chip.popped ? res.chip.ageUsSum / 1000.0 / res.chip.popped : 0.0, res.chip.ageUsMax / 1000.0,
+           res.chip.dropped, res.mismatches, res.lcd.busyViolations, r.about());
+}
+
+static void usage() {
+    puts("lcd_bench [--seconds S] [--rotate S] [--update-ms MS] [--loop-us US] [--clock HZ]\n"
+         "          [--renderer clear|rows|spans] [--dump]");
+}
+
+int main(int argc, char** argv) {
+    BenchConfig cfg;
+    for (int i = 1; i < argc; i++) {
+        const char* a = argv[i];
+        if (!strcmp(a, "--dump")) {
+            cfg.dump = true;
+            continue;
+        }
+        const char* v = i + 1 < argc ? argv[i + 1] : nullptr;
+        if (!strcmp(a, "--help") || !v) {
+            usage();
+            return strcmp(a, "--help") ? 2 : 0;
+        }
+        i++;
+        if (!strcmp(a, "--seconds")) cfg.seconds = atof(v);
+        else if (!strcmp(a, "--rotate")) cfg.rotateS = atof(v);
+        else if (!strcmp(a, "--update-ms")) cfg.updateMs = atoi(v);
+        else if (!strcmp(a, "--loop-us")) cfg.loopUs = atoi(v);
+        else if (!strcmp(a, "--clock")) cfg.clockHz = atoi(v);
+        else if (!strcmp(a, "--renderer")) cfg.only = v;
+        else {
+            usage();
+            return 2;
+        }
+    }
+
+    ClearRedraw clear;
+    RowRedraw rows;
+    SpanDiff spans;
+    LcdRenderer* renderers[] = {&clear, &rows, &spans};
+
+    printf("%.0f s, LCD every %lu ms, screen switch every %.0f s, I2C %lu Hz, MAX30102 100 sps / avg 4\n\n",
+           cfg.seconds, (unsigned long)cfg.updateMs, cfg.rotateS, (unsigned long)cfg.clockHz);
+    printf("%-6s %7s %7s %7s %7s %7s %7s %7s %7s %6s %4s %4s\n", "render", "tx/upd", "B/upd", "upd_ms",
+           "max_ms", "swt_ms", "bus%", "age_ms", "max_ms", "lost", "bad", "busy");
+    for (LcdRenderer* r : renderers) {
+        if (cfg.only && strcmp(cfg.only, r->name())) continue;
+        RunResult res;
+        if (!runOne(*r, cfg, res)) {
+            fprintf(stderr, "%s: MAX30105 begin() failed\n", r->name());
+            return 1;
+        }
+        printRow(*r, res);
+    }
+    return 0;
+}
@@ -0,0 +1,339 @@
+#include "max30102_emu.h"
+
+// ==================== SIGNAL SOURCES ====================
+double SyntheticPpg::gaussian() {
+    // xorshift32 + Box-Muller; deterministic per seed
+    double u[2];
+    for (int i = 0; i < 2; i++) {
+        rng ^= rng << 13;
+        rng ^= rng >> 17;
+        rng ^= rng << 5;
+        u[i] = (rng + 1.0) / 4294967297.0;
+    }
+    return sqrt(-2.0 * log(u[0])) * cos(2.0 * M_PI * u[1]);
+}
+
+void SyntheticPpg::sample(double tSec, double& red, double& ir) {
+    double phase = fmod(tSec * heartRateBpm / 60.0, 1.0);
+    double s = (phase - 0.15) / 0.06;
+    double d = (phase - 0.45) / 0.08;
+    double pulse = exp(-s * s) + 0.35 * exp(-d * d);   // 0..~1
+    double r = (110.0 - spo2) / 25.0;
+    double breath = 1.0 + respirationDepth * sin(2.0 * M_PI * respirationHz * tSec);
+    // More blood in systole absorbs more light, so the detected level dips
+    ir = irDc * breath * (1.0 - perfusion * pulse) + noise * gaussian();
+    red = redDc * breath * (1.0 - perfusion * r * pulse) + noise * gaussian();
+}
+
+RecordedSignal::~RecordedSignal() { free(data); }
+
+bool RecordedSignal::load(const char* path, double sampleRateHz) {
+    FILE* f = fopen(path, "r");
+    if (!f) return false;
+    size_t cap = 0;
+    char line[128];
+    while (fgets(line, sizeof(line), f)) {
+        double red, ir;
+        if (sscanf(line, "%lf%*[ ,;\t]%lf", &red, &ir) != 2) continue;   // header, blank
+        if (count == cap) {
+            cap = cap ? cap * 2 : 4096;
+            double* grown = (double*)realloc(data, cap * 2 * sizeof(double));
+            if (!grown) break;
+            data = grown;
+        }
+        data[2 * count] = red;
+        data[2 * count + 1] = ir;
+        count++;
+    }
+    fclose(f);
+    rateHz = sampleRateHz;
+    return count > 1;
+}
+
+void RecordedSignal::sample(double tSec, double& red, double& ir) {
+    double pos = fmod(tSec * rateHz, (double)count);
+    size_t i = (size_t)pos;
+    size_t j = (i + 1) % count;
+    double w = pos - i;
+    red = data[2 * i] * (1 - w) + data[2 * j] * w;
+    ir = data[2 * i + 1] * (1 - w) + data[2 * j + 1] * w;
+}
+
+// ==================== EMULATOR ====================
+Max30102Emu::Max30102Emu(SignalSource* source, uint8_t partId)
+    : source(source), regPtr(0), partId(partId), dieTempC(31.5f), intWasAsserted(false) {
+    reset();
+}
+
+void Max30102Emu::reset() {
+    memset(regs, 0, sizeof(regs));
+    regs[INT_STATUS1] = INT_PWR_RDY;
+    unread = 0;
+    bytePos = 0;
+    lastUs = hostclock::nowUs;
+    nextConvUs = (double)hostclock::nowUs;
+    avgCount = 0;
+    memset(avgAcc, 0, sizeof(avgAcc));
+    tempReadyUs = 0;
+    updateIntPin();
+}
+
+int Max30102Emu::averaging() const {
+    int code = regs[FIFO_CONFIG] >> 5;
+    return code >= 5 ? 32 : 1 << code;
+}
+
+uint32_t Max30102Emu::adcRateHz() const {
+    static const uint32_t RATES[8] = {50, 100, 200, 400, 800, 1000, 1600, 3200};
+    return RATES[(regs[SPO2_CONFIG] >> 2) & 0x07];
+}
+
+int Max30102Emu::resolutionBits() const { return 15 + (regs[SPO2_CONFIG] & 0x03); }
+
+double Max30102Emu::fifoRateHz() const { return (double)adcRateHz() / averaging(); }
+
+// Received light scales with LED current and integration time, and the
+// count with the inverse of the ADC full scale.
+double Max30102Emu::channelGain(uint8_t ledPa) const {
+    static const double PW_US[4] = {69, 118, 215, 411};
+    double range = 2048 << ((regs[SPO2_CONFIG] >> 5) & 0x03);
+    return (ledPa / 127.0) * (PW_US[regs[SPO2_CONFIG] & 0x03] / 411.0) * (4096.0 / range);
+}
+
+uint8_t Max30102Emu::slotLed(int slot) const {
+    uint8_t r = regs[slot < 2 ? MULTI_LED1 : MULTI_LED2];
+    return (slot & 1 ? r >> 4 : r) & 0x07;
+}
+
+int Max30102Emu::activeChannels() const {
+    switch (regs[MODE_CONFIG] & 0x07) {
+        case 0x02: return 1;   // HR: red
+        case 0x03: return 2;   // SpO2: red, IR
+        case 0x07: {
+            int n = 0;
+            for (int s = 0; s < 4 && n < 3; s++)
+                if (slotLed(s) >= 1 && slotLed(s) <= 3) n++;
+            return n;
+        }
+        default: return 0;
+    }
+}
+
+void Max30102Emu::advanceTo(uint64_t us) {
+    if (us < lastUs) return;
+    bool running = !(regs[MODE_CONFIG] & 0x80) && activeChannels() > 0;
+    if (running) {
+        double period = 1e6 / adcRateHz();
+        while (nextConvUs <= (double)us) {
+            convert((uint64_t)nextConvUs);
+            nextConvUs += period;
+        }
+    } else {
+        nextConvUs = (double)us;
+    }
+    if (tempReadyUs && us >= tempReadyUs) {
+        float t = dieTempC;
+        regs[TEMP_INT] = (uint8_t)(int8_t)floorf(t);
+        regs[TEMP_FRAC] = (uint8_t)((t - floorf(t)) * 16);   // 0.0625 C steps
+        regs[TEMP_CONFIG] &= ~0x01;
+        regs[INT_STATUS2] |= INT_DIE_TEMP_RDY;
+        tempReadyUs = 0;
+        updateIntPin();
+    }
+    lastUs = us;
+}
+
+// One ADC conversion; every `averaging()` of them make a FIFO sample
+void Max30102Emu::convert(uint64_t atUs) {
+    double red = 0, ir = 0;
+    if (source) source->sample(atUs / 1e6, red, ir);
+
+    uint8_t leds[3];
+    int channels = 0;
+    uint8_t mode = regs[MODE_CONFIG] & 0x07;
+    if (mode == 0x02 || mode == 0x03) {
+        leds[channels++] = 1;
+        if (mode == 0x03) leds[channels++] = 2;
+    } else {
+        for (int s = 0; s < 4 && channels < 3; s++) {
+            uint8_t led = slotLed(s);
+            if (led >= 1 && led <= 3) leds[channels++] = led;
+        }
+    }
+    for (int c = 0; c < channels; c++) {
+        double light = leds[c] == 1 ? red : leds[c] == 2 ? ir : ir * 0.5;   // green: weaker
+        avgAcc[c] += light * channelGain(regs[LED1_PA + leds[c] - 1]);
+    }
+    if (++avgCount < averaging()) return;
+
+    uint32_t values[3];
+    uint32_t lsbMask = ~((1u << (18 - resolutionBits())) - 1);
+    bool saturated = false;
+    for (int c = 0; c < channels; c++) {
+        double v = avgAcc[c] / avgCount;
+        if (v >= 0x3FFFF) {
+            v = 0x3FFFF;
+            saturated = true;
+        }
+        values[c] = (v > 0 ? (uint32_t)v : 0) & lsbMask;
+        avgAcc[c] = 0;
+    }
+    avgCount = 0;
+    stats.produced++;
+    if (saturated) stats.saturated++;
+    push(values, channels, atUs);
+}
+
+void Max30102Emu::push(const uint32_t* values, int channels, uint64_t atUs) {
+    uint8_t& wr = regs[FIFO_WR_PTR];
+    uint8_t& rd = regs[FIFO_RD_PTR];
+    uint8_t& ovf = regs[OVF_COUNTER];
+    if (unread == FIFO_DEPTH) {
+        if (ovf < 0x1F) ovf++;
+        if (!(regs[FIFO_CONFIG] & 0x10)) {
+            stats.dropped++;
+            return;
+        }
+        // Rollover: the oldest unread sample is replaced
+        rd = (rd + 1) & (FIFO_DEPTH - 1);
+        unread--;
+        bytePos = 0;
+        stats.overwritten++;
+    }
+    for (int c = 0; c < channels; c++) {
+        fifo[wr][3 * c] = (values[c] >> 16) & 0x03;
+        fifo[wr][3 * c + 1] = values[c] >> 8;
+        fifo[wr][3 * c + 2] = values[c];
+    }
+    fifoTimeUs[wr] = atUs;
+    wr = (wr + 1) & (FIFO_DEPTH - 1);
+    unread++;
+    stats.pushed++;
+    if (unread > stats.maxDepth) stats.maxDepth = unread;
+
+    regs[INT_STATUS1] |= INT_PPG_RDY;
+    // A_FULL fires once, when the free slots drop to the configured count
+    if (FIFO_DEPTH - unread == (regs[FIFO_CONFIG] & 0x0F)) regs[INT_STATUS1] |= INT_A_FULL;
+    updateIntPin();
+}
+
+void Max30102Emu::recountUnread() {
+    unread = (regs[FIFO_WR_PTR] - regs[FIFO_RD_PTR]) & (FIFO_DEPTH - 1);
+    bytePos = 0;
+}
+
+void Max30102Emu::updateIntPin() {
+    bool asserted = (regs[INT_STATUS1] & (regs[INT_ENABLE1] | INT_PWR_RDY)) ||
+                    (regs[INT_STATUS2] & regs[INT_ENABLE2]);
+    if (asserted && !intWasAsserted) stats.intAsserts++;
+    intWasAsserted = asserted;
+}
+
+bool Max30102Emu::intAsserted() {
+    sync();
+    return intWasAsserted;
+}
+
+void Max30102Emu::writeReg(uint8_t reg, uint8_t v) {
+    stats.regWrites++;
+    switch (reg) {
+        case INT_STATUS1:
+        case INT_STATUS2:
+        case REV_ID:
+        case PART_ID_REG:
+        case FIFO_DATA:
+            return;   // read-only
+        case FIFO_WR_PTR:
+        case FIFO_RD_PTR:
+            regs[reg] = v & (FIFO_DEPTH - 1);
+            recountUnread();
+            return;
+        case OVF_COUNTER:
+            regs[reg] = v & 0x1F;
+            return;
+        case MODE_CONFIG:
+            if (v & 0x40) {
+                reset();   // RESET self-clears
+                return;
+            }
+            regs[reg] = v & 0x87;
+            nextConvUs = (double)hostclock::nowUs + 1e6 / adcRateHz();
+            avgCount = 0;
+            memset(avgAcc, 0, sizeof(avgAcc));
+            return;
+        case FIFO_CONFIG:
+        case SPO2_CONFIG:
+            regs[reg] = v;
+            nextConvUs = (double)hostclock::nowUs + 1e6 / adcRateHz();
+            avgCount = 0;
+            memset(avgAcc, 0, sizeof(avgAcc));
+            return;
+        case TEMP_CONFIG:
+            regs[reg] = v & 0x01;
+            if (v & 0x01) tempReadyUs = hostclock::nowUs + 29000;   // ~29 ms conversion
+            return;
+        default:
+            regs[reg] = v;
+            if (reg == INT_ENABLE1 || reg == INT_ENABLE2) updateIntPin();
+            return;
+    }
+}
+
+uint8_t Max30102Emu::readFifoByte() {
+    if (unread == 0) return 0;
+    uint8_t& rd = regs[FIFO_RD_PTR];
+    int sampleBytes = 3 * activeChannels();
+    uint8_t b = bytePos < 9 ? fifo[rd][bytePos] : 0;
+    stats.fifoBytesRead++;
+    if (++bytePos >= sampleBytes) {
+        uint32_t age = (uint32_t)(hostclock::nowUs - fifoTimeUs[rd]);
+        stats.ageUsSum += age;
+        if (age > stats.ageUsMax) stats.ageUsMax = age;
+        rd = (rd + 1) & (FIFO_DEPTH - 1);
+        unread--;
+        bytePos = 0;
+        regs[OVF_COUNTER] = 0;   // cleared whenever a complete sample is popped
+        stats.popped++;
+    }
+    return b;
+}
+
+uint8_t Max30102Emu::readReg(uint8_t reg) {
+    stats.regReads++;
+    switch (reg) {
+        case INT_STATUS1:
+        case INT_STATUS2: {
+            uint8_t v = regs[reg];
+            regs[reg] = 0;   // cleared on read
+            updateIntPin();
+            return v;
+        }
+        case FIFO_DATA:
+            regs[INT_STATUS1] &= ~INT_PPG_RDY;
+            updateIntPin();
+            return readFifoByte();
+        case REV_ID: return 0x03;
+        case PART_ID_REG: return partId;
+        default: return regs[reg];
+    }
+}
+
+// The register pointer auto-increments, except on FIFO_DATA so a burst read
+// drains consecutive samples.
+void Max30102Emu::i2cWrite(const uint8_t* data, int n) {
+    advanceTo(hostclock::nowUs);
+    if (n < 1) return;
+    regPtr = data[0];
+    for (int i = 1; i < n; i++) {
+        writeReg(regPtr, data[i]);
+        if (regPtr != FIFO_DATA) regPtr++;
+    }
+}
+
+void Max30102Emu::i2cRead(uint8_t* data, int n) {
+    advanceTo(hostclock::nowUs);
+    for (int i = 0; i < n; i++) {
+        data[i] = readReg(regPtr);
+        if (regPtr != FIFO_DATA) regPtr++;
+    }
+}
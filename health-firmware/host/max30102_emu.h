@@ -0,0 +1,164 @@
+/**
+ * Register-level MAX30102/MAX30105 emulator for host runs.
+ *
+ * Models the parts of the register map acquisition code depends on: the
+ * 32-sample FIFO with its WR/RD pointers, OVF_COUNTER and rollover, sample
+ * rate, on-chip averaging, pulse width (ADC resolution), ADC range, LED
+ * amplitudes, the A_FULL / PPG_RDY interrupts with the INT pin, soft reset,
+ * and the die temperature conversion. Samples are generated lazily from the
+ * virtual clock whenever the bus touches the device, so polling late really
+ * does overflow the FIFO.
+ *
+ * The optical input comes from a SignalSource in photodiode units: the
+ * count an 18-bit, 4096 nA range, 411 us conversion would give at LED
+ * amplitude 0x7F. The emulator scales it by the configured LED current,
+ * pulse width and range, then saturates and truncates like the ADC.
+ */
+
+#ifndef MAX30102_EMU_H
+#define MAX30102_EMU_H
+
+#include "Wire.h"
+
+// ==================== SIGNAL SOURCES ====================
+class SignalSource {
+public:
+    virtual ~SignalSource() {}
+    virtual void sample(double tSec, double& red, double& ir) = 0;
+};
+
+// Finger PPG: DC level, a pulse shaped as systolic peak plus dicrotic notch,
+// red/IR modulation ratio derived from SpO2 (R = (110 - SpO2) / 25, the
+// firmware's calibration), slow respiratory baseline wander and noise.
+class SyntheticPpg : public SignalSource {
+public:
+    double heartRateBpm = 72;
+    double spo2 = 97;
+    double irDc = 120000;
+    double redDc = 90000;
+    double perfusion = 0.02;     // AC / DC of the IR channel
+    double noise = 60;           // RMS counts
+    double respirationHz = 0.25;
+    double respirationDepth = 0.004;
+
+    explicit SyntheticPpg(uint32_t seed = 1) : rng(seed ? seed : 1) {}
+    void sample(double tSec, double& red, double& ir) override;
+
+private:
+    uint32_t rng;
+    double gaussian();
+};
+
+// Recorded red/IR pairs, one "red,ir" (or "red ir") line per sample at a
+// fixed rate; looped, with linear interpolation between samples.
+class RecordedSignal : public SignalSource {
+public:
+    bool load(const char* path, double sampleRateHz);
+    size_t size() const { return count; }
+    void sample(double tSec, double& red, double& ir) override;
+    ~RecordedSignal() override;
+
+private:
+    double* data = nullptr;   // red, ir interleaved
+    size_t count = 0;
+    double rateHz = 100;
+};
+
+// ==================== EMULATOR ====================
+class Max30102Emu : public I2cTarget {
+public:
+    static const uint8_t ADDRESS = 0x57;
+    static const uint8_t PART_ID = 0x15;
+    static const int FIFO_DEPTH = 32;
+
+    // Register map (MAX30102 datasheet, table 1)
+    enum Reg : uint8_t {
+        INT_STATUS1 = 0x00, INT_STATUS2 = 0x01, INT_ENABLE1 = 0x02, INT_ENABLE2 = 0x03,
+        FIFO_WR_PTR = 0x04, OVF_COUNTER = 0x05, FIFO_RD_PTR = 0x06, FIFO_DATA = 0x07,
+        FIFO_CONFIG = 0x08, MODE_CONFIG = 0x09, SPO2_CONFIG = 0x0A,
+        LED1_PA = 0x0C, LED2_PA = 0x0D, LED3_PA = 0x0E, PILOT_PA = 0x10,
+        MULTI_LED1 = 0x11, MULTI_LED2 = 0x12,
+        TEMP_INT = 0x1F, TEMP_FRAC = 0x20, TEMP_CONFIG = 0x21,
+        REV_ID = 0xFE, PART_ID_REG = 0xFF,
+    };
+    enum IntBit : uint8_t {
+        INT_A_FULL = 0x80, INT_PPG_RDY = 0x40, INT_ALC_OVF = 0x20, INT_PWR_RDY = 0x01,
+        INT_DIE_TEMP_RDY = 0x02,   // in INT_STATUS2
+    };
+
+    struct Stats {
+        uint32_t produced = 0;      // samples the ADC finished
+        uint32_t pushed = 0;        // samples that made it into the FIFO
+        uint32_t dropped = 0;       // lost to a full FIFO (rollover off)
+        uint32_t overwritten = 0;   // unread samples replaced (rollover on)
+        uint32_t popped = 0;        // complete samples read out
+        uint32_t saturated = 0;     // samples with a channel at full scale
+        uint8_t maxDepth = 0;
+        uint32_t intAsserts = 0;    // INT pin falling edges
+        uint32_t regReads = 0;
+        uint32_t regWrites = 0;
+        uint32_t fifoBytesRead = 0;
+        uint64_t ageUsSum = 0;      // sample completion to pop, summed
+        uint32_t ageUsMax = 0;
+    };
+
+    explicit Max30102Emu(SignalSource* source, uint8_t partId = PART_ID);
+
+    uint8_t i2cAddress() const override { return ADDRESS; }
+    void i2cWrite(const uint8_t* data, int n) override;
+    void i2cRead(uint8_t* data, int n) override;
+
+    // INT is open-drain, active low: asserted while an enabled status bit is set
+    bool intAsserted();
+    // Brings the sample clock up to the virtual time without a bus access
+    void sync() { advanceTo(hostclock::nowUs); }
+
+    const Stats& getStats() const { return stats; }
+    void resetStats() { stats = Stats(); }
+    double fifoRateHz() const;   // ADC rate / averaging
+    int activeChannels() const;
+    int queued() const { return unread; }
+    uint8_t peekRegister(uint8_t reg) const { return regs[reg]; }
+    void setDieTemperature(float c) { dieTempC = c; }
+    void setSource(SignalSource* s) { source = s; }
+
+private:
+    SignalSource* source;
+    uint8_t regs[256];
+    uint8_t regPtr;
+    uint8_t partId;
+
+    // FIFO storage: up to 3 channels x 3 bytes per slot
+    uint8_t fifo[FIFO_DEPTH][9];
+    uint64_t fifoTimeUs[FIFO_DEPTH];
+    int unread;
+    int bytePos;            // bytes of the sample at RD_PTR already read
+
+    uint64_t lastUs;        // time the sample clock was last advanced to
+    double nextConvUs;      // when the next ADC conversion completes
+    int avgCount;           // conversions accumulated toward the next sample
+    double avgAcc[3];
+    uint64_t tempReadyUs;   // 0 = no die temperature conversion running
+    float dieTempC;
+    bool intWasAsserted;
+
+    Stats stats;
+
+    void reset();
+    void advanceTo(uint64_t us);
+    void convert(uint64_t atUs);
+    void push(const uint32_t* values, int channels, uint64_t atUs);
+    void writeReg(uint8_t reg, uint8_t v);
+    uint8_t readReg(uint8_t reg);
+    uint8_t readFifoByte();
+    void recountUnread();
+    void updateIntPin();
+
+    int averaging() const;
+    uint32_t adcRateHz() const;
+    int resolutionBits() const;
+    double channelGain(uint8_t ledPa) const;
+    uint8_t slotLed(int slot) const;   // 1 red, 2 IR, 3 green, 0 off
+};
+
+#endif
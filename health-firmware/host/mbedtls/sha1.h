@@ -0,0 +1,55 @@
+/**
+ * Host stand-in for mbedtls_sha1() (the one-shot call the local API uses
+ * for the WebSocket handshake): plain FIPS 180-1 SHA-1.
+ */
+
+#ifndef HOST_MBEDTLS_SHA1_H
+#define HOST_MBEDTLS_SHA1_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+inline int mbedtls_sha1(const unsigned char* input, size_t ilen, unsigned char output[20]) {
+    uint32_t h[5] = {0x67452301, 0xEFCDAB89, 0x98BADCFE, 0x10325476, 0xC3D2E1F0};
+    uint64_t bits = (uint64_t)ilen * 8;
+    size_t total = ((ilen + 8) / 64 + 1) * 64;
+    for (size_t off = 0; off < total; off += 64) {
+        uint8_t block[64];
+        for (size_t i = 0; i < 64; i++) {
+            size_t p = off + i;
+            if (p < ilen) block[i] = input[p];
+            else if (p == ilen) block[i] = 0x80;
+            else if (p >= total - 8) block[i] = (uint8_t)(bits >> (8 * (total - 1 - p)));
+            else block[i] = 0;
+        }
+        uint32_t w[80];
+        for (int i = 0; i < 16; i++) {
+            w[i] = (uint32_t)block[4 * i] << 24 | (uint32_t)block[4 * i + 1] << 16 |
+                   (uint32_t)block[4 * i + 2] << 8 | block[4 * i + 3];
+        }
+        for (int i = 16; i < 80; i++) {
+            uint32_t x = w[i - 3] ^ w[i - 8] ^ w[i - 14] ^ w[i - 16];
+            w[i] = (x << 1) | (x >> 31);
+        }
+        uint32_t a = h[0], b = h[1], c = h[2], d = h[3], e = h[4];
+        for (int i = 0; i < 80; i++) {
+            uint32_t f, k;
+            if (i < 20) f = (b & c) | (~b & d), k = 0x5A827999;
+            else if (i < 40) f = b ^ c ^ d, k = 0x6ED9EBA1;
+            else if (i < 60) f = (b & c) | (b & d) | (c & d), k = 0x8F1BBCDC;
+            else f = b ^ c ^ d, k = 0xCA62C1D6;
+            uint32_t t = ((a << 5) | (a >> 27)) + f + e + k + w[i];
+            e = d;
+            d = c;
+            c = (b << 30) | (b >> 2);
+            b = a;
+            a = t;
+        }
+        h[0] += a, h[1] += b, h[2] += c, h[3] += d, h[4] += e;
+    }
+    for (int i = 0; i < 20; i++) output[i] = (uint8_t)(h[i / 4] >> (24 - 8 * (i % 4)));
+    return 0;
+}
+
+#endif
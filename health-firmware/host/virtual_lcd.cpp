@@ -0,0 +1,114 @@
+#include "virtual_lcd.h"
+
+static const uint8_t PIN_RS = 0x01;
+static const uint8_t PIN_EN = 0x04;
+
+VirtualLcd::VirtualLcd(uint8_t address)
+    : address(address), port(0), fourBit(false), highNibble(true), pending(0), addr(0),
+      cgramSelected(false), increment(true), displayControl(0), busyUntilUs(0) {
+    memset(ddram, ' ', sizeof(ddram));
+}
+
+// 20x4 modules map rows 2 and 3 onto the tails of lines 1 and 2
+int VirtualLcd::ddramIndex(int r, int c) {
+    static const uint8_t ROW_OFFSETS[ROWS] = {0x00, 0x40, 0x14, 0x54};
+    return ROW_OFFSETS[r] + c;
+}
+
+void VirtualLcd::i2cWrite(const uint8_t* data, int n) {
+    for (int i = 0; i < n; i++) {
+        uint8_t next = data[i];
+        if ((port & PIN_EN) && !(next & PIN_EN)) latch(port >> 4, port & PIN_RS);
+        port = next;
+    }
+}
+
+void VirtualLcd::i2cRead(uint8_t* data, int n) {
+    for (int i = 0; i < n; i++) data[i] = port;
+}
+
+void VirtualLcd::latch(uint8_t nibble, bool rs) {
+    if (!fourBit) {
+        execute(nibble << 4, rs);
+        return;
+    }
+    if (highNibble) {
+        pending = nibble << 4;
+        highNibble = false;
+        return;
+    }
+    highNibble = true;
+    execute(pending | nibble, rs);
+}
+
+void VirtualLcd::execute(uint8_t value, bool rs) {
+    if (hostclock::nowUs < busyUntilUs) stats.busyViolations++;
+    busyUntilUs = hostclock::nowUs + 37;
+    if (!rs) {
+        command(value);
+        return;
+    }
+    stats.chars++;
+    if (!cgramSelected) ddram[addr & 0x7F] = value;
+    advanceAddress();
+}
+
+void VirtualLcd::command(uint8_t cmd) {
+    stats.commands++;
+    if (cmd & 0x80) {                 // set DDRAM address
+        addr = cmd & 0x7F;
+        cgramSelected = false;
+    } else if (cmd & 0x40) {          // set CGRAM address
+        cgramSelected = true;
+    } else if (cmd & 0x20) {          // function set
+        fourBit = !(cmd & 0x10);
+        highNibble = true;
+    } else if (cmd & 0x10) {          // cursor/display shift: not modelled
+    } else if (cmd & 0x08) {          // display control
+        displayControl = cmd & 0x07;
+    } else if (cmd & 0x04) {          // entry mode
+        increment = cmd & 0x02;
+    } else if (cmd & 0x02) {          // return home
+        addr = 0;
+        cgramSelected = false;
+        busyUntilUs = hostclock::nowUs + 1520;
+    } else if (cmd & 0x01) {          // clear display
+        memset(ddram, ' ', sizeof(ddram));
+        addr = 0;
+        increment = true;
+        cgramSelected = false;
+        stats.clears++;
+        busyUntilUs = hostclock::nowUs + 1520;
+    }
+}
+
+// Two-line addressing: 0x00-0x27 runs into 0x40-0x67 and back
+void VirtualLcd::advanceAddress() {
+    if (increment) addr = addr == 0x27 ? 0x40 : addr == 0x67 ? 0x00 : addr + 1;
+    else addr = addr == 0x00 ? 0x67 : addr == 0x40 ? 0x27 : addr - 1;
+}
+
+std::string VirtualLcd::row(int r) const {
+    std::string s(COLS, ' ');
+    for (int c = 0; c < COLS; c++) {
+        uint8_t ch = ddram[ddramIndex(r, c)];
+        s[c] = (ch >= 0x20 && ch < 0x7F) ? (char)ch : '?';
+    }
+    return s;
+}
+
+std::string VirtualLcd::snapshot() const {
+    std::string out;
+    for (int r = 0; r < ROWS; r++) out += "|" + row(r) + "|\n";
+    return out;
+}
+
+// Rows shorter than 20 characters are compared as if padded with spaces
+bool VirtualLcd::matches(const char* const rows[ROWS]) const {
+    for (int r = 0; r < ROWS; r++) {
+        char want[COLS + 1];
+        snprintf(want, sizeof(want), "%-20.20s", rows[r]);
+        if (row(r) != want) return false;
+    }
+    return true;
+}
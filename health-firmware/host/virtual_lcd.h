@@ -0,0 +1,73 @@
+/**
+ * Virtual 20x4 HD44780 behind a PCF8574 I2C backpack, the module driven by
+ * LiquidCrystal_I2C.
+ *
+ * Every byte written to the expander sets its port:
+ * P0 = RS, P1 = RW, P2 = EN, P3 = backlight, P4..P7 = D4..D7.
+ * The controller latches a nibble on the falling edge of EN. It starts in
+ * 8-bit mode, where each latch is a full byte, until a function set with
+ * DL = 0 switches it to 4-bit. The model decodes the nibble stream into
+ * commands and data, keeps DDRAM, the address counter and entry mode, and
+ * exposes the visible character grid for snapshots. Commands that arrive
+ * while the controller is still busy with the previous one (37 us, or
+ * 1.52 ms for clear/home) are counted. Real hardware would drop or corrupt
+ * them.
+ */
+
+#ifndef VIRTUAL_LCD_H
+#define VIRTUAL_LCD_H
+
+#include <string>
+
+#include "Wire.h"
+
+class VirtualLcd : public I2cTarget {
+public:
+    static const int COLS = 20;
+    static const int ROWS = 4;
+
+    struct Stats {
+        uint32_t commands = 0;
+        uint32_t chars = 0;
+        uint32_t clears = 0;
+        uint32_t busyViolations = 0;
+    };
+
+    explicit VirtualLcd(uint8_t address = 0x27);
+
+    uint8_t i2cAddress() const override { return address; }
+    void i2cWrite(const uint8_t* data, int n) override;
+    void i2cRead(uint8_t* data, int n) override;
+
+    // Visible text of one row / the whole screen ("|row|" lines)
+    std::string row(int r) const;
+    std::string snapshot() const;
+    bool matches(const char* const rows[ROWS]) const;
+
+    bool backlightOn() const { return port & 0x08; }
+    bool displayOn() const { return displayControl & 0x04; }
+    const Stats& getStats() const { return stats; }
+    void resetStats() { stats = Stats(); }
+
+private:
+    uint8_t address;
+    uint8_t port;
+    bool fourBit;
+    bool highNibble;          // next 4-bit latch is the high nibble
+    uint8_t pending;
+    uint8_t ddram[128];
+    uint8_t addr;             // address counter
+    bool cgramSelected;
+    bool increment;
+    uint8_t displayControl;
+    uint64_t busyUntilUs;
+    Stats stats;
+
+    void latch(uint8_t nibble, bool rs);
+    void execute(uint8_t value, bool rs);
+    void command(uint8_t cmd);
+    void advanceAddress();
+    static int ddramIndex(int r, int c);
+};
+
+#endif
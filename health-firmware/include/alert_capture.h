@@ -0,0 +1,213 @@
+/**
+ * The last CAPTURE_PRE_S seconds of raw RED/IR are always held in a ring of
+ * one-second blocks: the first sample of a block is stored whole, the rest
+ * as int16 deltas (4 bytes per sample instead of 6). Deltas are taken
+ * against the reconstructed value, so a step too large for int16 is spread
+ * over the following samples instead of corrupting the rest of the block.
+ * A critical alert onset keeps the ring recording for CAPTURE_POST_S more
+ * seconds, then freezes it until the capture has been posted. Alerts while
+ * a capture is pending are counted as missed.
+ *
+ * Body (little-endian): "WFC1", rate u16, block count u16, trigger sample
+ * u32 (from the first sample), capture id u32; then per block: IR u32,
+ * RED u32, sample count u8, flags u8 (1 = samples lost before this block),
+ * then count-1 pairs of IR/RED int16 deltas.
+ *
+ * Shared by the firmware (main.cpp, ALERT WAVEFORM CAPTURE) and the host
+ * check in test/test_alert_capture, which decodes the body.
+ */
+
+#ifndef ALERT_CAPTURE_H
+#define ALERT_CAPTURE_H
+
+#include <Arduino.h>
+#include <string.h>
+
+#if !defined(CAPTURE_PRE_S) || !defined(CAPTURE_POST_S) || !defined(CAPTURE_RATE) || \
+    !defined(CAPTURE_MAX_ATTEMPTS) || !defined(CAPTURE_RETRY_MS)
+#error "define the CAPTURE_* settings before including alert_capture.h"
+#endif
+
+#ifndef DSP_HOT
+#define DSP_HOT
+#endif
+
+// Provided by the firmware (or the host test): a capture is ready to post
+void captureFrozen();
+
+class AlertCapture {
+public:
+    enum State : uint8_t { ARMED, POST_TRIGGER, FROZEN };
+    
+private:
+    static const int BLOCKS = CAPTURE_PRE_S + CAPTURE_POST_S + 1;   // +1 being written
+    static const uint8_t BLOCK_GAP = 0x01;
+    
+    struct Block {
+        uint32_t ir0;
+        uint32_t red0;
+        uint8_t count;
+        uint8_t flags;
+        int16_t delta[2 * (CAPTURE_RATE - 1)];
+    };
+    
+    Block blocks[BLOCKS];
+    uint32_t writeSeq;       // block being written; earlier ones are complete
+    uint32_t reconIr;
+    uint32_t reconRed;
+    bool gapPending;
+    
+    State state;
+    uint32_t triggerSeq;
+    uint8_t triggerIndex;
+    uint8_t postLeft;
+    uint32_t onsetUs;
+    unsigned long triggerMs;
+    uint32_t id;
+    uint8_t attempts;
+    unsigned long notBefore;
+    
+    uint32_t triggered;
+    uint32_t uploaded;
+    uint32_t failed;
+    uint32_t missed;
+    uint32_t clipped;        // deltas saturated at int16
+    
+    static int16_t encode(uint32_t value, uint32_t& recon, uint32_t& clips) {
+        int32_t d = (int32_t)value - (int32_t)recon;
+        int32_t q = constrain(d, -32768, 32767);
+        if (q != d) clips++;
+        recon += q;
+        return q;
+    }
+    
+    void freeze() {
+        state = FROZEN;
+        attempts = 0;
+        notBefore = 0;
+        captureFrozen();
+    }
+    
+    void endBlock() {
+        writeSeq++;
+        blocks[writeSeq % BLOCKS].count = 0;
+        if (state == POST_TRIGGER && --postLeft == 0) freeze();
+    }
+    
+    void put(uint8_t*& p, const void* v, size_t n) {
+        memcpy(p, v, n);
+        p += n;
+    }
+    
+public:
+    AlertCapture() : writeSeq(0), reconIr(0), reconRed(0), gapPending(false), state(ARMED),
+                     triggerSeq(0), triggerIndex(0), postLeft(0), onsetUs(0), triggerMs(0), id(0),
+                     attempts(0), notBefore(0), triggered(0), uploaded(0), failed(0), missed(0),
+                     clipped(0) {
+        blocks[0].count = 0;
+    }
+    
+    void DSP_HOT addSample(uint32_t red, uint32_t ir) {
+        if (state == FROZEN) return;
+        Block& b = blocks[writeSeq % BLOCKS];
+        if (b.count == 0) {
+            b.ir0 = reconIr = ir;
+            b.red0 = reconRed = red;
+            b.flags = gapPending ? BLOCK_GAP : 0;
+            gapPending = false;
+        } else {
+            int i = 2 * (b.count - 1);
+            b.delta[i] = encode(ir, reconIr, clipped);
+            b.delta[i + 1] = encode(red, reconRed, clipped);
+        }
+        if (++b.count == CAPTURE_RATE) endBlock();
+    }
+    
+    // Samples were lost: close the partial block so the next one is flagged
+    void addGap() {
+        if (state == FROZEN) return;
+        if (blocks[writeSeq % BLOCKS].count > 0) endBlock();
+        gapPending = true;
+    }
+    
+    void trigger(uint32_t alertOnsetUs) {
+        if (id != 0 && alertOnsetUs == onsetUs) return;   // same alert, already captured
+        if (state != ARMED) {
+            missed++;
+            return;
+        }
+        state = POST_TRIGGER;
+        triggerSeq = writeSeq;
+        triggerIndex = blocks[writeSeq % BLOCKS].count;
+        postLeft = CAPTURE_POST_S;
+        onsetUs = alertOnsetUs;
+        triggerMs = millis();
+        id = ++triggered;
+    }
+    
+    // Capture id for an alert, 0 if none was taken for that onset
+    uint32_t idFor(uint32_t alertOnsetUs) {
+        return (id != 0 && alertOnsetUs == onsetUs) ? id : 0;
+    }
+    
+    bool isFrozen() {
+        // No samples (finger off) must not hold the capture open forever
+        if (state == POST_TRIGGER && millis() - triggerMs > (CAPTURE_POST_S + 5) * 1000UL) freeze();
+        return state == FROZEN;
+    }
+    
+    bool due() { return isFrozen() && (long)(millis() - notBefore) >= 0; }
+    
+    // Serializes the frozen capture, oldest block first. Returns the length.
+    size_t serialize(uint8_t* out, size_t cap) {
+        uint32_t complete = min(writeSeq, (uint32_t)(BLOCKS - 1));
+        uint32_t first = writeSeq - complete;
+        uint8_t* p = out;
+        if (cap < 16 + complete * sizeof(Block)) return 0;
+        
+        uint32_t triggerSample = 0;
+        for (uint32_t seq = first; seq < triggerSeq && seq < writeSeq; seq++) {
+            triggerSample += blocks[seq % BLOCKS].count;
+        }
+        triggerSample += (triggerSeq >= first) ? triggerIndex : 0;
+        uint16_t rate = CAPTURE_RATE;
+        uint16_t count = complete;
+        put(p, "WFC1", 4);
+        put(p, &rate, 2);
+        put(p, &count, 2);
+        put(p, &triggerSample, 4);
+        put(p, &id, 4);
+        for (uint32_t seq = first; seq < writeSeq; seq++) {
+            const Block& b = blocks[seq % BLOCKS];
+            put(p, &b.ir0, 4);
+            put(p, &b.red0, 4);
+            put(p, &b.count, 1);
+            put(p, &b.flags, 1);
+            put(p, b.delta, 2 * sizeof(int16_t) * (b.count - 1));
+        }
+        return p - out;
+    }
+    
+    uint32_t getId() { return id; }
+    uint32_t getOnsetUs() { return onsetUs; }
+    State getState() { return state; }
+    uint32_t getTriggered() { return triggered; }
+    uint32_t getUploaded() { return uploaded; }
+    uint32_t getFailed() { return failed; }
+    uint32_t getMissed() { return missed; }
+    uint32_t getClipped() { return clipped; }
+    
+    // Back to recording; whatever arrived while frozen was not kept
+    void finish(bool ok) {
+        if (!ok && ++attempts < CAPTURE_MAX_ATTEMPTS) {
+            notBefore = millis() + (unsigned long)CAPTURE_RETRY_MS * attempts;
+            return;
+        }
+        if (ok) uploaded++;
+        else failed++;
+        state = ARMED;
+        gapPending = true;
+    }
+};
+
+#endif
@@ -0,0 +1,20 @@
+/**
+ * Battery Configuration
+ * Battery gauge settings, included by config.h and by main.cpp's
+ * battery gauge so both read the same values
+ */
+
+#ifndef BATTERY_CONFIG_H
+#define BATTERY_CONFIG_H
+
+// Battery voltage divider ratio (adjust based on your circuit)
+#define BATTERY_VOLTAGE_DIVIDER 2.0
+
+// Battery voltage range (in millivolts)
+#define BATTERY_MIN_VOLTAGE 3400  // 3.4V (empty)
+#define BATTERY_MAX_VOLTAGE 4200  // 4.2V (full)
+
+// Low battery: power saver tier and a device alert below this (%)
+#define THRESHOLD_BATTERY_LOW 20
+
+#endif // BATTERY_CONFIG_H
@@ -20,12 +20,8 @@
 // Default resting heart rate (can be updated via app)
 #define DEFAULT_RESTING_HR 70
 
-// Battery voltage divider ratio (adjust based on your circuit)
-#define BATTERY_VOLTAGE_DIVIDER 2.0
-
-// Battery voltage range (in millivolts)
-#define BATTERY_MIN_VOLTAGE 3400  // 3.4V (empty)
-#define BATTERY_MAX_VOLTAGE 4200  // 4.2V (full)
+// Battery divider, voltage range and low threshold
+#include "battery_config.h"
 
 // ==================== TIMING CONFIGURATION ====================
 #define PULSE_SAMPLE_RATE_MS 2      // 500Hz sampling
@@ -41,7 +37,6 @@
 #define THRESHOLD_HR_LOW 50          // Bradycardia
 #define THRESHOLD_TEMP_HIGH 38.0     // Fever (Celsius)
 #define THRESHOLD_TEMP_LOW 35.5      // Hypothermia (Celsius)
-#define THRESHOLD_BATTERY_LOW 20     // Low battery (%)
 
 // ==================== LCD I2C ADDRESSES ====================
 // Try 0x27 first, if that doesn't work, try 0x3F
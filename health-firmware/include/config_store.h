@@ -0,0 +1,208 @@
+/**
+ * Typed RAM copy of everything the firmware keeps in NVS (see main.cpp,
+ * CONFIG STORE). Included by the firmware after its CONFIG_SCHEMA and
+ * CONFIG_FLUSH_INTERVAL_MS, and by the host test (test/test_config_store)
+ * over the in-memory host/Preferences.h.
+ *
+ * Reads are plain loads; set() only marks the key dirty, and service()
+ * writes dirty keys back once the shortest flush interval among them has
+ * passed, one key per loop pass, so an NVS commit (milliseconds, flash
+ * wear) never lands on a hot path. flushNow() is the escape hatch for a
+ * sagging battery and software restarts.
+ */
+
+#ifndef CONFIG_STORE_H
+#define CONFIG_STORE_H
+
+#include <Arduino.h>
+#include <Preferences.h>
+#include <esp_system.h>
+#include <cmath>
+#include <ctype.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if !defined(CONFIG_SCHEMA) || !defined(CONFIG_FLUSH_INTERVAL_MS)
+#error "define CONFIG_SCHEMA and CONFIG_FLUSH_INTERVAL_MS before including config_store.h"
+#endif
+
+extern Preferences preferences;
+
+enum ConfigKey {
+#define X(id, field, type, key, def, lo, hi, flushMs, tunable) id,
+    CONFIG_SCHEMA(X)
+#undef X
+    CFG_COUNT
+};
+
+struct ConfigValues {
+#define X(id, field, type, key, def, lo, hi, flushMs, tunable) type field = def;
+    CONFIG_SCHEMA(X)
+#undef X
+};
+
+template <ConfigKey K> struct ConfigField;
+#define X(id, field, type, key, def, lo, hi, flushMs, tunable) \
+    template <> struct ConfigField<id> { \
+        typedef type Type; \
+        static Type& of(ConfigValues& v) { return v.field; } \
+    };
+CONFIG_SCHEMA(X)
+#undef X
+
+class ConfigStore {
+private:
+    ConfigValues values;
+    uint32_t dirty;
+    uint32_t unsaved;    // changed from the console, RAM only until save()
+    uint32_t present;    // keys found in NVS at boot or written since
+    unsigned long lastFlush;
+    bool flushing;       // a pass has started and runs until nothing is dirty
+    
+    static void load(const char* key, float& v) { v = preferences.getFloat(key, v); }
+    static void load(const char* key, uint32_t& v) { v = preferences.getUInt(key, v); }
+    static void store(const char* key, float v) { preferences.putFloat(key, v); }
+    static void store(const char* key, uint32_t v) { preferences.putUInt(key, v); }
+    static bool parse(const char* text, float& v) {
+        char* end;
+        v = strtof(text, &end);
+        return end != text && *end == 0 && std::isfinite(v);
+    }
+    // Digits only: strtoul() would take "-1" as 4294967295.
+    static bool parse(const char* text, uint32_t& v) {
+        if (!isdigit((unsigned char)text[0])) return false;
+        char* end;
+        errno = 0;
+        unsigned long long n = strtoull(text, &end, 0);
+        if (*end != 0 || errno == ERANGE || n > UINT32_MAX) return false;
+        v = n;
+        return true;
+    }
+    template <typename T>
+    static bool inRange(T v, T lo, T hi) { return v >= lo && v <= hi; }
+    static void show(Print& out, float v) { out.print(v, 3); }
+    static void show(Print& out, uint32_t v) { out.print(v); }
+    
+    void write(int k) {
+        switch (k) {
+#define X(id, field, type, key, def, lo, hi, flushMs, tunable) case id: store(key, values.field); break;
+            CONFIG_SCHEMA(X)
+#undef X
+        }
+        dirty &= ~(1u << k);
+        present |= 1u << k;
+    }
+    
+    static void onShutdown();
+    
+public:
+    ConfigStore() : dirty(0), unsaved(0), present(0), lastFlush(0), flushing(false) {}
+    
+    // After preferences.begin()
+    void begin() {
+#define X(id, field, type, key, def, lo, hi, flushMs, tunable) \
+        if (preferences.isKey(key)) { \
+            load(key, values.field); \
+            if (inRange<type>(values.field, lo, hi)) present |= 1u << id; \
+            else values.field = def; \
+        }
+        CONFIG_SCHEMA(X)
+#undef X
+        lastFlush = millis();
+        esp_register_shutdown_handler(onShutdown);
+    }
+    
+    template <ConfigKey K>
+    typename ConfigField<K>::Type get() { return ConfigField<K>::of(values); }
+    
+    template <ConfigKey K>
+    void set(typename ConfigField<K>::Type v) {
+        typename ConfigField<K>::Type& field = ConfigField<K>::of(values);
+        if (field != v || !(present & (1u << K))) {
+            field = v;
+            dirty |= 1u << K;
+        }
+    }
+    
+    // Stored in NVS (or pending), as opposed to the schema default
+    bool isSet(ConfigKey k) { return (present | dirty) & (1u << k); }
+    
+    // Shortest flush interval among the dirty keys; a pass started for one
+    // key writes every dirty key.
+    unsigned long flushDueMs() {
+        unsigned long due = CONFIG_FLUSH_INTERVAL_MS;
+#define X(id, field, type, key, def, lo, hi, flushMs, tunable) \
+        if ((dirty & (1u << id)) && (unsigned long)(flushMs) < due) due = flushMs;
+        CONFIG_SCHEMA(X)
+#undef X
+        return due;
+    }
+    
+    // From loop(): at most one NVS write per call.
+    void service() {
+        if (!dirty) {
+            flushing = false;
+            return;
+        }
+        if (!flushing) {
+            if (millis() - lastFlush < flushDueMs()) return;
+            flushing = true;
+            lastFlush = millis();
+        }
+        for (int k = 0; k < CFG_COUNT; k++) {
+            if (dirty & (1u << k)) {
+                write(k);
+                flushing = dirty != 0;   // a key dirtied after this waits for the next interval
+                return;
+            }
+        }
+    }
+    
+    void flushNow() {
+        for (int k = 0; k < CFG_COUNT && dirty; k++) {
+            if (dirty & (1u << k)) write(k);
+        }
+        lastFlush = millis();
+    }
+    
+    uint32_t pending() { return dirty; }
+    
+    // Console "set": RAM only, so a bad value is gone after a reboot.
+    // Returns the key, or CFG_COUNT for an unknown/read-only key, a malformed
+    // value or one outside the schema's [min, max].
+    ConfigKey setByName(const char* name, const char* text) {
+#define X(id, field, type, key, def, lo, hi, flushMs, tunable) \
+        if (tunable && strcmp(name, key) == 0) { \
+            type v; \
+            if (!parse(text, v) || !inRange<type>(v, lo, hi)) return CFG_COUNT; \
+            if (values.field != v) { values.field = v; unsaved |= 1u << id; } \
+            return id; \
+        }
+        CONFIG_SCHEMA(X)
+#undef X
+        return CFG_COUNT;
+    }
+    
+    // Console "save": queue console changes for the next flush pass.
+    void save() {
+        dirty |= unsaved;
+        unsaved = 0;
+        lastFlush = millis() - CONFIG_FLUSH_INTERVAL_MS;
+    }
+    
+    void print(Print& out) {
+#define X(id, field, type, key, def, lo, hi, flushMs, tunable) \
+        out.print(key); out.print(" = "); show(out, values.field); \
+        if (unsaved & (1u << id)) out.print("  (unsaved)"); \
+        else if (dirty & (1u << id)) out.print("  (pending)"); \
+        else if (!(present & (1u << id))) out.print("  (default)"); \
+        if (!tunable) out.print("  [read-only]"); \
+        else { out.print("  ["); show(out, (type)(lo)); out.print(".."); show(out, (type)(hi)); out.print("]"); } \
+        out.println();
+        CONFIG_SCHEMA(X)
+#undef X
+    }
+};
+
+#endif
@@ -0,0 +1,174 @@
+/**
+ * Incremental oxygen desaturation event detector and oxygen desaturation
+ * index (events per hour of valid SpO2), fed the 1 Hz SpO2 readings by the
+ * firmware (main.cpp, OXYGEN DESATURATION) and by test/test_desat_detector.
+ *
+ * The baseline is an EWMA of the valid readings that stops moving while a
+ * dip is in progress. A dip starts DESAT_DROP_PCT below it and ends once
+ * SpO2 is back within DESAT_RECOVER_PCT; it is an event if DESAT_MIN_S of
+ * its readings were at or below the drop level. Events are kept as 8-byte
+ * records for the uplink, so the server gets the overnight screening
+ * metric without 1 Hz SpO2.
+ *
+ * The ODI is reported two ways: over the monitoring session (since
+ * startSession(), normally the start of the night) and over the last hour,
+ * from 60 one-minute slots of event and valid-second counts.
+ */
+
+#ifndef DESAT_DETECTOR_H
+#define DESAT_DETECTOR_H
+
+#include <Arduino.h>
+#include <math.h>
+#include <string.h>
+
+#if !defined(DESAT_DROP_PCT) || !defined(DESAT_MIN_S) || !defined(DESAT_RECOVER_PCT) || !defined(DESAT_MAX_S) || \
+    !defined(DESAT_BASELINE_S) || !defined(DESAT_WARMUP_S) || !defined(DESAT_MAX_GAP_S) || !defined(DESAT_EVENTS)
+#error "define the DESAT_* settings before including desat_detector.h"
+#endif
+
+struct DesatEvent {
+    uint32_t startMs;
+    uint16_t durationS;
+    uint8_t nadir;
+    uint8_t dropPct;     // baseline minus nadir
+};
+
+class DesatDetector {
+private:
+    static const int HOUR_SLOTS = 60;   // one per minute
+    
+    float baseline;
+    uint32_t warmupS;
+    uint32_t gapS;
+    
+    bool inDip;
+    uint32_t dipStartMs;
+    uint16_t dipS;
+    uint16_t belowS;
+    uint8_t nadir;
+    
+    DesatEvent events[DESAT_EVENTS];
+    uint32_t eventTotal;     // since boot: numbers the records for the uplink
+    uint32_t sessionEvents;
+    uint32_t sessionValidS;  // seconds of valid SpO2, the session ODI denominator
+    
+    uint16_t slotEvents[HOUR_SLOTS];
+    uint16_t slotValidS[HOUR_SLOTS];
+    uint32_t slotMinute;     // millis() / 60000 of the current slot
+    uint32_t hourEvents;     // sums over the slots
+    uint32_t hourValidS;
+    
+    // Moves the hour window up to now, emptying the slots it leaves behind
+    void advanceHour() {
+        uint32_t minute = millis() / 60000;
+        uint32_t steps = minute - slotMinute;
+        if (steps == 0) return;
+        if (steps > HOUR_SLOTS) steps = HOUR_SLOTS;
+        for (uint32_t i = 1; i <= steps; i++) {
+            int s = (slotMinute + i) % HOUR_SLOTS;
+            hourEvents -= slotEvents[s];
+            hourValidS -= slotValidS[s];
+            slotEvents[s] = slotValidS[s] = 0;
+        }
+        slotMinute = minute;
+    }
+    
+    void closeDip() {
+        if (belowS >= DESAT_MIN_S) {
+            DesatEvent& e = events[eventTotal % DESAT_EVENTS];
+            e.startMs = dipStartMs;
+            e.durationS = dipS;
+            e.nadir = nadir;
+            e.dropPct = max(lroundf(baseline) - nadir, 0L);
+            eventTotal++;
+            sessionEvents++;
+            slotEvents[slotMinute % HOUR_SLOTS]++;
+            hourEvents++;
+        }
+        inDip = false;
+    }
+    
+    void restart() {
+        if (inDip) closeDip();
+        baseline = 0;
+        warmupS = 0;
+    }
+    
+public:
+    DesatDetector() : baseline(0), warmupS(0), gapS(0), inDip(false), dipStartMs(0), dipS(0), belowS(0),
+                      nadir(0), eventTotal(0), sessionEvents(0), sessionValidS(0), hourEvents(0), hourValidS(0) {
+        memset(slotEvents, 0, sizeof(slotEvents));
+        memset(slotValidS, 0, sizeof(slotValidS));
+        slotMinute = millis() / 60000;
+    }
+    
+    // A new monitoring session: the session ODI and the baseline start over.
+    // The last-hour ODI keeps its window, and events keep their numbering.
+    void startSession() {
+        inDip = false;
+        restart();
+        gapS = 0;
+        sessionEvents = 0;
+        sessionValidS = 0;
+    }
+    
+    // Once a second; spo2 <= 0 when there is no valid reading
+    void addReading(int spo2) {
+        advanceHour();
+        if (spo2 <= 0) {
+            if (++gapS == DESAT_MAX_GAP_S) restart();
+            return;
+        }
+        gapS = 0;
+        sessionValidS++;
+        slotValidS[slotMinute % HOUR_SLOTS]++;
+        hourValidS++;
+        int v = spo2;
+        
+        if (inDip) {
+            dipS++;
+            if (v <= baseline - DESAT_DROP_PCT) belowS++;
+            if (v < nadir) nadir = v;
+            if (v >= baseline - DESAT_RECOVER_PCT) closeDip();
+            else if (dipS >= DESAT_MAX_S) restart();
+            return;
+        }
+        if (warmupS >= DESAT_WARMUP_S && v <= baseline - DESAT_DROP_PCT) {
+            inDip = true;
+            dipStartMs = millis();
+            dipS = belowS = 1;
+            nadir = v;
+            return;
+        }
+        warmupS++;
+        baseline = baseline > 0 ? baseline + (v - baseline) / DESAT_BASELINE_S : v;
+    }
+    
+    float getODI() { return sessionValidS ? sessionEvents * 3600.0f / sessionValidS : 0; }
+    float getHourODI() {
+        advanceHour();
+        return hourValidS ? hourEvents * 3600.0f / hourValidS : 0;
+    }
+    uint32_t getSessionEvents() { return sessionEvents; }
+    uint32_t getSessionValidS() { return sessionValidS; }
+    uint32_t getHourEvents() {
+        advanceHour();
+        return hourEvents;
+    }
+    uint32_t getHourValidS() {
+        advanceHour();
+        return hourValidS;
+    }
+    float getBaseline() { return warmupS >= DESAT_WARMUP_S ? baseline : 0; }
+    bool isInDip() { return inDip; }
+    
+    uint32_t eventCount() { return eventTotal; }
+    // First event after `after` (an eventCount() value) still held
+    uint32_t firstHeld(uint32_t after) {
+        return max(after, eventTotal > DESAT_EVENTS ? eventTotal - DESAT_EVENTS : 0);
+    }
+    const DesatEvent& event(uint32_t n) { return events[n % DESAT_EVENTS]; }
+};
+
+#endif
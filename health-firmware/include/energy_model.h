@@ -0,0 +1,106 @@
+/**
+ * Energy model shared by the firmware's EnergyMeter (main.cpp) and the host
+ * check in test/test_energy: the supply current of each subsystem state,
+ * the per-loop charge integration, and the charge implied by the state
+ * times the firmware reports as system.energy.state_s.
+ */
+
+#ifndef ENERGY_MODEL_H
+#define ENERGY_MODEL_H
+
+#include <stdint.h>
+#include <string.h>
+
+// Average supply current (mA) of each subsystem state
+#define ENERGY_CPU_ACTIVE_MA 50.0       // 240 MHz, running
+#define ENERGY_CPU_IDLE_MA 30.0         // in delay(), no light sleep
+#define ENERGY_RADIO_SLEEP_MA 5.0       // associated, max modem sleep (every 3rd DTIM)
+#define ENERGY_RADIO_AWAKE_MA 95.0      // power save off, receiver on
+#define ENERGY_RADIO_ACTIVE_MA 60.0     // TX on top of that during an HTTP exchange
+#define ENERGY_LCD_BACKLIGHT_MA 20.0
+#define ENERGY_SENSORS_MA 5.0           // SEN-11574, DS18B20, MAX30102 quiescent
+#define ENERGY_LED_MA_PER_STEP 0.2      // MAX30102 LED current per amplitude step
+#define ENERGY_LED_PULSE_US 411
+
+enum EnergySubsystem { EN_CPU, EN_RADIO, EN_LEDS, EN_LCD, EN_SENSORS, EN_COUNT };
+const char* const ENERGY_SUBSYSTEM_NAMES[EN_COUNT] = {"cpu", "radio", "leds", "lcd", "sensors"};
+
+// Time spent in each modelled state since boot. The LED current follows
+// amplitude and sample rate, so it is kept as charge rather than a time.
+struct EnergyStates {
+    uint64_t totalUs = 0;
+    uint64_t cpuActiveUs = 0;
+    uint64_t cpuIdleUs = 0;
+    uint64_t radioConnectedUs = 0;
+    uint64_t radioAwakeUs = 0;      // part of radioConnectedUs
+    uint64_t radioActiveUs = 0;     // HTTP exchanges, on top of awake
+    uint64_t backlightUs = 0;
+    double ledMas = 0;
+};
+
+// MAX30102 red + IR pulses: each amplitude * 0.2 mA for 411 us per sample
+inline float energyLedMa(uint8_t amplitude, int samplesPerSecond) {
+    return 2 * amplitude * ENERGY_LED_MA_PER_STEP * samplesPerSecond * ENERGY_LED_PULSE_US / 1e6f;
+}
+
+// Charge per subsystem (mA*s) implied by the state times alone.
+inline void energyFromStates(const EnergyStates& s, double mas[EN_COUNT]) {
+    mas[EN_CPU] = ENERGY_CPU_ACTIVE_MA * (s.cpuActiveUs / 1e6) + ENERGY_CPU_IDLE_MA * (s.cpuIdleUs / 1e6);
+    mas[EN_RADIO] = ENERGY_RADIO_ACTIVE_MA * (s.radioActiveUs / 1e6) +
+                    ENERGY_RADIO_AWAKE_MA * (s.radioAwakeUs / 1e6) +
+                    ENERGY_RADIO_SLEEP_MA * ((s.radioConnectedUs - s.radioAwakeUs) / 1e6);
+    mas[EN_LEDS] = s.ledMas;
+    mas[EN_LCD] = ENERGY_LCD_BACKLIGHT_MA * (s.backlightUs / 1e6);
+    mas[EN_SENSORS] = ENERGY_SENSORS_MA * (s.totalUs / 1e6);
+}
+
+// Integrates charge once per loop pass from the state the firmware controls.
+class EnergyAccount {
+private:
+    EnergyStates states;
+    double chargeMas[EN_COUNT];
+
+public:
+    EnergyAccount() { memset(chargeMas, 0, sizeof(chargeMas)); }
+
+    // busyUs of work, then totalUs - busyUs in delay(); radioUs of the busy
+    // time was spent in HTTP exchanges.
+    void noteLoop(uint32_t busyUs, uint32_t totalUs, uint32_t radioUs, bool connected, bool radioAwake,
+                  float ledMa, bool backlight) {
+        double dt = totalUs / 1e6;
+        double idle = (totalUs - busyUs) / 1e6;
+        if (radioUs > busyUs) radioUs = busyUs;
+
+        states.totalUs += totalUs;
+        states.cpuActiveUs += busyUs;
+        states.cpuIdleUs += totalUs - busyUs;
+        states.radioActiveUs += radioUs;
+
+        chargeMas[EN_CPU] += ENERGY_CPU_ACTIVE_MA * (busyUs / 1e6) + ENERGY_CPU_IDLE_MA * idle;
+        chargeMas[EN_RADIO] += ENERGY_RADIO_ACTIVE_MA * (radioUs / 1e6);
+        if (connected) {
+            states.radioConnectedUs += totalUs;
+            if (radioAwake) states.radioAwakeUs += totalUs;
+            chargeMas[EN_RADIO] += (radioAwake ? ENERGY_RADIO_AWAKE_MA : ENERGY_RADIO_SLEEP_MA) * dt;
+        }
+        states.ledMas += ledMa * dt;
+        chargeMas[EN_LEDS] += ledMa * dt;
+        if (backlight) {
+            states.backlightUs += totalUs;
+            chargeMas[EN_LCD] += ENERGY_LCD_BACKLIGHT_MA * dt;
+        }
+        chargeMas[EN_SENSORS] += ENERGY_SENSORS_MA * dt;
+    }
+
+    double getChargeMas(int subsystem) const { return chargeMas[subsystem]; }
+
+    double totalMas() const {
+        double sum = 0;
+        for (int i = 0; i < EN_COUNT; i++) sum += chargeMas[i];
+        return sum;
+    }
+
+    const EnergyStates& getStates() const { return states; }
+};
+
+#endif
@@ -0,0 +1,177 @@
+/**
+ * Minimal gzip (RFC 1952) writer: LZ77 over a 2 KB window with fixed-Huffman
+ * deflate blocks. All working memory is preallocated in the object; nothing
+ * is taken from the heap while compressing. Shared by the firmware and the
+ * host benchmark/tests (host/gzip_bench.cpp, test/test_gzip).
+ */
+
+#ifndef GZIP_ENCODER_H
+#define GZIP_ENCODER_H
+
+#include <Arduino.h>
+
+inline uint32_t crc32Update(uint32_t crc, const uint8_t* data, size_t len) {
+    static uint32_t table[256];
+    static bool tableReady = false;
+    if (!tableReady) {
+        for (uint32_t i = 0; i < 256; i++) {
+            uint32_t c = i;
+            for (int k = 0; k < 8; k++) c = (c & 1) ? 0xEDB88320 ^ (c >> 1) : c >> 1;
+            table[i] = c;
+        }
+        tableReady = true;
+    }
+    crc = ~crc;
+    while (len--) crc = table[(crc ^ *data++) & 0xFF] ^ (crc >> 8);
+    return ~crc;
+}
+
+class GzipEncoder {
+private:
+    static const int HASH_BITS = 11;
+    static const int HASH_SIZE = 1 << HASH_BITS;
+    static const int WINDOW = 2048;
+    static const int MIN_MATCH = 3;
+    static const int MAX_MATCH = 258;
+    
+    uint16_t head[HASH_SIZE];   // last position + 1 for each hash, 0 = empty
+    uint16_t prev[WINDOW];      // chain links, indexed by position & (WINDOW - 1)
+    
+    uint8_t* out;
+    size_t outCap;
+    size_t outLen;
+    uint32_t bitBuf;
+    int bitCount;
+    
+    void putByte(uint8_t b) {
+        if (outLen < outCap) out[outLen] = b;
+        outLen++;
+    }
+    
+    void putBits(uint32_t value, int n) {
+        bitBuf |= value << bitCount;
+        bitCount += n;
+        while (bitCount >= 8) {
+            putByte(bitBuf & 0xFF);
+            bitBuf >>= 8;
+            bitCount -= 8;
+        }
+    }
+    
+    // Huffman codes are defined MSB-first but packed LSB-first.
+    void putCode(uint32_t code, int n) {
+        uint32_t rev = 0;
+        for (int i = 0; i < n; i++) {
+            rev = (rev << 1) | (code & 1);
+            code >>= 1;
+        }
+        putBits(rev, n);
+    }
+    
+    void putLiteral(uint8_t c) {
+        if (c < 144) putCode(0x30 + c, 8);
+        else putCode(0x190 + c - 144, 9);
+    }
+    
+    void putMatch(int len, int dist) {
+        static const uint16_t LEN_BASE[29] = {3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+                                              35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258};
+        static const uint8_t LEN_EXTRA[29] = {0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+                                              3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0};
+        static const uint16_t DIST_BASE[24] = {1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+                                               257, 385, 513, 769, 1025, 1537, 2049, 3073};
+        static const uint8_t DIST_EXTRA[24] = {0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+                                               7, 7, 8, 8, 9, 9, 10, 10};
+        
+        int li = 28;
+        while (LEN_BASE[li] > len) li--;
+        int sym = 257 + li;
+        if (sym < 280) putCode(sym - 256, 7);
+        else putCode(0xC0 + sym - 280, 8);
+        if (LEN_EXTRA[li]) putBits(len - LEN_BASE[li], LEN_EXTRA[li]);
+        
+        int di = 23;
+        while (DIST_BASE[di] > dist) di--;
+        putCode(di, 5);
+        if (DIST_EXTRA[di]) putBits(dist - DIST_BASE[di], DIST_EXTRA[di]);
+    }
+    
+    static uint32_t hash3(const uint8_t* p) {
+        return ((p[0] << 10) ^ (p[1] << 5) ^ p[2]) & (HASH_SIZE - 1);
+    }
+    
+public:
+    static const int MAX_INPUT_BYTES = 65535;
+    
+    // level 1..3 selects the hash-chain depth (speed vs ratio). Returns the
+    // gzip size, or 0 if the input is too large or the result does not fit.
+    size_t compress(const uint8_t* in, size_t len, uint8_t* dst, size_t dstCap, int level) {
+        static const int CHAIN[4] = {0, 4, 16, 64};
+        if (len > MAX_INPUT_BYTES || level < 1) return 0;
+        int maxChain = CHAIN[level > 3 ? 3 : level];
+        
+        out = dst;
+        outCap = dstCap;
+        outLen = 0;
+        bitBuf = 0;
+        bitCount = 0;
+        memset(head, 0, sizeof(head));
+        
+        static const uint8_t GZIP_HEADER[10] = {0x1F, 0x8B, 8, 0, 0, 0, 0, 0, 0, 0xFF};
+        for (uint8_t b : GZIP_HEADER) putByte(b);
+        
+        putBits(1, 1);   // BFINAL
+        putBits(1, 2);   // BTYPE = fixed Huffman
+        
+        size_t pos = 0;
+        while (pos < len) {
+            int bestLen = 0;
+            int bestDist = 0;
+            
+            if (pos + MIN_MATCH <= len) {
+                uint32_t h = hash3(in + pos);
+                int cand = (int)head[h] - 1;
+                int chain = maxChain;
+                int maxLen = (int)min((size_t)MAX_MATCH, len - pos);
+                while (cand >= 0 && chain-- > 0) {
+                    int dist = (int)pos - cand;
+                    if (dist <= 0 || dist > WINDOW - 1) break;
+                    if (in[cand + bestLen] == in[pos + bestLen]) {
+                        int l = 0;
+                        while (l < maxLen && in[cand + l] == in[pos + l]) l++;
+                        if (l > bestLen) {
+                            bestLen = l;
+                            bestDist = dist;
+                            if (l == maxLen) break;
+                        }
+                    }
+                    int next = (int)prev[cand & (WINDOW - 1)] - 1;
+                    if (next >= cand) break;
+                    cand = next;
+                }
+            }
+            
+            int advance = (bestLen >= MIN_MATCH) ? bestLen : 1;
+            if (bestLen >= MIN_MATCH) putMatch(bestLen, bestDist);
+            else putLiteral(in[pos]);
+            
+            for (int i = 0; i < advance; i++, pos++) {
+                if (pos + MIN_MATCH > len) continue;
+                uint32_t h = hash3(in + pos);
+                prev[pos & (WINDOW - 1)] = head[h];
+                head[h] = (uint16_t)(pos + 1);
+            }
+        }
+        
+        putCode(0, 7);   // end of block (symbol 256)
+        if (bitCount > 0) putBits(0, 8 - bitCount);
+        
+        uint32_t crc = crc32Update(0, in, len);
+        for (int i = 0; i < 4; i++) putByte((crc >> (8 * i)) & 0xFF);
+        for (int i = 0; i < 4; i++) putByte((len >> (8 * i)) & 0xFF);
+        
+        return outLen <= outCap ? outLen : 0;
+    }
+};
+
+#endif
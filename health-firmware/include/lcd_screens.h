@@ -0,0 +1,61 @@
+/**
+ * Text of the 20x4 LCD screens, shared by updateLCD() (main.cpp LCD
+ * DISPLAY) and host/lcd_bench.cpp, whose snapshot check compares the
+ * virtual glass against these rows. Formatting only: which rows are
+ * rewritten, and when, stays with the caller.
+ */
+
+#ifndef LCD_SCREENS_H
+#define LCD_SCREENS_H
+
+#include <stdio.h>
+
+#define LCD_COLS 20
+#define LCD_ROWS 4
+
+typedef char LcdRows[LCD_ROWS][LCD_COLS + 1];
+
+// Screen 0: vitals
+struct LcdVitalsScreen {
+    int heartRate;
+    int spo2;
+    float temperature;
+    const char* source;     // HR source, cut to 12
+    const char* stateTag;   // "[MON] ", "[PAUSE]" or "[IDLE] "
+    const char* alert;      // "" when none, cut to 13
+};
+
+// Screen 1: system status
+struct LcdStatusScreen {
+    const char* version;
+    bool wifiOk;
+    unsigned long uptimeMin;
+    bool maxFinger;
+    bool senPulse;
+    int batteryPct;         // -1: no battery, on USB
+};
+
+inline void lcdFormatVitals(const LcdVitalsScreen& s, LcdRows rows) {
+    snprintf(rows[0], LCD_COLS + 1, "HR:%d BPM O2:%d%%", s.heartRate, s.spo2);
+    snprintf(rows[1], LCD_COLS + 1, "Temp: %.1fC", s.temperature);
+    snprintf(rows[2], LCD_COLS + 1, "Src:%.12s", s.source);
+    snprintf(rows[3], LCD_COLS + 1, "%s%.13s", s.stateTag, s.alert);
+}
+
+inline void lcdFormatStatus(const LcdStatusScreen& s, LcdRows rows) {
+    // Uptime wraps at 7 digits (19 years), which is what fits the row
+    snprintf(rows[0], LCD_COLS + 1, "System Status:");
+    snprintf(rows[1], LCD_COLS + 1, "WiFi:%s Up:%lum", s.wifiOk ? "OK " : "ERR", s.uptimeMin % 10000000UL);
+    snprintf(rows[2], LCD_COLS + 1, "MAX:%s SEN:%s", s.maxFinger ? "YES" : "NO ", s.senPulse ? "YES" : "NO ");
+    if (s.batteryPct >= 0)
+        snprintf(rows[3], LCD_COLS + 1, "v%s Batt:%d%%", s.version, s.batteryPct > 100 ? 100 : s.batteryPct);
+    else snprintf(rows[3], LCD_COLS + 1, "v%s Batt:USB", s.version);
+}
+
+// A full row as written to the glass: padded with spaces to LCD_COLS, so
+// rewriting it overwrites whatever was there without a clear()
+inline void lcdPadRow(char line[LCD_COLS + 1], const char* text) {
+    snprintf(line, LCD_COLS + 1, "%-20.20s", text);
+}
+
+#endif
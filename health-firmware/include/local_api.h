@@ -0,0 +1,342 @@
+/**
+ * Bedside HTTP + WebSocket server for the local API (see main.cpp, LOCAL
+ * API). Included by the firmware after its LOCAL_API_* settings, and by the
+ * host loopback test (test/test_local_api) over host/WiFi.h sockets.
+ *
+ *   GET /vitals/latest          current snapshot
+ *   GET /vitals/history?limit=N last N log records, newest last
+ *   GET /ws                     WebSocket; pushSnapshot() sends to every client
+ *
+ * At most LOCAL_API_MAX_CLIENTS sockets are open at once and service()
+ * spends at most LOCAL_API_BUDGET_US per call, history responses included:
+ * they are streamed a few records per pass.
+ */
+
+#ifndef LOCAL_API_H
+#define LOCAL_API_H
+
+#include <Arduino.h>
+#include <WiFi.h>
+#include <mbedtls/sha1.h>
+#include <time.h>
+
+#include "vitals_record.h"
+
+#if !defined(LOCAL_API_PORT) || !defined(LOCAL_API_MAX_CLIENTS) || !defined(LOCAL_API_BUDGET_US) || \
+    !defined(LOCAL_API_REQUEST_TIMEOUT_MS) || !defined(LOCAL_API_HISTORY_MAX)
+#error "define the LOCAL_API_* settings before including local_api.h"
+#endif
+
+// Provided by the firmware (or the host test)
+size_t formatVitalsSnapshot(char* buf, size_t cap);
+uint32_t localApiNewestSeq();
+uint32_t localApiReadHistory(uint32_t from, VitalsRecord* dst, uint32_t maxCount);
+
+inline void isoTimestamp(uint32_t epoch, char* buf, size_t cap) {
+    time_t t = epoch;
+    struct tm tmv;
+    gmtime_r(&t, &tmv);
+    strftime(buf, cap, "%Y-%m-%dT%H:%M:%SZ", &tmv);
+}
+
+inline size_t formatVitalsRecordFlat(const VitalsRecord& r, char* buf, size_t cap) {
+    char ts[24];
+    isoTimestamp(r.timestamp, ts, sizeof(ts));
+    return snprintf(buf, cap,
+                    "{\"seq\":%lu,\"timestamp\":\"%s\",\"heart_rate\":%u,\"hr_quality\":%u,"
+                    "\"spo2\":%u,\"spo2_quality\":%u,\"temperature\":%.2f,\"is_temp_estimated\":%s}",
+                    (unsigned long)r.seq, ts, r.heartRate, r.hrQuality, r.spo2, r.spo2Quality,
+                    r.tempCenti / 100.0, (r.flags & VR_TEMP_ESTIMATED) ? "true" : "false");
+}
+
+class LocalApiServer {
+private:
+    static const int REQUEST_MAX = 512;
+    static const int HISTORY_READ = 8;   // log records fetched per step of a history response
+
+    struct Slot {
+        WiFiClient client;
+        bool used = false;
+        bool websocket = false;
+        bool streaming = false;          // history response in progress
+        bool wroteRow = false;
+        uint32_t historyNext = 0;
+        uint32_t historyEnd = 0;         // one past the last seq to send
+        unsigned long deadline = 0;
+        int len = 0;
+        char request[REQUEST_MAX];       // HTTP request, then buffered WebSocket frames
+    };
+
+    WiFiServer server;
+    Slot slots[LOCAL_API_MAX_CLIENTS];
+    bool started;
+    int nextSlot;
+
+    static void base64Encode(const uint8_t* in, size_t len, char* out) {
+        static const char ALPHABET[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+        size_t o = 0;
+        for (size_t i = 0; i < len; i += 3) {
+            uint32_t v = in[i] << 16;
+            if (i + 1 < len) v |= in[i + 1] << 8;
+            if (i + 2 < len) v |= in[i + 2];
+            out[o++] = ALPHABET[(v >> 18) & 0x3F];
+            out[o++] = ALPHABET[(v >> 12) & 0x3F];
+            out[o++] = (i + 1 < len) ? ALPHABET[(v >> 6) & 0x3F] : '=';
+            out[o++] = (i + 2 < len) ? ALPHABET[v & 0x3F] : '=';
+        }
+        out[o] = '\0';
+    }
+
+    // Copies at most cap - 1 characters; false if the header is missing or longer.
+    static bool headerValue(const char* request, const char* name, char* out, size_t cap) {
+        const char* p = strcasestr(request, name);
+        if (!p) return false;
+        p += strlen(name);
+        while (*p == ' ') p++;
+        size_t n = 0;
+        while (p[n] && p[n] != '\r' && p[n] != ' ') {
+            if (n == cap - 1) return false;
+            n++;
+        }
+        memcpy(out, p, n);
+        out[n] = '\0';
+        return n > 0;
+    }
+
+    void close(Slot& s) {
+        s.client.stop();
+        s.used = false;
+        s.websocket = false;
+        s.streaming = false;
+        s.len = 0;
+    }
+
+    void respond(Slot& s, int code, const char* status, const char* body) {
+        s.client.printf("HTTP/1.1 %d %s\r\nContent-Type: application/json\r\n"
+                        "Access-Control-Allow-Origin: *\r\nContent-Length: %u\r\nConnection: close\r\n\r\n",
+                        code, status, (unsigned)strlen(body));
+        s.client.print(body);
+        close(s);
+    }
+
+    void sendFrame(Slot& s, uint8_t opcode, const char* payload, size_t len) {
+        uint8_t hdr[4];
+        size_t h = 0;
+        hdr[h++] = 0x80 | opcode;
+        if (len < 126) {
+            hdr[h++] = len;
+        } else {
+            hdr[h++] = 126;
+            hdr[h++] = (len >> 8) & 0xFF;
+            hdr[h++] = len & 0xFF;
+        }
+        s.client.write(hdr, h);
+        if (len) s.client.write((const uint8_t*)payload, len);
+    }
+
+    void upgrade(Slot& s) {
+        static const char WS_GUID[] = "258EAFA5-E914-47DA-95CA-C5AB0DC85B11";
+        char key[64];
+        // The key is 24 characters; leave room for the GUID after it
+        if (!headerValue(s.request, "Sec-WebSocket-Key:", key, sizeof(key) - (sizeof(WS_GUID) - 1))) {
+            respond(s, 400, "Bad Request", "{\"error\":\"missing websocket key\"}");
+            return;
+        }
+        strcat(key, WS_GUID);
+        uint8_t digest[20];
+        mbedtls_sha1((const unsigned char*)key, strlen(key), digest);
+        char accept[32];
+        base64Encode(digest, sizeof(digest), accept);
+        s.client.printf("HTTP/1.1 101 Switching Protocols\r\nUpgrade: websocket\r\nConnection: Upgrade\r\n"
+                        "Sec-WebSocket-Accept: %s\r\n\r\n", accept);
+        s.websocket = true;
+        s.len = 0;
+
+        char snapshot[512];
+        size_t n = formatVitalsSnapshot(snapshot, sizeof(snapshot));
+        sendFrame(s, 0x1, snapshot, n);
+    }
+
+    void handleRequest(Slot& s) {
+        char method[8], path[64];
+        if (sscanf(s.request, "%7s %63s", method, path) != 2 || strcmp(method, "GET") != 0) {
+            respond(s, 405, "Method Not Allowed", "{\"error\":\"GET only\"}");
+            return;
+        }
+
+        if (strcmp(path, "/ws") == 0) {
+            upgrade(s);
+        } else if (strcmp(path, "/vitals/latest") == 0) {
+            char body[512];
+            formatVitalsSnapshot(body, sizeof(body));
+            respond(s, 200, "OK", body);
+        } else if (strncmp(path, "/vitals/history", 15) == 0) {
+            const char* q = strstr(path, "limit=");
+            uint32_t limit = constrain(q ? atoi(q + 6) : 60, 1, LOCAL_API_HISTORY_MAX);
+            uint32_t newest = localApiNewestSeq();
+            s.historyNext = (newest >= limit) ? newest - limit + 1 : 1;
+            s.historyEnd = newest + 1;
+            s.streaming = true;
+            s.wroteRow = false;
+            s.client.print("HTTP/1.1 200 OK\r\nContent-Type: application/json\r\n"
+                           "Access-Control-Allow-Origin: *\r\nConnection: close\r\n\r\n[");
+        } else {
+            respond(s, 404, "Not Found", "{\"error\":\"not found\"}");
+        }
+    }
+
+    // Sends history rows a few log records at a time until the budget is spent.
+    void serviceHistory(Slot& s, unsigned long startUs) {
+        VitalsRecord recs[HISTORY_READ];
+        char row[256];
+        while (s.historyNext < s.historyEnd && micros() - startUs < LOCAL_API_BUDGET_US) {
+            uint32_t want = min((uint32_t)HISTORY_READ, s.historyEnd - s.historyNext);
+            uint32_t count = localApiReadHistory(s.historyNext, recs, want);
+            if (count == 0) {
+                s.historyNext = s.historyEnd;
+                break;
+            }
+            for (uint32_t i = 0; i < count; i++) {
+                if (recs[i].flags & VR_GAP) continue;
+                size_t n = formatVitalsRecordFlat(recs[i], row + 1, sizeof(row) - 1);
+                row[0] = ',';
+                s.client.write((const uint8_t*)(s.wroteRow ? row : row + 1), s.wroteRow ? n + 1 : n);
+                s.wroteRow = true;
+            }
+            s.historyNext = recs[count - 1].seq + 1;
+        }
+        if (s.historyNext >= s.historyEnd) {
+            s.client.print("]");
+            close(s);
+        }
+    }
+
+    // Client->server frames are only read to honour close and ping. Bytes
+    // are buffered until a whole frame is in, so a frame split across TCP
+    // segments is never parsed from the middle.
+    void serviceWebSocket(Slot& s) {
+        while (s.client.available() && s.len < REQUEST_MAX) s.request[s.len++] = (char)s.client.read();
+
+        while (s.len >= 2) {
+            const uint8_t* f = (const uint8_t*)s.request;
+            uint8_t opcode = f[0] & 0x0F;
+            uint32_t len = f[1] & 0x7F;
+            int hdr = 2;
+            if (len == 126) {
+                if (s.len < 4) return;
+                len = (f[2] << 8) | f[3];
+                hdr = 4;
+            } else if (len == 127) {
+                close(s);   // no 64-bit frames from bedside clients
+                return;
+            }
+            const uint8_t* mask = nullptr;
+            if (f[1] & 0x80) {
+                mask = f + hdr;
+                hdr += 4;
+            }
+            if (hdr + len > (uint32_t)REQUEST_MAX) {
+                close(s);   // far larger than any ping or close
+                return;
+            }
+            if ((uint32_t)s.len < hdr + len) return;
+
+            char payload[125];
+            uint32_t keep = min(len, (uint32_t)sizeof(payload));
+            for (uint32_t i = 0; i < keep; i++) payload[i] = (char)(f[hdr + i] ^ (mask ? mask[i & 3] : 0));
+            s.len -= hdr + len;
+            memmove(s.request, s.request + hdr + len, s.len);
+
+            if (opcode == 0x8) {
+                sendFrame(s, 0x8, nullptr, 0);
+                close(s);
+                return;
+            }
+            if (opcode == 0x9) sendFrame(s, 0xA, payload, keep);
+        }
+    }
+
+public:
+    LocalApiServer() : server(LOCAL_API_PORT), started(false), nextSlot(0) {}
+
+    // Once the network is up
+    void begin() {
+        if (started) return;
+        server.begin();
+        server.setNoDelay(true);
+        started = true;
+    }
+
+    bool isStarted() { return started; }
+
+    void service() {
+        if (!started) return;
+        unsigned long startUs = micros();
+
+        WiFiClient incoming = server.available();
+        if (incoming) {
+            int free = -1;
+            for (int i = 0; i < LOCAL_API_MAX_CLIENTS; i++) {
+                if (!slots[i].used) {
+                    free = i;
+                    break;
+                }
+            }
+            if (free < 0) {
+                incoming.print("HTTP/1.1 503 Service Unavailable\r\nConnection: close\r\n\r\n");
+                incoming.stop();
+            } else {
+                slots[free].client = incoming;
+                slots[free].used = true;
+                slots[free].websocket = false;
+                slots[free].streaming = false;
+                slots[free].len = 0;
+                slots[free].deadline = millis() + LOCAL_API_REQUEST_TIMEOUT_MS;
+            }
+        }
+
+        // Round-robin so one chatty client cannot monopolise the budget.
+        for (int n = 0; n < LOCAL_API_MAX_CLIENTS && micros() - startUs < LOCAL_API_BUDGET_US; n++) {
+            Slot& s = slots[nextSlot];
+            nextSlot = (nextSlot + 1) % LOCAL_API_MAX_CLIENTS;
+            if (!s.used) continue;
+            if (!s.client.connected()) {
+                close(s);
+                continue;
+            }
+            if (s.websocket) {
+                serviceWebSocket(s);
+                continue;
+            }
+            if (s.streaming) {
+                serviceHistory(s, startUs);
+                continue;
+            }
+            while (s.client.available() && s.len < REQUEST_MAX - 1) {
+                s.request[s.len++] = (char)s.client.read();
+            }
+            s.request[s.len] = '\0';
+            if (strstr(s.request, "\r\n\r\n")) {
+                handleRequest(s);
+                if (s.streaming) serviceHistory(s, startUs);
+            } else if (s.len >= REQUEST_MAX - 1) {
+                respond(s, 431, "Request Header Fields Too Large", "{\"error\":\"request too large\"}");
+            } else if ((long)(millis() - s.deadline) > 0) {
+                close(s);
+            }
+        }
+    }
+
+    void pushSnapshot() {
+        char snapshot[512];
+        size_t n = 0;
+        for (int i = 0; i < LOCAL_API_MAX_CLIENTS; i++) {
+            Slot& s = slots[i];
+            if (!s.used || !s.websocket) continue;
+            if (n == 0) n = formatVitalsSnapshot(snapshot, sizeof(snapshot));
+            sendFrame(s, 0x1, snapshot, n);
+        }
+    }
+};
+
+#endif
@@ -0,0 +1,132 @@
+/**
+ * MAX30102 FIFO drain shared by the firmware's MAX30102Sensor (main.cpp)
+ * and the host benches and test, which run it against the register
+ * emulator (host/max30102_emu.h) over the emulated bus.
+ *
+ * Rollover is off, so a full FIFO keeps its 32 oldest samples and
+ * OVF_COUNTER counts the newer ones dropped (saturating at 31). Each poll
+ * reads WR_PTR, OVF_COUNTER and RD_PTR in one 3-byte transfer; when the
+ * pointers meet, A_FULL (set at 0 free slots, cleared when INT_STATUS_1 is
+ * read) tells a full FIFO from an empty one. Samples then come out in
+ * bursts of up to 16. A sample that arrives between the pointer read and
+ * the first pop can fill the FIFO for a moment and raise A_FULL after the
+ * poll has sized its read, so a drain that started near full reads
+ * INT_STATUS_1 again at the end; otherwise the stale flag would make the
+ * next poll that finds the FIFO empty read 32 old samples.
+ */
+
+#ifndef MAX30102_FIFO_H
+#define MAX30102_FIFO_H
+
+#include <Arduino.h>
+#include <Wire.h>
+
+#if !defined(MAX30102_I2C_ADDR)
+#error "define MAX30102_I2C_ADDR before including max30102_fifo.h"
+#endif
+
+#ifndef DSP_HOT
+#define DSP_HOT
+#endif
+
+class Max30102Fifo {
+public:
+    static const uint8_t REG_INT_STATUS_1 = 0x00;
+    static const uint8_t INT_A_FULL = 0x80;
+    static const uint8_t REG_FIFO_WR_PTR = 0x04;   // then OVF_COUNTER, RD_PTR
+    static const uint8_t REG_FIFO_DATA = 0x07;
+    static const int DEPTH = 32;
+    static const int SAMPLE_BYTES = 6;      // 18-bit RED, then IR, 3 bytes each
+    static const int BURST_SAMPLES = 16;    // 96 bytes, inside the Wire buffer
+
+    struct Stats {
+        uint32_t samples = 0;
+        uint32_t lost = 0;           // lower bound: OVF saturates at 31 and clears on the next pop
+        uint32_t overflows = 0;      // polls that found OVF_COUNTER > 0
+        uint8_t maxDepth = 0;        // deepest FIFO seen at a poll; 32 = it filled up
+        uint8_t lastDepth = 0;
+    };
+
+private:
+    Stats stats;
+    uint32_t lastPollUs;
+    bool gapPending;     // the FIFO overflowed; samples read next follow a gap
+
+public:
+    Max30102Fifo() : lastPollUs(0), gapPending(false) {}
+
+    static bool DSP_HOT readRegs(uint8_t reg, uint8_t* buf, int n) {
+        Wire.beginTransmission(MAX30102_I2C_ADDR);
+        Wire.write(reg);
+        if (Wire.endTransmission(false) != 0) return false;
+        if (Wire.requestFrom((int)MAX30102_I2C_ADDR, n) != n) return false;
+        for (int i = 0; i < n; i++) buf[i] = Wire.read();
+        return true;
+    }
+
+    // Reads everything queued, at most once per periodUs (0: every call).
+    // Calls sink.onSample(red, ir) per sample in order, and sink.onGap()
+    // before the first sample that follows dropped ones. Returns the
+    // samples read, or -1 when the period has not elapsed yet.
+    template <typename Sink>
+    int DSP_HOT poll(uint32_t periodUs, Sink& sink) {
+        if (periodUs && micros() - lastPollUs < periodUs) return -1;
+        lastPollUs = micros();
+
+        uint8_t ptr[3];
+        int pending = 0;
+        uint8_t ovf = 0;
+        if (readRegs(REG_FIFO_WR_PTR, ptr, 3)) {
+            ovf = ptr[1] & 0x1F;
+            pending = (ptr[0] - ptr[2]) & (DEPTH - 1);
+            // Pointers meet: empty, or full. OVF > 0 only once a sample has
+            // been dropped, so check A_FULL too. Any flag still set was
+            // raised since the last read, while nothing was popped.
+            if (pending == 0) {
+                uint8_t status = 0;
+                readRegs(REG_INT_STATUS_1, &status, 1);
+                if ((status & INT_A_FULL) || ovf > 0) pending = DEPTH;
+            }
+        }
+        stats.lastDepth = pending;
+        if (pending > stats.maxDepth) stats.maxDepth = pending;
+
+        int got = 0;
+        uint8_t buf[BURST_SAMPLES * SAMPLE_BYTES];
+        while (got < pending) {
+            int n = pending - got < BURST_SAMPLES ? pending - got : BURST_SAMPLES;
+            if (!readRegs(REG_FIFO_DATA, buf, n * SAMPLE_BYTES)) break;
+            for (int i = 0; i < n; i++) {
+                const uint8_t* b = buf + i * SAMPLE_BYTES;
+                uint32_t red = ((uint32_t)b[0] << 16 | (uint32_t)b[1] << 8 | b[2]) & 0x3FFFF;
+                uint32_t ir = ((uint32_t)b[3] << 16 | (uint32_t)b[4] << 8 | b[5]) & 0x3FFFF;
+                if (gapPending) {
+                    gapPending = false;
+                    sink.onGap();
+                }
+                sink.onSample(red, ir);
+            }
+            got += n;
+        }
+
+        // A sample pushed before the first pop above may have filled the
+        // FIFO: clear the A_FULL it raised, the FIFO is far from full now
+        if (pending > DEPTH - BURST_SAMPLES) {
+            uint8_t status;
+            readRegs(REG_INT_STATUS_1, &status, 1);
+        }
+
+        // The dropped samples came after the ones just read
+        if (ovf > 0) {
+            stats.overflows++;
+            stats.lost += ovf;
+            gapPending = true;
+        }
+        stats.samples += got;
+        return got;
+    }
+
+    const Stats& getStats() const { return stats; }
+};
+
+#endif
@@ -0,0 +1,526 @@
+/**
+ * MAX30102 front end: drains the FIFO (include/max30102_fifo.h) and passes
+ * every sample, once, to the live stream, alert capture, pulse morphology
+ * and the heart-rate / SpO2 DSP; loop passes in between do nothing. Finger
+ * detection, the raw-window rate estimate, the DC/AC
+ * split, the adaptive-threshold beat detector and the ratio-of-ratios SpO2
+ * all live here; the chip setup, LED drive and bus recovery are the
+ * firmware's, through the functions declared below.
+ *
+ * Shared by the firmware (main.cpp, MAX30102 SENSOR CLASS) and the host
+ * check in test/test_max30102_sensor, which runs it against the register
+ * emulator.
+ */
+
+#ifndef MAX30102_SENSOR_H
+#define MAX30102_SENSOR_H
+
+#include <Arduino.h>
+#include <math.h>
+#include <string.h>
+
+#if !defined(MAX30102_SATURATED)
+#error "define MAX30102_SATURATED before including max30102_sensor.h"
+#endif
+
+#ifndef DSP_HOT
+#define DSP_HOT
+#endif
+#ifndef DSP_PROFILE_SCOPE
+#define DSP_PROFILE_SCOPE(stage)
+#endif
+
+#include "max30102_fifo.h"
+#include "pulse_morphology.h"
+#include "trace_stamp.h"
+
+// Provided by the firmware (or the host test)
+bool max30102Setup(uint8_t ledAmplitude, uint32_t& firstIr);   // false: no chip
+void max30102SetPower(uint8_t amplitude, int sps);
+void max30102BusRecover();
+uint32_t max30102FingerIr();                                   // finger-on thresholds
+uint32_t max30102FingerRed();
+void liveStreamSample(uint32_t ir);
+void liveStreamGap();
+void captureSample(uint32_t red, uint32_t ir);
+void captureGap();
+void rollupBeat(const char* source, unsigned long ibiMs);
+void rhythmBeat(uint16_t ibiMs);
+void rhythmGap();
+void rhythmReset();
+
+class MAX30102Sensor {
+private:
+    bool available;
+    
+    static const byte RATE_SIZE = 8;
+    byte rates[RATE_SIZE];
+    byte rateSpot;
+    unsigned long lastBeat;
+    float beatsPerMinute;
+    int beatAvg;
+    
+    uint32_t irValue;
+    uint32_t redValue;
+    
+    float irDC;
+    float redDC;
+    float irAC;
+    float redAC;
+    
+    int spo2Value;
+    int spo2Quality;
+    
+    uint32_t irPeak;
+    uint32_t irTrough;
+    uint32_t adaptiveThreshold;
+    unsigned long lastThresholdUpdate;
+    
+    bool fingerDetected;
+    int lastValidBPM;
+    int lastValidSpO2;
+    
+    static const int IR_RAW_BUF = 80;
+    uint32_t irRawBuf[IR_RAW_BUF];
+    unsigned long irRawTimeBuf[IR_RAW_BUF];
+    int irRawHead;
+    int irRawLen;
+    int bpmFromRaw;
+    
+    int i2cNoDataCount;
+    unsigned long i2cLastRecoveryMs;
+    
+    Max30102Fifo fifo;   // include/max30102_fifo.h
+    bool beatTimingReset;// next beat only re-arms lastBeat
+    PulseMorphology morph;
+    
+    TraceStamp sampleStamp;
+    TraceStamp beatStamp;
+    
+    // LED drive as set by the power policy
+    uint8_t ledAmplitude;
+    int samplesPerSecond;
+    
+    int DSP_HOT computeBPMFromRaw() {
+        if (irRawLen < (int)(IR_RAW_BUF - 2)) return 0;
+        uint32_t minV = 0xFFFFFFFF, maxV = 0;
+        for (int i = 0; i < irRawLen; i++) {
+            int idx = (irRawHead + i) % IR_RAW_BUF;
+            uint32_t v = irRawBuf[idx];
+            if (v < minV) minV = v;
+            if (v > maxV) maxV = v;
+        }
+        if (maxV <= minV || (maxV - minV) < 1000) return 0;
+        uint32_t thresh = minV + (maxV - minV) / 3;
+        int peakIdx[16];
+        int nPeaks = 0;
+        for (int i = 1; i < irRawLen - 1 && nPeaks < 16; i++) {
+            int idx = (irRawHead + i) % IR_RAW_BUF;
+            int idxL = (irRawHead + i - 1) % IR_RAW_BUF;
+            int idxR = (irRawHead + i + 1) % IR_RAW_BUF;
+            uint32_t v = irRawBuf[idx];
+            if (v > thresh && v >= irRawBuf[idxL] && v >= irRawBuf[idxR])
+                peakIdx[nPeaks++] = idx;
+        }
+        if (nPeaks < 2) return 0;
+        long intervals[15];
+        int nInt = 0;
+        for (int i = 1; i < nPeaks; i++) {
+            long dt = (long)(irRawTimeBuf[peakIdx[i]] - irRawTimeBuf[peakIdx[i-1]]);
+            if (dt >= 300 && dt <= 2000) intervals[nInt++] = dt;
+        }
+        if (nInt == 0) return 0;
+        for (int i = 0; i < nInt - 1; i++)
+            for (int j = i + 1; j < nInt; j++)
+                if (intervals[j] < intervals[i]) {
+                    long t = intervals[i]; intervals[i] = intervals[j]; intervals[j] = t;
+                }
+        long medianMs = nInt % 2 ? intervals[nInt/2] : (intervals[nInt/2 - 1] + intervals[nInt/2]) / 2;
+        int bpm = (int)(60000 / medianMs);
+        if (bpm >= 40 && bpm <= 180) return bpm;
+        return 0;
+    }
+    
+public:
+    MAX30102Sensor() : available(false), rateSpot(0),
+                                    lastBeat(0), beatsPerMinute(0), beatAvg(0),
+                                    irValue(0), redValue(0), irDC(0), redDC(0),
+                                    irAC(0), redAC(0), spo2Value(0), spo2Quality(0),
+                                    irPeak(0), irTrough(0xFFFFFFFF), adaptiveThreshold(25000),
+                                    lastThresholdUpdate(0), fingerDetected(false),
+                                    lastValidBPM(0), lastValidSpO2(0),
+                                    irRawHead(0), irRawLen(0), bpmFromRaw(0),
+                                    i2cNoDataCount(0), i2cLastRecoveryMs(0),
+                                    beatTimingReset(false),
+                                    ledAmplitude(0x7F), samplesPerSecond(100) {
+        memset(rates, 0, sizeof(rates));
+        memset(irRawBuf, 0, sizeof(irRawBuf));
+        memset(irRawTimeBuf, 0, sizeof(irRawTimeBuf));
+    }
+    
+    bool begin() {
+        uint32_t ir = 0;
+        if (!max30102Setup(ledAmplitude, ir)) {
+            available = false;
+            return false;
+        }
+        if (ir > 0) irDC = ir;
+        
+        available = true;
+        if (samplesPerSecond != 100) setPowerLevel(ledAmplitude, samplesPerSecond);
+        return true;
+    }
+    
+private:
+    // Samples lost in the FIFO end a run of contiguous data: the live stream
+    // gets a gap marker and beat timing restarts instead of measuring an
+    // interval across the hole.
+    void DSP_HOT markGap() {
+        liveStreamGap();
+        captureGap();
+        beatTimingReset = true;
+        irRawLen = 0;
+        morph.reset();
+        rhythmGap();
+    }
+    
+    // Every FIFO sample goes to the live stream, alert capture, pulse
+    // morphology and the DSP, once each.
+    struct FifoSink {
+        MAX30102Sensor& s;
+        void DSP_HOT onGap() { s.markGap(); }
+        void DSP_HOT onSample(uint32_t red, uint32_t ir) {
+            s.redValue = red;
+            s.irValue = ir;
+            liveStreamSample(ir);
+            captureSample(red, ir);
+            s.morph.addSample(ir);
+            if (ir >= MAX30102_SATURATED) s.morph.reset();
+            s.processSample();
+        }
+    };
+    
+    // Drains the FIFO at most once per FIFO sample period (40 ms at 25
+    // samples/s). A stuck bus is reset after ~35 polls (1.4 s) in a row
+    // without data.
+    void DSP_HOT readFifo() {
+        FifoSink sink = {*this};
+        int got = fifo.poll(1000000UL / getFifoRate(), sink);
+        if (got < 0) return;
+        
+        if (got > 0) {
+            i2cNoDataCount = 0;
+            sampleStamp.mark();
+        } else {
+            i2cNoDataCount++;
+            if (i2cNoDataCount >= 35 && (millis() - i2cLastRecoveryMs) >= 10000) {
+                max30102BusRecover();
+                i2cNoDataCount = 0;
+                i2cLastRecoveryMs = millis();
+            }
+        }
+    }
+    
+    // The DSP on one FIFO sample. The raw ring, the DC averages and the beat
+    // detector are all paced per sample, so it runs exactly once for each;
+    // a loop pass without a new sample leaves them alone.
+    void DSP_HOT processSample() {
+        DSP_PROFILE_SCOPE(DSP_MAX_PROCESS);
+        
+        bool saturated = (irValue >= MAX30102_SATURATED || redValue >= MAX30102_SATURATED);
+        if (saturated) {
+            // Don't use saturated readings for DC/AC/beat – signal is flat, BPM would stay 0
+            irValue = (irValue >= MAX30102_SATURATED && irDC > 0) ? (uint32_t)irDC : irValue;
+            redValue = (redValue >= MAX30102_SATURATED && redDC > 0) ? (uint32_t)redDC : redValue;
+        }
+        
+        bool wasDetected = fingerDetected;
+        fingerDetected = (irValue > max30102FingerIr()) && (redValue > max30102FingerRed()); 
+
+        #ifdef DEBUG_SENSORS
+        if (millis() % 200 == 0) {
+            Serial.print("MAX30102: IR=");
+            Serial.print(irValue);
+            Serial.print(", RED=");
+            Serial.print(redValue);
+            Serial.print(", Detect=");
+            Serial.print(fingerDetected);
+            Serial.print(", BPM=");
+            Serial.println(beatsPerMinute);
+        }
+        #endif
+        
+        if (fingerDetected && !wasDetected) {
+            memset(rates, 0, sizeof(rates));
+            rateSpot = 0;
+            beatAvg = 0;
+            irPeak = 0;
+            irTrough = 0xFFFFFFFF;
+            lastBeat = millis();
+            beatTimingReset = true;      // finger-on to first beat is not an interval
+            adaptiveThreshold = max30102FingerIr() + 10000;
+            lastThresholdUpdate = millis();
+        } else if (!fingerDetected && wasDetected) {
+            reset();
+            return;
+        }
+        
+        if (!fingerDetected) return;
+        
+        if (irValue < MAX30102_SATURATED) {
+            irRawBuf[irRawHead] = irValue;
+            irRawTimeBuf[irRawHead] = millis();
+            irRawHead = (irRawHead + 1) % IR_RAW_BUF;
+            if (irRawLen < IR_RAW_BUF) irRawLen++;
+        }
+        bpmFromRaw = computeBPMFromRaw();
+        if (bpmFromRaw > 0) lastValidBPM = bpmFromRaw;
+        
+        const float DC_ALPHA = 0.995f;
+        irDC = irDC * DC_ALPHA + irValue * (1.0f - DC_ALPHA);
+        redDC = redDC * DC_ALPHA + redValue * (1.0f - DC_ALPHA);
+        
+        irAC = irValue - irDC;
+        redAC = redValue - redDC;
+        
+        updateThreshold();
+        
+        bool beat = detectBeat(irValue);
+        if (beat) morph.onBeat();
+        if (beat && beatTimingReset) {
+            // First beat after a FIFO gap or finger-on: re-arm only
+            beatTimingReset = false;
+            lastBeat = millis();
+            beatStamp.mark();
+        } else if (beat) {
+            unsigned long delta = millis() - lastBeat;
+            lastBeat = millis();
+            beatStamp.mark();
+            
+            beatsPerMinute = 60.0f / (delta / 1000.0f);
+            
+            if (beatsPerMinute >= 30 && beatsPerMinute <= 200) {
+                // The rhythm screen takes every plausible interval, including
+                // the ones the rate average below discards as outliers
+                rhythmBeat((uint16_t)delta);
+                
+                bool valid = true;
+                if (beatAvg > 0) {
+                    int diff = abs((int)beatsPerMinute - beatAvg);
+                    if (diff > 40) valid = false;
+                }
+                
+                if (valid) {
+                    rates[rateSpot++] = (byte)beatsPerMinute;
+                    rateSpot %= RATE_SIZE;
+                    
+                    int sum = 0;
+                    int count = 0;
+                    for (byte x = 0; x < RATE_SIZE; x++) {
+                        if (rates[x] > 0) {
+                            sum += rates[x];
+                            count++;
+                        }
+                    }
+                    if (count > 0) beatAvg = sum / count;
+                    rollupBeat("MAX30102", delta);
+                }
+            } else {
+                rhythmGap();
+            }
+            if (beatAvg > 0) lastValidBPM = beatAvg;
+        }
+        
+        calculateSpO2();
+        if (spo2Value > 0) lastValidSpO2 = spo2Value;
+    }
+    
+public:
+    // Called every loop pass; the DSP runs from the FIFO sink
+    void DSP_HOT update() {
+        if (!available) return;
+        DSP_PROFILE_SCOPE(DSP_MAX_FIFO);
+        readFifo();
+    }
+    
+    void DSP_HOT updateThreshold() {
+        if (!fingerDetected) return;
+        
+        // Track peak and trough with better initialization
+        if (irPeak == 0 || irValue > irPeak) irPeak = irValue;
+        if (irTrough == 0xFFFFFFFF || (irValue < irTrough && irValue > max30102FingerIr())) {
+            irTrough = irValue;
+        }
+        
+        if (millis() - lastThresholdUpdate > 500) {
+            // Decay peak slowly, allow trough to rise
+            if (irPeak > 0) irPeak = irPeak * 0.92f;
+            if (irTrough < irValue * 1.5f && irTrough != 0xFFFFFFFF) {
+                irTrough = irTrough * 1.08f;
+            }
+            
+            // Calculate threshold based on peak/trough or DC level
+            if (irPeak > 0 && irTrough < 0xFFFFFFFF && irPeak > irTrough) {
+                uint32_t range = irPeak - irTrough;
+                adaptiveThreshold = irTrough + (range * 0.4f);
+            } else {
+                // Fallback: use DC-based threshold
+                adaptiveThreshold = irDC * 1.05f;
+            }
+            
+            // Keep threshold in reasonable range
+            adaptiveThreshold = constrain(adaptiveThreshold, max30102FingerIr(), (uint32_t)(irDC + 50000));
+            lastThresholdUpdate = millis();
+        }
+    }
+    
+    bool DSP_HOT detectBeat(uint32_t sample) {
+        static uint32_t lastSample = 0;
+        static bool risingEdge = false;
+        static unsigned long lastBeatTime = 0;
+        
+        // Initialize lastBeatTime on first call
+        if (lastBeatTime == 0) {
+            lastBeatTime = millis();
+            lastSample = sample;
+            return false;
+        }
+        
+        // Rising edge detection: signal crosses threshold from below
+        if (sample > adaptiveThreshold && lastSample <= adaptiveThreshold) {
+            risingEdge = true;
+        }
+        
+        // Falling edge detection: confirm beat only on downward crossing
+        if (risingEdge && sample < adaptiveThreshold && lastSample >= adaptiveThreshold) {
+            unsigned long now = millis();
+            unsigned long beatInterval = now - lastBeatTime;
+            
+            // Valid beat interval: 300ms to 2500ms (24-200 BPM)
+            if (beatInterval > 300 && beatInterval < 2500) {
+                lastBeatTime = now;
+                risingEdge = false;
+                lastSample = sample;
+                return true;
+            }
+            risingEdge = false;
+        }
+        
+        lastSample = sample;
+        return false;
+    }
+    
+    void DSP_HOT calculateSpO2() {
+        if (!fingerDetected || irDC < max30102FingerIr() || redDC < max30102FingerIr() || fabs(irAC) < 30) {
+            spo2Value = 0;
+            spo2Quality = 0;
+            return;
+        }
+        
+        float ratioRMS = (fabs(redAC) / redDC) / (fabs(irAC) / irDC);
+        spo2Value = constrain((int)(110 - 25 * ratioRMS), 70, 100);
+        
+        if (irValue > 80000 && beatAvg > 0) {
+            spo2Quality = 95;
+        } else if (irValue > 50000 && beatAvg > 0) {
+            spo2Quality = 80;
+        } else if (irValue > 30000) {
+            spo2Quality = 60;
+        } else if (irValue > max30102FingerIr()) {
+            spo2Quality = 40;
+        } else {
+            spo2Quality = 20;
+        }
+    }
+    
+    int getBPM() {
+        if (!available || !fingerDetected) return 0;
+        if (millis() - lastBeat <= 3000 && beatAvg > 0) return beatAvg;
+        if (bpmFromRaw > 0) return bpmFromRaw;
+        return lastValidBPM;
+    }
+    
+    int getLastValidBPM() { return fingerDetected ? lastValidBPM : 0; }
+    uint32_t getLastSampleUs() { return sampleStamp.get(); }
+    uint32_t getLastBeatUs() { return beatStamp.get(); }
+    
+    int getSpO2() {
+        if (available && fingerDetected && spo2Value > 0) return spo2Value;
+        if (lastValidSpO2 > 0) return lastValidSpO2;
+        return 0;
+    }
+    
+    int getHRQuality() {
+        if (!available || !fingerDetected) {
+            if (lastValidBPM > 0) return 25;
+            return 0;
+        }
+        if (bpmFromRaw > 0) return 45;
+        unsigned long timeSinceBeat = millis() - lastBeat;
+        if (irValue > 80000 && beatAvg > 0 && timeSinceBeat < 1200) return 95;
+        else if (irValue > 50000 && beatAvg > 0 && timeSinceBeat < 2000) return 75;
+        else if (irValue > 30000 && timeSinceBeat < 3000) return 50;
+        else if (irValue > max30102FingerIr()) return 30;
+        if (lastValidBPM > 0) return 25;
+        return 20;
+    }
+    
+    int getSpO2Quality() {
+        if (!available || !fingerDetected) {
+            if (lastValidSpO2 > 0) return 25;
+            return 0;
+        }
+        if (lastValidSpO2 > 0 && spo2Value == 0) return 25;
+        return spo2Quality;
+    }
+    
+    bool isAvailable() { return available; }
+    bool isFingerDetected() { return available && fingerDetected; }
+    
+    // LED current and sample rate (50 or 100 sps), applied now or at begin()
+    void setPowerLevel(uint8_t amplitude, int sps) {
+        ledAmplitude = amplitude;
+        samplesPerSecond = (sps <= 50) ? 50 : 100;
+        if (!available) return;
+        max30102SetPower(amplitude, samplesPerSecond);
+    }
+    
+    uint8_t getLedAmplitude() { return ledAmplitude; }
+    
+    void printState(Print& out) {
+        if (!available) {
+            out.println("MAX30102: not available");
+            return;
+        }
+        out.printf("MAX30102: ir=%lu red=%lu finger=%d ir_dc=%.0f red_dc=%.0f ir_ac=%.0f\n",
+                   (unsigned long)irValue, (unsigned long)redValue, fingerDetected, irDC, redDC, irAC);
+        out.printf("  threshold=%lu trough=%lu peak=%lu bpm=%.0f avg=%d raw_bpm=%d spo2=%d/%d\n",
+                   (unsigned long)adaptiveThreshold, (unsigned long)irTrough, (unsigned long)irPeak,
+                   beatsPerMinute, beatAvg, bpmFromRaw, spo2Value, spo2Quality);
+        out.printf("  led=0x%02X sps=%d i2c_idle=%d fifo_depth=%d/%d lost=%lu in %lu overflows\n",
+                   ledAmplitude, samplesPerSecond, i2cNoDataCount, fifo.getStats().lastDepth,
+                   fifo.getStats().maxDepth, (unsigned long)fifo.getStats().lost,
+                   (unsigned long)fifo.getStats().overflows);
+        morph.printState(out);
+    }
+    
+    const Max30102Fifo::Stats& getFifoStats() const { return fifo.getStats(); }
+    int getSamplesPerSecond() { return samplesPerSecond; }
+    // Samples the FIFO delivers per second: the ADC rate over the averaging
+    int getFifoRate() { return samplesPerSecond / (samplesPerSecond == 50 ? 2 : 4); }
+    const PulseMorphology& getMorphology() const { return morph; }
+    
+    void reset() {
+        morph.reset();
+        rhythmReset();
+        beatAvg = 0;
+        beatsPerMinute = 0;
+        spo2Value = 0;
+        memset(rates, 0, sizeof(rates));
+        rateSpot = 0;
+        irPeak = 0;
+        irTrough = 0xFFFFFFFF;
+    }
+};
+
+#endif
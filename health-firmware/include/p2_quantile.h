@@ -0,0 +1,90 @@
+/**
+ * Streaming quantile estimators for the firmware's vital rollups (main.cpp
+ * VITAL ROLLUPS) and the host check in test/test_p2_quantile: the P2
+ * algorithm (Jain & Chlamtac 1985) keeps five markers per quantile instead
+ * of the samples.
+ */
+
+#ifndef P2_QUANTILE_H
+#define P2_QUANTILE_H
+
+#include <math.h>
+#include <stdint.h>
+
+class P2Quantile {
+private:
+    float p;
+    float q[5];      // marker heights
+    float n[5];      // marker positions (0-based)
+    float want[5];   // desired positions
+    uint32_t count;
+    
+    float parabolic(int i, float d) {
+        return q[i] + d / (n[i + 1] - n[i - 1]) *
+               ((n[i] - n[i - 1] + d) * (q[i + 1] - q[i]) / (n[i + 1] - n[i]) +
+                (n[i + 1] - n[i] - d) * (q[i] - q[i - 1]) / (n[i] - n[i - 1]));
+    }
+    
+    float linear(int i, int d) {
+        return q[i] + d * (q[i + d] - q[i]) / (n[i + d] - n[i]);
+    }
+    
+public:
+    explicit P2Quantile(float quantile = 0.5) : p(quantile), count(0) {}
+    
+    void reset() { count = 0; }
+    
+    void add(float x) {
+        if (count < 5) {
+            // Insertion sort of the first five samples
+            int i = count++;
+            while (i > 0 && q[i - 1] > x) { q[i] = q[i - 1]; i--; }
+            q[i] = x;
+            if (count == 5) {
+                for (int j = 0; j < 5; j++) n[j] = j;
+                want[0] = 0; want[1] = 2 * p; want[2] = 4 * p; want[3] = 2 + 2 * p; want[4] = 4;
+            }
+            return;
+        }
+        count++;
+        
+        int k;
+        if (x < q[0]) { q[0] = x; k = 0; }
+        else if (x >= q[4]) { q[4] = x; k = 3; }
+        else { k = 0; while (x >= q[k + 1]) k++; }
+        for (int j = k + 1; j < 5; j++) n[j]++;
+        want[1] += p / 2; want[2] += p; want[3] += (1 + p) / 2; want[4] += 1;
+        
+        for (int i = 1; i < 4; i++) {
+            float d = want[i] - n[i];
+            if ((d >= 1 && n[i + 1] - n[i] > 1) || (d <= -1 && n[i - 1] - n[i] < -1)) {
+                int s = d >= 0 ? 1 : -1;
+                float h = parabolic(i, s);
+                q[i] = (q[i - 1] < h && h < q[i + 1]) ? h : linear(i, s);
+                n[i] += s;
+            }
+        }
+    }
+    
+    // Exact (nearest rank) until the markers are initialised.
+    float value() {
+        if (count == 0) return NAN;
+        if (count < 5) return q[(int)lroundf(p * (count - 1))];
+        return q[2];
+    }
+    
+    uint32_t samples() { return count; }
+};
+
+// p5 / p50 / p95 of one vital
+struct QuantileSketch {
+    P2Quantile lo, mid, hi;
+    
+    QuantileSketch() : lo(0.05), mid(0.5), hi(0.95) {}
+    
+    void add(float x) { lo.add(x); mid.add(x); hi.add(x); }
+    void reset() { lo.reset(); mid.reset(); hi.reset(); }
+    uint32_t count() { return mid.samples(); }
+};
+
+#endif
@@ -0,0 +1,209 @@
+/**
+ * Per-beat pulse-wave features from the MAX30102 IR stream. Every FIFO sample
+ * goes into a fixed ring; raw IR falls as blood volume rises, so the ring
+ * holds it negated (pulse pointing up). detectBeat() fires on the upstroke,
+ * so the samples between two events hold exactly one inter-pulse trough,
+ * even when the event lags a few samples behind a FIFO burst; each new
+ * trough closes the trough-to-trough cycle that began at the previous one.
+ * Work per beat is bounded by the ring size and nothing is allocated. At
+ * 25 sps a sample is 40 ms, so the foot (10 % amplitude crossing), the
+ * half-amplitude crossings and the peaks are interpolated; the dicrotic
+ * notch and diastolic peak are only reported when they show as a real dip
+ * and bump, which damped or fast pulses often do not.
+ *
+ * Shared by MAX30102Sensor (main.cpp) and the host check in
+ * test/test_pulse_morphology.
+ */
+
+#ifndef PULSE_MORPHOLOGY_H
+#define PULSE_MORPHOLOGY_H
+
+#include <Arduino.h>
+#include <math.h>
+
+#if !defined(MORPH_BUF_SAMPLES) || !defined(MORPH_BEATS)
+#error "define MORPH_BUF_SAMPLES and MORPH_BEATS before including pulse_morphology.h"
+#endif
+
+#ifndef DSP_HOT
+#define DSP_HOT
+#endif
+#ifndef DSP_PROFILE_SCOPE
+#define DSP_PROFILE_SCOPE(stage)
+#endif
+
+struct PulseFeatures {
+    uint32_t index;      // beat number since boot
+    uint16_t ibiMs;      // foot to foot
+    uint16_t riseMs;     // foot to systolic peak (crest time)
+    uint16_t widthMs;    // width at half amplitude
+    uint16_t notchMs;    // foot to dicrotic notch, 0 = not resolved
+    uint16_t dvpMs;      // systolic to diastolic peak (stiffness index = height / dvp), 0 = none
+    uint8_t riPct;       // reflection index: diastolic over systolic height
+    uint16_t piCenti;    // perfusion index, 0.01 %
+};
+
+class PulseMorphology {
+private:
+    int32_t ring[MORPH_BUF_SAMPLES];
+    uint32_t count;          // samples ever added; index of the next one
+    uint32_t segStart;       // sample index of the previous beat event
+    uint32_t trough;         // trough before the pulse being measured
+    uint32_t prevFoot;       // previous pulse's foot, whole + fractional sample
+    float prevFootFrac;
+    bool haveSeg;
+    bool haveTrough;
+    bool havePrevFoot;
+    float irDC;
+    float ampAvg;            // of accepted pulses
+    
+    PulseFeatures beats[MORPH_BEATS];
+    uint32_t beatTotal;      // valid beats ever recorded
+    uint32_t rejected;
+    
+    // The FIFO delivers 25 samples/s at either power level (setPowerLevel)
+    static constexpr float SAMPLE_MS = 40;
+    
+    int32_t at(uint32_t i) { return ring[i % MORPH_BUF_SAMPLES]; }
+    
+    // Offset of a sampled extremum's true position, in samples (-0.5..0.5)
+    float DSP_HOT parabolaOffset(uint32_t i) {
+        float a = at(i - 1), b = at(i), c = at(i + 1);
+        float den = a - 2 * b + c;
+        return den != 0 ? constrain(0.5f * (a - c) / den, -0.5f, 0.5f) : 0;
+    }
+    
+    // Where the signal crosses `level` between samples i-1 and i, as a
+    // fraction of a sample after i-1
+    float crossing(uint32_t i, float level) {
+        float a = at(i - 1), b = at(i);
+        return b != a ? (level - a) / (b - a) : 0.5f;
+    }
+    
+    // One cycle: trough t0, systolic peak pk, next trough t1. Times below
+    // are in samples after t0.
+    bool DSP_HOT measure(uint32_t t0, uint32_t pk, uint32_t t1, PulseFeatures& out) {
+        float base = at(t0);
+        float amp = at(pk) - base;
+        // A second event inside one pulse (on the diastolic wave) splits it;
+        // the fragment after the notch is far smaller than a real pulse
+        if (amp <= 0 || irDC <= 0 || amp < ampAvg / 2) return false;
+        
+        uint32_t i = pk;
+        float level = base + amp * 0.1f;
+        while (i > t0 + 1 && at(i - 1) >= level) i--;
+        uint32_t foot = i - 1;
+        float footFrac = crossing(i, level);
+        float tFoot = foot - t0 + footFrac;
+        float ibi = havePrevFoot ? ((foot - prevFoot) + (footFrac - prevFootFrac)) * SAMPLE_MS : 0;
+        bool chained = havePrevFoot;
+        prevFoot = foot;
+        prevFootFrac = footFrac;
+        havePrevFoot = true;
+        if (!chained) return false;
+        
+        float tPeak = pk - t0 + parabolaOffset(pk);
+        level = base + amp / 2;
+        uint32_t up = foot + 1;
+        while (up < pk && at(up) < level) up++;
+        uint32_t down = pk + 1;
+        while (down < t1 && at(down) >= level) down++;
+        float width = ((down - up) + crossing(down, level) - crossing(up, level)) * SAMPLE_MS;
+        float rise = (tPeak - tFoot) * SAMPLE_MS;
+        if (ibi < 300 || ibi > 2000 || rise <= 0 || rise > ibi / 2 || width <= 0 || width >= ibi) return false;
+        
+        // Dicrotic notch: the first dip after the peak that is followed by a
+        // rise (the diastolic / reflected wave) before the next trough.
+        out.notchMs = out.dvpMs = 0;
+        out.riPct = 0;
+        for (uint32_t n = pk + 2; n + 1 < t1; n++) {
+            if (at(n) < at(n - 1) && at(n) <= at(n + 1)) {
+                uint32_t d = n + 1;
+                while (d + 1 < t1 && at(d + 1) > at(d)) d++;
+                if (at(d) <= at(n)) break;
+                out.notchMs = lroundf((n - t0 + parabolaOffset(n) - tFoot) * SAMPLE_MS);
+                out.dvpMs = lroundf((d - t0 + parabolaOffset(d) - tPeak) * SAMPLE_MS);
+                out.riPct = constrain(lroundf((at(d) - base) * 100 / amp), 0L, 100L);
+                break;
+            }
+        }
+        out.ibiMs = lroundf(ibi);
+        out.riseMs = lroundf(rise);
+        out.widthMs = lroundf(width);
+        out.piCenti = min(lroundf(amp * 10000 / irDC), 65535L);
+        ampAvg = ampAvg > 0 ? ampAvg + (amp - ampAvg) * 0.25f : amp;
+        return true;
+    }
+    
+public:
+    PulseMorphology() : count(0), segStart(0), trough(0), prevFoot(0), prevFootFrac(0), haveSeg(false),
+                        haveTrough(false), havePrevFoot(false), irDC(0), ampAvg(0), beatTotal(0),
+                        rejected(0) {}
+    
+    // Samples were lost or the finger came off: the next cycle starts over
+    void reset() {
+        haveSeg = false;
+        haveTrough = false;
+        havePrevFoot = false;
+        ampAvg = 0;
+    }
+    
+    void DSP_HOT addSample(uint32_t ir) {
+        ring[count % MORPH_BUF_SAMPLES] = -(int32_t)ir;
+        count++;
+        irDC = irDC > 0 ? irDC + ((float)ir - irDC) * 0.02f : ir;
+    }
+    
+    void DSP_HOT onBeat() {
+        DSP_PROFILE_SCOPE(DSP_MORPH);
+        uint32_t end = count;
+        bool fits = haveSeg && end - segStart >= 2 && end - segStart < MORPH_BUF_SAMPLES;
+        if (!fits) {
+            haveTrough = false;
+            havePrevFoot = false;
+            segStart = end;
+            haveSeg = true;
+            return;
+        }
+        
+        uint32_t next = segStart;
+        for (uint32_t i = segStart + 1; i < end; i++) if (at(i) < at(next)) next = i;
+        
+        // The whole trough-to-trough cycle must still be in the ring
+        if (haveTrough && next > trough + 2 && end - trough <= MORPH_BUF_SAMPLES) {
+            uint32_t pk = trough + 1;
+            for (uint32_t i = trough + 2; i < next; i++) if (at(i) > at(pk)) pk = i;
+            PulseFeatures& f = beats[beatTotal % MORPH_BEATS];
+            bool chained = havePrevFoot;
+            if (measure(trough, pk, next, f)) f.index = beatTotal++;
+            else if (chained) rejected++;
+        } else {
+            havePrevFoot = false;
+        }
+        trough = next;
+        haveTrough = true;
+        segStart = end;
+    }
+    
+    uint32_t beatCount() const { return beatTotal; }
+    const PulseFeatures* latest() const { return beatTotal ? &beats[(beatTotal - 1) % MORPH_BEATS] : nullptr; }
+    
+    // First beat after `after` (a beatCount() value) still held: older
+    // ones have been overwritten. Equal to beatCount() when none are.
+    uint32_t firstHeld(uint32_t after) const {
+        return max(after, beatTotal > MORPH_BEATS ? beatTotal - MORPH_BEATS : 0);
+    }
+    const PulseFeatures& beat(uint32_t n) const { return beats[n % MORPH_BEATS]; }
+    
+    void printState(Print& out) {
+        out.printf("  morphology: beats=%lu rejected=%lu", (unsigned long)beatTotal, (unsigned long)rejected);
+        const PulseFeatures* f = latest();
+        if (f) {
+            out.printf(" last ibi=%u rise=%u width=%u notch=%u dvp=%u ri=%u%% pi=%.2f%%",
+                       f->ibiMs, f->riseMs, f->widthMs, f->notchMs, f->dvpMs, f->riPct, f->piCenti / 100.0f);
+        }
+        out.println();
+    }
+};
+
+#endif
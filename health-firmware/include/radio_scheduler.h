@@ -0,0 +1,134 @@
+/**
+ * Uploads, state polls, history chunks and NTP all run inside a burst with
+ * power save off. Between bursts the modem sleeps and only wakes for every
+ * third DTIM beacon (WIFI_PS_MAX_MODEM, default listen interval), so the
+ * association and the local API stay up at a fraction of the current.
+ * wakeNow() opens a burst at once instead of waiting for the period; the
+ * firmware calls it on a critical alert onset, for a frozen waveform
+ * capture and while an alert upload is pending, never for periodic work.
+ *
+ * Shared by the firmware (main.cpp, RADIO SCHEDULER) and the host check in
+ * test/test_radio_scheduler.
+ */
+
+#ifndef RADIO_SCHEDULER_H
+#define RADIO_SCHEDULER_H
+
+#include <Arduino.h>
+
+#if !defined(RADIO_BURST_MIN_MS) || !defined(RADIO_BURST_MAX_MS) || !defined(RADIO_NTP_INTERVAL_MS) || \
+    !defined(RADIO_NTP_RETRY_MS)
+#error "define the RADIO_* settings before including radio_scheduler.h"
+#endif
+
+// Provided by the firmware (or the host test)
+void radioSetPowerSave(bool on);   // modem sleep between bursts
+bool radioLinkUp();                // associated with the AP
+void radioNtpStart();
+bool radioNtpSynced();
+void radioNtpStop();
+
+class RadioScheduler {
+private:
+    bool awake;
+    bool urgent;
+    bool pendingUrgent;
+    bool ntpPending;
+    bool held;
+    unsigned long burstStart;
+    unsigned long lastBurst;
+    unsigned long nextNtpMs;
+    unsigned long startMs;
+    uint64_t awakeMs;
+    uint32_t bursts;
+    uint32_t urgentBursts;
+
+    void setAwake(bool on) {
+        awake = on;
+        radioSetPowerSave(!on);
+    }
+
+public:
+    RadioScheduler() : awake(true), urgent(false), pendingUrgent(false), ntpPending(false), held(false),
+                       burstStart(0), lastBurst(0), nextNtpMs(0), startMs(0),
+                       awakeMs(0), bursts(0), urgentBursts(0) {}
+
+    // Called after connectWiFi(): the join and its NTP request are the first burst.
+    void begin() {
+        startMs = millis();
+        burstStart = millis();
+        lastBurst = millis();
+        ntpPending = radioLinkUp();
+        nextNtpMs = millis() + RADIO_NTP_INTERVAL_MS;
+        bursts = 1;
+        setAwake(true);
+    }
+
+    // Critical alert: the next pass opens a burst regardless of the period.
+    void wakeNow() { pendingUrgent = true; }
+
+    // LAN live stream: while held, a burst opens on the next pass and stays
+    // open past RADIO_BURST_MAX_MS. The time still counts towards the duty.
+    void hold(bool on) { held = on; }
+
+    // Returns true on the pass that opens a burst; the caller does its
+    // periodic network work then.
+    bool open(unsigned long periodMs) {
+        if (awake) return false;
+        if (!pendingUrgent && !held && millis() - lastBurst < periodMs) return false;
+
+        urgent = pendingUrgent;
+        pendingUrgent = false;
+        burstStart = millis();
+        lastBurst = millis();
+        bursts++;
+        if (urgent) urgentBursts++;
+        setAwake(true);
+
+        if (radioLinkUp() && (long)(millis() - nextNtpMs) >= 0) {
+            radioNtpStart();
+            ntpPending = true;
+        }
+        return true;
+    }
+
+    // Closes the burst once the minimum hold has passed and nothing is left,
+    // or at RADIO_BURST_MAX_MS. SNTP is stopped afterwards so it cannot wake
+    // the radio on its own timer.
+    void service(bool moreWork) {
+        if (!awake) return;
+        if (ntpPending && radioNtpSynced()) {
+            ntpPending = false;
+            nextNtpMs = millis() + RADIO_NTP_INTERVAL_MS;
+            radioNtpStop();
+        }
+
+        if (held) return;
+        unsigned long heldMs = millis() - burstStart;
+        if (heldMs < RADIO_BURST_MIN_MS) return;
+        if ((moreWork || ntpPending) && heldMs < RADIO_BURST_MAX_MS) return;
+
+        if (ntpPending) {
+            ntpPending = false;
+            nextNtpMs = millis() + RADIO_NTP_RETRY_MS;
+            radioNtpStop();
+        }
+        awakeMs += heldMs;
+        urgent = false;
+        setAwake(false);
+    }
+
+    bool isAwake() const { return awake; }
+    bool isUrgent() const { return urgent; }
+    uint32_t getBursts() const { return bursts; }
+    uint32_t getUrgentBursts() const { return urgentBursts; }
+
+    float dutyPercent() const {
+        unsigned long total = millis() - startMs;
+        if (total == 0) return 100.0f;
+        uint64_t on = awakeMs + (awake ? millis() - burstStart : 0);
+        return 100.0f * on / total;
+    }
+};
+
+#endif
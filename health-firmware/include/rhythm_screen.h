@@ -0,0 +1,137 @@
+/**
+ * Irregular-rhythm screen on the beat-to-beat intervals of the MAX30102
+ * beat detector (main.cpp, MAX30102Sensor::update), after the nRMSSD +
+ * Shannon entropy AF criteria of Dash et al. (2009). Every detected beat
+ * counts: the intervals are taken before the rate average's outlier gate,
+ * and no pulse-amplitude gate applies, since short, weak beats are exactly
+ * what AF produces. The last RHYTHM_WINDOW_BEATS intervals are kept with the
+ * squared successive difference and histogram bin each one added, so a beat
+ * entering and one leaving the window are both O(1); entropy is a sum over
+ * the RHYTHM_BINS counts. Bins are IBI / running mean at the time the beat
+ * arrived, so slow rate drift does not read as irregularity. gap() ends a
+ * run of beats (FIFO overflow, an interval the detector discarded), and no
+ * successive difference is taken across it.
+ *
+ * Shared by the firmware and the host check in test/test_rhythm_screen.
+ */
+
+#ifndef RHYTHM_SCREEN_H
+#define RHYTHM_SCREEN_H
+
+#include <Arduino.h>
+#include <math.h>
+#include <string.h>
+
+#if !defined(RHYTHM_WINDOW_BEATS) || !defined(RHYTHM_BINS) || !defined(RHYTHM_NRMSSD_ON) || \
+    !defined(RHYTHM_ENTROPY_ON) || !defined(RHYTHM_NRMSSD_OFF) || !defined(RHYTHM_ENTROPY_OFF)
+#error "define the RHYTHM_* settings before including rhythm_screen.h"
+#endif
+
+#ifndef DSP_HOT
+#define DSP_HOT
+#endif
+
+class RhythmScreen {
+private:
+    uint16_t ibi[RHYTHM_WINDOW_BEATS];
+    uint32_t sqDiff[RHYTHM_WINDOW_BEATS];   // to the previous beat, 0 = none
+    uint8_t bin[RHYTHM_WINDOW_BEATS];
+    uint8_t hist[RHYTHM_BINS];
+    int head;
+    int len;
+    uint32_t sumIbi;
+    uint32_t sumSqDiff;
+    int diffs;
+    uint16_t lastIbi;          // 0 = next beat starts a new run
+    
+    float nrmssd;
+    float entropy;
+    bool irregular;
+    uint32_t beats;
+    uint32_t episodes;
+    
+    void evaluate() {
+        if (len < RHYTHM_WINDOW_BEATS || diffs < RHYTHM_WINDOW_BEATS / 2) {
+            nrmssd = entropy = 0;
+            irregular = false;
+            return;
+        }
+        float mean = (float)sumIbi / len;
+        nrmssd = sqrtf((float)sumSqDiff / diffs) / mean;
+        float h = 0;
+        for (int b = 0; b < RHYTHM_BINS; b++) {
+            if (hist[b] == 0) continue;
+            float p = (float)hist[b] / len;
+            h -= p * logf(p);
+        }
+        entropy = h / logf(RHYTHM_BINS);
+        
+        bool was = irregular;
+        if (!irregular) irregular = nrmssd > RHYTHM_NRMSSD_ON && entropy > RHYTHM_ENTROPY_ON;
+        else irregular = nrmssd >= RHYTHM_NRMSSD_OFF && entropy >= RHYTHM_ENTROPY_OFF;
+        if (irregular && !was) episodes++;
+    }
+    
+public:
+    RhythmScreen() : episodes(0) { reset(); }
+    
+    void reset() {
+        head = len = diffs = 0;
+        sumIbi = sumSqDiff = 0;
+        lastIbi = 0;
+        memset(hist, 0, sizeof(hist));
+        beats = 0;
+        nrmssd = entropy = 0;
+        irregular = false;
+    }
+    
+    void gap() { lastIbi = 0; }
+    
+    void DSP_HOT addBeat(uint16_t ms) {
+        if (len == RHYTHM_WINDOW_BEATS) {
+            int old = head;
+            sumIbi -= ibi[old];
+            if (sqDiff[old]) {
+                sumSqDiff -= sqDiff[old];
+                diffs--;
+            }
+            hist[bin[old]]--;
+            len--;
+        }
+        
+        float ratio = len ? ms * (float)len / sumIbi : 1.0f;
+        int b = constrain((int)((ratio - 0.6f) * RHYTHM_BINS / 0.8f), 0, RHYTHM_BINS - 1);
+        int32_t d = lastIbi ? (int32_t)ms - lastIbi : 0;
+        
+        ibi[head] = ms;
+        bin[head] = b;
+        sqDiff[head] = lastIbi ? max((uint32_t)(d * d), (uint32_t)1) : 0;   // floor keeps 0 = none
+        hist[b]++;
+        sumIbi += ms;
+        if (sqDiff[head]) {
+            sumSqDiff += sqDiff[head];
+            diffs++;
+        }
+        head = (head + 1) % RHYTHM_WINDOW_BEATS;
+        len++;
+        lastIbi = ms;
+        beats++;
+        evaluate();
+    }
+    
+    bool isIrregular() { return irregular; }
+    uint32_t beatCount() { return beats; }
+    int windowLen() { return len; }
+    float getNRMSSD() { return nrmssd; }
+    float getEntropy() { return entropy; }
+    uint32_t episodeCount() { return episodes; }
+    
+    void printState(Print& out) {
+        out.printf("Rhythm: beats=%lu window=%d/%d nrmssd=%.3f entropy=%.2f irregular=%d episodes=%lu\n",
+                   (unsigned long)beats, len, RHYTHM_WINDOW_BEATS, nrmssd, entropy, irregular,
+                   (unsigned long)episodes);
+    }
+};
+
+
+#endif
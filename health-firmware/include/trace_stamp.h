@@ -0,0 +1,32 @@
+/**
+ * A micros() stamp for trace ages. micros() wraps every ~71 min, so the
+ * stamp also keeps millis() and reads as 0 (none) once it is older than
+ * TRACE_STAMP_MAX_MS; an age is never taken across a wrap. Used by the
+ * firmware's upload traces and the sensor classes (include/max30102_sensor.h).
+ */
+
+#ifndef TRACE_STAMP_H
+#define TRACE_STAMP_H
+
+#include <Arduino.h>
+
+const uint32_t TRACE_STAMP_MAX_MS = 10UL * 60 * 1000;
+
+class TraceStamp {
+private:
+    uint32_t us;
+    uint32_t ms;
+    
+public:
+    TraceStamp() : us(0), ms(0) {}
+    
+    void mark() {
+        us = micros();
+        if (us == 0) us = 1;
+        ms = millis();
+    }
+    
+    uint32_t get() const { return (us != 0 && millis() - ms < TRACE_STAMP_MAX_MS) ? us : 0; }
+};
+
+#endif
@@ -0,0 +1,160 @@
+/**
+ * All cloud requests go through one scheduler with a bounded queue per
+ * traffic class, served in strict priority: critical alerts (the urgent
+ * vitals upload and waveform captures), live vitals, history backfill,
+ * diagnostics. Each loop pass runs at most one request, so an alert waits
+ * for at most the one request already in flight, never for a backlog
+ * drain. Classes below alerts each own a token bucket of request-body
+ * bytes refilled at their share of UPLINK_BUDGET_BPS; a class in debt is
+ * skipped until it refills, even if the radio is idle. When a queue is
+ * over budget or full its policy applies: vitals and backfill coalesce
+ * into the queued job (a newer live upload replaces an older one, whose
+ * record the backfill delivers later), diagnostics drop their oldest job.
+ *
+ * Queueing never wakes the radio: the firmware does that itself on an
+ * alert onset or a frozen capture, and opens bursts for a pending alert.
+ *
+ * Shared by the firmware (main.cpp, UPLINK SCHEDULER) and the host check
+ * in test/test_radio_scheduler.
+ */
+
+#ifndef UPLINK_SCHEDULER_H
+#define UPLINK_SCHEDULER_H
+
+#include <Arduino.h>
+
+#if !defined(UPLINK_QUEUE_DEPTH) || !defined(UPLINK_BUDGET_BPS) || !defined(UPLINK_BUDGET_BURST)
+#error "define the UPLINK_* settings before including uplink_scheduler.h"
+#endif
+
+enum UplinkClass : uint8_t { UC_ALERT, UC_VITALS, UC_BACKFILL, UC_DIAG, UC_COUNT };
+const char* const UPLINK_CLASS_NAMES[UC_COUNT] = {"alert", "vitals", "backfill", "diag"};
+const uint8_t UPLINK_SHARE_PCT[UC_COUNT] = {0, 40, 45, 15};   // alerts are never budgeted
+
+enum UplinkJobKind : uint8_t { JOB_VITALS, JOB_CAPTURE, JOB_HISTORY, JOB_DIAG };
+
+enum UplinkResult : uint8_t {
+    UJ_WAIT,      // nothing sent, not possible yet; lower classes may go
+    UJ_KEEP,      // request made, the job has more to do
+    UJ_DONE,
+    UJ_FAILED
+};
+
+struct UplinkJob {
+    UplinkJobKind kind;
+    uint32_t arg;            // JOB_VITALS: vitals log seq of the record
+    unsigned long queuedMs;
+};
+
+class UplinkScheduler {
+public:
+    struct Queue {
+        UplinkJob jobs[UPLINK_QUEUE_DEPTH];
+        uint8_t head = 0;
+        uint8_t len = 0;
+        float tokens = 0;
+        uint32_t queued = 0;
+        uint32_t requests = 0;
+        uint32_t done = 0;
+        uint32_t failed = 0;
+        uint32_t coalesced = 0;
+        uint32_t dropped = 0;
+        uint32_t bytes = 0;
+        uint32_t maxWaitMs = 0;
+    };
+
+private:
+    Queue q[UC_COUNT];
+    unsigned long lastRefill;
+
+    static bool coalesces(UplinkClass c) { return c != UC_DIAG; }
+
+    static float depth(int c) { return (float)UPLINK_BUDGET_BURST * UPLINK_SHARE_PCT[c] / 100; }
+
+public:
+    UplinkScheduler() : lastRefill(0) {
+        for (int c = 0; c < UC_COUNT; c++) q[c].tokens = depth(c);
+    }
+
+    bool has(UplinkClass c, UplinkJobKind kind) const {
+        const Queue& Q = q[c];
+        for (int i = 0; i < Q.len; i++) {
+            if (Q.jobs[(Q.head + i) % UPLINK_QUEUE_DEPTH].kind == kind) return true;
+        }
+        return false;
+    }
+
+    // False if the job was refused. A coalesced job keeps its place and
+    // original queue time but takes the new argument.
+    bool enqueue(UplinkClass c, UplinkJobKind kind, uint32_t arg = 0) {
+        Queue& Q = q[c];
+        Q.queued++;
+        if (coalesces(c)) {
+            for (int i = 0; i < Q.len; i++) {
+                UplinkJob& j = Q.jobs[(Q.head + i) % UPLINK_QUEUE_DEPTH];
+                if (j.kind != kind) continue;
+                j.arg = arg;
+                Q.coalesced++;
+                return true;
+            }
+        }
+        if (Q.len == UPLINK_QUEUE_DEPTH) {
+            Q.dropped++;
+            if (coalesces(c)) return false;
+            Q.head = (Q.head + 1) % UPLINK_QUEUE_DEPTH;
+            Q.len--;
+        }
+        UplinkJob& j = Q.jobs[(Q.head + Q.len) % UPLINK_QUEUE_DEPTH];
+        j.kind = kind;
+        j.arg = arg;
+        j.queuedMs = millis();
+        Q.len++;
+        return true;
+    }
+
+    // A burst's periodic live upload is vitals class. While an alert upload
+    // is still queued it takes the newer record instead, so the alert's
+    // retry sends the latest vitals and no second request goes out.
+    bool enqueueBurst(uint32_t seq) {
+        return enqueue(has(UC_ALERT, JOB_VITALS) ? UC_ALERT : UC_VITALS, JOB_VITALS, seq);
+    }
+
+    void refill() {
+        unsigned long now = millis();
+        float dt = (now - lastRefill) / 1000.0f;
+        lastRefill = now;
+        for (int c = UC_VITALS; c < UC_COUNT; c++) {
+            q[c].tokens = min(q[c].tokens + dt * UPLINK_BUDGET_BPS * UPLINK_SHARE_PCT[c] / 100, depth(c));
+        }
+    }
+
+    // Head job of a class that may run now, or nullptr
+    UplinkJob* eligible(UplinkClass c) {
+        Queue& Q = q[c];
+        if (Q.len == 0 || (c != UC_ALERT && Q.tokens < 0)) return nullptr;
+        return &Q.jobs[Q.head];
+    }
+
+    bool alertPending() const { return q[UC_ALERT].len > 0; }
+
+    // Charges what the job posted; pops it unless it has more to do
+    void complete(UplinkClass c, UplinkResult r, uint32_t bytes) {
+        Queue& Q = q[c];
+        if (bytes > 0) {
+            Q.requests++;
+            Q.bytes += bytes;
+            if (c != UC_ALERT) Q.tokens -= bytes;
+        }
+        if (r == UJ_WAIT || r == UJ_KEEP) return;
+        const UplinkJob& j = Q.jobs[Q.head];
+        Q.maxWaitMs = max(Q.maxWaitMs, (uint32_t)(millis() - j.queuedMs));
+        if (r == UJ_DONE) Q.done++;
+        else Q.failed++;
+        Q.head = (Q.head + 1) % UPLINK_QUEUE_DEPTH;
+        Q.len--;
+    }
+
+    const Queue& queue(UplinkClass c) const { return q[c]; }
+};
+
+#endif
@@ -0,0 +1,63 @@
+/**
+ * Offline vitals log record and its JSON batch format (the backend's flat
+ * history schema), shared by the firmware's history sync and the host
+ * compression benchmark/tests.
+ */
+
+#ifndef VITALS_RECORD_H
+#define VITALS_RECORD_H
+
+#include <Arduino.h>
+
+enum VitalsRecordFlags : uint8_t {
+    VR_TEMP_ESTIMATED = 1 << 0,
+    VR_ALERT          = 1 << 1,
+    VR_CRITICAL       = 1 << 2,
+    VR_LIVE_ACKED     = 1 << 6,   // RAM only: the server already has it from a live upload
+    VR_GAP            = 1 << 7    // placeholder for a sequence number lost in a reset
+};
+
+struct VitalsRecord {
+    uint32_t seq;
+    uint32_t timestamp;
+    uint8_t heartRate;
+    uint8_t hrQuality;
+    uint8_t spo2;
+    uint8_t spo2Quality;
+    int16_t tempCenti;
+    uint8_t flags;
+    uint8_t reserved;
+};
+
+// Serializes records into the backend's flat history schema. `used` is set to
+// the number of input records consumed (gap placeholders and records the
+// server already holds included). Returns 0 if no record was serialized.
+inline size_t formatVitalsBatch(const VitalsRecord* recs, uint32_t count, const char* deviceId,
+                                char* buf, size_t cap, uint32_t& used) {
+    used = 0;
+    int n = snprintf(buf, cap, "{\"device_id\":\"%s\",\"records\":[", deviceId);
+    bool first = true;
+    for (uint32_t i = 0; i < count; i++) {
+        const VitalsRecord& r = recs[i];
+        if (r.flags & (VR_GAP | VR_LIVE_ACKED)) {
+            used++;
+            continue;
+        }
+        int w = snprintf(buf + n, cap - n,
+                         "%s{\"seq\":%lu,\"timestamp\":%lu,\"heart_rate\":%u,\"hr_quality\":%u,"
+                         "\"spo2\":%u,\"spo2_quality\":%u,\"temperature\":%.2f,"
+                         "\"is_temp_estimated\":%s,\"alert\":%u}",
+                         first ? "" : ",", (unsigned long)r.seq, (unsigned long)r.timestamp,
+                         r.heartRate, r.hrQuality, r.spo2, r.spo2Quality, r.tempCenti / 100.0,
+                         (r.flags & VR_TEMP_ESTIMATED) ? "true" : "false",
+                         (r.flags & VR_CRITICAL) ? 2 : (r.flags & VR_ALERT) ? 1 : 0);
+        if (w < 0 || n + w + 3 > (int)cap) break;
+        n += w;
+        first = false;
+        used++;
+    }
+    n += snprintf(buf + n, cap - n, "]}");
+    return first ? 0 : n;
+}
+
+#endif
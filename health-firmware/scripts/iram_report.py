@@ -0,0 +1,96 @@
+# PlatformIO post-build step: how much of IRAM the firmware uses, how
+# much of that is the DSP_HOT sensor path placed there by main.cpp, and
+# which flash-resident functions that path still calls (each such call can
+# stall on an instruction-cache miss).
+#
+#   extra_scripts = post:scripts/iram_report.py
+#
+# The budget defaults to the ESP32's 128 KB IRAM0 segment; override with
+# `custom_iram_budget = <bytes>` in platformio.ini.
+
+import re
+import subprocess
+
+Import("env")  # noqa: F821 (provided by SCons)
+
+IRAM_START = 0x40080000
+IRAM_DEFAULT_BUDGET = 128 * 1024
+FLASH_TEXT_START, FLASH_TEXT_END = 0x400D0000, 0x40400000
+HOT_CLASSES = ("PulseSensor::", "MAX30102Sensor::", "PulseMorphology::", "RhythmScreen::", "AlertCapture::")
+
+FUNC_RE = re.compile(r"^([0-9a-f]+) <(.+)>:$")
+# Direct Xtensa calls; callx through a register cannot be resolved here
+CALL_RE = re.compile(r"\tcall(?:0|4|8|12)\s+([0-9a-f]+) <([^>+]+)")
+
+
+def tool(name):
+    cc = env.subst("$CC")  # noqa: F821
+    return re.sub(r"gcc$", name, cc)
+
+
+def run(args):
+    return subprocess.run(args, check=True, capture_output=True, text=True).stdout
+
+
+def sections(elf):
+    sizes = {}
+    for line in run([tool("size"), "-A", elf]).splitlines():
+        parts = line.split()
+        if len(parts) >= 3 and parts[0].startswith("."):
+            sizes[parts[0]] = int(parts[1])
+    return sizes
+
+
+def hot_symbols(elf, budget):
+    hot = []
+    for line in run([tool("nm"), "-S", "-C", "--size-sort", elf]).splitlines():
+        parts = line.split(None, 3)
+        if len(parts) < 4:
+            continue
+        addr, size, _, name = parts
+        addr = int(addr, 16)
+        if IRAM_START <= addr < IRAM_START + budget and name.startswith(HOT_CLASSES):
+            hot.append((int(size, 16), name))
+    return sorted(hot, reverse=True)
+
+
+def flash_callees(elf):
+    callees = {}
+    current = None
+    for line in run([tool("objdump"), "-d", "-C", "-j", ".iram0.text", elf]).splitlines():
+        m = FUNC_RE.match(line)
+        if m:
+            current = m.group(2) if m.group(2).startswith(HOT_CLASSES) else None
+            continue
+        m = CALL_RE.search(line) if current else None
+        if m and FLASH_TEXT_START <= int(m.group(1), 16) < FLASH_TEXT_END:
+            callees.setdefault(m.group(2), set()).add(current.split("(")[0])
+    return sorted(callees.items())
+
+
+def report(source, target, env):
+    elf = str(target[0])
+    budget = int(env.GetProjectOption("custom_iram_budget", IRAM_DEFAULT_BUDGET))
+    try:
+        sizes = sections(elf)
+        hot = hot_symbols(elf, budget)
+        callees = flash_callees(elf)
+    except (OSError, subprocess.CalledProcessError) as e:
+        print("iram_report: skipped (%s)" % e)
+        return
+
+    iram = sizes.get(".iram0.vectors", 0) + sizes.get(".iram0.text", 0)
+    dram = sizes.get(".dram0.data", 0) + sizes.get(".dram0.bss", 0)
+    hot_total = sum(size for size, _ in hot)
+
+    print("IRAM: %d / %d bytes (%.1f%%), %d free" % (iram, budget, 100.0 * iram / budget, budget - iram))
+    print("DRAM: %d bytes static (.data + .bss)" % dram)
+    print("DSP_HOT: %d bytes (%.1f%% of IRAM budget) in %d functions" % (hot_total, 100.0 * hot_total / budget, len(hot)))
+    for size, name in hot:
+        print("  %6d  %s" % (size, name))
+    print("DSP_HOT calls into flash: %d functions" % len(callees))
+    for name, callers in callees:
+        print("  %s  <- %s" % (name, ", ".join(sorted(callers))))
+
+
+env.AddPostAction("$BUILD_DIR/${PROGNAME}.elf", report)  # noqa: F821
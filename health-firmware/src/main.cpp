@@ -25,11 +25,21 @@
 #include <DallasTemperature.h>
 #include <LiquidCrystal_I2C.h>
 #include <Preferences.h>
+#include <LittleFS.h>
+#include <ESPmDNS.h>
+#include <mbedtls/sha1.h>
 #include <esp_task_wdt.h>
+#include <esp_system.h>
+#include <esp_wifi.h>
+#include <esp_sntp.h>
 #include <time.h>
 #include <cmath>
 #include "MAX30105.h"
 #include "heartRate.h"
+#include "gzip_encoder.h"
+#include "vitals_record.h"
+#include "energy_model.h"
+#include "p2_quantile.h"
 
 // ==================== VERSION INFO ====================
 #define FIRMWARE_VERSION "4.1"
@@ -43,6 +53,7 @@
 #define STATUS_LED 2
 #define BUTTON_START 18
 #define BUTTON_STOP 19
+#define BATTERY_PIN 35
 
 // ==================== CONFIGURATION ====================
 const char* WIFI_SSID = "cybergenii";
@@ -62,19 +73,145 @@ const int DAYLIGHT_OFFSET_SEC = 0;
 #define WATCHDOG_TIMEOUT 30
 #define STATE_POLL_INTERVAL 10000
 
+// Delta uploads: send only changed fields, with a full keyframe every N uploads.
+// Off until the backend merges delta records and answers 409 when it has
+// lost the base (README, Delta Uploads); 0 sends every upload as a keyframe.
+#define CLOUD_DELTA_UPLOADS 0
+#define CLOUD_KEYFRAME_EVERY 12
+
+// History sync (gzip-compressed chunks from the vitals log)
+#define BACKLOG_BATCH_RECORDS 96
+#define BACKLOG_BUFFER_SIZE 16384
+#define SYNC_ADVERTISE_BEHIND_MS 2000
+#define SYNC_ADVERTISE_IDLE_MS 300000
+#define UPLINK_BACKOFF_MIN_MS 5000
+#define UPLINK_BACKOFF_MAX_MS 300000
+
+// Uplink scheduler: strict priority alerts > live vitals > backfill >
+// diagnostics, one request per loop pass; everything below alerts spends
+// from a byte budget split by UPLINK_SHARE_PCT
+#define UPLINK_QUEUE_DEPTH 4
+#define UPLINK_BUDGET_BPS 2048          // average request-body bytes/s
+#define UPLINK_BUDGET_BURST 49152       // bucket depth, split by the same shares
+#define UPLINK_DIAG_INTERVAL_MS 900000  // trace ring + queue counters
+#define UPLINK_ALERT_RETRY_MS 2000      // failed alert upload, while the alert stands
+
+// Local bedside API (HTTP + WebSocket, mDNS _http._tcp). Off by default:
+// requests are not authenticated, so only enable it on a trusted network.
+#define LOCAL_API_ENABLED 0
+#define LOCAL_API_PORT 80
+#define LOCAL_API_MAX_CLIENTS 4
+#define LOCAL_API_BUDGET_US 2000
+#define LOCAL_API_REQUEST_TIMEOUT_MS 2000
+#define LOCAL_API_HISTORY_MAX 96        // records per /vitals/history response
+
+// LAN live stream: UDP multicast of vitals + raw IR waveform for ward
+// displays on the same network (no cloud round trip). Normal power tier only.
+// Off by default: frames are not authenticated, and while it runs the stream
+// holds the radio awake (RadioScheduler::hold), so only enable it for a ward
+// view on a trusted network.
+#define LIVE_STREAM_ENABLED 0
+#define LIVE_STREAM_GROUP IPAddress(239, 255, 72, 83)
+#define LIVE_STREAM_PORT 47800
+#define LIVE_STREAM_VITALS_MS 500
+#define LIVE_STREAM_WAVE_SAMPLES 25     // IR samples per waveform datagram: 1 s of FIFO output (max 64)
+
+// Alert waveform capture: raw MAX30102 RED/IR around each critical alert
+// onset, delta-encoded in one fixed ring and posted ahead of all other
+// uplink work once the post-trigger window has been recorded.
+#define CAPTURE_ENABLED 1
+#define CAPTURE_PRE_S 30
+#define CAPTURE_POST_S 10
+#define CAPTURE_RATE 25                 // FIFO samples/s; one ring block per second
+#define CAPTURE_MAX_ATTEMPTS 4
+#define CAPTURE_RETRY_MS 5000           // times the attempt number
+const char* CAPTURE_ENDPOINT = "/alerts/waveform";   // under /health/devices/{id}
+
 #define MIN_QUALITY_THRESHOLD 40
 #define WIFI_MAX_RETRIES 5
 #define WIFI_RETRY_BASE_DELAY 1000
 
+// Battery gauge (2x 10k divider on GPIO 35); the divider and the low
+// threshold are shared with include/config.h
+#include "battery_config.h"
+#define BATTERY_OVERSAMPLE 64
+#define BATTERY_READ_INTERVAL_MS 5000
+#define BATTERY_PRESENT_MIN_MV 2500     // below this no cell is connected
+#define BATTERY_INTERNAL_MOHM 250       // cell + protection FET + wiring
+#define BATTERY_CRITICAL_PERCENT 10
+#define BATTERY_TIER_HYSTERESIS 5       // % above a threshold before stepping back up
+#define BATTERY_CAPACITY_MAH 2000
+
+// Radio bursts: network work is grouped, modem sleep in between
+#define RADIO_BURST_MIN_MS 200          // stay awake at least this long per burst
+#define RADIO_BURST_MAX_MS 3000         // cap for history chunks / NTP holding a burst open
+#define RADIO_NTP_INTERVAL_MS 21600000  // NTP resync every 6 h, inside a burst
+#define RADIO_NTP_RETRY_MS 60000
+
+// Energy model: per-state supply currents are in include/energy_model.h
+#define ENERGY_WINDOW_MS 600000         // mAh/h rates cover the last 10 minutes
+
 // MAX30102 I2C address (standard; some modules allow 0x57 or 0x58 via ADDR pin)
 #define MAX30102_I2C_ADDR 0x57
-// IR: finger present when reflected IR is above this.
+// IR: finger present when reflected IR is above this (default of config finger_ir).
 #define MAX30102_FINGER_THRESHOLD 4000
-// RED: finger present when RED is above this (finger on ~200k+, removed ~6k).
+// RED: finger present when RED is above this (finger on ~200k+, removed ~6k; finger_red).
 #define MAX30102_FINGER_THRESHOLD_RED 15000
 // 18-bit max = 262143. Above this we treat as saturated (no pulse visible).
 #define MAX30102_SATURATED 250000
 
+// DS18B20 timing and warm-up prediction
+#define DS18B20_CONVERSION_MS 750       // 12-bit conversion
+#define TEMP_FAST_INTERVAL_MS 2000      // while the probe is warming up
+#define TEMP_SLOW_INTERVAL_MS 10000     // once at equilibrium
+#define TEMP_RAW_MIN 15.0               // below this the probe is not on a body at all
+#define TEMP_PLACEMENT_STEP 1.0         // C jump between readings that restarts the fit
+#define TEMP_PREDICT_MAX_BAND 0.3       // report a prediction once +/- band is this tight
+#define TEMP_SETTLED_DELTA 0.1          // C of predicted rise left when the probe counts as settled
+
+// Vital rollups: p5/p50/p95 of HR, SpO2 and IBI per window (P2 sketches)
+#define ROLLUP_WINDOW_MS 300000         // reported in keyframes once closed
+#define RESTING_MIN_SAMPLES 120         // good HR readings a window needs to train the baseline
+#define RESTING_MAX_SPREAD 15.0         // bpm p95-p5; wider windows are activity, not rest
+#define RESTING_ALPHA_DOWN 0.2          // baseline follows a lower window p5 quickly...
+#define RESTING_ALPHA_UP 0.02           // ...and a higher one slowly
+#define RESTING_PERSIST_DELTA 1.0       // bpm of drift before the baseline is stored
+
+// Pulse morphology: per-beat features from the MAX30102 IR FIFO stream
+#define MORPH_BUF_SAMPLES 64            // 2.56 s at 25 sps: one full cycle down to 24 bpm
+#define MORPH_BEATS 16                  // feature records held until an upload is acked
+
+// Irregular rhythm screen over the MAX30102 beat-to-beat intervals. Both
+// nRMSSD (RMSSD / mean IBI) and normalized Shannon entropy of the IBIs must
+// exceed their limits; ectopic beats alone raise nRMSSD but not entropy.
+#define RHYTHM_WINDOW_BEATS 64
+#define RHYTHM_BINS 16                  // entropy histogram: IBI / mean from 0.6 to 1.4
+#define RHYTHM_NRMSSD_ON 0.10f
+#define RHYTHM_ENTROPY_ON 0.70f
+#define RHYTHM_NRMSSD_OFF 0.08f         // hysteresis: either below its off level clears
+#define RHYTHM_ENTROPY_OFF 0.60f
+
+// Oxygen desaturation events (ODI-3 %) from the 1 Hz SpO2 readings
+#define DESAT_DROP_PCT 3                // below baseline by at least this...
+#define DESAT_MIN_S 10                  // ...for this many seconds is an event
+#define DESAT_RECOVER_PCT 1             // event ends within this of baseline
+#define DESAT_MAX_S 120                 // longer dips are closed and the baseline re-seeded
+#define DESAT_BASELINE_S 120            // baseline EWMA time constant, frozen during a dip
+#define DESAT_WARMUP_S 60               // valid seconds before a baseline is trusted
+#define DESAT_MAX_GAP_S 10              // invalid readings for longer restart the baseline
+#define DESAT_EVENTS 16                 // event records held until an upload is acked
+
+// Config store: NVS writes are coalesced in RAM and flushed in the background
+#define CONFIG_FLUSH_INTERVAL_MS 300000 // at most one flush pass per 5 min
+#define CONFIG_BACKLOG_FLUSH_MS 30000   // backlog_from: ~6 records resent after a crash
+#define BATTERY_FLUSH_MV 3400           // loaded cell voltage that forces a flush (LDO dropout)
+
+// Serial console (115200 baud, line-based; "help" lists commands)
+#define CONSOLE_ENABLED 1
+#define CONSOLE_LINE_MAX 64
+#define CONSOLE_RX_BUDGET 32            // input bytes consumed per loop pass
+#define CONSOLE_OUT_BYTES 2048          // replies are queued here, never block on the UART
+
 // ==================== HARDWARE OBJECTS ====================
 OneWire oneWire(DS18B20_PIN);
 DallasTemperature dallas(&oneWire);
@@ -82,6 +219,28 @@ LiquidCrystal_I2C lcd(0x27, 20, 4);
 Preferences preferences;
 MAX30105 max30102;
 
+// ==================== CONFIG STORE ====================
+// Everything kept in NVS, coalesced in RAM (include/config_store.h).
+//
+// Schema: X(enum id, field, type, NVS key, default, min, max, flush interval
+// ms, settable from the serial console). Console values and NVS values
+// outside [min, max] are rejected. Types need load/store/parse/show
+// overloads in ConfigStore. backlog_from moves with every server ack; its
+// shorter interval bounds what a crash resends to 30 s of records.
+#define CONFIG_SCHEMA(X) \
+    X(CFG_RESTING_HR,   restingHR,   float,    "resting_hr",   70.0f, 30.0f, 120.0f, CONFIG_FLUSH_INTERVAL_MS, true) \
+    X(CFG_BACKLOG_FROM, backlogFrom, uint32_t, "backlog_from", 0, 0, UINT32_MAX, CONFIG_BACKLOG_FLUSH_MS, false) \
+    X(CFG_FINGER_IR,    fingerIr,    uint32_t, "finger_ir",    MAX30102_FINGER_THRESHOLD, 1000, 200000, CONFIG_FLUSH_INTERVAL_MS, true) \
+    X(CFG_FINGER_RED,   fingerRed,   uint32_t, "finger_red",   MAX30102_FINGER_THRESHOLD_RED, 1000, 200000, CONFIG_FLUSH_INTERVAL_MS, true) \
+    X(CFG_PULSE_ALPHA,  pulseAlpha,  float,    "pulse_alpha",  0.12f, 0.01f, 1.0f, CONFIG_FLUSH_INTERVAL_MS, true) \
+    X(CFG_PULSE_THRESH, pulseThresh, float,    "pulse_thresh", 0.40f, 0.10f, 0.90f, CONFIG_FLUSH_INTERVAL_MS, true)
+
+#include "config_store.h"
+
+ConfigStore config;
+
+void ConfigStore::onShutdown() { config.flushNow(); }
+
 // ==================== STATE MANAGEMENT ====================
 enum MonitoringState {
     STATE_IDLE,
@@ -102,8 +261,171 @@ bool wifiReconnecting = false;
 bool timeInitialized = false;
 unsigned long bootTimestamp = 0;
 unsigned long lastStatePoll = 0;
+uint32_t uplinkTxBytes = 0;         // request bodies posted, charged by the uplink scheduler
+float loopLoad = 0;                 // EWMA of the busy fraction of each loop() pass
+
+// ==================== LATENCY TRACING ====================
+// Every upload records when its data was sampled, when the beat behind it
+// was detected, when updateVitals() published it, and when it was
+// serialized, sent and acknowledged. Stage latencies go into fixed-bucket
+// histograms (O(1) memory) reported as p50/p95/p99 in keyframes.
+enum TraceStage {
+    TS_SAMPLE_TO_PUBLISH,
+    TS_BEAT_TO_PUBLISH,
+    TS_PUBLISH_TO_SERIALIZE,    // how stale currentVitals is when the uplink reads it
+    TS_SERIALIZE_TO_SEND,
+    TS_SEND_TO_RESPONSE,
+    TS_SAMPLE_TO_RESPONSE,      // end to end
+    TS_ALERT_TO_RESPONSE,       // critical alert onset to server ack
+    TS_COUNT
+};
+
+const char* const TRACE_STAGE_NAMES[TS_COUNT] = {
+    "sample_publish", "beat_publish", "publish_serialize", "serialize_send",
+    "send_response", "sample_response", "alert_response"
+};
+
+const uint16_t LATENCY_EDGES_MS[] = {1, 2, 5, 10, 20, 50, 100, 200, 500, 1000, 2000, 5000, 10000};
+const int LATENCY_BUCKETS = sizeof(LATENCY_EDGES_MS) / sizeof(LATENCY_EDGES_MS[0]) + 1;
+
+class LatencyHistogram {
+private:
+    uint32_t counts[LATENCY_BUCKETS];
+    uint32_t total;
+    uint32_t maxMs;
+    
+public:
+    LatencyHistogram() : total(0), maxMs(0) { memset(counts, 0, sizeof(counts)); }
+    
+    void add(uint32_t ms) {
+        int b = 0;
+        while (b < LATENCY_BUCKETS - 1 && ms > LATENCY_EDGES_MS[b]) b++;
+        counts[b]++;
+        total++;
+        if (ms > maxMs) maxMs = ms;
+    }
+    
+    // Upper edge of the bucket holding the p-th percentile (max for the overflow bucket).
+    uint32_t percentile(int p) {
+        if (total == 0) return 0;
+        uint32_t rank = (total * p + 99) / 100;
+        uint32_t seen = 0;
+        for (int b = 0; b < LATENCY_BUCKETS - 1; b++) {
+            seen += counts[b];
+            if (seen >= rank) return LATENCY_EDGES_MS[b];
+        }
+        return maxMs;
+    }
+    
+    uint32_t count() { return total; }
+    // Samples above `ms`; exact when `ms` is one of the bucket edges.
+    uint32_t countAbove(uint32_t ms) {
+        uint32_t n = 0;
+        for (int b = 1; b < LATENCY_BUCKETS; b++) {
+            if (LATENCY_EDGES_MS[b - 1] >= ms) n += counts[b];
+        }
+        return n;
+    }
+};
+
+LatencyHistogram latency[TS_COUNT];
+
+#include "trace_stamp.h"
+
+// Critical alert onset to the first server ack. Every onset is counted;
+// one that is superseded, cleared or still waiting past the budget without
+// an ack counts as over budget. Timed with millis() so a long outage
+// cannot wrap.
+const uint32_t CRITICAL_BUDGET_MS = 2000;
+
+class CriticalLatency {
+private:
+    uint32_t total;
+    uint32_t over;
+    bool pending;
+    uint32_t pendingOnsetMs;
+    
+public:
+    CriticalLatency() : total(0), over(0), pending(false), pendingOnsetMs(0) {}
+    
+    void onset(uint32_t nowMs) {
+        if (pending) over++;
+        pending = true;
+        pendingOnsetMs = nowMs;
+        total++;
+    }
+    
+    void cleared() {
+        if (pending) over++;
+        pending = false;
+    }
+    
+    void acked(uint32_t nowMs) {
+        if (!pending) return;
+        uint32_t ms = nowMs - pendingOnsetMs;
+        latency[TS_ALERT_TO_RESPONSE].add(ms);
+        if (ms > CRITICAL_BUDGET_MS) over++;
+        pending = false;
+    }
+    
+    uint32_t getTotal() const { return total; }
+    uint32_t getOverBudget() const {
+        return over + ((pending && millis() - pendingOnsetMs > CRITICAL_BUDGET_MS) ? 1 : 0);
+    }
+};
+
+CriticalLatency criticalLatency;
+
+// Adds `key` = age in ms at `nowUs`, unless the stamp is unknown (0).
+template <typename J>
+void addAgeMs(J obj, const char* key, uint32_t nowUs, uint32_t stampUs) {
+    if (stampUs != 0) obj[key] = (nowUs - stampUs) / 1000;
+}
+
+struct TraceRecord {
+    uint32_t seq;
+    uint32_t sampleUs;
+    uint32_t beatUs;
+    uint32_t publishUs;
+    uint32_t serializeUs;
+    uint32_t sendUs;
+    uint32_t responseUs;
+    int httpCode;
+};
+
+const int TRACE_RING_SIZE = 16;
+TraceRecord traceRing[TRACE_RING_SIZE];
+int traceRingHead = 0;
+
+void recordTrace(const TraceRecord& t) {
+    traceRing[traceRingHead] = t;
+    traceRingHead = (traceRingHead + 1) % TRACE_RING_SIZE;
+    
+    latency[TS_PUBLISH_TO_SERIALIZE].add((t.serializeUs - t.publishUs) / 1000);
+    latency[TS_SERIALIZE_TO_SEND].add((t.sendUs - t.serializeUs) / 1000);
+    latency[TS_SEND_TO_RESPONSE].add((t.responseUs - t.sendUs) / 1000);
+    if ((t.httpCode == 200 || t.httpCode == 201) && t.sampleUs != 0) {
+        latency[TS_SAMPLE_TO_RESPONSE].add((t.responseUs - t.sampleUs) / 1000);
+    }
+}
 
 // ==================== VITAL SIGNS STRUCTURE ====================
+// One dirty bit per uploadable/displayable field group. Setters below raise
+// the bit only when the value actually changes, so consumers (uplink, LCD)
+// can skip everything that is unchanged.
+enum VitalField : uint16_t {
+    VF_HEART_RATE   = 1 << 0,
+    VF_HR_QUALITY   = 1 << 1,
+    VF_HR_SOURCE    = 1 << 2,
+    VF_SPO2         = 1 << 3,
+    VF_SPO2_QUALITY = 1 << 4,
+    VF_SPO2_SOURCE  = 1 << 5,
+    VF_TEMPERATURE  = 1 << 6,
+    VF_TEMP_SOURCE  = 1 << 7,   // tempSource + tempEstimated + tempPredicted + tempBand
+    VF_ALERT        = 1 << 8,   // hasAlert + isCriticalAlert + alertType + alertMessage
+    VF_ALL          = 0x01FF
+};
+
 struct VitalSigns {
     int heartRate = 0;
     int hrQuality = 0;
@@ -111,22 +433,188 @@ struct VitalSigns {
     int spo2Quality = 0;
     float temperature = 36.5;
     bool tempEstimated = false;
+    bool tempPredicted = false;
+    float tempBand = 0;
     String tempSource = "UNKNOWN";
     String hrSource = "NONE";
     String spo2Source = "NONE";
     bool hasAlert = false;
+    const char* alertType = "";   // uplink alert class
     String alertMessage = "";
     bool isCriticalAlert = false;
-    bool hasChanged = true;
+    uint16_t dirty = VF_ALL;
+    
+    // Pipeline timestamps (micros) of the data behind this snapshot
+    uint32_t sampleUs = 0;        // newest sensor sample used
+    uint32_t beatUs = 0;          // beat that produced heartRate
+    uint32_t publishUs = 0;       // publishVitalChanges()
+    uint32_t alertOnsetUs = 0;    // alert raised or escalated; identifies the alert
+    uint32_t alertOnsetMs = 0;    // same moment, for ages longer than a micros() wrap
+    
+    template <typename T, typename V>
+    void set(T& field, const V& value, uint16_t bit) {
+        if (field != value) {
+            field = value;
+            dirty |= bit;
+        }
+    }
+    
+    // Temperature is reported with 0.1 C resolution; only a change of the
+    // rounded value counts as dirty.
+    void setTemperature(float celsius) {
+        if (lroundf(celsius * 10) != lroundf(temperature * 10)) dirty |= VF_TEMPERATURE;
+        temperature = celsius;
+    }
+    
+    void setAlert(bool active, bool critical, const char* type, const char* message) {
+        if (hasAlert != active || isCriticalAlert != critical || strcmp(alertType, type) != 0 ||
+            alertMessage != message) {
+            if (active && (!hasAlert || (critical && !isCriticalAlert))) {
+                alertOnsetUs = micros();
+                alertOnsetMs = millis();
+                if (critical) criticalLatency.onset(alertOnsetMs);
+            } else if (isCriticalAlert && !critical) {
+                criticalLatency.cleared();
+            }
+            hasAlert = active;
+            isCriticalAlert = critical;
+            alertType = type;
+            alertMessage = message;
+            dirty |= VF_ALERT;
+        }
+    }
 };
 
 VitalSigns currentVitals;
-VitalSigns lastDisplayedVitals;
+
+// Per-consumer views of currentVitals.dirty, filled by publishVitalChanges().
+uint16_t uplinkDirty = VF_ALL;   // changed since the last server-acknowledged upload
+uint16_t lcdDirty = VF_ALL;      // changed since the last LCD redraw
+
+uint16_t publishVitalChanges() {
+    currentVitals.publishUs = micros();
+    if (currentVitals.sampleUs != 0) {
+        latency[TS_SAMPLE_TO_PUBLISH].add((currentVitals.publishUs - currentVitals.sampleUs) / 1000);
+    }
+    if (currentVitals.beatUs != 0) {
+        latency[TS_BEAT_TO_PUBLISH].add((currentVitals.publishUs - currentVitals.beatUs) / 1000);
+    }
+    
+    uint16_t changed = currentVitals.dirty;
+    uplinkDirty |= changed;
+    lcdDirty |= changed;
+    currentVitals.dirty = 0;
+    return changed;
+}
+
+// ==================== DSP PLACEMENT & PROFILING ====================
+// The per-sample sensor path runs from IRAM, so its own instructions never
+// miss the flash cache when WiFi/TLS on the other core evicts lines.
+// noinline keeps the entry points from being folded back into their
+// flash-resident callers. That is all it buys. The path still calls into
+// flash (Wire and the SparkFun driver for the FIFO read, analogRead, millis,
+// libm), and those calls can stall on a miss. During a flash write (NVS,
+// LittleFS) the cache is off on both cores, so nothing here runs at all.
+// Those pauses are absorbed by the 32-sample FIFO, not avoided.
+// scripts/iram_report.py lists the IRAM cost and the flash callees after
+// every build.
+#define DSP_HOT IRAM_ATTR __attribute__((noinline))
+
+// Build with -DDSP_PROFILE (env:esp32dev-profile) to count cycles per stage
+// and, where the IDF perfmon component is available, instruction-cache
+// misses and the cycles stalled on them. Counters are per core and include
+// whatever else runs on it during the stage (delay() yields).
+#ifdef DSP_PROFILE
+#if defined(__has_include)
+#if __has_include(<perfmon.h>)
+#include <perfmon.h>
+#define DSP_PERFMON 1
+#endif
+#endif
+
+enum DspStage { DSP_MAX_FIFO, DSP_MAX_PROCESS, DSP_MORPH, DSP_PULSE, DSP_STAGE_COUNT };
+const char* const DSP_STAGE_NAMES[DSP_STAGE_COUNT] = {"max_fifo", "max_dsp", "morph", "pulse"};
+
+struct DspStageStats {
+    uint32_t calls;
+    uint64_t cycles;
+    uint32_t maxCycles;
+    uint64_t stallCycles;    // I-fetch stalled on a cache miss
+    uint64_t misses;         // I-cache misses
+};
+
+DspStageStats dspStats[DSP_STAGE_COUNT];
+
+class DspProfileScope {
+private:
+    DspStage stage;
+    uint32_t c0;
+    uint32_t stall0;
+    uint32_t miss0;
+    
+public:
+    explicit DspProfileScope(DspStage st) : stage(st), stall0(0), miss0(0) {
+#ifdef DSP_PERFMON
+        stall0 = xtensa_perfmon_value(0);
+        miss0 = xtensa_perfmon_value(1);
+#endif
+        c0 = ESP.getCycleCount();
+    }
+    
+    ~DspProfileScope() {
+        uint32_t cycles = ESP.getCycleCount() - c0;
+        DspStageStats& st = dspStats[stage];
+        st.calls++;
+        st.cycles += cycles;
+        if (cycles > st.maxCycles) st.maxCycles = cycles;
+#ifdef DSP_PERFMON
+        st.stallCycles += xtensa_perfmon_value(0) - stall0;
+        st.misses += xtensa_perfmon_value(1) - miss0;
+#endif
+    }
+};
+
+void dspProfileBegin() {
+    memset(dspStats, 0, sizeof(dspStats));
+#ifdef DSP_PERFMON
+    xtensa_perfmon_init(0, XTPERF_CNT_I_STALL, XTPERF_MASK_I_STALL_CACHE_MISS, 0, -1);
+    xtensa_perfmon_init(1, XTPERF_CNT_I_MEM, XTPERF_MASK_I_MEM_CACHE_MISS, 0, -1);
+    xtensa_perfmon_start();
+#endif
+}
+
+void dspProfilePrint(Print& out) {
+    for (int i = 0; i < DSP_STAGE_COUNT; i++) {
+        const DspStageStats& st = dspStats[i];
+        if (st.calls == 0) continue;
+        out.printf("%-9s calls=%lu avg=%lu max=%lu cycles", DSP_STAGE_NAMES[i], (unsigned long)st.calls,
+                   (unsigned long)(st.cycles / st.calls), (unsigned long)st.maxCycles);
+#ifdef DSP_PERFMON
+        out.printf(" icache_miss=%.1f/call stall=%.1f%%", (float)st.misses / st.calls,
+                   st.cycles ? 100.0f * st.stallCycles / st.cycles : 0.0f);
+#endif
+        out.println();
+    }
+}
+
+#define DSP_PROFILE_SCOPE(stage) DspProfileScope dspProfileScope(stage)
+#else
+#define DSP_PROFILE_SCOPE(stage)
+#endif
 
 // ==================== FORWARD DECLARATIONS ====================
 class PulseSensor;
 class MAX30102Sensor;
 class TemperatureSensor;
+void liveStreamSample(uint32_t ir);
+void liveStreamGap();
+void captureSample(uint32_t red, uint32_t ir);
+void captureGap();
+void rollupBeat(const char* source, unsigned long ibiMs);
+void rhythmBeat(uint16_t ibiMs);
+void rhythmGap();
+void rhythmReset();
+void desatStartSession();
 
 // ==================== BUTTON CLASS ====================
 class Button {
@@ -200,7 +688,6 @@ private:
     int baselineLevel;
     
     float smoothedSignal;
-    float smoothAlpha;
     int lastGoodRaw;
     
     int peakValue;
@@ -221,13 +708,17 @@ private:
     unsigned long rawPeakZoneMaxTime;
     int bpmFromRaw;
     
+    TraceStamp sampleStamp;
+    TraceStamp beatStamp;
+    
 public:
     PulseSensor() : bufferIndex(0), bufferFilled(false), lastBeatTime(0), currentBPM(0),
                     beatHistoryIndex(0), beatHistoryCount(0), dcLevel(2048), acAmplitude(0),
                     dynamicThreshold(2048), baselineLevel(2048), smoothedSignal(2048),
-                    smoothAlpha(0.12), lastGoodRaw(2048), peakValue(0), troughValue(4095), lastAdaptUpdate(0),
+                    lastGoodRaw(2048), peakValue(0), troughValue(4095), lastAdaptUpdate(0),
                     signalQuality(0), spo2Value(0), spo2Quality(0), lastValidBPM(0), lastValidSpO2(0),
-                    rawPeakCount(0), rawPeakIndex(0), rawPeakZone(false), rawPeakZoneMax(0), rawPeakZoneMaxTime(0), bpmFromRaw(0) {
+                    rawPeakCount(0), rawPeakIndex(0), rawPeakZone(false), rawPeakZoneMax(0), rawPeakZoneMaxTime(0), bpmFromRaw(0),
+                    sampleStamp(), beatStamp() {
         memset(signalBuffer, 0, sizeof(signalBuffer));
         memset(beatHistory, 0, sizeof(beatHistory));
         memset(rawPeakTimes, 0, sizeof(rawPeakTimes));
@@ -265,9 +756,11 @@ public:
         }
     }
     
-    void update() {
+    void DSP_HOT update() {
+        DSP_PROFILE_SCOPE(DSP_PULSE);
         int rawSignal = analogRead(SEN11574_PIN);
         if (rawSignal < 0 || rawSignal > MAX_SIGNAL) return;
+        sampleStamp.mark();
         if (rawSignal <= 50 || rawSignal >= MAX_SIGNAL - 50) {
             rawSignal = lastGoodRaw;
         } else {
@@ -283,7 +776,8 @@ public:
             Serial.println(currentBPM);
         }
 #endif
-        smoothedSignal = smoothedSignal * (1.0 - smoothAlpha) + rawSignal * smoothAlpha;
+        float smoothAlpha = config.get<CFG_PULSE_ALPHA>();
+        smoothedSignal = smoothedSignal * (1.0f - smoothAlpha) + rawSignal * smoothAlpha;
         int signal = (int)smoothedSignal;
         
         signalBuffer[bufferIndex] = signal;
@@ -300,7 +794,7 @@ public:
         updateQuality();
     }
     
-    void updateBPMFromRaw(int signal, unsigned long now) {
+    void DSP_HOT updateBPMFromRaw(int signal, unsigned long now) {
         int thresh = (int)(dcLevel + 0.35f * (acAmplitude > 20 ? acAmplitude : 20));
         if (signal > thresh) {
             if (!rawPeakZone) rawPeakZone = true;
@@ -332,7 +826,7 @@ public:
         }
     }
     
-    void updateSignalStats() {
+    void DSP_HOT updateSignalStats() {
         if (!bufferFilled) return;
         
         long sum = 0;
@@ -347,10 +841,10 @@ public:
         }
         
         float newDC = sum / (float)WINDOW_SIZE;
-        dcLevel = dcLevel * 0.98 + newDC * 0.02;
+        dcLevel = dcLevel * 0.98f + newDC * 0.02f;
         
         int range = maxVal - minVal;
-        acAmplitude = acAmplitude * 0.7 + range * 0.3;
+        acAmplitude = acAmplitude * 0.7f + range * 0.3f;
         
         if (millis() - lastAdaptUpdate > 500) {
             peakValue = maxVal;
@@ -358,11 +852,11 @@ public:
             
             // More aggressive threshold positioning
             if (range > 20) {
-                // Position threshold at 40% of the way from trough to peak
-                dynamicThreshold = troughValue + (range * 0.40);
+                // Position threshold pulse_thresh (40%) of the way from trough to peak
+                dynamicThreshold = troughValue + (range * config.get<CFG_PULSE_THRESH>());
             } else if (range > 10) {
                 // For smaller signals, be more conservative
-                dynamicThreshold = troughValue + (range * 0.35);
+                dynamicThreshold = troughValue + (range * 0.35f);
             } else {
                 // Fallback to DC-based threshold
                 dynamicThreshold = dcLevel + 50;
@@ -375,7 +869,7 @@ public:
         }
     }
     
-    void detectBeat(int signal, unsigned long now) {
+    void DSP_HOT detectBeat(int signal, unsigned long now) {
         static int lastSignal = 0;
         static bool aboveThreshold = false;
         
@@ -425,6 +919,8 @@ public:
                     currentBPM = sum / beatHistoryCount;
                     lastValidBPM = currentBPM;
                     lastBeatTime = now;
+                    beatStamp.mark();
+                    rollupBeat("SEN11574", beatInterval);
                 }
             }
         }
@@ -437,7 +933,7 @@ public:
         lastSignal = signal;
     }
     
-    void calculateSpO2() {
+    void DSP_HOT calculateSpO2() {
         if (acAmplitude < 10 || dcLevel < 200) {
             spo2Value = 0;
             spo2Quality = 0;
@@ -458,7 +954,7 @@ public:
         }
     }
     
-    void updateQuality() {
+    void DSP_HOT updateQuality() {
         if (!bufferFilled) {
             signalQuality = 0;
             return;
@@ -502,6 +998,8 @@ public:
     }
     
     int getLastValidBPM() { return hasPulseSignal() ? lastValidBPM : 0; }
+    uint32_t getLastSampleUs() { return sampleStamp.get(); }
+    uint32_t getLastBeatUs() { return beatStamp.get(); }
     
     int getSpO2() {
         if (signalQuality >= 20 && spo2Value > 0) return (int)spo2Value;
@@ -510,6 +1008,13 @@ public:
     }
     
     int getSignalQuality() { return signalQuality; }
+    
+    void printState(Print& out) {
+        out.printf("SEN11574: smoothed=%.0f dc=%.0f ac=%.1f threshold=%d range=%d..%d\n",
+                   smoothedSignal, dcLevel, acAmplitude, dynamicThreshold, troughValue, peakValue);
+        out.printf("  bpm=%d raw_bpm=%d beats=%d quality=%d spo2=%.0f/%d\n",
+                   currentBPM, bpmFromRaw, beatHistoryCount, signalQuality, spo2Value, spo2Quality);
+    }
     int getSpO2Quality() { return spo2Quality; }
     
     void reset() {
@@ -523,433 +1028,279 @@ public:
     }
 };
 
+// ==================== PULSE MORPHOLOGY ====================
+#include "pulse_morphology.h"
+
 // ==================== MAX30102 SENSOR CLASS ====================
-class MAX30102Sensor {
-private:
-    MAX30105* sensor;
-    bool available;
-    
-    static const byte RATE_SIZE = 8;
-    byte rates[RATE_SIZE];
-    byte rateSpot;
-    unsigned long lastBeat;
-    float beatsPerMinute;
-    int beatAvg;
-    
-    uint32_t irValue;
-    uint32_t redValue;
+#include "max30102_sensor.h"
+
+bool max30102Setup(uint8_t ledAmplitude, uint32_t& firstIr) {
+    if (!max30102.begin(Wire, I2C_SPEED_STANDARD, MAX30102_I2C_ADDR)) {
+        uint8_t partId = max30102.readPartID();
+        Serial.println(F("MAX30102: begin() FAILED"));
+        Serial.print(F("  Part ID read: 0x"));
+        Serial.println(partId, HEX);
+        Serial.println(F("  Expected 0x15. If 0x00: no device at 0x57 (check wiring/SDA/SCL)."));
+        return false;
+    }
     
-    float irDC;
-    float redDC;
-    float irAC;
-    float redAC;
+    byte ledBrightness = 0x7F;   // 25 mA – balance: 0x5F too dim, 0xFF saturates
+    byte sampleAverage = 4;
+    byte ledMode = 2;   // Red + IR only (MAX30102 has no green)
+    byte sampleRate = 100;
+    int pulseWidth = 411;
+    int adcRange = 4096;
+    
+    max30102.setup(ledBrightness, sampleAverage, ledMode, sampleRate, pulseWidth, adcRange);
+    max30102.setPulseAmplitudeRed(ledAmplitude);
+    max30102.setPulseAmplitudeIR(ledAmplitude);
+    max30102.setPulseAmplitudeGreen(0);
+    max30102.wakeUp();
+    max30102.disableFIFORollover();
+    max30102.setFIFOAlmostFull(0);   // A_FULL at 32 queued: see Max30102Fifo::poll()
+    max30102.enableAFULL();
+    max30102.clearFIFO();
+    
+    delay(300);
+    for (int i = 0; i < 30; i++) {
+        max30102.check();
+        delay(15);
+    }
+    firstIr = max30102.getIR();
+    Serial.println(F("MAX30102: init OK"));
+    return true;
+}
+
+// LED current and sample rate. 50 sps halves the LED pulses; averaging
+// drops from 4 to 2 so the FIFO still delivers 25 samples/s to the beat
+// detector.
+void max30102SetPower(uint8_t amplitude, int sps) {
+    max30102.setPulseAmplitudeRed(amplitude);
+    max30102.setPulseAmplitudeIR(amplitude);
+    if (sps == 50) {
+        max30102.setSampleRate(MAX30105_SAMPLERATE_50);
+        max30102.setFIFOAverage(MAX30105_SAMPLEAVG_2);
+    } else {
+        max30102.setSampleRate(MAX30105_SAMPLERATE_100);
+        max30102.setFIFOAverage(MAX30105_SAMPLEAVG_4);
+    }
+}
+
+void max30102BusRecover() {
+    Wire.end();
+    delay(80);
+    Wire.begin(SDA_PIN, SCL_PIN);
+    Wire.setTimeOut(2000);
+    Wire.setClock(100000);
+}
+
+uint32_t max30102FingerIr() { return config.get<CFG_FINGER_IR>(); }
+uint32_t max30102FingerRed() { return config.get<CFG_FINGER_RED>(); }
+
+// ==================== TEMPERATURE SENSOR CLASS ====================
+// Fits the first-order warm-up curve T(t) = Teq + C * e^(-t/tau) of a contact
+// probe. For a fixed tau the model is linear in (Teq, C), so a least-squares
+// fit is kept incrementally for each tau in a geometric grid. The band is the
+// spread of Teq over every tau whose fit is within two sigma of the best one
+// (a profile-likelihood interval), plus the best fit's own 2-sigma error.
+const float EQ_TAUS_S[] = {15, 19, 24, 30, 38, 48, 60, 75, 95, 120, 150, 190, 240, 300, 380};
+const int EQ_TAU_COUNT = sizeof(EQ_TAUS_S) / sizeof(EQ_TAUS_S[0]);
+
+class EquilibriumEstimator {
+private:
+    static const int MIN_SAMPLES = 6;
+    static constexpr double NOISE_FLOOR = 0.02;   // C, below the DS18B20's 1/16 C step
     
-    int spo2Value;
-    int spo2Quality;
+    struct Fit {
+        double n, su, suu, sy, suy, syy;
+    };
     
-    uint32_t irPeak;
-    uint32_t irTrough;
-    uint32_t adaptiveThreshold;
-    unsigned long lastThresholdUpdate;
+    Fit fits[EQ_TAU_COUNT];  // double: the SSE is a small difference of large sums
+    float origin;            // first reading; sums are kept relative to it
+    unsigned long startMs;
+    float lastT;
+    unsigned long lastMs;
+    int samples;
+    
+    // Least squares for one tau; returns SSE, or -1 if degenerate.
+    double solve(const Fit& f, double& teq, double& c, double& varTeq) {
+        double det = f.n * f.suu - f.su * f.su;
+        if (det <= 1e-9) return -1;
+        c = (f.n * f.suy - f.su * f.sy) / det;
+        teq = (f.sy - c * f.su) / f.n;
+        double sse = f.syy - teq * f.sy - c * f.suy;
+        if (sse < 0) sse = 0;
+        varTeq = sse / max(f.n - 2, 1.0) * f.suu / det;
+        return sse;
+    }
     
-    bool fingerDetected;
-    int lastValidBPM;
-    int lastValidSpO2;
+    // Teq at a fractional grid position, linear between neighbouring taus
+    static double teqAt(const double* fitTeq, double x) {
+        x = constrain(x, 0.0, (double)(EQ_TAU_COUNT - 1));
+        int i = min((int)x, EQ_TAU_COUNT - 2);
+        double f = x - i;
+        return fitTeq[i] * (1 - f) + fitTeq[i + 1] * f;
+    }
     
-    static const int IR_RAW_BUF = 80;
-    uint32_t irRawBuf[IR_RAW_BUF];
-    unsigned long irRawTimeBuf[IR_RAW_BUF];
-    int irRawHead;
-    int irRawLen;
-    int bpmFromRaw;
+public:
+    EquilibriumEstimator() { reset(); }
     
-    int i2cNoDataCount;
-    unsigned long i2cLastRecoveryMs;
-    int i2cCooldownLeft;
-    
-    int computeBPMFromRaw() {
-        if (irRawLen < (int)(IR_RAW_BUF - 2)) return 0;
-        uint32_t minV = 0xFFFFFFFF, maxV = 0;
-        for (int i = 0; i < irRawLen; i++) {
-            int idx = (irRawHead + i) % IR_RAW_BUF;
-            uint32_t v = irRawBuf[idx];
-            if (v < minV) minV = v;
-            if (v > maxV) maxV = v;
-        }
-        if (maxV <= minV || (maxV - minV) < 1000) return 0;
-        uint32_t thresh = minV + (maxV - minV) / 3;
-        int peakIdx[16];
-        int nPeaks = 0;
-        for (int i = 1; i < irRawLen - 1 && nPeaks < 16; i++) {
-            int idx = (irRawHead + i) % IR_RAW_BUF;
-            int idxL = (irRawHead + i - 1) % IR_RAW_BUF;
-            int idxR = (irRawHead + i + 1) % IR_RAW_BUF;
-            uint32_t v = irRawBuf[idx];
-            if (v > thresh && v >= irRawBuf[idxL] && v >= irRawBuf[idxR])
-                peakIdx[nPeaks++] = idx;
-        }
-        if (nPeaks < 2) return 0;
-        long intervals[15];
-        int nInt = 0;
-        for (int i = 1; i < nPeaks; i++) {
-            long dt = (long)(irRawTimeBuf[peakIdx[i]] - irRawTimeBuf[peakIdx[i-1]]);
-            if (dt >= 300 && dt <= 2000) intervals[nInt++] = dt;
-        }
-        if (nInt == 0) return 0;
-        for (int i = 0; i < nInt - 1; i++)
-            for (int j = i + 1; j < nInt; j++)
-                if (intervals[j] < intervals[i]) {
-                    long t = intervals[i]; intervals[i] = intervals[j]; intervals[j] = t;
-                }
-        long medianMs = nInt % 2 ? intervals[nInt/2] : (intervals[nInt/2 - 1] + intervals[nInt/2]) / 2;
-        int bpm = (int)(60000 / medianMs);
-        if (bpm >= 40 && bpm <= 180) return bpm;
-        return 0;
+    void reset() {
+        memset(fits, 0, sizeof(fits));
+        origin = 0;
+        startMs = 0;
+        lastT = 0;
+        lastMs = 0;
+        samples = 0;
     }
     
-public:
-    MAX30102Sensor(MAX30105& max) : sensor(&max), available(false), rateSpot(0),
-                                    lastBeat(0), beatsPerMinute(0), beatAvg(0),
-                                    irValue(0), redValue(0), irDC(0), redDC(0),
-                                    irAC(0), redAC(0), spo2Value(0), spo2Quality(0),
-                                    irPeak(0), irTrough(0xFFFFFFFF), adaptiveThreshold(25000),
-                                    lastThresholdUpdate(0), fingerDetected(false),
-                                    lastValidBPM(0), lastValidSpO2(0),
-                                    irRawHead(0), irRawLen(0), bpmFromRaw(0),
-                                    i2cNoDataCount(0), i2cLastRecoveryMs(0), i2cCooldownLeft(0) {
-        memset(rates, 0, sizeof(rates));
-        memset(irRawBuf, 0, sizeof(irRawBuf));
-        memset(irRawTimeBuf, 0, sizeof(irRawTimeBuf));
-    }
-    
-    bool begin() {
-        if (!sensor->begin(Wire, I2C_SPEED_STANDARD, MAX30102_I2C_ADDR)) {
-            available = false;
-            uint8_t partId = sensor->readPartID();
-            Serial.println(F("MAX30102: begin() FAILED"));
-            Serial.print(F("  Part ID read: 0x"));
-            Serial.println(partId, HEX);
-            Serial.println(F("  Expected 0x15. If 0x00: no device at 0x57 (check wiring/SDA/SCL)."));
-            return false;
+    void add(float celsius, unsigned long nowMs) {
+        if (samples == 0) {
+            origin = celsius;
+            startMs = nowMs;
         }
-        
-        byte ledBrightness = 0x7F;   // 25 mA – balance: 0x5F too dim, 0xFF saturates
-        byte sampleAverage = 4;
-        byte ledMode = 2;   // Red + IR only (MAX30102 has no green)
-        byte sampleRate = 100;
-        int pulseWidth = 411;
-        int adcRange = 4096;
-        
-        sensor->setup(ledBrightness, sampleAverage, ledMode, sampleRate, pulseWidth, adcRange);
-        sensor->setPulseAmplitudeRed(0x7F);
-        sensor->setPulseAmplitudeIR(0x7F);
-        sensor->setPulseAmplitudeGreen(0);
-        sensor->wakeUp();
-        sensor->clearFIFO();
-        
-        delay(300);
-        for (int i = 0; i < 30; i++) {
-            sensor->check();
-            delay(15);
+        double t = (nowMs - startMs) / 1000.0;
+        double y = celsius - origin;
+        for (int i = 0; i < EQ_TAU_COUNT; i++) {
+            double u = exp(-t / EQ_TAUS_S[i]);
+            Fit& f = fits[i];
+            f.n += 1;
+            f.su += u;
+            f.suu += u * u;
+            f.sy += y;
+            f.suy += u * y;
+            f.syy += y * y;
         }
-        uint32_t ir = sensor->getIR();
-        if (ir > 0) irDC = ir;
-        
-        available = true;
-        Serial.println(F("MAX30102: init OK"));
-        return true;
+        lastT = celsius;
+        lastMs = nowMs;
+        samples++;
     }
     
-    void update() {
-        if (!available) return;
-        
-        if (i2cCooldownLeft > 0) i2cCooldownLeft--;
-        int checkCount = (i2cCooldownLeft > 0) ? 2 : 5;
-        for (int i = 0; i < checkCount; i++) {
-            sensor->check();
-            delay(1);
-            esp_task_wdt_reset();
-        }
-        if (sensor->available() > 0) {
-            while (sensor->available() > 1) sensor->nextSample();
-            irValue = sensor->getFIFOIR();
-            redValue = sensor->getFIFORed();
-            sensor->nextSample();
-            i2cNoDataCount = 0;
-        } else {
-            i2cNoDataCount++;
-            if (i2cNoDataCount >= 35 && (millis() - i2cLastRecoveryMs) >= 10000) {
-                Wire.end();
-                delay(80);
-                Wire.begin(SDA_PIN, SCL_PIN);
-                Wire.setTimeOut(2000);
-                Wire.setClock(100000);
-                i2cNoDataCount = 0;
-                i2cLastRecoveryMs = millis();
-                i2cCooldownLeft = 15;
+    // teq/band in C; remaining = predicted rise still to come at the last reading.
+    bool predict(float& teq, float& band, float& remaining) {
+        if (samples < MIN_SAMPLES) return false;
+        double fitTeq[EQ_TAU_COUNT], fitSse[EQ_TAU_COUNT];
+        double bestVar = 0, bestC = 0;
+        int best = -1;
+        for (int i = 0; i < EQ_TAU_COUNT; i++) {
+            double c, v;
+            fitSse[i] = solve(fits[i], fitTeq[i], c, v);
+            if (fitSse[i] >= 0 && (best < 0 || fitSse[i] < fitSse[best])) {
+                best = i;
+                bestVar = v;
+                bestC = c;
             }
         }
-        // When FIFO empty keep previous values; do not block on getIR()/getRed()
-        
-        bool saturated = (irValue >= MAX30102_SATURATED || redValue >= MAX30102_SATURATED);
-        if (saturated) {
-            // Don't use saturated readings for DC/AC/beat – signal is flat, BPM would stay 0
-            irValue = (irValue >= MAX30102_SATURATED && irDC > 0) ? (uint32_t)irDC : irValue;
-            redValue = (redValue >= MAX30102_SATURATED && redDC > 0) ? (uint32_t)redDC : redValue;
-        }
-        
-        bool wasDetected = fingerDetected;
-        fingerDetected = (irValue > MAX30102_FINGER_THRESHOLD) && (redValue > MAX30102_FINGER_THRESHOLD_RED); 
-
-        #ifdef DEBUG_SENSORS
-        if (millis() % 200 == 0) {
-            Serial.print("MAX30102: IR=");
-            Serial.print(irValue);
-            Serial.print(", RED=");
-            Serial.print(redValue);
-            Serial.print(", Detect=");
-            Serial.print(fingerDetected);
-            Serial.print(", BPM=");
-            Serial.println(beatsPerMinute);
-        }
-        #endif
-        
-        if (fingerDetected && !wasDetected) {
-            memset(rates, 0, sizeof(rates));
-            rateSpot = 0;
-            beatAvg = 0;
-            irPeak = 0;
-            irTrough = 0xFFFFFFFF;
-            lastBeat = millis();
-            adaptiveThreshold = MAX30102_FINGER_THRESHOLD + 10000;
-            lastThresholdUpdate = millis();
-        } else if (!fingerDetected && wasDetected) {
-            reset();
-            return;
-        }
-        
-        if (!fingerDetected) return;
-        
-        if (irValue < MAX30102_SATURATED) {
-            irRawBuf[irRawHead] = irValue;
-            irRawTimeBuf[irRawHead] = millis();
-            irRawHead = (irRawHead + 1) % IR_RAW_BUF;
-            if (irRawLen < IR_RAW_BUF) irRawLen++;
-        }
-        bpmFromRaw = computeBPMFromRaw();
-        if (bpmFromRaw > 0) lastValidBPM = bpmFromRaw;
+        if (best < 0) return false;
         
-        const float DC_ALPHA = 0.995;
-        irDC = irDC * DC_ALPHA + irValue * (1.0 - DC_ALPHA);
-        redDC = redDC * DC_ALPHA + redValue * (1.0 - DC_ALPHA);
-        
-        irAC = irValue - irDC;
-        redAC = redValue - redDC;
-        
-        updateThreshold();
-        
-        if (detectBeat(irValue)) {
-            unsigned long delta = millis() - lastBeat;
-            lastBeat = millis();
-            
-            beatsPerMinute = 60.0 / (delta / 1000.0);
-            
-            if (beatsPerMinute >= 30 && beatsPerMinute <= 200) {
-                bool valid = true;
-                if (beatAvg > 0) {
-                    int diff = abs((int)beatsPerMinute - beatAvg);
-                    if (diff > 40) valid = false;
-                }
-                
-                if (valid) {
-                    rates[rateSpot++] = (byte)beatsPerMinute;
-                    rateSpot %= RATE_SIZE;
-                    
-                    int sum = 0;
-                    int count = 0;
-                    for (byte x = 0; x < RATE_SIZE; x++) {
-                        if (rates[x] > 0) {
-                            sum += rates[x];
-                            count++;
-                        }
-                    }
-                    if (count > 0) beatAvg = sum / count;
-                }
+        // Tau grid is geometric, so a parabola through the best SSE and its
+        // neighbours locates the optimum in log-tau; the points where it rises
+        // by 4 sigma^2 bound tau at two sigma, and Teq is read off there.
+        double sigma2 = max(fitSse[best] / (samples - 3), NOISE_FLOOR * NOISE_FLOOR);
+        double x0 = best, halfWidth = 1.0;
+        if (best > 0 && best < EQ_TAU_COUNT - 1 && fitSse[best - 1] >= 0 && fitSse[best + 1] >= 0) {
+            double curv = (fitSse[best - 1] + fitSse[best + 1] - 2 * fitSse[best]) / 2;
+            if (curv > 0) {
+                x0 = best + (fitSse[best - 1] - fitSse[best + 1]) / (4 * curv);
+                halfWidth = min(sqrt(4 * sigma2 / curv), 1.0);
             }
-            if (beatAvg > 0) lastValidBPM = beatAvg;
         }
+        double centre = teqAt(fitTeq, x0);
+        double spread = max(fabs(teqAt(fitTeq, x0 - halfWidth) - centre),
+                            fabs(teqAt(fitTeq, x0 + halfWidth) - centre));
         
-        calculateSpO2();
-        if (spo2Value > 0) lastValidSpO2 = spo2Value;
+        double t = (lastMs - startMs) / 1000.0;
+        teq = origin + centre;
+        remaining = -bestC * exp(-t / EQ_TAUS_S[best]);
+        band = 2.0 * sqrt(bestVar) + spread;
+        return true;
     }
     
-    void updateThreshold() {
-        if (!fingerDetected) return;
-        
-        // Track peak and trough with better initialization
-        if (irPeak == 0 || irValue > irPeak) irPeak = irValue;
-        if (irTrough == 0xFFFFFFFF || (irValue < irTrough && irValue > MAX30102_FINGER_THRESHOLD)) {
-            irTrough = irValue;
-        }
-        
-        if (millis() - lastThresholdUpdate > 500) {
-            // Decay peak slowly, allow trough to rise
-            if (irPeak > 0) irPeak = irPeak * 0.92;
-            if (irTrough < irValue * 1.5 && irTrough != 0xFFFFFFFF) {
-                irTrough = irTrough * 1.08;
-            }
-            
-            // Calculate threshold based on peak/trough or DC level
-            if (irPeak > 0 && irTrough < 0xFFFFFFFF && irPeak > irTrough) {
-                uint32_t range = irPeak - irTrough;
-                adaptiveThreshold = irTrough + (range * 0.4);
-            } else {
-                // Fallback: use DC-based threshold
-                adaptiveThreshold = irDC * 1.05;
-            }
-            
-            // Keep threshold in reasonable range
-            adaptiveThreshold = constrain(adaptiveThreshold, (uint32_t)MAX30102_FINGER_THRESHOLD, (uint32_t)(irDC + 50000));
-            lastThresholdUpdate = millis();
-        }
-    }
+    int count() { return samples; }
+};
+
+class TemperatureSensor {
+private:
+    DallasTemperature& ds18b20;
+    bool sensorAvailable;
+    unsigned long lastCheck;
+    float restingHR;
+    float lastValidTemp;
+    unsigned long lastValidMs;
+    int consecutiveFailures;
     
-    bool detectBeat(uint32_t sample) {
-        static uint32_t lastSample = 0;
-        static bool risingEdge = false;
-        static unsigned long lastBeatTime = 0;
-        
-        // Initialize lastBeatTime on first call
-        if (lastBeatTime == 0) {
-            lastBeatTime = millis();
-            lastSample = sample;
-            return false;
+    // Non-blocking conversion: request, then collect DS18B20_CONVERSION_MS later.
+    bool conversionPending;
+    unsigned long conversionStart;
+    
+    // Placement tracking: fast readings feed the estimator until the curve flattens.
+    EquilibriumEstimator estimator;
+    bool warmingUp;
+    float lastRaw;
+    float predictedTemp;
+    float predictedBand;
+    bool predictionValid;
+    
+    void handleRaw(float raw) {
+        if (raw == -127.0 || raw < TEMP_RAW_MIN || raw > 45.0) {
+            consecutiveFailures++;
+            if (consecutiveFailures > 3) sensorAvailable = false;
+            return;
         }
+        sensorAvailable = true;
+        consecutiveFailures = 0;
         
-        // Rising edge detection: signal crosses threshold from below
-        if (sample > adaptiveThreshold && lastSample <= adaptiveThreshold) {
-            risingEdge = true;
+        // A step of more than TEMP_PLACEMENT_STEP means the probe was (re)placed:
+        // restart the fit instead of rejecting the reading.
+        if (!warmingUp && fabs(raw - lastRaw) > TEMP_PLACEMENT_STEP) {
+            warmingUp = true;
+            estimator.reset();
         }
+        lastRaw = raw;
         
-        // Falling edge detection: confirm beat only on downward crossing
-        if (risingEdge && sample < adaptiveThreshold && lastSample >= adaptiveThreshold) {
-            unsigned long now = millis();
-            unsigned long beatInterval = now - lastBeatTime;
-            
-            // Valid beat interval: 300ms to 2500ms (24-200 BPM)
-            if (beatInterval > 300 && beatInterval < 2500) {
-                lastBeatTime = now;
-                risingEdge = false;
-                lastSample = sample;
-                return true;
+        if (!warmingUp) {
+            if (raw > 30.0) {
+                lastValidTemp = raw;
+                lastValidMs = millis();
             }
-            risingEdge = false;
-        }
-        
-        lastSample = sample;
-        return false;
-    }
-    
-    void calculateSpO2() {
-        if (!fingerDetected || irDC < MAX30102_FINGER_THRESHOLD || redDC < MAX30102_FINGER_THRESHOLD || fabs(irAC) < 30) {
-            spo2Value = 0;
-            spo2Quality = 0;
             return;
         }
         
-        float ratioRMS = (fabs(redAC) / redDC) / (fabs(irAC) / irDC);
-        spo2Value = constrain((int)(110 - 25 * ratioRMS), 70, 100);
-        
-        if (irValue > 80000 && beatAvg > 0) {
-            spo2Quality = 95;
-        } else if (irValue > 50000 && beatAvg > 0) {
-            spo2Quality = 80;
-        } else if (irValue > 30000) {
-            spo2Quality = 60;
-        } else if (irValue > MAX30102_FINGER_THRESHOLD) {
-            spo2Quality = 40;
-        } else {
-            spo2Quality = 20;
-        }
-    }
-    
-    int getBPM() {
-        if (!available || !fingerDetected) return 0;
-        if (millis() - lastBeat <= 3000 && beatAvg > 0) return beatAvg;
-        if (bpmFromRaw > 0) return bpmFromRaw;
-        return lastValidBPM;
-    }
-    
-    int getLastValidBPM() { return fingerDetected ? lastValidBPM : 0; }
-    
-    int getSpO2() {
-        if (available && fingerDetected && spo2Value > 0) return spo2Value;
-        if (lastValidSpO2 > 0) return lastValidSpO2;
-        return 0;
-    }
-    
-    int getHRQuality() {
-        if (!available || !fingerDetected) {
-            if (lastValidBPM > 0) return 25;
-            return 0;
+        estimator.add(raw, millis());
+        float teq, band, remaining;
+        predictionValid = estimator.predict(teq, band, remaining) && band <= TEMP_PREDICT_MAX_BAND &&
+                          teq > 30.0 && teq < 45.0;
+        if (predictionValid) {
+            predictedTemp = teq;
+            predictedBand = band;
         }
-        if (bpmFromRaw > 0) return 45;
-        unsigned long timeSinceBeat = millis() - lastBeat;
-        if (irValue > 80000 && beatAvg > 0 && timeSinceBeat < 1200) return 95;
-        else if (irValue > 50000 && beatAvg > 0 && timeSinceBeat < 2000) return 75;
-        else if (irValue > 30000 && timeSinceBeat < 3000) return 50;
-        else if (irValue > MAX30102_FINGER_THRESHOLD) return 30;
-        if (lastValidBPM > 0) return 25;
-        return 20;
-    }
-    
-    int getSpO2Quality() {
-        if (!available || !fingerDetected) {
-            if (lastValidSpO2 > 0) return 25;
-            return 0;
+        if (predictionValid && fabs(remaining) < TEMP_SETTLED_DELTA && raw > 30.0) {
+            // Settled on skin: back to slow direct readings.
+            warmingUp = false;
+            predictionValid = false;
+            lastValidTemp = raw;
+            lastValidMs = millis();
         }
-        if (lastValidSpO2 > 0 && spo2Value == 0) return 25;
-        return spo2Quality;
-    }
-    
-    bool isAvailable() { return available; }
-    bool isFingerDetected() { return available && fingerDetected; }
-    
-    void reset() {
-        beatAvg = 0;
-        beatsPerMinute = 0;
-        spo2Value = 0;
-        memset(rates, 0, sizeof(rates));
-        rateSpot = 0;
-        irPeak = 0;
-        irTrough = 0xFFFFFFFF;
     }
-};
-
-// ==================== TEMPERATURE SENSOR CLASS ====================
-class TemperatureSensor {
-private:
-    DallasTemperature& ds18b20;
-    bool sensorAvailable;
-    unsigned long lastCheck;
-    float restingHR;
-    float lastValidTemp;
-    int consecutiveFailures;
     
 public:
     struct TempReading {
         float celsius;
         bool isEstimated;
+        bool isPredicted;
+        float band;          // +/- C of the prediction, 0 for direct readings
         String source;
     };
     
     TemperatureSensor(DallasTemperature& sensor) : ds18b20(sensor), sensorAvailable(true),
                                                    lastCheck(0), restingHR(70.0),
-                                                   lastValidTemp(36.5), consecutiveFailures(0) {}
+                                                   lastValidTemp(36.5), lastValidMs(0), consecutiveFailures(0),
+                                                   conversionPending(false), conversionStart(0),
+                                                   warmingUp(true), lastRaw(0), predictedTemp(0),
+                                                   predictedBand(0), predictionValid(false) {}
     
     void begin() {
         ds18b20.begin();
-        restingHR = preferences.getFloat("resting_hr", 70.0);
         
         ds18b20.requestTemperatures();
         delay(100);
@@ -958,44 +1309,51 @@ public:
         if (temp > 30.0 && temp < 45.0 && temp != -127.0) {
             sensorAvailable = true;
             lastValidTemp = temp;
+            lastValidMs = millis();
+            lastRaw = temp;
+            warmingUp = false;   // already on skin; a placement step restarts the fit
         } else {
             sensorAvailable = false;
         }
+        ds18b20.setWaitForConversion(false);
+    }
+    
+    void poll() {
+        unsigned long interval = warmingUp ? TEMP_FAST_INTERVAL_MS : TEMP_SLOW_INTERVAL_MS;
+        if (conversionPending) {
+            if (millis() - conversionStart < DS18B20_CONVERSION_MS) return;
+            conversionPending = false;
+            handleRaw(ds18b20.getTempCByIndex(0));
+        } else if (lastCheck == 0 || millis() - lastCheck >= interval) {
+            ds18b20.requestTemperatures();
+            conversionPending = true;
+            conversionStart = millis();
+            lastCheck = millis();
+        }
     }
     
     TempReading getTemperature(float currentHR) {
         TempReading result;
+        result.isPredicted = false;
+        result.band = 0;
+        poll();
         
-        if (millis() - lastCheck > 10000 || lastCheck == 0) {
-            ds18b20.requestTemperatures();
-            delay(100);
-            float temp = ds18b20.getTempCByIndex(0);
-            
-            if (temp > 30.0 && temp < 45.0 && temp != -127.0) {
-                if (abs(temp - lastValidTemp) < 2.0 || consecutiveFailures > 5) {
-                    sensorAvailable = true;
-                    lastValidTemp = temp;
-                    consecutiveFailures = 0;
-                    result.celsius = temp;
-                    result.isEstimated = false;
-                    result.source = "DS18B20";
-                    lastCheck = millis();
-                    return result;
-                }
-            }
-            
-            consecutiveFailures++;
-            if (consecutiveFailures > 3) sensorAvailable = false;
-            lastCheck = millis();
-        }
-        
-        if (sensorAvailable && millis() - lastCheck < 30000) {
+        if (sensorAvailable && !warmingUp && lastValidMs != 0 && millis() - lastValidMs < 30000) {
             result.celsius = lastValidTemp;
             result.isEstimated = false;
             result.source = "DS18B20";
             return result;
         }
         
+        if (sensorAvailable && warmingUp && predictionValid) {
+            result.celsius = predictedTemp;
+            result.isEstimated = false;
+            result.isPredicted = true;
+            result.band = predictedBand;
+            result.source = "DS18B20_PRED";
+            return result;
+        }
+        
         if (currentHR > 0) {
             float hrDelta = currentHR - restingHR;
             result.celsius = 36.5 + (hrDelta / 10.0);
@@ -1011,58 +1369,354 @@ public:
     }
     
     bool isSensorAvailable() { return sensorAvailable; }
+    bool isWarmingUp() { return warmingUp; }
+    // Baseline for the HR-based estimate, learned by VitalRollups.
+    void setRestingHR(float bpm) { restingHR = bpm; }
 };
 
 // ==================== SENSOR INSTANCES ====================
 PulseSensor pulseSensor;
-MAX30102Sensor max30102Sensor(max30102);
+MAX30102Sensor max30102Sensor;
+
+// FIFO counters: max_depth near 32 or any lost samples mean the loop is
+// not keeping up with the sample rate.
+void addMax30102FifoTo(JsonObject obj) {
+    const Max30102Fifo::Stats& st = max30102Sensor.getFifoStats();
+    obj["samples"] = st.samples;
+    obj["lost"] = st.lost;
+    obj["overflows"] = st.overflows;
+    obj["max_depth"] = st.maxDepth;
+}
+
+// Beats after `after` (a beatCount() value) still held, flattened as
+// [first, ibi, rise, width, notch, dvp, ri, pi, ibi, ...]. Returns the beat
+// count covered, for the caller to pass back once acknowledged.
+uint32_t addMorphologyTo(JsonObject obj, uint32_t after) {
+    const PulseMorphology& morph = max30102Sensor.getMorphology();
+    uint32_t total = morph.beatCount();
+    uint32_t first = morph.firstHeld(after);
+    if (first >= total) return total;
+    obj["first"] = first;
+    obj["dropped"] = first - after;
+    JsonArray a = obj.createNestedArray("beats");
+    for (uint32_t b = first; b < total; b++) {
+        const PulseFeatures& f = morph.beat(b);
+        a.add(f.ibiMs);
+        a.add(f.riseMs);
+        a.add(f.widthMs);
+        a.add(f.notchMs);
+        a.add(f.dvpMs);
+        a.add(f.riPct);
+        a.add(f.piCenti);
+    }
+    return total;
+}
 TemperatureSensor tempSensor(dallas);
 
 
-// ==================== ALERT CHECKING ====================
-void checkAlerts() {
-    currentVitals.hasAlert = false;
-    currentVitals.isCriticalAlert = false;
-    currentVitals.alertMessage = "";
+// ==================== RADIO SCHEDULER ====================
+#include "radio_scheduler.h"
+
+void radioSetPowerSave(bool on) { esp_wifi_set_ps(on ? WIFI_PS_MAX_MODEM : WIFI_PS_NONE); }
+bool radioLinkUp() { return WiFi.status() == WL_CONNECTED; }
+void radioNtpStart() { configTime(GMT_OFFSET_SEC, DAYLIGHT_OFFSET_SEC, NTP_SERVER); }
+bool radioNtpSynced() { return sntp_get_sync_status() == SNTP_SYNC_STATUS_COMPLETED; }
+void radioNtpStop() { sntp_stop(); }
+
+RadioScheduler radio;
+
+void addRadioTo(JsonObject obj) {
+    obj["duty_pct"] = lroundf(radio.dutyPercent() * 10) / 10.0;
+    obj["bursts"] = radio.getBursts();
+    obj["urgent_bursts"] = radio.getUrgentBursts();
+}
+
+// ==================== ENERGY ACCOUNTING ====================
+// Charge per subsystem, integrated once per loop pass from state the firmware
+// already controls: CPU busy vs delay() time, HTTP exchange time, MAX30102 LED
+// amplitude and duty, and the LCD backlight. The raw state times are reported
+// alongside; energyFromStates() recomputes the totals from them (see
+// test/test_energy).
+class EnergyMeter {
+private:
+    EnergyAccount account;
+    double windowStartMas[EN_COUNT];
+    float rateMah[EN_COUNT];           // mAh per hour over the last full window
+    unsigned long windowStartMs;
+    bool haveRates;
+    bool backlightOn;
+    uint32_t pendingRadioUs;
     
-    if (currentVitals.spo2 > 0 && currentVitals.spo2Quality > 50 && currentVitals.spo2 < 90) {
-        currentVitals.hasAlert = true;
-        currentVitals.isCriticalAlert = true;
-        currentVitals.alertMessage = "CRITICAL: SpO2 LOW!";
-        return;
+public:
+    EnergyMeter() : windowStartMs(0), haveRates(false), backlightOn(true), pendingRadioUs(0) {
+        memset(windowStartMas, 0, sizeof(windowStartMas));
+        memset(rateMah, 0, sizeof(rateMah));
     }
     
-    if (currentVitals.heartRate == 0) {
-        currentVitals.hasAlert = true;
-        currentVitals.alertMessage = "No HR detected";
-        return;
+    float ledMa() {
+        if (!max30102Sensor.isAvailable()) return 0;
+        return energyLedMa(max30102Sensor.getLedAmplitude(), max30102Sensor.getSamplesPerSecond());
     }
     
-    if (currentVitals.spo2 > 0 && currentVitals.spo2Quality > 50 && currentVitals.spo2 < 95) {
-        currentVitals.hasAlert = true;
-        currentVitals.alertMessage = "Low SpO2";
-        return;
+    // Expected draw right now, outside any HTTP exchange
+    float currentMa() {
+        float ma = ENERGY_CPU_IDLE_MA + loopLoad * (ENERGY_CPU_ACTIVE_MA - ENERGY_CPU_IDLE_MA);
+        if (WiFi.status() == WL_CONNECTED) ma += radio.isAwake() ? ENERGY_RADIO_AWAKE_MA : ENERGY_RADIO_SLEEP_MA;
+        if (backlightOn) ma += ENERGY_LCD_BACKLIGHT_MA;
+        return ma + ledMa() + ENERGY_SENSORS_MA;
     }
     
-    if (currentVitals.heartRate > 100 && currentVitals.hrQuality > 50) {
-        currentVitals.hasAlert = true;
-        currentVitals.alertMessage = "High HR";
-        return;
+    // Called by setLcdBacklight()
+    void setBacklight(bool on) { backlightOn = on; }
+    
+    // Called right after each blocking request with its wall time.
+    void noteRadioBurst(uint32_t us) { pendingRadioUs += us; }
+    
+    // Integrates one loop pass: busyUs of work, then totalUs - busyUs in delay().
+    void noteLoop(uint32_t busyUs, uint32_t totalUs) {
+        account.noteLoop(busyUs, totalUs, pendingRadioUs, WiFi.status() == WL_CONNECTED, radio.isAwake(),
+                         ledMa(), backlightOn);
+        pendingRadioUs = 0;
+        
+        unsigned long elapsed = millis() - windowStartMs;
+        if (elapsed >= ENERGY_WINDOW_MS) {
+            // mAh per hour is the window's mean current in mA
+            for (int i = 0; i < EN_COUNT; i++) {
+                double mas = account.getChargeMas(i);
+                rateMah[i] = (mas - windowStartMas[i]) / (elapsed / 1000.0);
+                windowStartMas[i] = mas;
+            }
+            windowStartMs = millis();
+            haveRates = true;
+            printReport();
+        }
     }
     
-    if (currentVitals.heartRate < 50 && currentVitals.heartRate > 0 && currentVitals.hrQuality > 50) {
-        currentVitals.hasAlert = true;
-        currentVitals.alertMessage = "Low HR";
-        return;
+    float totalMah() { return account.totalMas() / 3600.0; }
+    
+    float totalRateMah() {
+        float sum = 0;
+        for (int i = 0; i < EN_COUNT; i++) sum += rateMah[i];
+        return sum;
     }
     
-    if (currentVitals.temperature > 38.0 && !currentVitals.tempEstimated) {
-        currentVitals.hasAlert = true;
-        currentVitals.alertMessage = "Fever";
-        return;
+    void printReport() {
+        Serial.print("Energy mAh/h:");
+        for (int i = 0; i < EN_COUNT; i++) Serial.printf(" %s=%.1f", ENERGY_SUBSYSTEM_NAMES[i], rateMah[i]);
+        Serial.printf(" total=%.1f (%.1f mAh since boot)\n", totalRateMah(), totalMah());
+    }
+    
+    void addTo(JsonObject obj, int batteryPercent) {
+        JsonObject rates = obj.createNestedObject("mah_per_h");
+        if (haveRates) {
+            for (int i = 0; i < EN_COUNT; i++) rates[ENERGY_SUBSYSTEM_NAMES[i]] = lroundf(rateMah[i] * 10) / 10.0;
+            if (batteryPercent >= 0 && totalRateMah() > 0) {
+                obj["hours_left"] = lroundf(batteryPercent / 100.0f * BATTERY_CAPACITY_MAH / totalRateMah() * 10) / 10.0;
+            }
+        }
+        obj["total_mah"] = lroundf(totalMah() * 10) / 10.0;
+        
+        const EnergyStates& st = account.getStates();
+        JsonObject t = obj.createNestedObject("state_s");
+        t["total"] = (uint32_t)(st.totalUs / 1000000);
+        t["cpu_active"] = (uint32_t)(st.cpuActiveUs / 1000000);
+        t["cpu_idle"] = (uint32_t)(st.cpuIdleUs / 1000000);
+        t["radio_connected"] = (uint32_t)(st.radioConnectedUs / 1000000);
+        t["radio_awake"] = (uint32_t)(st.radioAwakeUs / 1000000);
+        t["radio_active"] = (uint32_t)(st.radioActiveUs / 1000000);
+        t["backlight"] = (uint32_t)(st.backlightUs / 1000000);
+        obj["led_mah"] = lroundf(st.ledMas / 3600.0 * 10) / 10.0;
+        obj["led_ma"] = lroundf(ledMa() * 100) / 100.0;
+    }
+};
+
+EnergyMeter energy;
+
+// The only place the LCD backlight is switched, so the energy model follows it.
+void setLcdBacklight(bool on) {
+    if (on) lcd.backlight();
+    else lcd.noBacklight();
+    energy.setBacklight(on);
+}
+
+// ==================== BATTERY GAUGE ====================
+// Single-cell LiPo open-circuit voltage (mV) at 100, 95, ... 0 % charge.
+const uint16_t LIPO_OCV_MV[21] = {
+    4200, 4150, 4110, 4080, 4020, 3980, 3950, 3910, 3870, 3850, 3840,
+    3820, 3800, 3790, 3770, 3750, 3730, 3710, 3690, 3610, 3270
+};
+
+enum PowerTier { POWER_NORMAL, POWER_SAVER, POWER_CRITICAL };
+const char* POWER_TIER_NAMES[] = {"normal", "saver", "critical"};
+
+// What each tier costs: MAX30102 LED current and sample rate, and how often
+// the radio is used.
+struct PowerPolicy {
+    uint8_t ledAmplitude;
+    int sampleRate;
+    unsigned long cloudSyncMs;
+    bool historySync;
+    bool backlight;
+};
+
+const PowerPolicy POWER_POLICIES[] = {
+    {0x7F, 100, (unsigned long)CLOUD_SYNC_INTERVAL, true, true},  // 25 mA LEDs
+    {0x5F, 50, 15000, true, true},                    // 19 mA LEDs
+    {0x4F, 50, 60000, false, false}                   // 16 mA LEDs, backlog waits for charge, LCD unlit
+};
+
+class BatteryGauge {
+private:
+    float voltage;           // load-compensated, smoothed
+    int percent;
+    bool present;
+    PowerTier tier;
+    unsigned long lastRead;
+    
+    static int percentFromMv(float mv) {
+        if (mv >= LIPO_OCV_MV[0]) return 100;
+        for (int i = 1; i < 21; i++) {
+            if (mv >= LIPO_OCV_MV[i]) {
+                float f = (mv - LIPO_OCV_MV[i]) / (float)(LIPO_OCV_MV[i - 1] - LIPO_OCV_MV[i]);
+                return (int)lroundf(100 - 5 * i + 5 * f);
+            }
+        }
+        return 0;
     }
+    
+    // Hysteresis keeps the tier from flapping around a threshold as the
+    // voltage recovers under lighter load.
+    PowerTier tierFor(int pct) {
+        switch (tier) {
+            case POWER_NORMAL:
+                if (pct < BATTERY_CRITICAL_PERCENT) return POWER_CRITICAL;
+                if (pct < THRESHOLD_BATTERY_LOW) return POWER_SAVER;
+                return POWER_NORMAL;
+            case POWER_SAVER:
+                if (pct < BATTERY_CRITICAL_PERCENT) return POWER_CRITICAL;
+                if (pct >= THRESHOLD_BATTERY_LOW + BATTERY_TIER_HYSTERESIS) return POWER_NORMAL;
+                return POWER_SAVER;
+            default:
+                if (pct >= THRESHOLD_BATTERY_LOW + BATTERY_TIER_HYSTERESIS) return POWER_NORMAL;
+                if (pct >= BATTERY_CRITICAL_PERCENT + BATTERY_TIER_HYSTERESIS) return POWER_SAVER;
+                return POWER_CRITICAL;
+        }
+    }
+    
+public:
+    BatteryGauge() : voltage(0), percent(0), present(false), tier(POWER_NORMAL), lastRead(0) {}
+    
+    void begin() {
+        analogSetPinAttenuation(BATTERY_PIN, ADC_11db);
+        lastRead = 0;
+        update();
+    }
+    
+    // Averages BATTERY_OVERSAMPLE calibrated reads (about 1 ms) to beat down
+    // ADC noise, then adds back the sag under the estimated load.
+    void update() {
+        if (lastRead != 0 && millis() - lastRead < BATTERY_READ_INTERVAL_MS) return;
+        lastRead = millis();
+        
+        uint32_t sum = 0;
+        for (int i = 0; i < BATTERY_OVERSAMPLE; i++) sum += analogReadMilliVolts(BATTERY_PIN);
+        float mv = (float)sum / BATTERY_OVERSAMPLE * BATTERY_VOLTAGE_DIVIDER;
+        
+        // Divider reads near zero without a cell (USB power only)
+        if (mv < BATTERY_PRESENT_MIN_MV) {
+            present = false;
+            percent = 0;
+            voltage = mv / 1000.0f;
+            applyTier(POWER_NORMAL);
+            return;
+        }
+        
+        // Going down soon: get pending config out while NVS writes still work
+        if (mv < BATTERY_FLUSH_MV && config.pending()) config.flushNow();
+        
+        // I*R sag across the cell and protection circuit at the modelled load
+        float ocv = mv + energy.currentMa() * BATTERY_INTERNAL_MOHM / 1000.0f;
+        voltage = present ? voltage * 0.8f + 0.2f * ocv / 1000.0f : ocv / 1000.0f;
+        present = true;
+        percent = percentFromMv(voltage * 1000.0f);
+        applyTier(tierFor(percent));
+    }
+    
+    void applyTier(PowerTier next) {
+        if (next == tier) return;
+        PowerTier prev = tier;
+        tier = next;
+        const PowerPolicy& p = POWER_POLICIES[tier];
+        max30102Sensor.setPowerLevel(p.ledAmplitude, p.sampleRate);
+        setLcdBacklight(p.backlight);
+        Serial.printf("Battery %d%% (%.2fV): power tier %s -> %s\n", percent, voltage,
+                      POWER_TIER_NAMES[prev], POWER_TIER_NAMES[tier]);
+    }
+    
+    bool isPresent() { return present; }
+    int getPercent() { return percent; }
+    float getVoltage() { return voltage; }
+    PowerTier getTier() { return tier; }
+    const PowerPolicy& policy() { return POWER_POLICIES[tier]; }
+};
+
+BatteryGauge battery;
+
+// ==================== RHYTHM SCREEN ====================
+#include "rhythm_screen.h"
+
+RhythmScreen rhythm;
+
+void addRhythmTo(JsonObject obj) {
+    obj["beats"] = rhythm.beatCount();
+    obj["window"] = rhythm.windowLen();
+    obj["nrmssd"] = lroundf(rhythm.getNRMSSD() * 1000) / 1000.0;
+    obj["entropy"] = lroundf(rhythm.getEntropy() * 100) / 100.0;
+    obj["irregular"] = rhythm.isIrregular();
+    obj["episodes"] = rhythm.episodeCount();
+}
+
+void rhythmBeat(uint16_t ibiMs) { rhythm.addBeat(ibiMs); }
+void rhythmGap() { rhythm.gap(); }
+void rhythmReset() { rhythm.reset(); }
+
+// ==================== ALERT CHECKING ====================
+void checkAlerts() {
+    bool hasAlert = true;
+    bool critical = false;
+    const char* type = "threshold_exceeded";
+    const char* message = "";
+    
+    if (currentVitals.spo2 > 0 && currentVitals.spo2Quality > 50 && currentVitals.spo2 < 90) {
+        critical = true;
+        type = "critical_hypoxia";
+        message = "CRITICAL: SpO2 LOW!";
+    } else if (currentVitals.heartRate == 0) {
+        message = "No HR detected";
+    } else if (currentVitals.spo2 > 0 && currentVitals.spo2Quality > 50 && currentVitals.spo2 < 95) {
+        message = "Low SpO2";
+    } else if (rhythm.isIrregular()) {
+        type = "irregular_rhythm";
+        message = "Irregular HR";
+    } else if (currentVitals.heartRate > 100 && currentVitals.hrQuality > 50) {
+        message = "High HR";
+    } else if (currentVitals.heartRate < 50 && currentVitals.heartRate > 0 && currentVitals.hrQuality > 50) {
+        message = "Low HR";
+    } else if (currentVitals.temperature > 38.0 && !currentVitals.tempEstimated) {
+        message = "Fever";
+    } else if (battery.isPresent() && battery.getPercent() < THRESHOLD_BATTERY_LOW) {
+        type = "device_battery_low";
+        message = "Low battery";
+    } else {
+        hasAlert = false;
+    }
+    
+    currentVitals.setAlert(hasAlert, critical, hasAlert ? type : "", message);
 }
 
+// Device status (not a patient reading): reported with severity "info"
+bool isDeviceAlert(const char* type) { return strncmp(type, "device_", 7) == 0; }
+
 // ==================== BUTTON HANDLERS ====================
 void handleButtons() {
     startButton.update();
@@ -1070,6 +1724,7 @@ void handleButtons() {
     
     if (startButton.isPressed()) {
         if (monitoringState == STATE_IDLE || monitoringState == STATE_PAUSED) {
+            if (monitoringState == STATE_IDLE) desatStartSession();
             monitoringState = STATE_MONITORING;
             monitoringStateStr = "monitoring";
             
@@ -1081,6 +1736,7 @@ void handleButtons() {
             lcd.setCursor(0, 1);
             lcd.print("Monitoring Started");
             delay(500);
+            lastDisplayedScreen = -1;
         }
         startButton.resetState();
     }
@@ -1101,6 +1757,7 @@ void handleButtons() {
             lcd.setCursor(0, 1);
             lcd.print("Monitoring Paused");
             delay(500);
+            lastDisplayedScreen = -1;
         } else if (monitoringState == STATE_PAUSED) {
             monitoringState = STATE_IDLE;
             monitoringStateStr = "idle";
@@ -1109,83 +1766,82 @@ void handleButtons() {
             lcd.setCursor(0, 1);
             lcd.print("Monitoring Stopped");
             delay(500);
+            lastDisplayedScreen = -1;
         }
         stopButton.resetState();
     }
 }
 
 // ==================== LCD DISPLAY ====================
-bool vitalsChanged() {
-    return currentVitals.heartRate != lastDisplayedVitals.heartRate ||
-           currentVitals.spo2 != lastDisplayedVitals.spo2 ||
-           abs(currentVitals.temperature - lastDisplayedVitals.temperature) > 0.1 ||
-           currentVitals.hasAlert != lastDisplayedVitals.hasAlert ||
-           monitoringState != lastDisplayedScreen;
+#include "lcd_screens.h"
+
+// Overwrites one full row, padding with spaces so no clear() is needed.
+void lcdPrintRow(uint8_t row, const char* text) {
+    char line[LCD_COLS + 1];
+    lcdPadRow(line, text);
+    lcd.setCursor(0, row);
+    lcd.print(line);
 }
 
 void updateLCD() {
-    if (currentScreen == lastDisplayedScreen && !vitalsChanged()) return;
+    static MonitoringState lastDisplayedState = STATE_IDLE;
+    static LcdStatusScreen lastStatus;
     
-    lcd.clear();
+    bool fullRedraw = (currentScreen != lastDisplayedScreen);
+    if (fullRedraw) {
+        lcd.clear();
+        lcdDirty = VF_ALL;
+    }
+    
+    LcdRows rows;
     
     switch(currentScreen) {
-        case 0:
-            lcd.setCursor(0, 0);
-            lcd.print("HR:");
-            lcd.print(currentVitals.heartRate);
-            lcd.print(" BPM ");
-            lcd.print("O2:");
-            lcd.print(currentVitals.spo2);
-            lcd.print("%");
-            
-            lcd.setCursor(0, 1);
-            lcd.print("Temp: ");
-            lcd.print(currentVitals.temperature, 1);
-            lcd.print("C");
+        case 0: {
+            // Row 3 also carries the monitoring state tag.
+            if (monitoringState != lastDisplayedState) lcdDirty |= VF_ALERT;
             
-            lcd.setCursor(0, 2);
-            lcd.print("Src:");
-            lcd.print(currentVitals.hrSource.substring(0, 12));
-            
-            lcd.setCursor(0, 3);
-            if (monitoringState == STATE_MONITORING) {
-                lcd.print("[MON] ");
-            } else if (monitoringState == STATE_PAUSED) {
-                lcd.print("[PAUSE]");
-            } else {
-                lcd.print("[IDLE] ");
-            }
+            LcdVitalsScreen s;
+            s.heartRate = currentVitals.heartRate;
+            s.spo2 = currentVitals.spo2;
+            s.temperature = currentVitals.temperature;
+            s.source = currentVitals.hrSource.c_str();
+            s.stateTag = monitoringState == STATE_MONITORING ? "[MON] " :
+                         monitoringState == STATE_PAUSED ? "[PAUSE]" : "[IDLE] ";
+            s.alert = currentVitals.hasAlert ? currentVitals.alertMessage.c_str() : "";
+            lcdFormatVitals(s, rows);
             
-            if (currentVitals.hasAlert) {
-                lcd.print(currentVitals.alertMessage.substring(0, 13));
-            }
+            static const uint16_t rowFields[LCD_ROWS] = {
+                VF_HEART_RATE | VF_SPO2, VF_TEMPERATURE, VF_HR_SOURCE, VF_ALERT
+            };
+            for (uint8_t r = 0; r < LCD_ROWS; r++)
+                if (lcdDirty & rowFields[r]) lcdPrintRow(r, rows[r]);
             break;
+        }
             
-        case 1:
-            lcd.setCursor(0, 0);
-            lcd.print("System Status:");
-            
-            lcd.setCursor(0, 1);
-            lcd.print("WiFi:");
-            lcd.print(WiFi.status() == WL_CONNECTED ? "OK " : "ERR");
-            lcd.print(" Up:");
-            lcd.print(millis() / 60000);
-            lcd.print("m");
-            
-            lcd.setCursor(0, 2);
-            lcd.print("MAX:");
-            lcd.print(max30102Sensor.isFingerDetected() ? "YES" : "NO ");
-            lcd.print(" SEN:");
-            lcd.print(pulseSensor.getBPM() > 0 ? "YES" : "NO ");
+        case 1: {
+            LcdStatusScreen s;
+            s.version = FIRMWARE_VERSION;
+            s.wifiOk = (WiFi.status() == WL_CONNECTED);
+            s.uptimeMin = millis() / 60000;
+            s.maxFinger = max30102Sensor.isFingerDetected();
+            s.senPulse = pulseSensor.getBPM() > 0;
+            s.batteryPct = battery.isPresent() ? battery.getPercent() : -1;
+            lcdFormatStatus(s, rows);
             
-            lcd.setCursor(0, 3);
-            lcd.print("v");
-            lcd.print(FIRMWARE_VERSION);
+            if (fullRedraw) lcdPrintRow(0, rows[0]);
+            if (fullRedraw || s.batteryPct != lastStatus.batteryPct) lcdPrintRow(3, rows[3]);
+            if (fullRedraw || s.wifiOk != lastStatus.wifiOk || s.uptimeMin != lastStatus.uptimeMin)
+                lcdPrintRow(1, rows[1]);
+            if (fullRedraw || s.maxFinger != lastStatus.maxFinger || s.senPulse != lastStatus.senPulse)
+                lcdPrintRow(2, rows[2]);
+            lastStatus = s;
             break;
+        }
     }
     
     lastDisplayedScreen = currentScreen;
-    lastDisplayedVitals = currentVitals;
+    lastDisplayedState = monitoringState;
+    lcdDirty = 0;
 }
 
 // ==================== VITALS UPDATE ====================
@@ -1207,22 +1863,22 @@ void updateVitals() {
     bool fingerOnMax = max30102Sensor.isFingerDetected();
     
     if (!fingerOnMax) {
-        currentVitals.heartRate = 0;
-        currentVitals.hrQuality = 0;
-        currentVitals.hrSource = "NONE";
+        currentVitals.set(currentVitals.heartRate, 0, VF_HEART_RATE);
+        currentVitals.set(currentVitals.hrQuality, 0, VF_HR_QUALITY);
+        currentVitals.set(currentVitals.hrSource, "NONE", VF_HR_SOURCE);
         lastReportedBPM = 0;
     }
     else if (max30102_hr > 0 && max30102_hrQuality >= MIN_QUALITY_THRESHOLD) {
-        currentVitals.heartRate = max30102_hr;
-        currentVitals.hrQuality = max30102_hrQuality;
-        currentVitals.hrSource = "MAX30102";
+        currentVitals.set(currentVitals.heartRate, max30102_hr, VF_HEART_RATE);
+        currentVitals.set(currentVitals.hrQuality, max30102_hrQuality, VF_HR_QUALITY);
+        currentVitals.set(currentVitals.hrSource, "MAX30102", VF_HR_SOURCE);
         lastReportedBPM = max30102_hr;
         lastReportedBPMTime = millis();
     }
     else if (sen11574_hr > 0 && sen11574_hrQuality >= MIN_QUALITY_THRESHOLD) {
-        currentVitals.heartRate = sen11574_hr;
-        currentVitals.hrQuality = sen11574_hrQuality;
-        currentVitals.hrSource = "SEN11574";
+        currentVitals.set(currentVitals.heartRate, sen11574_hr, VF_HEART_RATE);
+        currentVitals.set(currentVitals.hrQuality, sen11574_hrQuality, VF_HR_QUALITY);
+        currentVitals.set(currentVitals.hrSource, "SEN11574", VF_HR_SOURCE);
         lastReportedBPM = sen11574_hr;
         lastReportedBPMTime = millis();
     }
@@ -1237,126 +1893,1279 @@ void updateVitals() {
         else if (lastSen > 0)
             fusedBPM = lastSen;
         if (fusedBPM > 0) {
-            currentVitals.heartRate = fusedBPM;
-            currentVitals.hrQuality = 25;
-            currentVitals.hrSource = (lastMax > 0 && lastSen > 0) ? "Fused" : "Held";
+            currentVitals.set(currentVitals.heartRate, fusedBPM, VF_HEART_RATE);
+            currentVitals.set(currentVitals.hrQuality, 25, VF_HR_QUALITY);
+            currentVitals.set(currentVitals.hrSource, (lastMax > 0 && lastSen > 0) ? "Fused" : "Held", VF_HR_SOURCE);
             lastReportedBPM = fusedBPM;
             lastReportedBPMTime = millis();
         } else if (lastReportedBPM > 0 && (millis() - lastReportedBPMTime) < BPM_HOLD_MS) {
-            currentVitals.heartRate = lastReportedBPM;
-            currentVitals.hrQuality = 25;
-            currentVitals.hrSource = "Held";
+            currentVitals.set(currentVitals.heartRate, lastReportedBPM, VF_HEART_RATE);
+            currentVitals.set(currentVitals.hrQuality, 25, VF_HR_QUALITY);
+            currentVitals.set(currentVitals.hrSource, "Held", VF_HR_SOURCE);
         } else {
-            currentVitals.heartRate = 0;
-            currentVitals.hrQuality = 0;
-            currentVitals.hrSource = "NONE";
+            currentVitals.set(currentVitals.heartRate, 0, VF_HEART_RATE);
+            currentVitals.set(currentVitals.hrQuality, 0, VF_HR_QUALITY);
+            currentVitals.set(currentVitals.hrSource, "NONE", VF_HR_SOURCE);
         }
     }
     
     // --- SpO2 PRIORITY: MAX30102 ---
     // MAX30102 is the primary sensor for SpO2
     if (max30102_spo2 > 0 && max30102_spo2Quality >= MIN_QUALITY_THRESHOLD) {
-        currentVitals.spo2 = max30102_spo2;
-        currentVitals.spo2Quality = max30102_spo2Quality;
-        currentVitals.spo2Source = "MAX30102";
+        currentVitals.set(currentVitals.spo2, max30102_spo2, VF_SPO2);
+        currentVitals.set(currentVitals.spo2Quality, max30102_spo2Quality, VF_SPO2_QUALITY);
+        currentVitals.set(currentVitals.spo2Source, "MAX30102", VF_SPO2_SOURCE);
     }
     else if (sen11574_spo2 > 0 && sen11574_spo2Quality >= MIN_QUALITY_THRESHOLD) {
-        currentVitals.spo2 = sen11574_spo2;
-        currentVitals.spo2Quality = sen11574_spo2Quality;
-        currentVitals.spo2Source = "SEN11574 (Est)";
+        currentVitals.set(currentVitals.spo2, sen11574_spo2, VF_SPO2);
+        currentVitals.set(currentVitals.spo2Quality, sen11574_spo2Quality, VF_SPO2_QUALITY);
+        currentVitals.set(currentVitals.spo2Source, "SEN11574 (Est)", VF_SPO2_SOURCE);
     }
     else {
-        currentVitals.spo2 = 0;
-        currentVitals.spo2Quality = 0;
-        currentVitals.spo2Source = "NONE";
+        currentVitals.set(currentVitals.spo2, 0, VF_SPO2);
+        currentVitals.set(currentVitals.spo2Quality, 0, VF_SPO2_QUALITY);
+        currentVitals.set(currentVitals.spo2Source, "NONE", VF_SPO2_SOURCE);
+    }
+    
+    if (currentVitals.hrSource == "SEN11574") {
+        currentVitals.sampleUs = pulseSensor.getLastSampleUs();
+        currentVitals.beatUs = pulseSensor.getLastBeatUs();
+    } else {
+        currentVitals.sampleUs = max30102Sensor.getLastSampleUs();
+        currentVitals.beatUs = max30102Sensor.getLastBeatUs();
     }
     
     // Get temperature
     TemperatureSensor::TempReading tempReading = tempSensor.getTemperature(currentVitals.heartRate);
-    currentVitals.temperature = tempReading.celsius;
-    currentVitals.tempEstimated = tempReading.isEstimated;
-    currentVitals.tempSource = tempReading.source;
+    currentVitals.setTemperature(tempReading.celsius);
+    currentVitals.set(currentVitals.tempEstimated, tempReading.isEstimated, VF_TEMP_SOURCE);
+    currentVitals.set(currentVitals.tempSource, tempReading.source, VF_TEMP_SOURCE);
+    currentVitals.set(currentVitals.tempPredicted, tempReading.isPredicted, VF_TEMP_SOURCE);
+    if (lroundf(tempReading.band * 10) != lroundf(currentVitals.tempBand * 10)) currentVitals.dirty |= VF_TEMP_SOURCE;
+    currentVitals.tempBand = tempReading.band;
+}
+
+// ==================== VITAL ROLLUPS ====================
+// Percentiles of HR, SpO2 and beat-to-beat interval without keeping any
+// history: each quantile is a P2 estimator (Jain & Chlamtac 1985), five
+// markers whose heights are nudged along a parabola as samples arrive.
+// Sketches (include/p2_quantile.h) cover ROLLUP_WINDOW_MS; a closed window
+// is reported in keyframes and trains the resting HR baseline (persisted as
+// "resting_hr").
+class VitalRollups {
+public:
+    struct Summary {
+        float p[3];      // p5, p50, p95
+        uint32_t n;
+    };
+    
+private:
+    QuantileSketch hr, spo2, ibi;
+    Summary closed[3];   // last closed window: hr, spo2, ibi
+    bool haveClosed;
+    unsigned long windowStart;
+    unsigned long closedAt;
+    float restingHR;
+    bool learned;        // baseline updated since boot
+    
+    static Summary summarize(QuantileSketch& s) {
+        Summary out;
+        out.p[0] = s.lo.value();
+        out.p[1] = s.mid.value();
+        out.p[2] = s.hi.value();
+        out.n = s.count();
+        return out;
+    }
+    
+    // Only calm windows count as rest; the baseline drops quickly toward a
+    // lower p5 (sleep, recovery) and rises slowly so a fever or a busy day
+    // does not drag it up.
+    void learnResting(const Summary& h) {
+        if (h.n < RESTING_MIN_SAMPLES || h.p[2] - h.p[0] > RESTING_MAX_SPREAD) return;
+        float alpha = h.p[0] < restingHR ? RESTING_ALPHA_DOWN : RESTING_ALPHA_UP;
+        restingHR += alpha * (h.p[0] - restingHR);
+        learned = true;
+        tempSensor.setRestingHR(restingHR);
+        
+        if (fabsf(restingHR - config.get<CFG_RESTING_HR>()) >= RESTING_PERSIST_DELTA) {
+            config.set<CFG_RESTING_HR>(restingHR);
+        }
+    }
+    
+    void closeWindow() {
+        closed[0] = summarize(hr);
+        closed[1] = summarize(spo2);
+        closed[2] = summarize(ibi);
+        haveClosed = closed[0].n > 0 || closed[1].n > 0;
+        closedAt = millis();
+        learnResting(closed[0]);
+        hr.reset();
+        spo2.reset();
+        ibi.reset();
+    }
+    
+    static void addSummary(JsonObject obj, const char* key, const Summary& s) {
+        if (s.n == 0) return;
+        JsonArray a = obj.createNestedArray(key);
+        for (int i = 0; i < 3; i++) a.add(lroundf(s.p[i] * 10) / 10.0);
+    }
+    
+public:
+    VitalRollups() : haveClosed(false), windowStart(0), closedAt(0), restingHR(70.0),
+                     learned(false) {}
+    
+    void begin() {
+        reloadBaseline();
+        windowStart = millis();
+    }
+    
+    // After the stored baseline was changed from outside (console)
+    void reloadBaseline() {
+        restingHR = config.get<CFG_RESTING_HR>();
+        tempSensor.setRestingHR(restingHR);
+    }
+    
+    // Once per updateVitals(): only readings the uplink would call valid.
+    void addVitals() {
+        if (currentVitals.heartRate > 0 && currentVitals.hrQuality >= MIN_QUALITY_THRESHOLD) {
+            hr.add(currentVitals.heartRate);
+        }
+        if (currentVitals.spo2 > 0 && currentVitals.spo2Quality >= MIN_QUALITY_THRESHOLD) {
+            spo2.add(currentVitals.spo2);
+        }
+        if (millis() - windowStart >= ROLLUP_WINDOW_MS) {
+            closeWindow();
+            windowStart = millis();
+        }
+    }
+    
+    // Beats from the sensor currently providing HR only, so the two
+    // detectors are never mixed in one distribution.
+    void addBeat(const char* source, unsigned long ibiMs) {
+        if (currentVitals.hrSource == source) ibi.add(ibiMs);
+    }
+    
+    float getRestingHR() { return restingHR; }
+    
+    void addTo(JsonObject obj) {
+        obj["resting_hr"] = lroundf(restingHR * 10) / 10.0;
+        obj["resting_learned"] = learned;
+        if (!haveClosed) return;
+        obj["window_s"] = ROLLUP_WINDOW_MS / 1000;
+        obj["age_s"] = (millis() - closedAt) / 1000;
+        addSummary(obj, "hr", closed[0]);
+        addSummary(obj, "spo2", closed[1]);
+        addSummary(obj, "ibi_ms", closed[2]);
+        obj["hr_n"] = closed[0].n;
+        obj["spo2_n"] = closed[1].n;
+        obj["ibi_n"] = closed[2].n;
+    }
+};
+
+VitalRollups rollups;
+
+void rollupBeat(const char* source, unsigned long ibiMs) { rollups.addBeat(source, ibiMs); }
+
+// ==================== OXYGEN DESATURATION ====================
+#include "desat_detector.h"
+
+DesatDetector desat;
+
+void desatStartSession() { desat.startSession(); }
+
+// Once per updateVitals(), with the same validity rule as the rollups
+void desatAddVitals() {
+    bool valid = currentVitals.spo2 > 0 && currentVitals.spo2Quality >= MIN_QUALITY_THRESHOLD;
+    desat.addReading(valid ? currentVitals.spo2 : 0);
+}
+
+// Events after `after` (an eventCount() value) still held, flattened as
+// [age_s, duration_s, nadir, drop, ...]. Returns the count covered.
+uint32_t addDesatEventsTo(JsonObject obj, uint32_t after) {
+    uint32_t total = desat.eventCount();
+    uint32_t first = desat.firstHeld(after);
+    if (first >= total) return total;
+    obj["first"] = first;
+    obj["dropped"] = first - after;
+    obj["odi"] = lroundf(desat.getODI() * 10) / 10.0;
+    obj["odi_1h"] = lroundf(desat.getHourODI() * 10) / 10.0;
+    JsonArray a = obj.createNestedArray("events");
+    for (uint32_t i = first; i < total; i++) {
+        const DesatEvent& e = desat.event(i);
+        a.add((millis() - e.startMs) / 1000);
+        a.add(e.durationS);
+        a.add(e.nadir);
+        a.add(e.dropPct);
+    }
+    return total;
+}
+
+void addDesatTo(JsonObject obj) {
+    obj["odi"] = lroundf(desat.getODI() * 10) / 10.0;
+    obj["events"] = desat.getSessionEvents();
+    obj["valid_min"] = desat.getSessionValidS() / 60;
+    obj["odi_1h"] = lroundf(desat.getHourODI() * 10) / 10.0;
+    obj["events_1h"] = desat.getHourEvents();
+    obj["valid_min_1h"] = desat.getHourValidS() / 60;
+    obj["baseline"] = lroundf(desat.getBaseline() * 10) / 10.0;
+    obj["in_dip"] = desat.isInDip();
+}
+
+// ==================== PAYLOAD COMPRESSION ====================
+// crc32Update() and the gzip writer live in gzip_encoder.h, shared with the
+// host benchmark (host/gzip_bench.cpp) and tests.
+GzipEncoder gzipEncoder;
+
+// Picks the deflate effort from what the device can spare right now: TLS
+// needs heap headroom, and a busy loop means acquisition is already tight.
+int chooseCompressionLevel() {
+    uint32_t freeHeap = ESP.getFreeHeap();
+    if (freeHeap < 30000 || loopLoad > 0.6f) return 1;
+    if (freeHeap < 60000 || loopLoad > 0.3f) return 2;
+    return 3;
+}
+
+// ==================== OFFLINE VITALS LOG ====================
+// Fixed-size records appended every cloud-sync tick, online or not. Records
+// are staged in RAM and written to LittleFS one block at a time, alternating
+// between two segment files so the oldest segment is dropped when full.
+// VitalsRecord and its batch JSON are in vitals_record.h.
+class VitalsLog {
+private:
+    static const int STAGE_RECORDS = 32;
+    static const uint32_t SEGMENT_RECORDS = 24576;   // 384 KB, ~34 h at 5 s
+    
+    bool fsReady;
+    VitalsRecord stage[STAGE_RECORDS];
+    int staged;
+    uint32_t nextSeq;
+    int activeSeg;
+    uint32_t segBase[2];
+    uint32_t segCount[2];
+    
+    static const char* segPath(int seg) { return seg ? "/vlog1.bin" : "/vlog0.bin"; }
+    
+    void loadSegment(int seg) {
+        segBase[seg] = 0;
+        segCount[seg] = 0;
+        File f = LittleFS.open(segPath(seg), "r");
+        if (!f) return;
+        VitalsRecord first;
+        if (f.read((uint8_t*)&first, sizeof(first)) == sizeof(first)) {
+            segBase[seg] = first.seq;
+            segCount[seg] = f.size() / sizeof(VitalsRecord);
+        }
+        f.close();
+    }
+    
+    uint32_t readFromSegment(int seg, uint32_t from, VitalsRecord* dst, uint32_t maxCount) {
+        if (segCount[seg] == 0 || from < segBase[seg] || from >= segBase[seg] + segCount[seg]) return 0;
+        uint32_t n = min(maxCount, segBase[seg] + segCount[seg] - from);
+        File f = LittleFS.open(segPath(seg), "r");
+        if (!f) return 0;
+        f.seek((from - segBase[seg]) * sizeof(VitalsRecord));
+        size_t got = f.read((uint8_t*)dst, n * sizeof(VitalsRecord));
+        f.close();
+        return got / sizeof(VitalsRecord);
+    }
+    
+public:
+    VitalsLog() : fsReady(false), staged(0), nextSeq(1), activeSeg(0) {
+        segBase[0] = segBase[1] = 0;
+        segCount[0] = segCount[1] = 0;
+    }
+    
+    void begin() {
+        fsReady = LittleFS.begin(true);
+        if (!fsReady) {
+            Serial.println(F("VitalsLog: LittleFS unavailable, RAM only"));
+            return;
+        }
+        loadSegment(0);
+        loadSegment(1);
+        activeSeg = (segBase[1] > segBase[0]) ? 1 : 0;
+        if (segCount[activeSeg] > 0) {
+            nextSeq = segBase[activeSeg] + segCount[activeSeg];
+            // Records staged but not flushed before the reset are gone; burn
+            // their sequence numbers so the server never sees one reused.
+            VitalsRecord gap = {};
+            gap.flags = VR_GAP;
+            for (int i = 0; i < STAGE_RECORDS; i++) append(gap);
+            flush();
+        }
+    }
+    
+    uint32_t append(const VitalsRecord& rec) {
+        if (staged == STAGE_RECORDS) flush();
+        stage[staged] = rec;
+        stage[staged].seq = nextSeq;
+        staged++;
+        return nextSeq++;
+    }
+    
+    void flush() {
+        if (staged == 0) return;
+        if (!fsReady) {
+            staged = 0;   // nowhere to keep them
+            return;
+        }
+        if (segCount[activeSeg] + staged > SEGMENT_RECORDS) {
+            activeSeg ^= 1;
+            LittleFS.remove(segPath(activeSeg));
+            segCount[activeSeg] = 0;
+        }
+        File f = LittleFS.open(segPath(activeSeg), "a");
+        if (f) {
+            f.write((const uint8_t*)stage, staged * sizeof(VitalsRecord));
+            f.close();
+            if (segCount[activeSeg] == 0) segBase[activeSeg] = stage[0].seq;
+            segCount[activeSeg] += staged;
+        }
+        staged = 0;
+    }
+    
+    uint32_t oldestSeq() {
+        int older = activeSeg ^ 1;
+        if (segCount[older] > 0) return segBase[older];
+        if (segCount[activeSeg] > 0) return segBase[activeSeg];
+        return nextSeq - staged;
+    }
+    
+    uint32_t newestSeq() { return nextSeq - 1; }
+    
+    // Copies up to maxCount consecutive records starting at seq `from`.
+    uint32_t read(uint32_t from, VitalsRecord* dst, uint32_t maxCount) {
+        if (from < oldestSeq()) from = oldestSeq();
+        uint32_t n = 0;
+        if (fsReady) {
+            n += readFromSegment(activeSeg ^ 1, from, dst, maxCount);
+            n += readFromSegment(activeSeg, from + n, dst + n, maxCount - n);
+        }
+        uint32_t stageBase = nextSeq - staged;
+        for (uint32_t s = from + n; n < maxCount && s < nextSeq; s++, n++) {
+            if (s < stageBase) break;
+            dst[n] = stage[s - stageBase];
+        }
+        return n;
+    }
+};
+
+VitalsLog vitalsLog;
+
+uint32_t currentTimestamp() {
+    if (timeInitialized) {
+        time_t now;
+        time(&now);
+        return (uint32_t)now;
+    }
+    return bootTimestamp + (millis() / 1000);
+}
+
+uint32_t logVitalsRecord() {
+    VitalsRecord rec;
+    rec.seq = 0;
+    rec.timestamp = currentTimestamp();
+    rec.heartRate = constrain(currentVitals.heartRate, 0, 255);
+    rec.hrQuality = constrain(currentVitals.hrQuality, 0, 100);
+    rec.spo2 = constrain(currentVitals.spo2, 0, 100);
+    rec.spo2Quality = constrain(currentVitals.spo2Quality, 0, 100);
+    rec.tempCenti = (int16_t)lroundf(currentVitals.temperature * 100);
+    rec.flags = (currentVitals.tempEstimated ? VR_TEMP_ESTIMATED : 0) |
+                (currentVitals.hasAlert ? VR_ALERT : 0) |
+                (currentVitals.isCriticalAlert ? VR_CRITICAL : 0);
+    rec.reserved = 0;
+    return vitalsLog.append(rec);
+}
+
+// ==================== OFFLINE BACKLOG ====================
+// Records whose live upload did not land stay in the vitals log until the
+// server confirms them through the history sync below.
+uint32_t backlogFrom = 1;            // first seq not yet confirmed by the server
+
+VitalsRecord batchRecords[BACKLOG_BATCH_RECORDS];
+char batchBody[BACKLOG_BUFFER_SIZE];
+uint8_t batchGzip[BACKLOG_BUFFER_SIZE];
+
+// Write-behind: backlog_from flushes within CONFIG_BACKLOG_FLUSH_MS, so a
+// crash only resends a few records the server already has (a clean restart
+// flushes it at once).
+void commitBacklogFrom() {
+    config.set<CFG_BACKLOG_FROM>(backlogFrom);
+}
+
+// Live uploads acknowledged ahead of backlogFrom (the backlog is older, or an
+// earlier live upload failed). History sync skips them, and backlogFrom
+// moves over them once the gap before them is filled. Bit seq % SIZE is
+// valid for seq in [base, base + SIZE); acks further ahead are not kept and
+// are only sent again.
+class AckedWindow {
+private:
+    static const uint32_t SIZE = 4096;   // 512 bytes, ~5.7 h of 5 s records
+    uint32_t bits[SIZE / 32];
+    uint32_t base;
+    
+    void clear(uint32_t seq) { bits[(seq % SIZE) / 32] &= ~(1u << (seq % 32)); }
+    
+public:
+    AckedWindow() : base(1) { memset(bits, 0, sizeof(bits)); }
+    
+    void reset(uint32_t from) {
+        memset(bits, 0, sizeof(bits));
+        base = from;
+    }
+    
+    void mark(uint32_t seq) {
+        if (seq - base < SIZE) bits[(seq % SIZE) / 32] |= 1u << (seq % 32);
+    }
+    
+    bool has(uint32_t seq) {
+        return seq - base < SIZE && (bits[(seq % SIZE) / 32] & (1u << (seq % 32)));
+    }
     
-    currentVitals.hasChanged = true;
+    // Moves the base to `from` and then over any run of acked records;
+    // returns the new base.
+    uint32_t advance(uint32_t from) {
+        if (from - base >= SIZE) reset(from);
+        while (base != from) clear(base++);
+        while (has(base)) clear(base++);
+        return base;
+    }
+};
+
+AckedWindow liveAcked;
+
+void advanceBacklogFrom(uint32_t next) {
+    if ((int32_t)(next - backlogFrom) <= 0) return;
+    backlogFrom = liveAcked.advance(next);
+    commitBacklogFrom();
+}
+
+void noteLiveAck(uint32_t seq) {
+    if (seq == backlogFrom) advanceBacklogFrom(seq + 1);
+    else if ((int32_t)(seq - backlogFrom) > 0) liveAcked.mark(seq);
+}
+
+// ==================== UPLINK SCHEDULER ====================
+#include "uplink_scheduler.h"
+
+UplinkScheduler uplink;
+
+// Per class: [queued, done, failed, coalesced, dropped, bytes, max_wait_ms, depth]
+const size_t UPLINK_QOS_JSON_SIZE = JSON_OBJECT_SIZE(UC_COUNT) + UC_COUNT * JSON_ARRAY_SIZE(8);
+
+void addUplinkQosTo(JsonObject obj) {
+    for (int c = 0; c < UC_COUNT; c++) {
+        const UplinkScheduler::Queue& Q = uplink.queue((UplinkClass)c);
+        JsonArray a = obj.createNestedArray(UPLINK_CLASS_NAMES[c]);
+        a.add(Q.queued);
+        a.add(Q.done);
+        a.add(Q.failed);
+        a.add(Q.coalesced);
+        a.add(Q.dropped);
+        a.add(Q.bytes);
+        a.add(Q.maxWaitMs);
+        a.add(Q.len);
+    }
 }
 
+// ==================== ALERT WAVEFORM CAPTURE ====================
+#if CAPTURE_ENABLED
+#include "alert_capture.h"
+
+AlertCapture alertCapture;
+
+void captureFrozen() { radio.wakeNow(); }
+void captureSample(uint32_t red, uint32_t ir) { alertCapture.addSample(red, ir); }
+void captureGap() { alertCapture.addGap(); }
+
+void addCaptureTo(JsonObject obj) {
+    obj["triggered"] = alertCapture.getTriggered();
+    obj["uploaded"] = alertCapture.getUploaded();
+    obj["failed"] = alertCapture.getFailed();
+    obj["missed"] = alertCapture.getMissed();
+    obj["clipped"] = alertCapture.getClipped();
+    obj["pending"] = alertCapture.getState() != AlertCapture::ARMED;
+}
+
+// Posts a frozen capture as an alert-class job, regardless of the live
+// uplink's backoff. Retries are paced by the capture itself.
+UplinkResult sendAlertCapture() {
+    if (!alertCapture.isFrozen()) return UJ_DONE;
+    if (!alertCapture.due() || WiFi.status() != WL_CONNECTED) return UJ_WAIT;
+    
+    size_t len = alertCapture.serialize((uint8_t*)batchBody, sizeof(batchBody));
+    HTTPClient http;
+    http.setTimeout(10000);
+    String url = API_BASE_URL + String("/health/devices/") + deviceID + String(CAPTURE_ENDPOINT);
+    if (len == 0 || !http.begin(url)) {
+        alertCapture.finish(false);
+        return alertCapture.isFrozen() ? UJ_KEEP : UJ_FAILED;
+    }
+    
+    char hdr[12];
+    http.addHeader("Content-Type", "application/octet-stream");
+    snprintf(hdr, sizeof(hdr), "%lu", (unsigned long)alertCapture.getId());
+    http.addHeader("X-Capture-Id", hdr);
+    uint32_t onsetAgeS = (micros() - alertCapture.getOnsetUs()) / 1000000UL;
+    snprintf(hdr, sizeof(hdr), "%lu", (unsigned long)(currentTimestamp() - onsetAgeS));
+    http.addHeader("X-Alert-Onset", hdr);
+    snprintf(hdr, sizeof(hdr), "%08lx", (unsigned long)crc32Update(0, (const uint8_t*)batchBody, len));
+    http.addHeader("X-Capture-CRC32", hdr);
+    
+    uint32_t sendUs = micros();
+    int httpCode = http.POST((uint8_t*)batchBody, len);
+    energy.noteRadioBurst(micros() - sendUs);
+    uplinkTxBytes += len;
+    http.end();
+    
+    bool ok = httpCode == 200 || httpCode == 201;
+    alertCapture.finish(ok);
+    if (ok) return UJ_DONE;
+    return alertCapture.isFrozen() ? UJ_KEEP : UJ_FAILED;
+}
+
+#else
+
+void captureSample(uint32_t, uint32_t) {}
+void captureGap() {}
+
+#endif
+
 // ==================== CLOUD SYNC ====================
-void sendToCloud() {
-    if (WiFi.status() != WL_CONNECTED) return;
+// Uploads are deltas against the last payload the server acknowledged:
+// only fields in uplinkDirty are sent. Every CLOUD_KEYFRAME_EVERY uploads,
+// after a state change, or when the server answers 409 (baseline lost) a
+// full keyframe is sent instead. Field values are absolute, so resending a
+// delta whose ack was lost is harmless.
+uint32_t uplinkSeq = 0;
+uint32_t uplinkAckedSeq = 0;
+int uploadsSinceKeyframe = CLOUD_KEYFRAME_EVERY;
+MonitoringState lastUploadedState = STATE_IDLE;
+uint32_t morphAckedBeats = 0;   // pulse morphology records the server holds
+uint32_t desatAckedEvents = 0;  // desaturation events the server holds
+
+// Failure accounting shared by every uplink request. Transport errors, 5xx
+// and 429 back off exponentially (or per Retry-After); while backing off the
+// record stays in the vitals log and reaches the server via history sync.
+struct UplinkStats {
+    uint32_t acked = 0;
+    uint32_t transportErrors = 0;   // connect/TLS/timeout (negative HTTPClient codes)
+    uint32_t serverErrors = 0;      // 5xx and 429
+    uint32_t rejected = 0;          // other 4xx: payload refused, not retried live
+};
+
+UplinkStats uplinkStats;
+unsigned long uplinkBackoffUntil = 0;
+unsigned long uplinkBackoffMs = 0;
+
+void noteUplinkSuccess() {
+    uplinkStats.acked++;
+    uplinkBackoffMs = 0;
+}
+
+void noteUplinkFailure(int httpCode, unsigned long retryAfterMs = 0) {
+    if (httpCode >= 400 && httpCode < 500 && httpCode != 429) {
+        uplinkStats.rejected++;
+        return;
+    }
+    if (httpCode < 0) uplinkStats.transportErrors++;
+    else uplinkStats.serverErrors++;
+    
+    uplinkBackoffMs = uplinkBackoffMs ? min(uplinkBackoffMs * 2, (unsigned long)UPLINK_BACKOFF_MAX_MS)
+                                      : (unsigned long)UPLINK_BACKOFF_MIN_MS;
+    unsigned long wait = max(uplinkBackoffMs, retryAfterMs);
+    uplinkBackoffUntil = millis() + wait;
+}
+
+bool uplinkBackingOff() {
+    return uplinkBackoffMs > 0 && (long)(millis() - uplinkBackoffUntil) < 0;
+}
+
+// An urgent upload (critical alert) goes out even while backing off.
+bool sendToCloud(bool urgent = false) {
+    if (WiFi.status() != WL_CONNECTED || (!urgent && uplinkBackingOff())) return false;
     
     HTTPClient http;
     http.setTimeout(5000);
     
     String url = API_BASE_URL + String(VITALS_ENDPOINT);
-    if (!http.begin(url)) return;
+    if (!http.begin(url)) {
+        noteUplinkFailure(-1);
+        return false;
+    }
     
+    static const char* RESPONSE_HEADERS[] = {"Retry-After"};
+    http.collectHeaders(RESPONSE_HEADERS, 1);
     http.addHeader("Content-Type", "application/json");
     
-    DynamicJsonDocument doc(1024);
-    doc["device_id"] = deviceID;
+    bool keyframe = !CLOUD_DELTA_UPLOADS || uploadsSinceKeyframe >= CLOUD_KEYFRAME_EVERY ||
+                    uplinkAckedSeq == 0 || monitoringState != lastUploadedState;
+    uint16_t fields = keyframe ? (uint16_t)VF_ALL : uplinkDirty;
     
-    if (timeInitialized) {
-        time_t now;
-        time(&now);
-        doc["timestamp"] = now;
-    } else {
-        doc["timestamp"] = bootTimestamp + (millis() / 1000);
+    TraceRecord trace;
+    trace.sampleUs = currentVitals.sampleUs;
+    trace.beatUs = currentVitals.beatUs;
+    trace.publishUs = currentVitals.publishUs;
+    trace.serializeUs = micros();
+    
+    DynamicJsonDocument doc(8192);
+    doc["device_id"] = deviceID;
+    doc["timestamp"] = currentTimestamp();
+    
+    uint32_t seq = ++uplinkSeq;
+    trace.seq = seq;
+    doc["seq"] = seq;
+    if (!keyframe) {
+        doc["delta"] = true;
+        doc["base_seq"] = uplinkAckedSeq;
     }
     
     JsonObject vitals = doc.createNestedObject("vitals");
     
-    JsonObject hr = vitals.createNestedObject("heart_rate");
-    hr["bpm"] = currentVitals.heartRate;
-    hr["signal_quality"] = currentVitals.hrQuality;
-    hr["is_valid"] = (currentVitals.heartRate > 0 && currentVitals.hrQuality > MIN_QUALITY_THRESHOLD);
-    hr["source"] = currentVitals.hrSource;
-    
-    JsonObject spo2 = vitals.createNestedObject("spo2");
-    spo2["percent"] = currentVitals.spo2;
-    spo2["signal_quality"] = currentVitals.spo2Quality;
-    spo2["is_valid"] = (currentVitals.spo2 > 0 && currentVitals.spo2Quality > MIN_QUALITY_THRESHOLD);
-    spo2["source"] = currentVitals.spo2Source;
-    
-    JsonObject temp = vitals.createNestedObject("temperature");
-    temp["celsius"] = currentVitals.temperature;
-    temp["source"] = currentVitals.tempSource;
-    temp["is_estimated"] = currentVitals.tempEstimated;
-    
-    JsonObject sys = doc.createNestedObject("system");
-    sys["wifi_rssi"] = WiFi.RSSI();
-    sys["uptime_seconds"] = millis() / 1000;
-    sys["monitoring_state"] = monitoringStateStr;
-    sys["free_heap"] = ESP.getFreeHeap();
-    sys["firmware_version"] = FIRMWARE_VERSION;
+    if (fields & (VF_HEART_RATE | VF_HR_QUALITY | VF_HR_SOURCE)) {
+        JsonObject hr = vitals.createNestedObject("heart_rate");
+        if (fields & (VF_HEART_RATE | VF_HR_QUALITY)) {
+            hr["bpm"] = currentVitals.heartRate;
+            hr["signal_quality"] = currentVitals.hrQuality;
+            hr["is_valid"] = (currentVitals.heartRate > 0 && currentVitals.hrQuality > MIN_QUALITY_THRESHOLD);
+        }
+        if (fields & VF_HR_SOURCE) hr["source"] = currentVitals.hrSource;
+    }
+    
+    if (fields & (VF_SPO2 | VF_SPO2_QUALITY | VF_SPO2_SOURCE)) {
+        JsonObject spo2 = vitals.createNestedObject("spo2");
+        if (fields & (VF_SPO2 | VF_SPO2_QUALITY)) {
+            spo2["percent"] = currentVitals.spo2;
+            spo2["signal_quality"] = currentVitals.spo2Quality;
+            spo2["is_valid"] = (currentVitals.spo2 > 0 && currentVitals.spo2Quality > MIN_QUALITY_THRESHOLD);
+        }
+        if (fields & VF_SPO2_SOURCE) spo2["source"] = currentVitals.spo2Source;
+    }
+    
+    if (fields & (VF_TEMPERATURE | VF_TEMP_SOURCE)) {
+        JsonObject temp = vitals.createNestedObject("temperature");
+        if (fields & VF_TEMPERATURE) temp["celsius"] = lroundf(currentVitals.temperature * 10) / 10.0;
+        if (fields & VF_TEMP_SOURCE) {
+            temp["source"] = currentVitals.tempSource;
+            temp["is_estimated"] = currentVitals.tempEstimated;
+            temp["is_predicted"] = currentVitals.tempPredicted;
+            if (currentVitals.tempPredicted) temp["band"] = lroundf(currentVitals.tempBand * 10) / 10.0;
+        }
+    }
+    
+    // Beat features not yet acknowledged ride along with every upload
+    uint32_t morphSent = morphAckedBeats;
+    if (max30102Sensor.getMorphology().beatCount() > morphAckedBeats) {
+        morphSent = addMorphologyTo(doc.createNestedObject("pulse"), morphAckedBeats);
+    }
+    uint32_t desatSent = desatAckedEvents;
+    if (desat.eventCount() > desatAckedEvents) {
+        desatSent = addDesatEventsTo(doc.createNestedObject("desat"), desatAckedEvents);
+    }
+    
+    if (keyframe) {
+        JsonObject sys = doc.createNestedObject("system");
+        sys["wifi_rssi"] = WiFi.RSSI();
+        sys["uptime_seconds"] = millis() / 1000;
+        sys["monitoring_state"] = monitoringStateStr;
+        sys["free_heap"] = ESP.getFreeHeap();
+        sys["firmware_version"] = FIRMWARE_VERSION;
+        if (battery.isPresent()) {
+            sys["battery_percent"] = battery.getPercent();
+            sys["battery_voltage"] = lroundf(battery.getVoltage() * 100) / 100.0;
+        }
+        sys["power_tier"] = POWER_TIER_NAMES[battery.getTier()];
+        energy.addTo(sys.createNestedObject("energy"), battery.isPresent() ? battery.getPercent() : -1);
+        rollups.addTo(sys.createNestedObject("rollup"));
+        addRhythmTo(sys.createNestedObject("rhythm"));
+        addDesatTo(sys.createNestedObject("desat"));
+        addMax30102FifoTo(sys.createNestedObject("max30102_fifo"));
+        addRadioTo(sys.createNestedObject("radio"));
+#if CAPTURE_ENABLED
+        addCaptureTo(sys.createNestedObject("capture"));
+#endif
+        
+        JsonObject up = sys.createNestedObject("uplink");
+        addUplinkQosTo(up.createNestedObject("qos"));
+        up["acked"] = uplinkStats.acked;
+        up["transport_errors"] = uplinkStats.transportErrors;
+        up["server_errors"] = uplinkStats.serverErrors;
+        up["rejected"] = uplinkStats.rejected;
+        up["backlog"] = vitalsLog.newestSeq() + 1 - backlogFrom;
+        
+        JsonObject lat = sys.createNestedObject("latency_ms");
+        for (int st = 0; st < TS_COUNT; st++) {
+            if (latency[st].count() == 0) continue;
+            JsonArray pct = lat.createNestedArray(TRACE_STAGE_NAMES[st]);
+            pct.add(latency[st].percentile(50));
+            pct.add(latency[st].percentile(95));
+            pct.add(latency[st].percentile(99));
+        }
+        lat["critical_total"] = criticalLatency.getTotal();
+        lat["critical_over_2s"] = criticalLatency.getOverBudget();
+    }
+    
+    // Ages at serialization, plus the previous upload's own timings.
+    static uint32_t prevSerializeMs = 0;
+    static uint32_t prevRttMs = 0;
+    JsonObject tr = doc.createNestedObject("trace");
+    addAgeMs(tr, "sample_age_ms", trace.serializeUs, trace.sampleUs);
+    addAgeMs(tr, "beat_age_ms", trace.serializeUs, trace.beatUs);
+    addAgeMs(tr, "publish_age_ms", trace.serializeUs, trace.publishUs);
+    tr["prev_serialize_ms"] = prevSerializeMs;
+    tr["prev_rtt_ms"] = prevRttMs;
     
     if (currentVitals.hasAlert) {
         JsonArray alerts = doc.createNestedArray("alerts");
         JsonObject alert = alerts.createNestedObject();
         
-        if (currentVitals.isCriticalAlert) {
-            alert["type"] = "critical_hypoxia";
-            alert["severity"] = "critical";
-        } else {
-            alert["type"] = "threshold_exceeded";
-            alert["severity"] = "warning";
-        }
+        alert["type"] = currentVitals.alertType;
+        alert["severity"] = currentVitals.isCriticalAlert ? "critical" :
+                            isDeviceAlert(currentVitals.alertType) ? "info" : "warning";
         alert["message"] = currentVitals.alertMessage;
+        alert["onset_age_ms"] = millis() - currentVitals.alertOnsetMs;
+#if CAPTURE_ENABLED
+        uint32_t captureId = alertCapture.idFor(currentVitals.alertOnsetUs);
+        if (captureId) alert["capture_id"] = captureId;
+#endif
+        addAgeMs(alert, "sample_age_ms", trace.serializeUs, trace.sampleUs);
     }
     
     String jsonString;
     serializeJson(doc, jsonString);
     
+    trace.sendUs = micros();
     int httpCode = http.POST(jsonString);
-    
-    if (httpCode == 200 || httpCode == 201) {
+    uplinkTxBytes += jsonString.length();
+    trace.responseUs = micros();
+    energy.noteRadioBurst(trace.responseUs - trace.sendUs);
+    trace.httpCode = httpCode;
+    bool acked = (httpCode == 200 || httpCode == 201);
+    
+    recordTrace(trace);
+    prevSerializeMs = (trace.sendUs - trace.serializeUs) / 1000;
+    prevRttMs = (trace.responseUs - trace.sendUs) / 1000;
+    
+    // First acknowledged upload carrying a critical alert closes its latency.
+    if (acked && currentVitals.isCriticalAlert) criticalLatency.acked(millis());
+    
+    if (acked) {
+        noteUplinkSuccess();
+        uplinkAckedSeq = seq;
+        uplinkDirty &= ~fields;
+        morphAckedBeats = morphSent;
+        desatAckedEvents = desatSent;
+        uploadsSinceKeyframe = keyframe ? 1 : uploadsSinceKeyframe + 1;
+        if (keyframe) lastUploadedState = monitoringState;
+        
         digitalWrite(STATUS_LED, HIGH);
         delay(30);
         digitalWrite(STATUS_LED, LOW);
+    } else if (httpCode == 409) {
+        // Server has no baseline for us (restart, eviction): resync fully.
+        uploadsSinceKeyframe = CLOUD_KEYFRAME_EVERY;
+    } else {
+        noteUplinkFailure(httpCode, http.header("Retry-After").toInt() * 1000UL);
+    }
+    
+    http.end();
+    return acked;
+}
+
+// ==================== HISTORY SYNC ====================
+// Server-driven, resumable backfill from the vitals log. The device
+// advertises the range it holds; the server answers with the range it wants
+// (and how fast). Each chunk carries a CRC32 of the uncompressed body and is
+// acknowledged with the last sequence number the server stored, so a broken
+// transfer resumes where the server left off instead of starting over.
+struct SyncRequest {
+    uint32_t from = 0;
+    uint32_t count = 0;
+    uint32_t maxChunk = BACKLOG_BATCH_RECORDS;
+    unsigned long notBefore = 0;     // server-imposed pacing
+    int crcRetries = 0;
+};
+
+SyncRequest syncRequest;
+unsigned long lastSyncAdvertise = 0;
+bool syncServerOk = true;           // false after a failed advertise: poll at the idle rate
+
+// Advertise and chunk requests share one keep-alive connection, so a
+// drain pays for a single TLS handshake per radio burst instead of one per
+// chunk. It is closed when the burst ends; the server would drop it while
+// the modem sleeps anyway.
+HTTPClient syncHttp;
+bool syncHttpOpen = false;
+
+bool beginSyncRequest(const char* path, uint16_t timeoutMs) {
+    syncHttp.setReuse(true);
+    syncHttp.setTimeout(timeoutMs);
+    String url = API_BASE_URL + String("/health/devices/") + deviceID + String(path);
+    syncHttpOpen = syncHttp.begin(url);
+    return syncHttpOpen;
+}
+
+void closeSyncConnection() {
+    if (!syncHttpOpen) return;
+    syncHttp.setReuse(false);
+    syncHttp.end();
+    syncHttpOpen = false;
+}
+
+void applySyncResponse(const String& response) {
+    DynamicJsonDocument doc(256);
+    if (deserializeJson(doc, response)) return;
+    
+    uint32_t ackedThrough = doc["acked_through"] | 0;
+    advanceBacklogFrom(ackedThrough + 1);
+    
+    if (doc.containsKey("from")) {
+        syncRequest.from = doc["from"] | 0;
+        syncRequest.count = doc["count"] | 0;
+    } else if (ackedThrough >= syncRequest.from && syncRequest.count > 0) {
+        uint32_t done = ackedThrough - syncRequest.from + 1;
+        syncRequest.count = (done >= syncRequest.count) ? 0 : syncRequest.count - done;
+        syncRequest.from = ackedThrough + 1;
+    }
+    syncRequest.maxChunk = constrain((uint32_t)(doc["max_chunk"] | BACKLOG_BATCH_RECORDS), 1u,
+                                     (uint32_t)BACKLOG_BATCH_RECORDS);
+    syncRequest.notBefore = millis() + (uint32_t)(doc["retry_after_ms"] | 0);
+}
+
+bool advertiseHistory() {
+    if (!beginSyncRequest("/sync", 5000)) return false;
+    HTTPClient& http = syncHttp;
+    
+    http.addHeader("Content-Type", "application/json");
+    
+    char body[96];
+    snprintf(body, sizeof(body), "{\"oldest_seq\":%lu,\"newest_seq\":%lu,\"acked_through\":%lu}",
+             (unsigned long)vitalsLog.oldestSeq(), (unsigned long)vitalsLog.newestSeq(),
+             (unsigned long)(backlogFrom - 1));
+    
+    uint32_t sendUs = micros();
+    int httpCode = http.POST(String(body));
+    energy.noteRadioBurst(micros() - sendUs);
+    uplinkTxBytes += strlen(body);
+    if (httpCode == 200) {
+        syncRequest.count = 0;
+        applySyncResponse(http.getString());
+    } else {
+        noteUplinkFailure(httpCode);
+    }
+    
+    http.end();
+    return httpCode == 200;
+}
+
+void sendHistoryChunk() {
+    if (syncRequest.from < vitalsLog.oldestSeq()) {
+        // Overwritten before the server asked for it; skip ahead.
+        uint32_t lost = vitalsLog.oldestSeq() - syncRequest.from;
+        syncRequest.count = (lost >= syncRequest.count) ? 0 : syncRequest.count - lost;
+        syncRequest.from = vitalsLog.oldestSeq();
+    }
+    if (syncRequest.count == 0 || syncRequest.from > vitalsLog.newestSeq()) {
+        syncRequest.count = 0;
+        return;
+    }
+    
+    uint32_t want = min(syncRequest.count, syncRequest.maxChunk);
+    uint32_t count = vitalsLog.read(syncRequest.from, batchRecords, want);
+    if (count == 0) return;
+    for (uint32_t i = 0; i < count; i++) {
+        if (liveAcked.has(batchRecords[i].seq)) batchRecords[i].flags |= VR_LIVE_ACKED;
+    }
+    
+    uint32_t used = 0;
+    size_t len = formatVitalsBatch(batchRecords, count, deviceID.c_str(), batchBody, sizeof(batchBody), used);
+    if (len == 0) {
+        // Only gaps and live-acked records: an empty records array still lets the server ack the range.
+        len = snprintf(batchBody, sizeof(batchBody), "{\"device_id\":\"%s\",\"records\":[]}", deviceID.c_str());
+    }
+    
+    if (!beginSyncRequest("/sync/chunk", 10000)) return;
+    HTTPClient& http = syncHttp;
+    
+    char hdr[12];
+    http.addHeader("Content-Type", "application/json");
+    snprintf(hdr, sizeof(hdr), "%lu", (unsigned long)syncRequest.from);
+    http.addHeader("X-Sync-From", hdr);
+    snprintf(hdr, sizeof(hdr), "%lu", (unsigned long)used);
+    http.addHeader("X-Sync-Count", hdr);
+    snprintf(hdr, sizeof(hdr), "%08lx", (unsigned long)crc32Update(0, (const uint8_t*)batchBody, len));
+    http.addHeader("X-Sync-CRC32", hdr);
+    
+    int httpCode;
+    size_t gzLen = gzipEncoder.compress((const uint8_t*)batchBody, len, batchGzip, sizeof(batchGzip),
+                                        chooseCompressionLevel());
+    uint32_t sendUs = micros();
+    if (gzLen > 0 && gzLen < len) {
+        http.addHeader("Content-Encoding", "gzip");
+        httpCode = http.POST(batchGzip, gzLen);
+        uplinkTxBytes += gzLen;
+    } else {
+        httpCode = http.POST((uint8_t*)batchBody, len);
+        uplinkTxBytes += len;
+    }
+    energy.noteRadioBurst(micros() - sendUs);
+    
+    if (httpCode == 200 || httpCode == 201) {
+        syncRequest.crcRetries = 0;
+        applySyncResponse(http.getString());
+    } else if (httpCode == 422 && ++syncRequest.crcRetries <= 3) {
+        // CRC mismatch on the server side: resend the same range.
+    } else {
+        // Transport or server failure: drop the request; the next advertise
+        // resumes from whatever the server has acknowledged.
+        syncRequest.count = 0;
+        syncRequest.crcRetries = 0;
+        noteUplinkFailure(httpCode);
+    }
+    
+    http.end();
+}
+
+void syncHistory() {
+    if (WiFi.status() != WL_CONNECTED || uplinkBackingOff()) return;
+    if ((long)(millis() - syncRequest.notBefore) < 0) return;
+    
+    if (syncRequest.count == 0) {
+        bool behind = backlogFrom <= vitalsLog.newestSeq();
+        unsigned long interval = (behind && syncServerOk) ? SYNC_ADVERTISE_BEHIND_MS : SYNC_ADVERTISE_IDLE_MS;
+        if (lastSyncAdvertise != 0 && millis() - lastSyncAdvertise < interval) return;
+        lastSyncAdvertise = millis();
+        syncServerOk = advertiseHistory();
+        if (!syncServerOk || syncRequest.count == 0) return;
+    }
+    
+    sendHistoryChunk();
+}
+
+// ==================== UPLINK DISPATCH ====================
+// Periodic diagnostics: the recent upload traces and the queue counters.
+// A full trace ring and the QoS arrays; the slack covers the device id
+// and timestamp strings, which the document copies
+const size_t DIAG_JSON_SIZE = JSON_OBJECT_SIZE(5) + JSON_ARRAY_SIZE(TRACE_RING_SIZE) +
+                              TRACE_RING_SIZE * JSON_ARRAY_SIZE(5) + UPLINK_QOS_JSON_SIZE + 128;
+
+UplinkResult postDiagnostics() {
+    if (WiFi.status() != WL_CONNECTED || uplinkBackingOff()) return UJ_WAIT;
+    
+    DynamicJsonDocument doc(DIAG_JSON_SIZE);
+    doc["device_id"] = deviceID;
+    doc["timestamp"] = currentTimestamp();
+    doc["uptime_s"] = millis() / 1000;
+    // [seq, http, publish-serialize, serialize-send, send-response] (ms), oldest first
+    JsonArray traces = doc.createNestedArray("traces");
+    for (int i = 0; i < TRACE_RING_SIZE; i++) {
+        const TraceRecord& t = traceRing[(traceRingHead + i) % TRACE_RING_SIZE];
+        if (t.seq == 0) continue;
+        JsonArray a = traces.createNestedArray();
+        a.add(t.seq);
+        a.add(t.httpCode);
+        a.add((t.serializeUs - t.publishUs) / 1000);
+        a.add((t.sendUs - t.serializeUs) / 1000);
+        a.add((t.responseUs - t.sendUs) / 1000);
+    }
+    addUplinkQosTo(doc.createNestedObject("qos"));
+    if (doc.overflowed()) {
+        Serial.println(F("Diagnostics: JSON document too small, not sent"));
+        return UJ_FAILED;
     }
     
+    String body;
+    serializeJson(doc, body);
+    
+    HTTPClient http;
+    http.setTimeout(5000);
+    String url = API_BASE_URL + String("/health/devices/") + deviceID + String("/diagnostics");
+    if (!http.begin(url)) return UJ_FAILED;
+    http.addHeader("Content-Type", "application/json");
+    
+    uint32_t sendUs = micros();
+    int httpCode = http.POST(body);
+    energy.noteRadioBurst(micros() - sendUs);
+    uplinkTxBytes += body.length();
     http.end();
+    
+    if (httpCode == 200 || httpCode == 201 || httpCode == 204) return UJ_DONE;
+    noteUplinkFailure(httpCode);
+    return UJ_FAILED;
 }
 
+unsigned long alertRetryAt = 0;
+
+UplinkResult runUplinkJob(UplinkClass c, const UplinkJob& job) {
+    switch (job.kind) {
+        case JOB_VITALS: {
+            bool urgent = (c == UC_ALERT);
+            // An alert upload still waiting for the link when the alert
+            // clears is left to the backfill, so it cannot keep waking the radio
+            if (urgent && !currentVitals.isCriticalAlert && WiFi.status() != WL_CONNECTED) return UJ_FAILED;
+            if (WiFi.status() != WL_CONNECTED || (!urgent && uplinkBackingOff())) return UJ_WAIT;
+            if (urgent && (long)(millis() - alertRetryAt) < 0) return UJ_WAIT;
+            if (!sendToCloud(urgent)) {
+                // A critical alert keeps its place and is retried shortly for
+                // as long as it stands; anything else waits in the log for the
+                // backfill
+                if (urgent && currentVitals.isCriticalAlert) {
+                    alertRetryAt = millis() + UPLINK_ALERT_RETRY_MS;
+                    return UJ_KEEP;
+                }
+                return UJ_FAILED;
+            }
+            if (job.arg != 0) noteLiveAck(job.arg);
+            return UJ_DONE;
+        }
+        case JOB_CAPTURE:
+#if CAPTURE_ENABLED
+            return sendAlertCapture();
+#else
+            return UJ_DONE;
+#endif
+        case JOB_HISTORY: {
+            // Stays queued while the power tier allows backfill; syncHistory()
+            // paces its own advertise/chunk requests
+            if (!battery.policy().historySync) return UJ_DONE;
+            uint32_t before = uplinkTxBytes;
+            syncHistory();
+            return uplinkTxBytes != before ? UJ_KEEP : UJ_WAIT;
+        }
+        case JOB_DIAG:
+            return postDiagnostics();
+    }
+    return UJ_DONE;
+}
+
+// Jobs that follow from device state rather than from a single event
+void feedUplinkQueues() {
+    static unsigned long lastDiag = 0;
+#if CAPTURE_ENABLED
+    if (alertCapture.isFrozen() && !uplink.has(UC_ALERT, JOB_CAPTURE)) uplink.enqueue(UC_ALERT, JOB_CAPTURE);
+#endif
+    if (radio.isAwake() && battery.policy().historySync && !uplink.has(UC_BACKFILL, JOB_HISTORY)) {
+        uplink.enqueue(UC_BACKFILL, JOB_HISTORY);
+    }
+    if (millis() - lastDiag >= UPLINK_DIAG_INTERVAL_MS) {
+        uplink.enqueue(UC_DIAG, JOB_DIAG);
+        lastDiag = millis();
+    }
+}
+
+// Runs the first class, in priority order, whose head job can make a
+// request now. Returns true when the radio burst should stay open.
+bool serviceUplink() {
+    feedUplinkQueues();
+    if (!radio.isAwake()) {
+        closeSyncConnection();
+        if (uplink.alertPending()) radio.wakeNow();
+        return false;
+    }
+    uplink.refill();
+    
+    for (int c = 0; c < UC_COUNT; c++) {
+        UplinkClass cls = (UplinkClass)c;
+        UplinkJob* job = uplink.eligible(cls);
+        if (job == nullptr) continue;
+        uint32_t before = uplinkTxBytes;
+        UplinkResult r = runUplinkJob(cls, *job);
+        uplink.complete(cls, r, uplinkTxBytes - before);
+        if (r != UJ_WAIT) return true;
+    }
+    return uplink.alertPending();
+}
+
+// ==================== LOCAL API ====================
+// Optional bedside API on port 80, advertised over mDNS as _http._tcp:
+//   GET /vitals/latest          current snapshot (same fields as the backend's vitals JSON)
+//   GET /vitals/history?limit=N last N log records, newest last
+//   GET /ws                     WebSocket; pushes the snapshot whenever it changes
+// The server itself is in local_api.h (host-tested over loopback). At most
+// LOCAL_API_MAX_CLIENTS sockets are open at once and each loop pass spends
+// at most LOCAL_API_BUDGET_US servicing them, history responses included,
+// so bedside clients can never starve acquisition. Requests are not
+// authenticated; anything on the LAN can read the vitals.
+#if LOCAL_API_ENABLED
+#include "local_api.h"
+
+size_t formatVitalsSnapshot(char* buf, size_t cap) {
+    char ts[24];
+    isoTimestamp(currentTimestamp(), ts, sizeof(ts));
+    return snprintf(buf, cap,
+                    "{\"device_id\":\"%s\",\"timestamp\":\"%s\",\"heart_rate\":%d,\"hr_quality\":%d,"
+                    "\"hr_source\":\"%s\",\"spo2\":%d,\"spo2_quality\":%d,\"temperature\":%.1f,"
+                    "\"is_temp_estimated\":%s,\"temp_source\":\"%s\",\"wifi_rssi\":%d,"
+                    "\"battery_percent\":%d,\"battery_voltage\":%.2f,"
+                    "\"monitoring_state\":\"%s\",\"alert\":\"%s\",\"is_critical\":%s}",
+                    deviceID.c_str(), ts, currentVitals.heartRate, currentVitals.hrQuality,
+                    currentVitals.hrSource.c_str(), currentVitals.spo2, currentVitals.spo2Quality,
+                    currentVitals.temperature, currentVitals.tempEstimated ? "true" : "false",
+                    currentVitals.tempSource.c_str(), (int)WiFi.RSSI(),
+                    battery.getPercent(), battery.getVoltage(), monitoringStateStr.c_str(),
+                    currentVitals.hasAlert ? currentVitals.alertMessage.c_str() : "",
+                    currentVitals.isCriticalAlert ? "true" : "false");
+}
+
+uint32_t localApiNewestSeq() { return vitalsLog.newestSeq(); }
+
+uint32_t localApiReadHistory(uint32_t from, VitalsRecord* dst, uint32_t maxCount) {
+    return vitalsLog.read(from, dst, maxCount);
+}
+
+LocalApiServer localApi;
+
+void startLocalApi() {
+    if (localApi.isStarted() || WiFi.status() != WL_CONNECTED) return;
+    localApi.begin();
+    
+    String host = "vitalwatch-" + deviceID.substring(deviceID.length() - 3);
+    host.toLowerCase();
+    if (MDNS.begin(host.c_str())) {
+        MDNS.addService("http", "tcp", LOCAL_API_PORT);
+        MDNS.addServiceTxt("http", "tcp", "device_id", deviceID.c_str());
+        MDNS.addServiceTxt("http", "tcp", "ws", "/ws");
+    }
+}
+
+#endif
+
+// ==================== LIVE STREAM ====================
+// Fire-and-forget UDP datagrams to a multicast group so any number of ward
+// displays can watch a bed without the device holding a connection per
+// viewer. Format "HLS1" (36-byte header, little-endian) is documented in
+// health_app/linux/analytics/live_stream.h; keep the two in step.
+#if LIVE_STREAM_ENABLED
+
+class LiveStream {
+private:
+    static const int HEADER_BYTES = 36;
+    static const int ID_BYTES = 20;
+    static const int VITALS_BYTES = 12;
+    
+    WiFiUDP udp;
+    uint32_t seq;
+    unsigned long lastVitalsMs;
+    uint32_t wave[LIVE_STREAM_WAVE_SAMPLES];
+    int waveCount;
+    uint32_t waveStartMs;
+    int gapAt;           // samples in wave[] before a FIFO gap, -1 if none
+    uint32_t gapMs;
+    bool batchGap;       // samples were lost right before the next batch
+    uint8_t packet[HEADER_BYTES + 4 + 4 * LIVE_STREAM_WAVE_SAMPLES];
+    
+    static void put16(uint8_t* p, uint16_t v) { p[0] = v; p[1] = v >> 8; }
+    static void put32(uint8_t* p, uint32_t v) { put16(p, v); put16(p + 2, v >> 16); }
+    
+    uint8_t* header(uint8_t type, uint16_t payload, uint32_t deviceMs) {
+        memset(packet, 0, HEADER_BYTES + payload);
+        memcpy(packet, "HLS1", 4);
+        packet[4] = type;
+        packet[5] = (currentVitals.hasAlert ? 1 : 0) |
+                    (currentVitals.isCriticalAlert ? 2 : 0) |
+                    (currentVitals.tempEstimated ? 4 : 0);
+        put16(packet + 6, payload);
+        put32(packet + 8, seq++);
+        put32(packet + 12, deviceMs);
+        size_t idLen = deviceID.length() < ID_BYTES ? deviceID.length() : ID_BYTES;
+        memcpy(packet + 16, deviceID.c_str(), idLen);
+        return packet + HEADER_BYTES;
+    }
+    
+    void send(size_t len) {
+        uint32_t sendUs = micros();
+        if (udp.beginPacket(LIVE_STREAM_GROUP, LIVE_STREAM_PORT)) {
+            udp.write(packet, len);
+            udp.endPacket();
+        }
+        energy.noteRadioBurst(micros() - sendUs);
+    }
+    
+    void sendVitals() {
+        uint8_t* body = header(1, VITALS_BYTES, millis());
+        body[0] = constrain(currentVitals.heartRate, 0, 255);
+        body[1] = constrain(currentVitals.hrQuality, 0, 100);
+        body[2] = constrain(currentVitals.spo2, 0, 100);
+        body[3] = constrain(currentVitals.spo2Quality, 0, 100);
+        put16(body + 4, (uint16_t)(int16_t)lroundf(currentVitals.temperature * 100));
+        body[6] = battery.isPresent() ? battery.getPercent() : 0;
+        body[7] = monitoringState == STATE_MONITORING ? 1 : monitoringState == STATE_PAUSED ? 2 : 0;
+        body[8] = (uint8_t)(int8_t)constrain(WiFi.RSSI(), -128, 0);
+        send(HEADER_BYTES + VITALS_BYTES);
+    }
+    
+    // Sends the first `count` samples; any after them start the next batch.
+    void sendWaveform(int count) {
+        uint16_t payload = 4 + 4 * count;
+        uint8_t* body = header(2, payload, waveStartMs);
+        if (batchGap) packet[5] |= 8;   // LS_FLAG_GAP
+        put16(body, max30102Sensor.getFifoRate());
+        put16(body + 2, count);
+        for (int i = 0; i < count; i++) put32(body + 4 + 4 * i, wave[i]);
+        send(HEADER_BYTES + payload);
+        batchGap = false;
+        waveCount -= count;
+        memmove(wave, wave + count, waveCount * sizeof(wave[0]));
+    }
+    
+    bool streaming() {
+        return WiFi.status() == WL_CONNECTED && battery.getTier() == POWER_NORMAL;
+    }
+    
+public:
+    LiveStream() : seq(0), lastVitalsMs(0), waveCount(0), waveStartMs(0), gapAt(-1), gapMs(0),
+                   batchGap(false) {}
+    
+    void addSample(uint32_t ir) {
+        if (waveCount == 0) waveStartMs = millis();
+        if (waveCount < LIVE_STREAM_WAVE_SAMPLES) wave[waveCount++] = ir;
+    }
+    
+    // Called from the FIFO reader before the first sample after lost ones.
+    // Two gaps in one batch are reported as one.
+    void addGap() {
+        if (waveCount == 0) batchGap = true;
+        else if (gapAt < 0) {
+            gapAt = waveCount;
+            gapMs = millis();
+        }
+    }
+    
+    // Runs after radio.service(): the hold set here opens the next pass's
+    // burst, and nothing is sent until the scheduler has the radio awake.
+    void service() {
+        radio.hold(streaming());
+        if (!streaming() || !radio.isAwake()) {
+            waveCount = 0;
+            gapAt = -1;
+            return;
+        }
+        if (gapAt >= 0) {
+            sendWaveform(gapAt);
+            gapAt = -1;
+            batchGap = true;
+            waveStartMs = gapMs;
+        }
+        if (waveCount >= LIVE_STREAM_WAVE_SAMPLES) sendWaveform(waveCount);
+        if (millis() - lastVitalsMs >= LIVE_STREAM_VITALS_MS) {
+            sendVitals();
+            lastVitalsMs = millis();
+        }
+    }
+};
+
+LiveStream liveStream;
+
+void liveStreamSample(uint32_t ir) { liveStream.addSample(ir); }
+void liveStreamGap() { liveStream.addGap(); }
+
+#else
+
+void liveStreamSample(uint32_t) {}
+void liveStreamGap() {}
+
+#endif
+
 // ==================== REMOTE STATE CONTROL ====================
 void checkRemoteStateCommand() {
     if (WiFi.status() != WL_CONNECTED) return;
@@ -1367,7 +3176,9 @@ void checkRemoteStateCommand() {
     String url = API_BASE_URL + String("/health/devices/") + deviceID + String("/state/pending");
     if (!http.begin(url)) return;
     
+    uint32_t sendUs = micros();
     int httpCode = http.GET();
+    energy.noteRadioBurst(micros() - sendUs);
     
     if (httpCode == 200) {
         String response = http.getString();
@@ -1383,6 +3194,7 @@ void checkRemoteStateCommand() {
                 
                 if (newState != nullptr) {
                     if (strcmp(newState, "monitoring") == 0) {
+                        if (monitoringState == STATE_IDLE) desatStartSession();
                         monitoringState = STATE_MONITORING;
                         monitoringStateStr = "monitoring";
                     } else if (strcmp(newState, "paused") == 0) {
@@ -1468,6 +3280,196 @@ void handleScreenRotation() {
     }
 }
 
+// ==================== SERIAL CONSOLE ====================
+// Runs last in every loop pass. Input is consumed CONSOLE_RX_BUDGET bytes at
+// a time; a reply is formatted into a RAM queue and drained only as far as
+// the UART FIFO has room, so a long dump never stalls acquisition. The next
+// command is read once the previous reply is out.
+#if CONSOLE_ENABLED
+
+class ConsoleOutput : public Print {
+private:
+    uint8_t buf[CONSOLE_OUT_BYTES];
+    size_t head;
+    size_t tail;
+    size_t used;
+    bool truncated;
+    
+public:
+    ConsoleOutput() : head(0), tail(0), used(0), truncated(false) {}
+    
+    size_t write(uint8_t c) override {
+        if (used == CONSOLE_OUT_BYTES) {
+            truncated = true;
+            return 0;
+        }
+        buf[head] = c;
+        head = (head + 1) % CONSOLE_OUT_BYTES;
+        used++;
+        return 1;
+    }
+    using Print::write;
+    
+    void drain() {
+        int room = Serial.availableForWrite();
+        while (room > 0 && used > 0) {
+            size_t n = min((size_t)room, min(used, (size_t)CONSOLE_OUT_BYTES - tail));
+            Serial.write(buf + tail, n);
+            tail = (tail + n) % CONSOLE_OUT_BYTES;
+            used -= n;
+            room -= n;
+        }
+        if (used == 0 && truncated) {
+            truncated = false;
+            print("...(truncated)\n");
+        }
+    }
+    
+    bool busy() { return used > 0; }
+};
+
+class SerialConsole {
+private:
+    char line[CONSOLE_LINE_MAX];
+    int len;
+    bool overflow;
+    ConsoleOutput out;
+    
+    void help() {
+        out.println("help                 this list");
+        out.println("config               settings (console-settable ones can be changed)");
+        out.println("set <key> <value>    change a setting in RAM");
+        out.println("save                 persist changed settings to NVS");
+        out.println("latency              pipeline latency histograms");
+        out.println("trace                last upload traces, newest first");
+        out.println("metrics              uplink, energy, radio, rollup counters (JSON)");
+        out.println("dsp                  sensor signal-processing state");
+#ifdef DSP_PROFILE
+        out.println("prof [reset]         per-stage cycles / I-cache misses");
+#endif
+    }
+    
+    void latencyDump() {
+        for (int st = 0; st < TS_COUNT; st++) {
+            out.printf("%-18s n=%-6lu p50=%lu p95=%lu p99=%lu ms\n", TRACE_STAGE_NAMES[st],
+                       (unsigned long)latency[st].count(), (unsigned long)latency[st].percentile(50),
+                       (unsigned long)latency[st].percentile(95), (unsigned long)latency[st].percentile(99));
+        }
+        out.printf("critical alerts: %lu, acked: %lu, over 2 s or unacked: %lu\n",
+                   (unsigned long)criticalLatency.getTotal(),
+                   (unsigned long)latency[TS_ALERT_TO_RESPONSE].count(),
+                   (unsigned long)criticalLatency.getOverBudget());
+    }
+    
+    void traceDump() {
+        for (int i = 1; i <= TRACE_RING_SIZE; i++) {
+            const TraceRecord& t = traceRing[(traceRingHead - i + TRACE_RING_SIZE) % TRACE_RING_SIZE];
+            if (t.seq == 0) break;
+            out.printf("seq=%lu http=%d sample->send=%lu rtt=%lu serialize=%lu ms\n",
+                       (unsigned long)t.seq, t.httpCode, (unsigned long)(t.sampleUs ? (t.sendUs - t.sampleUs) / 1000 : 0),
+                       (unsigned long)((t.responseUs - t.sendUs) / 1000),
+                       (unsigned long)((t.sendUs - t.serializeUs) / 1000));
+        }
+    }
+    
+    void metricsDump() {
+        DynamicJsonDocument doc(3072);
+        doc["uptime_s"] = millis() / 1000;
+        doc["free_heap"] = ESP.getFreeHeap();
+        doc["loop_load"] = lroundf(loopLoad * 1000) / 1000.0;
+        doc["config_pending"] = config.pending();
+        JsonObject up = doc.createNestedObject("uplink");
+        up["seq"] = uplinkSeq;
+        up["acked"] = uplinkStats.acked;
+        up["transport_errors"] = uplinkStats.transportErrors;
+        up["server_errors"] = uplinkStats.serverErrors;
+        up["rejected"] = uplinkStats.rejected;
+        up["backing_off"] = uplinkBackingOff();
+        up["backlog"] = vitalsLog.newestSeq() + 1 - backlogFrom;
+        addUplinkQosTo(up.createNestedObject("qos"));
+        energy.addTo(doc.createNestedObject("energy"), battery.isPresent() ? battery.getPercent() : -1);
+        addRadioTo(doc.createNestedObject("radio"));
+        rollups.addTo(doc.createNestedObject("rollup"));
+        addRhythmTo(doc.createNestedObject("rhythm"));
+        addDesatTo(doc.createNestedObject("desat"));
+        addMax30102FifoTo(doc.createNestedObject("max30102_fifo"));
+        if (doc.overflowed()) out.println("metrics: JSON document too small, output cut short");
+        serializeJsonPretty(doc, out);
+        out.println();
+    }
+    
+    void execute(char* cmd) {
+        char* save = nullptr;
+        char* verb = strtok_r(cmd, " \t", &save);
+        if (verb == nullptr) return;
+        
+        if (strcmp(verb, "help") == 0) {
+            help();
+        } else if (strcmp(verb, "config") == 0) {
+            config.print(out);
+        } else if (strcmp(verb, "set") == 0) {
+            char* key = strtok_r(nullptr, " \t", &save);
+            char* value = strtok_r(nullptr, " \t", &save);
+            ConfigKey k = (key && value) ? config.setByName(key, value) : CFG_COUNT;
+            if (k == CFG_COUNT) {
+                out.println("usage: set <key> <value> (see config for keys and ranges)");
+                return;
+            }
+            if (k == CFG_RESTING_HR) rollups.reloadBaseline();
+            out.printf("%s set; \"save\" to keep it\n", key);
+        } else if (strcmp(verb, "save") == 0) {
+            config.save();
+            out.println("saving");
+        } else if (strcmp(verb, "latency") == 0) {
+            latencyDump();
+        } else if (strcmp(verb, "trace") == 0) {
+            traceDump();
+        } else if (strcmp(verb, "metrics") == 0) {
+            metricsDump();
+        } else if (strcmp(verb, "dsp") == 0) {
+            max30102Sensor.printState(out);
+            rhythm.printState(out);
+            pulseSensor.printState(out);
+#ifdef DSP_PROFILE
+        } else if (strcmp(verb, "prof") == 0) {
+            char* arg = strtok_r(nullptr, " \t", &save);
+            if (arg && strcmp(arg, "reset") == 0) dspProfileBegin();
+            else dspProfilePrint(out);
+#endif
+        } else {
+            out.printf("unknown command '%s' (try help)\n", verb);
+        }
+    }
+    
+public:
+    SerialConsole() : len(0), overflow(false) {}
+    
+    void service() {
+        out.drain();
+        if (out.busy()) return;
+        
+        for (int n = 0; n < CONSOLE_RX_BUDGET && Serial.available() > 0; n++) {
+            char c = Serial.read();
+            if (c == '\r') continue;
+            if (c != '\n') {
+                if (len < CONSOLE_LINE_MAX - 1) line[len++] = c;
+                else overflow = true;
+                continue;
+            }
+            line[len] = 0;
+            if (overflow) out.println("line too long");
+            else execute(line);
+            len = 0;
+            overflow = false;
+            return;   // one command per pass
+        }
+    }
+};
+
+SerialConsole console;
+
+#endif
+
 // ==================== SETUP ====================
 void setup() {
     Serial.begin(115200);
@@ -1476,6 +3478,10 @@ void setup() {
     esp_task_wdt_init(WATCHDOG_TIMEOUT, true);
     esp_task_wdt_add(NULL);
     
+#ifdef DSP_PROFILE
+    dspProfileBegin();
+#endif
+    
     pinMode(STATUS_LED, OUTPUT);
     digitalWrite(STATUS_LED, LOW);
     
@@ -1487,7 +3493,7 @@ void setup() {
     Wire.begin(SDA_PIN, SCL_PIN);
     Wire.setTimeOut(2000);
     lcd.init();
-    lcd.backlight();
+    setLcdBacklight(true);
     lcd.clear();
     lcd.setCursor(0, 0);
     lcd.print("VitalWatch v4.1");
@@ -1497,10 +3503,16 @@ void setup() {
     lcd.print("Initializing...");
     
     preferences.begin("health", false);
+    config.begin();
     deviceID = "HEALTH_DEVICE_001";
     
+    vitalsLog.begin();
+    backlogFrom = config.isSet(CFG_BACKLOG_FROM) ? config.get<CFG_BACKLOG_FROM>() : vitalsLog.newestSeq() + 1;
+    liveAcked.reset(backlogFrom);
+    
     dallas.begin();
     tempSensor.begin();
+    rollups.begin();
     
     delay(100);
     Wire.begin(SDA_PIN, SCL_PIN);
@@ -1508,10 +3520,12 @@ void setup() {
     delay(50);
     max30102Sensor.begin();
     pulseSensor.begin();
+    battery.begin();
     
     lcd.setCursor(0, 3);
     lcd.print("WiFi connecting...");
     connectWiFi();
+    radio.begin();
     
     lcd.clear();
     lcd.setCursor(0, 0);
@@ -1544,16 +3558,19 @@ void setup() {
 // ==================== MAIN LOOP ====================
 void loop() {
     static unsigned long lastSensorRead = 0;
-    static unsigned long lastCloudSync = 0;
     static unsigned long lastLCDUpdate = 0;
     static unsigned long lastVitalUpdate = 0;
+    unsigned long loopStartUs = micros();
     
     esp_task_wdt_reset();
     
     handleButtons();
     checkWiFiConnection();
+    battery.update();
+    
+    bool burst = radio.open(battery.policy().cloudSyncMs);
     
-    if (millis() - lastStatePoll >= STATE_POLL_INTERVAL) {
+    if (burst && millis() - lastStatePoll >= STATE_POLL_INTERVAL) {
         if (WiFi.status() == WL_CONNECTED) {
             checkRemoteStateCommand();
         }
@@ -1568,14 +3585,27 @@ void loop() {
         }
         if (millis() - lastVitalUpdate >= VITALS_UPDATE_INTERVAL) {
             updateVitals();
+            rollups.addVitals();
+            desatAddVitals();
             checkAlerts();
+            uint16_t changed = publishVitalChanges();
+#if LOCAL_API_ENABLED
+            if (changed) localApi.pushSnapshot();
+#endif
+            if ((changed & VF_ALERT) && currentVitals.isCriticalAlert) {
+                // Onset or escalation wakes the radio (queueing does not);
+                // the burst's own record coalesces into this job
+                uplink.enqueue(UC_ALERT, JOB_VITALS);
+                radio.wakeNow();
+#if CAPTURE_ENABLED
+                alertCapture.trigger(currentVitals.alertOnsetUs);
+#endif
+            }
             lastVitalUpdate = millis();
         }
-        if (millis() - lastCloudSync >= CLOUD_SYNC_INTERVAL) {
-            if (WiFi.status() == WL_CONNECTED) {
-                sendToCloud();
-            }
-            lastCloudSync = millis();
+        if (burst) {
+            uint32_t seq = logVitalsRecord();
+            uplink.enqueueBurst(seq);
         }
     } else {
         static unsigned long lastPulseIdle = 0;
@@ -1590,7 +3620,25 @@ void loop() {
         lastLCDUpdate = millis();
     }
     
+    radio.service(serviceUplink());
+    
+#if LOCAL_API_ENABLED
+    startLocalApi();
+    localApi.service();
+#endif
+#if LIVE_STREAM_ENABLED
+    liveStream.service();
+#endif
+    
     handleScreenRotation();
+    config.service();
+#if CONSOLE_ENABLED
+    console.service();
+#endif
     
+    unsigned long busyUs = micros() - loopStartUs;
     delay(1);
+    unsigned long totalUs = micros() - loopStartUs;
+    loopLoad = loopLoad * 0.99f + 0.01f * (float)busyUs / (float)totalUs;
+    energy.noteLoop(busyUs, totalUs);
 }
\ No newline at end of file
@@ -0,0 +1,262 @@
+// AlertCapture: the serialized WFC1 body is decoded back to samples and
+// compared with what went in. Covers the pre/post-trigger window and the
+// trigger offset, int16 delta clipping on a large step, gap flags, and the
+// frozen / retry / missed-alert state machine.
+
+#include <unity.h>
+#include <vector>
+
+#include "Arduino.h"
+
+#define CAPTURE_PRE_S 30
+#define CAPTURE_POST_S 10
+#define CAPTURE_RATE 25
+#define CAPTURE_MAX_ATTEMPTS 4
+#define CAPTURE_RETRY_MS 5000
+#include "alert_capture.h"
+
+static int frozenCalls;
+void captureFrozen() { frozenCalls++; }
+
+static AlertCapture* capture;
+static uint8_t body[64 * 1024];
+
+struct Sample {
+    uint32_t ir;
+    uint32_t red;
+    bool gapBefore;
+};
+
+struct Decoded {
+    uint16_t rate = 0;
+    uint16_t blocks = 0;
+    uint32_t triggerSample = 0;
+    uint32_t id = 0;
+    std::vector<Sample> samples;
+};
+
+template <typename T> static T take(const uint8_t*& p) {
+    T v;
+    memcpy(&v, p, sizeof(v));
+    p += sizeof(v);
+    return v;
+}
+
+static bool decode(const uint8_t* buf, size_t len, Decoded& out) {
+    const uint8_t* p = buf;
+    const uint8_t* end = buf + len;
+    if (len < 16 || memcmp(p, "WFC1", 4)) return false;
+    p += 4;
+    out.rate = take<uint16_t>(p);
+    out.blocks = take<uint16_t>(p);
+    out.triggerSample = take<uint32_t>(p);
+    out.id = take<uint32_t>(p);
+    for (int b = 0; b < out.blocks; b++) {
+        if (end - p < 10) return false;
+        uint32_t ir = take<uint32_t>(p);
+        uint32_t red = take<uint32_t>(p);
+        uint8_t count = take<uint8_t>(p);
+        uint8_t flags = take<uint8_t>(p);
+        if (count == 0 || end - p < 4 * (count - 1)) return false;
+        out.samples.push_back({ir, red, (flags & 1) != 0});
+        for (int i = 1; i < count; i++) {
+            ir += take<int16_t>(p);
+            red += take<int16_t>(p);
+            out.samples.push_back({ir, red, false});
+        }
+    }
+    return p == end;
+}
+
+// A PPG-like pair with a distinct value for every sample index
+static uint32_t irAt(uint32_t n) { return 100000 + (n * 37) % 2000; }
+static uint32_t redAt(uint32_t n) { return 80000 + (n * 53) % 1500; }
+
+static void feed(uint32_t& n, uint32_t count) {
+    for (uint32_t i = 0; i < count; i++, n++) {
+        capture->addSample(redAt(n), irAt(n));
+        delay(40);
+    }
+}
+
+static Decoded serializeAndDecode() {
+    Decoded d;
+    size_t len = capture->serialize(body, sizeof(body));
+    TEST_ASSERT_GREATER_THAN(0, len);
+    TEST_ASSERT_TRUE(decode(body, len, d));
+    return d;
+}
+
+void setUp() {
+    hostclock::nowUs = 1000000;
+    frozenCalls = 0;
+    static AlertCapture c;
+    c = AlertCapture();
+    capture = &c;
+}
+
+void tearDown() {}
+
+// Trigger at 50 s; 10 s later the ring freezes holding 30 s on either side
+void test_window_around_the_trigger() {
+    uint32_t n = 0;
+    feed(n, 50 * CAPTURE_RATE + 7);
+    capture->trigger(micros());
+    TEST_ASSERT_EQUAL(AlertCapture::POST_TRIGGER, capture->getState());
+    feed(n, CAPTURE_POST_S * CAPTURE_RATE - 7);
+    TEST_ASSERT_TRUE(capture->isFrozen());
+    TEST_ASSERT_EQUAL(1, frozenCalls);
+
+    Decoded d = serializeAndDecode();
+    TEST_ASSERT_EQUAL(CAPTURE_RATE, d.rate);
+    TEST_ASSERT_EQUAL(CAPTURE_PRE_S + CAPTURE_POST_S, d.blocks);
+    TEST_ASSERT_EQUAL_UINT32(capture->getId(), d.id);
+    TEST_ASSERT_EQUAL((CAPTURE_PRE_S + CAPTURE_POST_S) * CAPTURE_RATE, d.samples.size());
+    uint32_t first = n - d.samples.size();
+    TEST_ASSERT_EQUAL_UINT32(50 * CAPTURE_RATE + 7 - first, d.triggerSample);
+    for (size_t i = 0; i < d.samples.size(); i++) {
+        TEST_ASSERT_EQUAL_UINT32(irAt(first + i), d.samples[i].ir);
+        TEST_ASSERT_EQUAL_UINT32(redAt(first + i), d.samples[i].red);
+        TEST_ASSERT_FALSE(d.samples[i].gapBefore);
+    }
+    TEST_ASSERT_EQUAL_UINT32(0, capture->getClipped());
+}
+
+// Samples arriving while frozen are dropped; the body does not change
+void test_frozen_capture_is_stable() {
+    uint32_t n = 0;
+    feed(n, 40 * CAPTURE_RATE);
+    capture->trigger(micros());
+    feed(n, CAPTURE_POST_S * CAPTURE_RATE);
+    size_t len = capture->serialize(body, sizeof(body));
+    std::vector<uint8_t> before(body, body + len);
+    feed(n, 5 * CAPTURE_RATE);
+    capture->addGap();
+    TEST_ASSERT_EQUAL(len, capture->serialize(body, sizeof(body)));
+    TEST_ASSERT_EQUAL(0, memcmp(before.data(), body, len));
+    TEST_ASSERT_EQUAL(0, capture->serialize(body, 100));
+}
+
+// A step too large for int16 is spread over the next samples; the block
+// after it starts exact again
+void test_large_step_is_clipped_and_recovers() {
+    uint32_t n = 0;
+    feed(n, 20 * CAPTURE_RATE + 3);
+    for (int i = 0; i < 2 * CAPTURE_RATE; i++) {
+        capture->addSample(50000, 200000);   // IR +100000, RED -30000
+        delay(40);
+    }
+    capture->trigger(micros());
+    feed(n, CAPTURE_POST_S * CAPTURE_RATE);
+    TEST_ASSERT_TRUE(capture->isFrozen());
+    TEST_ASSERT_GREATER_THAN(0, capture->getClipped());
+
+    // 32 s so far: the ring still holds everything from the first sample
+    Decoded d = serializeAndDecode();
+    size_t step = 20 * CAPTURE_RATE + 3;
+    TEST_ASSERT_EQUAL_UINT32(irAt(step - 1), d.samples[step - 1].ir);
+    TEST_ASSERT_LESS_THAN(200000, d.samples[step].ir);    // clipped at +32767
+    TEST_ASSERT_EQUAL_UINT32(50000, d.samples[step].red); // RED's step fits
+    TEST_ASSERT_EQUAL_UINT32(200000, d.samples[step + 3].ir);
+    for (size_t i = step + 3; i < step + 2 * CAPTURE_RATE; i++) TEST_ASSERT_EQUAL_UINT32(200000, d.samples[i].ir);
+}
+
+// addGap() closes the partial block; the next block carries the flag
+void test_gap_is_flagged() {
+    uint32_t n = 0;
+    feed(n, 35 * CAPTURE_RATE + 10);
+    capture->addGap();
+    n += 50;                       // lost in the FIFO
+    feed(n, 2 * CAPTURE_RATE);
+    capture->trigger(micros());
+    feed(n, CAPTURE_POST_S * CAPTURE_RATE);
+    TEST_ASSERT_TRUE(capture->isFrozen());
+
+    Decoded d = serializeAndDecode();
+    int gaps = 0;
+    for (size_t i = 0; i < d.samples.size(); i++) {
+        if (!d.samples[i].gapBefore) continue;
+        gaps++;
+        TEST_ASSERT_EQUAL_UINT32(irAt(35 * CAPTURE_RATE + 10 + 50), d.samples[i].ir);
+        TEST_ASSERT_EQUAL_UINT32(irAt(35 * CAPTURE_RATE + 9), d.samples[i - 1].ir);
+    }
+    TEST_ASSERT_EQUAL(1, gaps);
+}
+
+// No samples after the trigger (finger off) must not hold it open
+void test_freezes_without_samples() {
+    uint32_t n = 0;
+    feed(n, 10 * CAPTURE_RATE);
+    capture->trigger(micros());
+    delay((CAPTURE_POST_S + 4) * 1000);
+    TEST_ASSERT_FALSE(capture->isFrozen());
+    delay(2000);
+    TEST_ASSERT_TRUE(capture->isFrozen());
+    Decoded d = serializeAndDecode();
+    TEST_ASSERT_EQUAL(10, d.blocks);
+    TEST_ASSERT_EQUAL_UINT32(10 * CAPTURE_RATE, d.triggerSample);
+}
+
+void test_retry_then_give_up() {
+    uint32_t n = 0;
+    feed(n, 5 * CAPTURE_RATE);
+    capture->trigger(micros());
+    feed(n, CAPTURE_POST_S * CAPTURE_RATE);
+    TEST_ASSERT_TRUE(capture->due());
+    for (int attempt = 1; attempt < CAPTURE_MAX_ATTEMPTS; attempt++) {
+        capture->finish(false);
+        TEST_ASSERT_TRUE(capture->isFrozen());
+        TEST_ASSERT_FALSE(capture->due());
+        delay(CAPTURE_RETRY_MS * attempt - 1);
+        TEST_ASSERT_FALSE(capture->due());
+        delay(1);
+        TEST_ASSERT_TRUE(capture->due());
+    }
+    capture->finish(false);
+    TEST_ASSERT_EQUAL(AlertCapture::ARMED, capture->getState());
+    TEST_ASSERT_EQUAL_UINT32(1, capture->getFailed());
+    TEST_ASSERT_EQUAL_UINT32(0, capture->getUploaded());
+}
+
+// One capture per alert onset; a new onset while one is pending is missed
+void test_one_capture_per_onset() {
+    uint32_t n = 0;
+    feed(n, 5 * CAPTURE_RATE);
+    uint32_t onset = micros();
+    capture->trigger(onset);
+    uint32_t id = capture->getId();
+    TEST_ASSERT_EQUAL_UINT32(id, capture->idFor(onset));
+    capture->trigger(onset);
+    TEST_ASSERT_EQUAL_UINT32(0, capture->getMissed());
+    capture->trigger(onset + 1);
+    TEST_ASSERT_EQUAL_UINT32(1, capture->getMissed());
+    TEST_ASSERT_EQUAL_UINT32(0, capture->idFor(onset + 1));
+
+    feed(n, CAPTURE_POST_S * CAPTURE_RATE);
+    capture->finish(true);
+    TEST_ASSERT_EQUAL_UINT32(1, capture->getUploaded());
+    capture->trigger(onset);       // still the same alert
+    TEST_ASSERT_EQUAL(AlertCapture::ARMED, capture->getState());
+
+    // Samples missed while frozen: the next block is flagged
+    feed(n, 3 * CAPTURE_RATE);
+    capture->trigger(onset + 2);
+    TEST_ASSERT_EQUAL_UINT32(id + 1, capture->getId());
+    feed(n, CAPTURE_POST_S * CAPTURE_RATE);
+    Decoded d = serializeAndDecode();
+    int gaps = 0;
+    for (const Sample& s : d.samples) gaps += s.gapBefore;
+    TEST_ASSERT_EQUAL(1, gaps);
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_window_around_the_trigger);
+    RUN_TEST(test_frozen_capture_is_stable);
+    RUN_TEST(test_large_step_is_clipped_and_recovers);
+    RUN_TEST(test_gap_is_flagged);
+    RUN_TEST(test_freezes_without_samples);
+    RUN_TEST(test_retry_then_give_up);
+    RUN_TEST(test_one_capture_per_onset);
+    return UNITY_END();
+}
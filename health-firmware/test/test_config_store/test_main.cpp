@@ -0,0 +1,218 @@
+// ConfigStore over the in-memory host/Preferences.h: NVS writes are
+// coalesced and paced per key (the backlog pointer on its short interval),
+// one write per service() pass; console edits stay in RAM until save() and
+// must parse and fall inside the schema's range; flushNow() and the shutdown
+// handler write everything at once.
+
+#include <unity.h>
+#include <string>
+
+#include "Arduino.h"
+
+#define CONFIG_FLUSH_INTERVAL_MS 300000
+#define CONFIG_BACKLOG_FLUSH_MS 30000
+#define CONFIG_SCHEMA(X) \
+    X(CFG_RESTING_HR,   restingHR,   float,    "resting_hr",   70.0f, 30.0f, 120.0f, CONFIG_FLUSH_INTERVAL_MS, true) \
+    X(CFG_BACKLOG_FROM, backlogFrom, uint32_t, "backlog_from", 0, 0, UINT32_MAX, CONFIG_BACKLOG_FLUSH_MS, false) \
+    X(CFG_FINGER_IR,    fingerIr,    uint32_t, "finger_ir",    50000, 1000, 200000, CONFIG_FLUSH_INTERVAL_MS, true)
+
+#include "config_store.h"
+
+Preferences preferences;
+static ConfigStore* config;
+
+void ConfigStore::onShutdown() { config->flushNow(); }
+
+class StringPrint : public Print {
+public:
+    std::string text;
+    using Print::write;
+    size_t write(uint8_t b) override {
+        text += (char)b;
+        return 1;
+    }
+};
+
+static void runPasses(int n) {
+    for (int i = 0; i < n; i++) config->service();
+}
+
+void setUp() {
+    hostclock::nowUs = 1000000;
+    preferences.clear();
+    preferences.puts = 0;
+    static ConfigStore store;
+    store = ConfigStore();
+    config = &store;
+}
+
+void tearDown() {}
+
+void test_defaults_and_nvs_values_at_boot() {
+    preferences.putFloat("resting_hr", 58.5f);
+    preferences.puts = 0;
+    config->begin();
+    TEST_ASSERT_EQUAL_FLOAT(58.5f, config->get<CFG_RESTING_HR>());
+    TEST_ASSERT_TRUE(config->isSet(CFG_RESTING_HR));
+    TEST_ASSERT_EQUAL_UINT32(50000, config->get<CFG_FINGER_IR>());
+    TEST_ASSERT_FALSE(config->isSet(CFG_FINGER_IR));
+    TEST_ASSERT_FALSE(config->isSet(CFG_BACKLOG_FROM));
+}
+
+void test_unchanged_value_is_not_rewritten() {
+    preferences.putUInt("finger_ir", 42000);
+    preferences.puts = 0;
+    config->begin();
+    config->set<CFG_FINGER_IR>(42000);
+    TEST_ASSERT_EQUAL_UINT32(0, config->pending());
+
+    // A default that was never stored is written once
+    config->set<CFG_RESTING_HR>(70.0f);
+    TEST_ASSERT_TRUE(config->isSet(CFG_RESTING_HR));
+    TEST_ASSERT_EQUAL_UINT32(1u << CFG_RESTING_HR, config->pending());
+}
+
+// Many updates between flushes cost one NVS write
+void test_writes_are_coalesced_until_the_interval() {
+    config->begin();
+    for (int i = 0; i < 100; i++) {
+        config->set<CFG_RESTING_HR>(60.0f + i * 0.1f);
+        delay(1000);
+        config->service();
+    }
+    TEST_ASSERT_EQUAL_UINT32(0, preferences.puts);
+
+    delay(CONFIG_FLUSH_INTERVAL_MS);
+    runPasses(3);
+    TEST_ASSERT_EQUAL_UINT32(1, preferences.puts);
+    TEST_ASSERT_EQUAL_FLOAT(69.9f, preferences.getFloat("resting_hr"));
+    TEST_ASSERT_EQUAL_UINT32(0, config->pending());
+}
+
+// backlog_from advances with every server ack; it must not wait 5 min
+void test_backlog_pointer_flushes_on_its_short_interval() {
+    config->begin();
+    uint32_t seq = 100;
+    for (uint32_t t = 0; t < 120000; t += 5000) {
+        config->set<CFG_BACKLOG_FROM>(++seq);
+        delay(5000);
+        config->service();
+        // Never more than CONFIG_BACKLOG_FLUSH_MS behind
+        uint32_t stored = preferences.getUInt("backlog_from", 0);
+        TEST_ASSERT_TRUE(t < CONFIG_BACKLOG_FLUSH_MS || seq - stored <= CONFIG_BACKLOG_FLUSH_MS / 5000);
+    }
+    TEST_ASSERT_LESS_OR_EQUAL(120000 / CONFIG_BACKLOG_FLUSH_MS, preferences.puts);
+    TEST_ASSERT_GREATER_OR_EQUAL(120000 / CONFIG_BACKLOG_FLUSH_MS - 1, preferences.puts);
+}
+
+// A pass started for one key writes every dirty key, one per service() call
+void test_flush_pass_writes_one_key_per_call() {
+    config->begin();
+    config->set<CFG_RESTING_HR>(61.0f);
+    config->set<CFG_FINGER_IR>(43000);
+    config->set<CFG_BACKLOG_FROM>(7);
+    delay(CONFIG_BACKLOG_FLUSH_MS);
+    config->service();
+    TEST_ASSERT_EQUAL_UINT32(1, preferences.puts);
+    config->service();
+    TEST_ASSERT_EQUAL_UINT32(2, preferences.puts);
+    config->service();
+    TEST_ASSERT_EQUAL_UINT32(3, preferences.puts);
+    config->service();
+    TEST_ASSERT_EQUAL_UINT32(3, preferences.puts);
+    TEST_ASSERT_EQUAL_UINT32(7, preferences.getUInt("backlog_from", 0));
+    TEST_ASSERT_EQUAL_UINT32(43000, preferences.getUInt("finger_ir", 0));
+}
+
+void test_shutdown_handler_flushes_everything() {
+    config->begin();
+    config->set<CFG_RESTING_HR>(64.0f);
+    config->set<CFG_BACKLOG_FROM>(900);
+    TEST_ASSERT_NOT_NULL(hostsystem::shutdownHandler());
+    hostsystem::shutdownHandler()();
+    TEST_ASSERT_EQUAL_UINT32(2, preferences.puts);
+    TEST_ASSERT_EQUAL_UINT32(0, config->pending());
+    TEST_ASSERT_EQUAL_UINT32(900, preferences.getUInt("backlog_from", 0));
+}
+
+void test_console_set_is_ram_only_until_save() {
+    config->begin();
+    TEST_ASSERT_EQUAL(CFG_FINGER_IR, config->setByName("finger_ir", "45000"));
+    TEST_ASSERT_EQUAL_UINT32(45000, config->get<CFG_FINGER_IR>());
+    TEST_ASSERT_EQUAL_UINT32(0, config->pending());
+    delay(CONFIG_FLUSH_INTERVAL_MS);
+    runPasses(3);
+    TEST_ASSERT_EQUAL_UINT32(0, preferences.puts);
+
+    StringPrint out;
+    config->print(out);
+    TEST_ASSERT_TRUE(out.text.find("finger_ir = 45000  (unsaved)  [1000..200000]") != std::string::npos);
+    TEST_ASSERT_TRUE(out.text.find("backlog_from = 0  (default)  [read-only]") != std::string::npos);
+
+    // save() queues the change for the next pass, without waiting
+    config->save();
+    config->service();
+    TEST_ASSERT_EQUAL_UINT32(1, preferences.puts);
+    TEST_ASSERT_EQUAL_UINT32(45000, preferences.getUInt("finger_ir", 0));
+}
+
+void test_console_rejects_unknown_read_only_and_malformed() {
+    config->begin();
+    TEST_ASSERT_EQUAL(CFG_COUNT, config->setByName("nope", "1"));
+    TEST_ASSERT_EQUAL(CFG_COUNT, config->setByName("backlog_from", "1"));
+    TEST_ASSERT_EQUAL(CFG_COUNT, config->setByName("finger_ir", "12k"));
+    TEST_ASSERT_EQUAL(CFG_COUNT, config->setByName("finger_ir", ""));
+    TEST_ASSERT_EQUAL(CFG_COUNT, config->setByName("resting_hr", "nan"));
+    TEST_ASSERT_EQUAL(CFG_COUNT, config->setByName("resting_hr", "inf"));
+    TEST_ASSERT_EQUAL_UINT32(50000, config->get<CFG_FINGER_IR>());
+    TEST_ASSERT_EQUAL_FLOAT(70.0f, config->get<CFG_RESTING_HR>());
+}
+
+void test_console_rejects_out_of_range() {
+    config->begin();
+    TEST_ASSERT_EQUAL(CFG_COUNT, config->setByName("finger_ir", "-1"));
+    TEST_ASSERT_EQUAL(CFG_COUNT, config->setByName("finger_ir", "+5000"));
+    TEST_ASSERT_EQUAL(CFG_COUNT, config->setByName("finger_ir", " 5000"));
+    TEST_ASSERT_EQUAL(CFG_COUNT, config->setByName("finger_ir", "999"));
+    TEST_ASSERT_EQUAL(CFG_COUNT, config->setByName("finger_ir", "200001"));
+    TEST_ASSERT_EQUAL(CFG_COUNT, config->setByName("finger_ir", "4294967296"));   // would wrap to 0
+    TEST_ASSERT_EQUAL(CFG_COUNT, config->setByName("finger_ir", "99999999999999999999"));
+    TEST_ASSERT_EQUAL(CFG_COUNT, config->setByName("resting_hr", "-70"));
+    TEST_ASSERT_EQUAL(CFG_COUNT, config->setByName("resting_hr", "29.9"));
+    TEST_ASSERT_EQUAL(CFG_COUNT, config->setByName("resting_hr", "1e9"));
+    TEST_ASSERT_EQUAL_UINT32(50000, config->get<CFG_FINGER_IR>());
+    TEST_ASSERT_EQUAL_FLOAT(70.0f, config->get<CFG_RESTING_HR>());
+
+    // Both ends are inclusive; hex is still accepted
+    TEST_ASSERT_EQUAL(CFG_FINGER_IR, config->setByName("finger_ir", "1000"));
+    TEST_ASSERT_EQUAL(CFG_FINGER_IR, config->setByName("finger_ir", "0x30D40"));
+    TEST_ASSERT_EQUAL_UINT32(200000, config->get<CFG_FINGER_IR>());
+    TEST_ASSERT_EQUAL(CFG_RESTING_HR, config->setByName("resting_hr", "30"));
+}
+
+// A stored value outside the range (older firmware, corrupt entry) is
+// replaced by the default and rewritten on the next change
+void test_out_of_range_nvs_value_falls_back_to_default() {
+    preferences.putUInt("finger_ir", 0xFFFFFFFF);
+    preferences.putFloat("resting_hr", 0.0f);
+    config->begin();
+    TEST_ASSERT_EQUAL_UINT32(50000, config->get<CFG_FINGER_IR>());
+    TEST_ASSERT_FALSE(config->isSet(CFG_FINGER_IR));
+    TEST_ASSERT_EQUAL_FLOAT(70.0f, config->get<CFG_RESTING_HR>());
+    TEST_ASSERT_FALSE(config->isSet(CFG_RESTING_HR));
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_defaults_and_nvs_values_at_boot);
+    RUN_TEST(test_unchanged_value_is_not_rewritten);
+    RUN_TEST(test_writes_are_coalesced_until_the_interval);
+    RUN_TEST(test_backlog_pointer_flushes_on_its_short_interval);
+    RUN_TEST(test_flush_pass_writes_one_key_per_call);
+    RUN_TEST(test_shutdown_handler_flushes_everything);
+    RUN_TEST(test_console_set_is_ram_only_until_save);
+    RUN_TEST(test_console_rejects_unknown_read_only_and_malformed);
+    RUN_TEST(test_console_rejects_out_of_range);
+    RUN_TEST(test_out_of_range_nvs_value_falls_back_to_default);
+    return UNITY_END();
+}
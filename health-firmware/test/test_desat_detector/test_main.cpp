@@ -0,0 +1,164 @@
+// DesatDetector on 1 Hz SpO2 sequences: dips of 3 % for 10 s are events and
+// shorter or shallower ones are not, the session ODI starts over with each
+// session while the last-hour ODI rolls, and a reading gap restarts the
+// baseline.
+
+#include <unity.h>
+
+#include "Arduino.h"
+
+#define DESAT_DROP_PCT 3
+#define DESAT_MIN_S 10
+#define DESAT_RECOVER_PCT 1
+#define DESAT_MAX_S 120
+#define DESAT_BASELINE_S 120
+#define DESAT_WARMUP_S 60
+#define DESAT_MAX_GAP_S 10
+#define DESAT_EVENTS 16
+#include "desat_detector.h"
+
+static DesatDetector* desat;
+
+static void feed(int spo2, int seconds) {
+    for (int i = 0; i < seconds; i++) {
+        desat->addReading(spo2);
+        delay(1000);
+    }
+}
+
+// A 60 s cycle: 40 s at 97 %, then `dipS` at 92 %, rest at 97 %
+static void cycle(int dipS) {
+    feed(97, 40);
+    feed(92, dipS);
+    feed(97, 20 - dipS);
+}
+
+void setUp() {
+    hostclock::nowUs = 0;
+    static DesatDetector d;
+    d = DesatDetector();
+    desat = &d;
+}
+
+void tearDown() {}
+
+void test_steady_saturation_has_no_events() {
+    feed(97, 600);
+    TEST_ASSERT_EQUAL_UINT32(0, desat->eventCount());
+    TEST_ASSERT_FLOAT_WITHIN(0.01f, 97, desat->getBaseline());
+    TEST_ASSERT_EQUAL_FLOAT(0, desat->getODI());
+    TEST_ASSERT_EQUAL_UINT32(600, desat->getSessionValidS());
+}
+
+void test_dip_is_recorded() {
+    feed(97, 120);
+    feed(95, 3);
+    feed(92, 12);
+    feed(97, 10);
+    TEST_ASSERT_EQUAL_UINT32(1, desat->eventCount());
+    const DesatEvent& e = desat->event(0);
+    TEST_ASSERT_EQUAL(13, e.durationS);       // the first reading back up closes it
+    TEST_ASSERT_EQUAL(92, e.nadir);
+    TEST_ASSERT_EQUAL(5, e.dropPct);
+    TEST_ASSERT_EQUAL_UINT32(123000, e.startMs);   // 95 % is not 3 % below
+    TEST_ASSERT_FALSE(desat->isInDip());
+}
+
+void test_short_or_shallow_dips_are_not_events() {
+    feed(97, 120);
+    feed(92, DESAT_MIN_S - 1);
+    feed(97, 30);
+    feed(95, 60);     // 2 % below: not a dip
+    feed(97, 30);
+    TEST_ASSERT_EQUAL_UINT32(0, desat->eventCount());
+}
+
+// Dips are only judged against a trusted baseline
+void test_no_events_during_warmup() {
+    feed(97, DESAT_WARMUP_S - 20);
+    feed(92, 15);
+    TEST_ASSERT_EQUAL_UINT32(0, desat->eventCount());
+}
+
+// More than DESAT_MAX_GAP_S without a valid reading restarts the baseline
+void test_gap_restarts_the_baseline() {
+    feed(97, 120);
+    feed(0, DESAT_MAX_GAP_S);
+    TEST_ASSERT_EQUAL_FLOAT(0, desat->getBaseline());
+    feed(92, 30);     // a new baseline at 92, not a dip
+    TEST_ASSERT_EQUAL_UINT32(0, desat->eventCount());
+    TEST_ASSERT_EQUAL_UINT32(150, desat->getSessionValidS());
+}
+
+// One event a minute is an ODI of 60, over the session and the last hour
+void test_odi_over_session_and_hour() {
+    feed(97, 60);
+    for (int i = 0; i < 59; i++) cycle(12);
+    TEST_ASSERT_EQUAL_UINT32(59, desat->eventCount());
+    TEST_ASSERT_FLOAT_WITHIN(1.5f, 59, desat->getODI());
+    TEST_ASSERT_FLOAT_WITHIN(2, 60, desat->getHourODI());
+    TEST_ASSERT_EQUAL_UINT32(3600, desat->getSessionValidS());
+
+    // An hour without events: the hourly figure drops to 0, the session's
+    // is averaged over both hours
+    feed(97, 3600);
+    TEST_ASSERT_EQUAL_FLOAT(0, desat->getHourODI());
+    TEST_ASSERT_EQUAL_UINT32(0, desat->getHourEvents());
+    TEST_ASSERT_FLOAT_WITHIN(1, 29.5f, desat->getODI());
+}
+
+// Invalid seconds count for neither ODI
+void test_odi_is_per_hour_of_valid_readings() {
+    feed(97, 60);
+    for (int i = 0; i < 10; i++) {
+        cycle(12);
+        feed(0, 5);
+    }
+    TEST_ASSERT_EQUAL_UINT32(10, desat->eventCount());
+    TEST_ASSERT_EQUAL_UINT32(660, desat->getSessionValidS());
+    TEST_ASSERT_FLOAT_WITHIN(0.1f, 10 * 3600.0f / 660, desat->getODI());
+    TEST_ASSERT_FLOAT_WITHIN(0.1f, 10 * 3600.0f / 660, desat->getHourODI());
+}
+
+// A new session zeroes the session ODI but keeps the hour window and
+// the event numbering the uplink acknowledges against
+void test_new_session() {
+    feed(97, 60);
+    for (int i = 0; i < 20; i++) cycle(12);
+    float hour = desat->getHourODI();
+    desat->startSession();
+    TEST_ASSERT_EQUAL_FLOAT(0, desat->getODI());
+    TEST_ASSERT_EQUAL_UINT32(0, desat->getSessionEvents());
+    TEST_ASSERT_EQUAL_FLOAT(hour, desat->getHourODI());
+    TEST_ASSERT_EQUAL_UINT32(20, desat->eventCount());
+    TEST_ASSERT_EQUAL_FLOAT(0, desat->getBaseline());
+
+    feed(97, 60);
+    cycle(12);
+    TEST_ASSERT_EQUAL_UINT32(1, desat->getSessionEvents());
+    TEST_ASSERT_EQUAL_UINT32(21, desat->eventCount());
+}
+
+// Only the last DESAT_EVENTS records are held for the uplink
+void test_held_events_are_numbered() {
+    feed(97, 60);
+    for (int i = 0; i < 20; i++) cycle(10 + i % 5);
+    TEST_ASSERT_EQUAL_UINT32(20, desat->eventCount());
+    TEST_ASSERT_EQUAL_UINT32(20 - DESAT_EVENTS, desat->firstHeld(0));
+    TEST_ASSERT_EQUAL_UINT32(18, desat->firstHeld(18));
+    for (uint32_t i = desat->firstHeld(0); i < 20; i++) TEST_ASSERT_EQUAL(11 + i % 5, desat->event(i).durationS);
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_steady_saturation_has_no_events);
+    RUN_TEST(test_dip_is_recorded);
+    RUN_TEST(test_short_or_shallow_dips_are_not_events);
+    RUN_TEST(test_no_events_during_warmup);
+    RUN_TEST(test_gap_restarts_the_baseline);
+    RUN_TEST(test_odi_over_session_and_hour);
+    RUN_TEST(test_odi_is_per_hour_of_valid_readings);
+    RUN_TEST(test_new_session);
+    RUN_TEST(test_held_events_are_numbered);
+    return UNITY_END();
+}
@@ -0,0 +1,112 @@
+// Energy model: the per-loop integration in EnergyAccount must agree with
+// energyFromStates() fed the state times the firmware reports, so a
+// keyframe's state_s can be checked against its totals on the host.
+
+#include <unity.h>
+
+#include "Arduino.h"
+#include "energy_model.h"
+
+void setUp() {}
+void tearDown() {}
+
+static uint32_t nextRand(uint32_t& seed) {
+    seed = seed * 1103515245 + 12345;
+    return seed >> 8;
+}
+
+// A night of loop passes: mostly idle, radio bursts every 5 s, a power tier
+// change halfway (lower LED power, backlight off) and a WiFi dropout.
+static void simulateNight(EnergyAccount& acc) {
+    uint32_t seed = 42;
+    uint64_t nowUs = 0;
+    const uint64_t nightUs = 8ULL * 3600 * 1000000;
+    while (nowUs < nightUs) {
+        uint32_t busyUs = 200 + nextRand(seed) % 3000;
+        uint32_t totalUs = busyUs + 1000 + nextRand(seed) % 200;
+        bool saver = nowUs > nightUs / 2;
+        bool connected = !(nowUs > 3ULL * 3600 * 1000000 && nowUs < 3ULL * 3600 * 1000000 + 600ULL * 1000000);
+        bool awake = connected && (nowUs / 1000) % 5000 < 300;
+        uint32_t radioUs = (awake && nextRand(seed) % 50 == 0) ? busyUs + 500 : 0;   // clamped to busyUs
+        float ledMa = saver ? energyLedMa(0x5F, 50) : energyLedMa(0x7F, 100);
+        acc.noteLoop(busyUs, totalUs, radioUs, connected, awake, ledMa, !saver);
+        nowUs += totalUs;
+    }
+}
+
+// What addTo() reports: whole seconds
+static EnergyStates reported(const EnergyStates& s) {
+    EnergyStates r = s;
+    r.totalUs = s.totalUs / 1000000 * 1000000;
+    r.cpuActiveUs = s.cpuActiveUs / 1000000 * 1000000;
+    r.cpuIdleUs = s.cpuIdleUs / 1000000 * 1000000;
+    r.radioConnectedUs = s.radioConnectedUs / 1000000 * 1000000;
+    r.radioAwakeUs = s.radioAwakeUs / 1000000 * 1000000;
+    r.radioActiveUs = s.radioActiveUs / 1000000 * 1000000;
+    r.backlightUs = s.backlightUs / 1000000 * 1000000;
+    return r;
+}
+
+void test_states_reproduce_integrated_charge() {
+    static EnergyAccount acc;
+    simulateNight(acc);
+    double mas[EN_COUNT];
+    energyFromStates(acc.getStates(), mas);
+    for (int i = 0; i < EN_COUNT; i++) {
+        TEST_ASSERT_TRUE(fabs(mas[i] - acc.getChargeMas(i)) <= acc.getChargeMas(i) * 1e-9 + 1e-6);
+    }
+}
+
+void test_reported_seconds_recompute_total_mah() {
+    static EnergyAccount acc;
+    simulateNight(acc);
+    double mas[EN_COUNT];
+    energyFromStates(reported(acc.getStates()), mas);
+    double sum = 0;
+    for (int i = 0; i < EN_COUNT; i++) sum += mas[i];
+    // Each truncated state loses under a second at its own current
+    double slack = ENERGY_CPU_ACTIVE_MA + ENERGY_CPU_IDLE_MA + ENERGY_RADIO_ACTIVE_MA + ENERGY_RADIO_AWAKE_MA +
+                   ENERGY_RADIO_SLEEP_MA + ENERGY_LCD_BACKLIGHT_MA + ENERGY_SENSORS_MA;
+    TEST_ASSERT_FLOAT_WITHIN(slack / 3600.0, acc.totalMas() / 3600.0, sum / 3600.0);
+
+    // Sanity of the night itself: 8 h, CPU states cover all of it
+    const EnergyStates& s = acc.getStates();
+    TEST_ASSERT_TRUE(s.totalUs == s.cpuActiveUs + s.cpuIdleUs);
+    TEST_ASSERT_TRUE(s.radioAwakeUs <= s.radioConnectedUs && s.radioConnectedUs < s.totalUs);
+    TEST_ASSERT_TRUE(s.backlightUs > s.totalUs / 2 - 60000000ULL && s.backlightUs < s.totalUs / 2 + 60000000ULL);
+}
+
+void test_backlight_off_stops_lcd_charge() {
+    EnergyAccount acc;
+    acc.noteLoop(1000, 10000, 0, false, false, 0, true);
+    double lit = acc.getChargeMas(EN_LCD);
+    TEST_ASSERT_FLOAT_WITHIN(1e-6, ENERGY_LCD_BACKLIGHT_MA * 0.01, lit);
+    acc.noteLoop(1000, 10000, 0, false, false, 0, false);
+    TEST_ASSERT_TRUE(acc.getChargeMas(EN_LCD) == lit);
+    TEST_ASSERT_EQUAL_UINT32(10000, (uint32_t)acc.getStates().backlightUs);
+}
+
+void test_radio_time_is_clamped_to_busy_time() {
+    EnergyAccount acc;
+    acc.noteLoop(2000, 3000, 5000, true, true, 0, false);
+    TEST_ASSERT_EQUAL_UINT32(2000, (uint32_t)acc.getStates().radioActiveUs);
+    double mas[EN_COUNT];
+    energyFromStates(acc.getStates(), mas);
+    TEST_ASSERT_FLOAT_WITHIN(1e-6, ENERGY_RADIO_ACTIVE_MA * 0.002 + ENERGY_RADIO_AWAKE_MA * 0.003, mas[EN_RADIO]);
+}
+
+void test_led_current_follows_power_level() {
+    // 0x7F at 100 sps: 2 * 127 * 0.2 mA * 411 us * 100/s
+    TEST_ASSERT_FLOAT_WITHIN(1e-4f, 2.0878f, energyLedMa(0x7F, 100));
+    TEST_ASSERT_FLOAT_WITHIN(1e-4f, energyLedMa(0x7F, 100) / 2, energyLedMa(0x7F, 50));
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_states_reproduce_integrated_charge);
+    RUN_TEST(test_reported_seconds_recompute_total_mah);
+    RUN_TEST(test_backlight_off_stops_lcd_charge);
+    RUN_TEST(test_radio_time_is_clamped_to_busy_time);
+    RUN_TEST(test_led_current_follows_power_level);
+    return UNITY_END();
+}
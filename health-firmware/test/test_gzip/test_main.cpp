@@ -0,0 +1,161 @@
+// GzipEncoder and the history batch format: every level must produce a
+// gzip stream that zlib inflates back to the input, with a matching CRC.
+
+#include <unity.h>
+#include <zlib.h>
+
+#include "Arduino.h"
+#include "gzip_encoder.h"
+#include "vitals_record.h"
+
+static GzipEncoder encoder;
+static uint8_t gz[80000];
+static uint8_t plain[70000];
+
+void setUp() {}
+void tearDown() {}
+
+static size_t gunzip(const uint8_t* in, size_t len, uint8_t* out, size_t cap) {
+    z_stream zs = {};
+    TEST_ASSERT_EQUAL(Z_OK, inflateInit2(&zs, 16 + MAX_WBITS));
+    zs.next_in = (Bytef*)in;
+    zs.avail_in = (uInt)len;
+    zs.next_out = out;
+    zs.avail_out = (uInt)cap;
+    int rc = inflate(&zs, Z_FINISH);
+    size_t got = zs.total_out;
+    inflateEnd(&zs);
+    TEST_ASSERT_EQUAL(Z_STREAM_END, rc);
+    return got;
+}
+
+static void roundTrip(const uint8_t* in, size_t len) {
+    for (int level = 1; level <= 3; level++) {
+        size_t n = encoder.compress(in, len, gz, sizeof(gz), level);
+        TEST_ASSERT_GREATER_THAN(0, n);
+        TEST_ASSERT_EQUAL(len, gunzip(gz, n, plain, sizeof(plain)));
+        if (len) TEST_ASSERT_EQUAL_MEMORY(in, plain, len);
+    }
+}
+
+void test_empty_and_tiny_inputs() {
+    roundTrip((const uint8_t*)"", 0);
+    roundTrip((const uint8_t*)"a", 1);
+    roundTrip((const uint8_t*)"abcabc", 6);
+}
+
+void test_long_runs_split_into_max_matches() {
+    static uint8_t run[5000];
+    memset(run, 'x', sizeof(run));
+    roundTrip(run, sizeof(run));
+    size_t n = encoder.compress(run, sizeof(run), gz, sizeof(gz), 3);
+    TEST_ASSERT_LESS_THAN(100, n);
+}
+
+void test_incompressible_input() {
+    static uint8_t noise[20000];
+    uint32_t seed = 1;
+    for (size_t i = 0; i < sizeof(noise); i++) {
+        seed = seed * 1103515245 + 12345;
+        noise[i] = seed >> 24;
+    }
+    roundTrip(noise, sizeof(noise));
+}
+
+// Repeats at every distance up to the window edge, and just past it
+void test_matches_at_window_edge() {
+    static uint8_t buf[12000];
+    uint32_t seed = 7;
+    for (size_t i = 0; i < 2100; i++) {
+        seed = seed * 1103515245 + 12345;
+        buf[i] = 'a' + (seed >> 24) % 26;
+    }
+    memcpy(buf + 2100, buf + 2100 - 2047, 2047);
+    memcpy(buf + 4147, buf + 4147 - 2048, 2048);
+    memcpy(buf + 6195, buf + 6195 - 2049, 2049);
+    for (size_t i = 8244; i < sizeof(buf); i++) buf[i] = buf[i - 1 - (i % 300)];
+    roundTrip(buf, sizeof(buf));
+}
+
+void test_largest_input() {
+    for (size_t i = 0; i < GzipEncoder::MAX_INPUT_BYTES; i++) plain[i] = "vitals"[i % 6] + (i / 4096);
+    static uint8_t copy[GzipEncoder::MAX_INPUT_BYTES];
+    memcpy(copy, plain, sizeof(copy));
+    roundTrip(copy, sizeof(copy));
+    TEST_ASSERT_EQUAL(0, encoder.compress(copy, GzipEncoder::MAX_INPUT_BYTES + 1, gz, sizeof(gz), 1));
+}
+
+void test_output_too_small_fails() {
+    const char* text = "{\"seq\":1,\"heart_rate\":61}";
+    TEST_ASSERT_EQUAL(0, encoder.compress((const uint8_t*)text, strlen(text), gz, 12, 2));
+    TEST_ASSERT_EQUAL(0, encoder.compress((const uint8_t*)text, strlen(text), gz, sizeof(gz), 0));
+}
+
+void test_crc_matches_zlib() {
+    const char* text = "The quick brown fox jumps over the lazy dog";
+    size_t len = strlen(text);
+    TEST_ASSERT_EQUAL_HEX32(0x414FA339, crc32Update(0, (const uint8_t*)text, len));
+    uint32_t split = crc32Update(crc32Update(0, (const uint8_t*)text, 10), (const uint8_t*)text + 10, len - 10);
+    TEST_ASSERT_EQUAL_HEX32(crc32(0, (const Bytef*)text, len), split);
+}
+
+static VitalsRecord record(uint32_t seq, uint8_t flags) {
+    VitalsRecord r = {};
+    r.seq = seq;
+    r.timestamp = 1700000000 + seq * 5;
+    r.heartRate = 60 + seq % 7;
+    r.hrQuality = 90;
+    r.spo2 = 97;
+    r.spo2Quality = 88;
+    r.tempCenti = 3655;
+    r.flags = flags;
+    return r;
+}
+
+void test_batch_skips_gaps_and_live_acked() {
+    VitalsRecord recs[5] = {record(10, 0), record(11, VR_GAP), record(12, VR_LIVE_ACKED),
+                            record(13, VR_CRITICAL), record(14, VR_TEMP_ESTIMATED)};
+    static char body[2048];
+    uint32_t used = 0;
+    size_t len = formatVitalsBatch(recs, 5, "DEV", body, sizeof(body), used);
+    TEST_ASSERT_EQUAL(5, used);
+    TEST_ASSERT_EQUAL(strlen(body), len);
+    TEST_ASSERT_NOT_NULL(strstr(body, "\"seq\":10,"));
+    TEST_ASSERT_NULL(strstr(body, "\"seq\":11,"));
+    TEST_ASSERT_NULL(strstr(body, "\"seq\":12,"));
+    TEST_ASSERT_NOT_NULL(strstr(body, "\"seq\":13,"));
+    TEST_ASSERT_NOT_NULL(strstr(body, "\"alert\":2}"));
+    TEST_ASSERT_NOT_NULL(strstr(body, "\"is_temp_estimated\":true"));
+    TEST_ASSERT_EQUAL_STRING("]}", body + len - 2);
+    roundTrip((const uint8_t*)body, len);
+
+    VitalsRecord skipped[2] = {record(20, VR_GAP), record(21, VR_LIVE_ACKED)};
+    TEST_ASSERT_EQUAL(0, formatVitalsBatch(skipped, 2, "DEV", body, sizeof(body), used));
+    TEST_ASSERT_EQUAL(2, used);
+}
+
+void test_batch_stops_when_buffer_is_full() {
+    VitalsRecord recs[8];
+    for (int i = 0; i < 8; i++) recs[i] = record(100 + i, 0);
+    static char body[600];
+    uint32_t used = 0;
+    size_t len = formatVitalsBatch(recs, 8, "DEV", body, sizeof(body), used);
+    TEST_ASSERT_GREATER_THAN(0, used);
+    TEST_ASSERT_LESS_THAN(8, used);
+    TEST_ASSERT_LESS_THAN(sizeof(body), len);
+    TEST_ASSERT_EQUAL_STRING("]}", body + len - 2);
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_empty_and_tiny_inputs);
+    RUN_TEST(test_long_runs_split_into_max_matches);
+    RUN_TEST(test_incompressible_input);
+    RUN_TEST(test_matches_at_window_edge);
+    RUN_TEST(test_largest_input);
+    RUN_TEST(test_output_too_small_fails);
+    RUN_TEST(test_crc_matches_zlib);
+    RUN_TEST(test_batch_skips_gaps_and_live_acked);
+    RUN_TEST(test_batch_stops_when_buffer_is_full);
+    return UNITY_END();
+}
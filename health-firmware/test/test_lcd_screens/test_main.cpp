@@ -0,0 +1,66 @@
+// LCD screen text (include/lcd_screens.h): every row fits the 20-column
+// glass, long fields are cut where updateLCD() cuts them, and padded rows
+// overwrite the previous text completely.
+
+#include <unity.h>
+#include <string.h>
+
+#include "lcd_screens.h"
+
+void setUp() {}
+void tearDown() {}
+
+void test_vitals_screen() {
+    LcdRows rows;
+    LcdVitalsScreen s = {72, 97, 36.64f, "MAX30102", "[MON] ", ""};
+    lcdFormatVitals(s, rows);
+    TEST_ASSERT_EQUAL_STRING("HR:72 BPM O2:97%", rows[0]);
+    TEST_ASSERT_EQUAL_STRING("Temp: 36.6C", rows[1]);
+    TEST_ASSERT_EQUAL_STRING("Src:MAX30102", rows[2]);
+    TEST_ASSERT_EQUAL_STRING("[MON] ", rows[3]);
+}
+
+// The state tag is 6 or 7 characters; the alert gets the 13 after it
+void test_long_fields_are_cut() {
+    LcdRows rows;
+    LcdVitalsScreen s = {188, 100, -12.5f, "A-SOURCE-NAME-TOO-LONG", "[PAUSE]", "SpO2 LOW 84% for 30s"};
+    lcdFormatVitals(s, rows);
+    TEST_ASSERT_EQUAL_STRING("Src:A-SOURCE-NAM", rows[2]);
+    TEST_ASSERT_EQUAL_STRING("[PAUSE]SpO2 LOW 84% ", rows[3]);
+    for (int r = 0; r < LCD_ROWS; r++) TEST_ASSERT_LESS_OR_EQUAL(LCD_COLS, strlen(rows[r]));
+}
+
+void test_status_screen() {
+    LcdRows rows;
+    LcdStatusScreen s = {"4.1", false, 1440, true, false, 86};
+    lcdFormatStatus(s, rows);
+    TEST_ASSERT_EQUAL_STRING("System Status:", rows[0]);
+    TEST_ASSERT_EQUAL_STRING("WiFi:ERR Up:1440m", rows[1]);
+    TEST_ASSERT_EQUAL_STRING("MAX:YES SEN:NO ", rows[2]);
+    TEST_ASSERT_EQUAL_STRING("v4.1 Batt:86%", rows[3]);
+
+    s.batteryPct = -1;
+    s.uptimeMin = 4000000000UL;
+    lcdFormatStatus(s, rows);
+    TEST_ASSERT_EQUAL_STRING("v4.1 Batt:USB", rows[3]);
+    for (int r = 0; r < LCD_ROWS; r++) TEST_ASSERT_LESS_OR_EQUAL(LCD_COLS, strlen(rows[r]));
+}
+
+void test_padded_row_covers_the_glass() {
+    char line[LCD_COLS + 1];
+    lcdPadRow(line, "HR:9 BPM");
+    TEST_ASSERT_EQUAL_STRING("HR:9 BPM            ", line);
+    lcdPadRow(line, "");
+    TEST_ASSERT_EQUAL(LCD_COLS, strlen(line));
+    lcdPadRow(line, "0123456789abcdefghijKLM");
+    TEST_ASSERT_EQUAL_STRING("0123456789abcdefghij", line);
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_vitals_screen);
+    RUN_TEST(test_long_fields_are_cut);
+    RUN_TEST(test_status_screen);
+    RUN_TEST(test_padded_row_covers_the_glass);
+    return UNITY_END();
+}
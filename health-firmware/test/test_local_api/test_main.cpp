@@ -0,0 +1,236 @@
+// Local API over real loopback sockets (host/WiFi.h): HTTP routes, the
+// RFC 6455 handshake, WebSocket frames split across segments, history
+// streaming within the per-pass budget, and the connection limit.
+
+#include <unity.h>
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <string>
+
+#define LOCAL_API_PORT 18080
+#define LOCAL_API_MAX_CLIENTS 4
+#define LOCAL_API_BUDGET_US 2000
+#define LOCAL_API_REQUEST_TIMEOUT_MS 2000
+#define LOCAL_API_HISTORY_MAX 96
+
+#include "local_api.h"
+
+static const char SNAPSHOT[] = "{\"device_id\":\"DEV\",\"heart_rate\":61}";
+static const uint32_t NEWEST = 200;
+static const uint32_t READ_COST_US = 700;   // a LittleFS read of a few records
+static uint32_t historyReads = 0;
+
+size_t formatVitalsSnapshot(char* buf, size_t cap) { return snprintf(buf, cap, "%s", SNAPSHOT); }
+
+uint32_t localApiNewestSeq() { return NEWEST; }
+
+// Seqs 1..NEWEST, every 10th one a gap placeholder
+uint32_t localApiReadHistory(uint32_t from, VitalsRecord* dst, uint32_t maxCount) {
+    historyReads++;
+    delayMicroseconds(READ_COST_US);
+    uint32_t n = 0;
+    for (uint32_t seq = from; seq <= NEWEST && n < maxCount; seq++, n++) {
+        VitalsRecord r = {};
+        r.seq = seq;
+        r.timestamp = 1700000000 + seq * 5;
+        r.heartRate = 60;
+        r.spo2 = 97;
+        r.tempCenti = 3650;
+        r.flags = (seq % 10 == 0) ? VR_GAP : 0;
+        dst[n] = r;
+    }
+    return n;
+}
+
+static LocalApiServer* api;
+
+void setUp() {}
+void tearDown() {}
+
+// ==================== LOOPBACK CLIENT ====================
+static int connectClient() {
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    struct sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(LOCAL_API_PORT);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    TEST_ASSERT_EQUAL(0, connect(fd, (struct sockaddr*)&addr, sizeof(addr)));
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+    return fd;
+}
+
+static void sendAll(int fd, const void* data, size_t n) {
+    TEST_ASSERT_EQUAL((ssize_t)n, send(fd, data, n, 0));
+}
+
+static void sendText(int fd, const char* text) { sendAll(fd, text, strlen(text)); }
+
+// Runs service() passes and collects what the server sends until `done`
+// holds or the peer closes. Returns false on EOF.
+template <typename Done>
+static bool pump(int fd, std::string& got, Done done, int passes = 2000) {
+    for (int i = 0; i < passes; i++) {
+        api->service();
+        char buf[4096];
+        ssize_t n = recv(fd, buf, sizeof(buf), 0);
+        if (n > 0) got.append(buf, n);
+        if (done(got)) return true;
+        if (n == 0) return false;
+        usleep(200);
+    }
+    return true;
+}
+
+static std::string request(const char* text) {
+    int fd = connectClient();
+    sendText(fd, text);
+    std::string got;
+    pump(fd, got, [](const std::string&) { return false; });
+    close(fd);
+    return got;
+}
+
+static std::string frameText(const std::string& stream, size_t at) {
+    TEST_ASSERT_TRUE(stream.size() >= at + 2);
+    size_t len = (uint8_t)stream[at + 1];
+    size_t hdr = 2;
+    if (len == 126) {
+        len = ((uint8_t)stream[at + 2] << 8) | (uint8_t)stream[at + 3];
+        hdr = 4;
+    }
+    return stream.substr(at + hdr, len);
+}
+
+// ==================== TESTS ====================
+void test_latest_snapshot() {
+    std::string got = request("GET /vitals/latest HTTP/1.1\r\nHost: x\r\n\r\n");
+    TEST_ASSERT_EQUAL(0, got.find("HTTP/1.1 200 OK\r\n"));
+    char length[40];
+    snprintf(length, sizeof(length), "Content-Length: %u\r\n", (unsigned)strlen(SNAPSHOT));
+    TEST_ASSERT_TRUE(got.find(length) != std::string::npos);
+    TEST_ASSERT_EQUAL_STRING(SNAPSHOT, got.substr(got.find("\r\n\r\n") + 4).c_str());
+}
+
+void test_unknown_path_and_method() {
+    TEST_ASSERT_EQUAL(0, request("GET /nope HTTP/1.1\r\n\r\n").find("HTTP/1.1 404"));
+    TEST_ASSERT_EQUAL(0, request("POST /vitals/latest HTTP/1.1\r\n\r\n").find("HTTP/1.1 405"));
+}
+
+// The handshake example from RFC 6455 section 1.3
+void test_websocket_handshake_and_ping() {
+    int fd = connectClient();
+    sendText(fd, "GET /ws HTTP/1.1\r\nHost: x\r\nUpgrade: websocket\r\nConnection: Upgrade\r\n"
+                 "Sec-WebSocket-Key: dGhlIHNhbXBsZSBub25jZQ==\r\nSec-WebSocket-Version: 13\r\n\r\n");
+    std::string got;
+    size_t body = 0;
+    pump(fd, got, [&](const std::string& g) {
+        body = g.find("\r\n\r\n");
+        return body != std::string::npos && g.size() >= body + 4 + 2 + strlen(SNAPSHOT);
+    });
+    TEST_ASSERT_EQUAL(0, got.find("HTTP/1.1 101 Switching Protocols\r\n"));
+    TEST_ASSERT_TRUE(got.find("Sec-WebSocket-Accept: s3pPLMBiTxaQ9kYGzzhZRbK+xOo=\r\n") != std::string::npos);
+    TEST_ASSERT_EQUAL(0x81, (uint8_t)got[body + 4]);
+    TEST_ASSERT_EQUAL_STRING(SNAPSHOT, frameText(got, body + 4).c_str());
+
+    // Masked ping "hi", split inside the mask: nothing may happen until it is whole
+    const uint8_t ping[] = {0x89, 0x82, 0x11, 0x22, 0x33, 0x44, 'h' ^ 0x11, 'i' ^ 0x22};
+    got.clear();
+    sendAll(fd, ping, 4);
+    pump(fd, got, [](const std::string&) { return false; }, 50);
+    TEST_ASSERT_EQUAL(0, got.size());
+    sendAll(fd, ping + 4, sizeof(ping) - 4);
+    pump(fd, got, [](const std::string& g) { return g.size() >= 4; });
+    TEST_ASSERT_EQUAL(0x8A, (uint8_t)got[0]);
+    TEST_ASSERT_EQUAL_STRING("hi", frameText(got, 0).c_str());
+
+    // Pushes arrive as text frames
+    got.clear();
+    api->pushSnapshot();
+    pump(fd, got, [](const std::string& g) { return g.size() >= 2 + strlen(SNAPSHOT); });
+    TEST_ASSERT_EQUAL_STRING(SNAPSHOT, frameText(got, 0).c_str());
+
+    // Close is echoed, then the server hangs up
+    const uint8_t closeFrame[] = {0x88, 0x80, 1, 2, 3, 4};
+    got.clear();
+    sendAll(fd, closeFrame, sizeof(closeFrame));
+    TEST_ASSERT_FALSE(pump(fd, got, [](const std::string&) { return false; }));
+    TEST_ASSERT_EQUAL(0x88, (uint8_t)got[0]);
+    close(fd);
+}
+
+void test_websocket_key_missing_or_oversized() {
+    TEST_ASSERT_EQUAL(0, request("GET /ws HTTP/1.1\r\nUpgrade: websocket\r\n\r\n").find("HTTP/1.1 400"));
+    std::string longKey = "GET /ws HTTP/1.1\r\nSec-WebSocket-Key: " + std::string(40, 'A') + "\r\n\r\n";
+    TEST_ASSERT_EQUAL(0, request(longKey.c_str()).find("HTTP/1.1 400"));
+}
+
+void test_history_is_streamed_within_budget() {
+    int fd = connectClient();
+    sendText(fd, "GET /vitals/history?limit=96 HTTP/1.1\r\n\r\n");
+    usleep(2000);
+
+    // The first pass reads the request and stops once the budget is spent
+    historyReads = 0;
+    uint64_t t0 = hostclock::nowUs;
+    api->service();
+    TEST_ASSERT_LESS_OR_EQUAL(LOCAL_API_BUDGET_US + READ_COST_US, hostclock::nowUs - t0);
+    TEST_ASSERT_LESS_THAN(96 / 8, historyReads);
+
+    std::string got;
+    TEST_ASSERT_FALSE(pump(fd, got, [](const std::string&) { return false; }));
+    close(fd);
+    std::string body = got.substr(got.find("\r\n\r\n") + 4);
+    TEST_ASSERT_EQUAL('[', body[0]);
+    TEST_ASSERT_EQUAL(']', body[body.size() - 1]);
+
+    // Seqs 105..200 without the gap placeholders (every 10th), in order
+    int rows = 0;
+    uint32_t last = 0;
+    for (size_t at = body.find("\"seq\":"); at != std::string::npos; at = body.find("\"seq\":", at + 1)) {
+        uint32_t seq = strtoul(body.c_str() + at + 6, nullptr, 10);
+        TEST_ASSERT_GREATER_THAN(last, seq);
+        TEST_ASSERT_NOT_EQUAL(0u, seq % 10);
+        last = seq;
+        rows++;
+    }
+    TEST_ASSERT_EQUAL(96 - 10, rows);
+    TEST_ASSERT_EQUAL(NEWEST - 1, last);
+    TEST_ASSERT_TRUE(body.find(",,") == std::string::npos && body.find("[,") == std::string::npos);
+}
+
+void test_connection_limit() {
+    int fds[LOCAL_API_MAX_CLIENTS];
+    for (int i = 0; i < LOCAL_API_MAX_CLIENTS; i++) {
+        fds[i] = connectClient();
+        usleep(1000);
+        api->service();
+    }
+    int extra = connectClient();
+    std::string got;
+    TEST_ASSERT_FALSE(pump(extra, got, [](const std::string&) { return false; }));
+    TEST_ASSERT_EQUAL(0, got.find("HTTP/1.1 503"));
+    close(extra);
+
+    // Idle sockets are dropped after the request timeout
+    for (int i = 0; i < LOCAL_API_MAX_CLIENTS; i++) close(fds[i]);
+    delay(LOCAL_API_REQUEST_TIMEOUT_MS + 1);
+    for (int i = 0; i < 10; i++) api->service();
+    TEST_ASSERT_EQUAL(0, request("GET /vitals/latest HTTP/1.1\r\n\r\n").find("HTTP/1.1 200"));
+}
+
+int main() {
+    static LocalApiServer server;
+    api = &server;
+    server.begin();
+    UNITY_BEGIN();
+    RUN_TEST(test_latest_snapshot);
+    RUN_TEST(test_unknown_path_and_method);
+    RUN_TEST(test_websocket_handshake_and_ping);
+    RUN_TEST(test_websocket_key_missing_or_oversized);
+    RUN_TEST(test_history_is_streamed_within_budget);
+    RUN_TEST(test_connection_limit);
+    return UNITY_END();
+}
@@ -0,0 +1,185 @@
+// Max30102Fifo against the register emulator (host/max30102_emu.h): pacing,
+// the exactly-full FIFO (pointers meet, no overflow yet), an A_FULL raised
+// mid-drain not taken for a full FIFO later, overflow accounting, and the
+// gap marker landing right where samples were dropped.
+
+#include <unity.h>
+
+#include "Arduino.h"
+#include "max30102_emu.h"
+#define MAX30102_I2C_ADDR Max30102Emu::ADDRESS
+#include "max30102_fifo.h"
+
+// IR and red rise 10000 counts per second, so consecutive FIFO samples
+// differ by a fixed step and a hole shows up as a larger one.
+class Ramp : public SignalSource {
+public:
+    void sample(double tSec, double& red, double& ir) override { red = ir = 1000 + 10000 * tSec; }
+};
+
+struct CheckingSink {
+    uint32_t samples = 0;
+    uint32_t gaps = 0;
+    uint32_t jumps = 0;          // steps well above one sample period
+    uint32_t jumpsAtGap = 0;     // ... that were announced by onGap()
+    uint32_t last = 0;
+    bool gapSeen = false;
+
+    void onGap() {
+        gaps++;
+        gapSeen = true;
+    }
+    void onSample(uint32_t red, uint32_t ir) {
+        TEST_ASSERT_EQUAL_UINT32(red, ir);
+        if (samples > 0 && ir - last > 600) {   // one sample is 400 counts at 25/s
+            jumps++;
+            if (gapSeen) jumpsAtGap++;
+        }
+        gapSeen = false;
+        last = ir;
+        samples++;
+    }
+};
+
+static Ramp ramp;
+static Max30102Emu* emu;
+
+static void writeReg(uint8_t reg, uint8_t v) {
+    Wire.beginTransmission(Max30102Emu::ADDRESS);
+    Wire.write(reg);
+    Wire.write(v);
+    Wire.endTransmission();
+}
+
+// The firmware's configuration: SpO2 mode, 100 sps / avg 4 (25 samples/s
+// out), rollover off, A_FULL at 0 free slots
+void setUp() {
+    hostclock::nowUs = 1000000;
+    emu = new Max30102Emu(&ramp);
+    Wire.attach(emu);
+    writeReg(Max30102Emu::FIFO_CONFIG, 2 << 5);
+    writeReg(Max30102Emu::SPO2_CONFIG, (1 << 5) | (1 << 2) | 3);
+    writeReg(Max30102Emu::LED1_PA, 0x7F);
+    writeReg(Max30102Emu::LED2_PA, 0x7F);
+    writeReg(Max30102Emu::MODE_CONFIG, 0x03);
+}
+
+void tearDown() {
+    Wire.detach(emu);
+    delete emu;
+}
+
+void test_poll_is_paced() {
+    Max30102Fifo fifo;
+    CheckingSink sink;
+    TEST_ASSERT_GREATER_OR_EQUAL(0, fifo.poll(40000, sink));
+    delay(10);
+    TEST_ASSERT_EQUAL(-1, fifo.poll(40000, sink));
+    delay(30);
+    TEST_ASSERT_GREATER_OR_EQUAL(0, fifo.poll(40000, sink));
+}
+
+// Steady polling at the FIFO rate sees every sample, in order
+void test_steady_polling_loses_nothing() {
+    Max30102Fifo fifo;
+    CheckingSink sink;
+    while (hostclock::nowUs < 10000000ULL) {
+        fifo.poll(40000, sink);
+        delay(2);
+    }
+    emu->sync();
+    TEST_ASSERT_EQUAL(0, emu->getStats().dropped);
+    TEST_ASSERT_EQUAL_UINT32(emu->getStats().pushed - emu->queued(), sink.samples);
+    TEST_ASSERT_EQUAL_UINT32(sink.samples, fifo.getStats().samples);
+    TEST_ASSERT_EQUAL_UINT32(0, sink.jumps);
+    TEST_ASSERT_EQUAL_UINT32(0, sink.gaps);
+    TEST_ASSERT_LESS_OR_EQUAL(3, fifo.getStats().maxDepth);
+}
+
+// 32 queued, nothing dropped yet: WR_PTR == RD_PTR and OVF_COUNTER == 0,
+// exactly like an empty FIFO. A_FULL must tell them apart.
+void test_exactly_full_fifo_is_read() {
+    Max30102Fifo fifo;
+    CheckingSink sink;
+    fifo.poll(0, sink);
+    uint32_t before = sink.samples;
+    while (emu->queued() < Max30102Fifo::DEPTH) {
+        delay(1);
+        emu->sync();
+    }
+    TEST_ASSERT_EQUAL(0, emu->peekRegister(Max30102Emu::OVF_COUNTER));
+    TEST_ASSERT_EQUAL(Max30102Fifo::DEPTH, fifo.poll(0, sink));
+    TEST_ASSERT_EQUAL_UINT32(before + Max30102Fifo::DEPTH, sink.samples);
+    TEST_ASSERT_EQUAL(Max30102Fifo::DEPTH, fifo.getStats().maxDepth);
+    TEST_ASSERT_EQUAL_UINT32(0, fifo.getStats().lost);
+
+    // The A_FULL flag was consumed: an empty FIFO right after reads as empty
+    TEST_ASSERT_EQUAL(0, fifo.poll(0, sink));
+}
+
+// A sample pushed between the pointer read and the first pop fills the
+// FIFO for a moment and raises A_FULL after the poll sized its read. Once
+// the FIFO has been drained, the next poll that finds it empty must not
+// take that flag for a full FIFO and read 32 stale samples.
+void test_a_full_raised_mid_drain_is_not_stale() {
+    Max30102Fifo fifo;
+    CheckingSink sink;
+    fifo.poll(0, sink);
+    uint32_t before = sink.samples;
+    while (emu->queued() < Max30102Fifo::DEPTH - 1) {
+        delayMicroseconds(10);
+        emu->sync();
+    }
+    // The 32nd sample is due 40 ms after the 31st: start the poll so it
+    // lands just after the pointer read
+    delayMicroseconds(40000 - 700);
+    emu->resetStats();
+    TEST_ASSERT_EQUAL(Max30102Fifo::DEPTH - 1, fifo.poll(0, sink));
+    TEST_ASSERT_EQUAL(Max30102Fifo::DEPTH, emu->getStats().maxDepth);
+    TEST_ASSERT_EQUAL(0, emu->getStats().dropped);
+
+    TEST_ASSERT_EQUAL(1, fifo.poll(0, sink));
+    TEST_ASSERT_EQUAL(0, fifo.poll(0, sink));
+    TEST_ASSERT_EQUAL(0, fifo.poll(0, sink));
+    TEST_ASSERT_EQUAL_UINT32(before + Max30102Fifo::DEPTH, sink.samples);
+    TEST_ASSERT_EQUAL_UINT32(0, sink.jumps);
+}
+
+// A stall past 32 samples: the overflow is counted, and the next sample
+// read (the first after the hole) is announced with onGap()
+void test_overflow_is_counted_and_marked() {
+    Max30102Fifo fifo;
+    CheckingSink sink;
+    while (hostclock::nowUs < 3000000ULL) {
+        fifo.poll(40000, sink);
+        delay(2);
+    }
+    delay(2000);   // 50 samples due, 18 dropped
+    while (hostclock::nowUs < 7000000ULL) {
+        fifo.poll(40000, sink);
+        delay(2);
+    }
+    emu->sync();
+    const Max30102Fifo::Stats& st = fifo.getStats();
+    TEST_ASSERT_EQUAL_UINT32(1, st.overflows);
+    // A sample dropped between the pointer read and the first FIFO_DATA
+    // pop is cleared with OVF_COUNTER unseen, so lost may be one short
+    TEST_ASSERT_LESS_OR_EQUAL(emu->getStats().dropped, st.lost);
+    TEST_ASSERT_GREATER_OR_EQUAL(emu->getStats().dropped - 1, st.lost);
+    TEST_ASSERT_GREATER_OR_EQUAL(17, st.lost);
+    TEST_ASSERT_EQUAL(Max30102Fifo::DEPTH, st.maxDepth);
+    TEST_ASSERT_EQUAL_UINT32(1, sink.gaps);
+    TEST_ASSERT_EQUAL_UINT32(1, sink.jumps);
+    TEST_ASSERT_EQUAL_UINT32(1, sink.jumpsAtGap);
+    TEST_ASSERT_EQUAL_UINT32(emu->getStats().pushed - emu->queued(), sink.samples);
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_poll_is_paced);
+    RUN_TEST(test_steady_polling_loses_nothing);
+    RUN_TEST(test_exactly_full_fifo_is_read);
+    RUN_TEST(test_a_full_raised_mid_drain_is_not_stale);
+    RUN_TEST(test_overflow_is_counted_and_marked);
+    return UNITY_END();
+}
@@ -0,0 +1,157 @@
+// MAX30102Sensor against the register emulator with a synthetic finger,
+// called once per millisecond like the main loop: update() passes without a
+// new FIFO sample leave the DSP untouched, and the DSP state after N samples
+// does not depend on how often the loop runs.
+
+#include <unity.h>
+#include <string>
+
+#include "Arduino.h"
+#include "max30102_emu.h"
+
+#define MAX30102_I2C_ADDR Max30102Emu::ADDRESS
+#define MAX30102_SATURATED 250000
+#define MORPH_BUF_SAMPLES 64
+#define MORPH_BEATS 16
+#include "max30102_sensor.h"
+
+static Max30102Emu* emu;
+static SyntheticPpg* ppg;
+static uint32_t liveSamples;
+
+static void writeReg(uint8_t reg, uint8_t v) {
+    Wire.beginTransmission(Max30102Emu::ADDRESS);
+    Wire.write(reg);
+    Wire.write(v);
+    Wire.endTransmission();
+}
+
+// The firmware's configuration: SpO2 mode, 100 sps / avg 4 (25 samples/s
+// out), 411 us pulses, 4096 nA range, rollover off, A_FULL at 0 free slots
+bool max30102Setup(uint8_t ledAmplitude, uint32_t& firstIr) {
+    writeReg(Max30102Emu::FIFO_CONFIG, 2 << 5);
+    writeReg(Max30102Emu::SPO2_CONFIG, (1 << 5) | (1 << 2) | 3);
+    writeReg(Max30102Emu::LED1_PA, ledAmplitude);
+    writeReg(Max30102Emu::LED2_PA, ledAmplitude);
+    writeReg(Max30102Emu::MODE_CONFIG, 0x03);
+    firstIr = 0;
+    return true;
+}
+void max30102SetPower(uint8_t, int) {}
+void max30102BusRecover() {}
+uint32_t max30102FingerIr() { return 4000; }
+uint32_t max30102FingerRed() { return 15000; }
+void liveStreamSample(uint32_t) { liveSamples++; }
+void liveStreamGap() {}
+void captureSample(uint32_t, uint32_t) {}
+void captureGap() {}
+void rollupBeat(const char*, unsigned long) {}
+void rhythmBeat(uint16_t) {}
+void rhythmGap() {}
+void rhythmReset() {}
+
+// printState() text, to compare the DSP state between calls
+class StringPrint : public Print {
+public:
+    std::string text;
+    using Print::write;
+    size_t write(uint8_t b) override {
+        text += (char)b;
+        return 1;
+    }
+};
+
+// The first two lines: raw values, DC/AC, threshold, rate and SpO2 state
+static std::string dspState(MAX30102Sensor& s) {
+    StringPrint p;
+    s.printState(p);
+    size_t first = p.text.find('\n');
+    return p.text.substr(0, p.text.find('\n', first + 1));
+}
+
+static void run(MAX30102Sensor& s, unsigned long ms, unsigned long stepMs) {
+    unsigned long end = millis() + ms;
+    while ((long)(millis() - end) < 0) {
+        s.update();
+        delay(stepMs);
+    }
+}
+
+void setUp() {
+    hostclock::nowUs = 1000000;
+    ppg = new SyntheticPpg(7);
+    ppg->heartRateBpm = 72;
+    ppg->spo2 = 97;
+    ppg->noise = 0;
+    emu = new Max30102Emu(ppg);
+    Wire.attach(emu);
+    liveSamples = 0;
+}
+
+void tearDown() {
+    Wire.detach(emu);
+    delete emu;
+    delete ppg;
+}
+
+// Between FIFO samples update() polls nothing new (paced out, or an empty
+// FIFO) and must not touch the DSP
+void test_update_without_new_samples_changes_nothing() {
+    MAX30102Sensor s;
+    TEST_ASSERT_TRUE(s.begin());
+    run(s, 10000, 1);
+    TEST_ASSERT_TRUE(s.isFingerDetected());
+
+    // Right after a sample: the next one is 40 ms away
+    uint32_t samples = s.getFifoStats().samples;
+    while (s.getFifoStats().samples == samples) {
+        s.update();
+        delay(1);
+    }
+    std::string before = dspState(s);
+    samples = s.getFifoStats().samples;
+    for (int i = 0; i < 30; i++) {
+        s.update();
+        delay(1);
+    }
+    TEST_ASSERT_EQUAL_UINT32(samples, s.getFifoStats().samples);
+    TEST_ASSERT_EQUAL_STRING(before.c_str(), dspState(s).c_str());
+}
+
+// printState()'s first line: raw values and the DC/AC split
+static std::string dcState(MAX30102Sensor& s) {
+    StringPrint p;
+    s.printState(p);
+    return p.text.substr(0, p.text.find('\n'));
+}
+
+// The DC averages only depend on the samples fed in, so a 1 ms loop and a
+// 40 ms loop end up in the same state after the same samples
+void test_fast_loop_matches_a_slow_one() {
+    const uint32_t N = 500;
+    MAX30102Sensor fast;
+    TEST_ASSERT_TRUE(fast.begin());
+    run(fast, N * 40, 1);
+    uint32_t samples = fast.getFifoStats().samples;
+    std::string fastState = dcState(fast);
+    TEST_ASSERT_TRUE(fast.isFingerDetected());
+    TEST_ASSERT_EQUAL_UINT32(samples, liveSamples);
+
+    tearDown();
+    setUp();
+    MAX30102Sensor slow;
+    TEST_ASSERT_TRUE(slow.begin());
+    while (slow.getFifoStats().samples < samples) {
+        slow.update();
+        delay(40);
+    }
+    TEST_ASSERT_EQUAL_UINT32(samples, slow.getFifoStats().samples);
+    TEST_ASSERT_EQUAL_STRING(fastState.c_str(), dcState(slow).c_str());
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_update_without_new_samples_changes_nothing);
+    RUN_TEST(test_fast_loop_matches_a_slow_one);
+    return UNITY_END();
+}
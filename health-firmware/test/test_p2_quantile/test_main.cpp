@@ -0,0 +1,139 @@
+// P2Quantile / QuantileSketch: exact nearest rank until five samples, then
+// estimates within a few percent of the sorted-sample quantile for the
+// distributions the rollups see (HR, SpO2, beat intervals), including
+// monotonic and constant input.
+
+#include <unity.h>
+#include <algorithm>
+#include <vector>
+
+#include "Arduino.h"
+#include "p2_quantile.h"
+
+void setUp() {}
+void tearDown() {}
+
+static uint32_t seed;
+
+static float uniform() {
+    seed = seed * 1103515245 + 12345;
+    return (seed >> 8) / 16777216.0f;
+}
+
+// Nearest-rank quantile of the samples
+static float exact(std::vector<float> xs, float p) {
+    std::sort(xs.begin(), xs.end());
+    return xs[(size_t)lroundf(p * (xs.size() - 1))];
+}
+
+// Feeds xs to a p5/p50/p95 sketch and checks each estimate against the
+// exact quantile, within tol of the sample range.
+static void checkSketch(const std::vector<float>& xs, float tol) {
+    QuantileSketch s;
+    for (float x : xs) s.add(x);
+    TEST_ASSERT_EQUAL_UINT32(xs.size(), s.count());
+    float range = *std::max_element(xs.begin(), xs.end()) - *std::min_element(xs.begin(), xs.end());
+    TEST_ASSERT_FLOAT_WITHIN(tol * range, exact(xs, 0.05f), s.lo.value());
+    TEST_ASSERT_FLOAT_WITHIN(tol * range, exact(xs, 0.5f), s.mid.value());
+    TEST_ASSERT_FLOAT_WITHIN(tol * range, exact(xs, 0.95f), s.hi.value());
+    TEST_ASSERT_TRUE(s.lo.value() <= s.mid.value() && s.mid.value() <= s.hi.value());
+}
+
+void test_empty_and_first_samples_are_exact() {
+    P2Quantile q(0.5);
+    TEST_ASSERT_TRUE(isnan(q.value()));
+    const float xs[] = {72, 60, 90, 65};
+    for (float x : xs) q.add(x);
+    TEST_ASSERT_EQUAL_UINT32(4, q.samples());
+    TEST_ASSERT_EQUAL_FLOAT(72, q.value());   // sorted 60 65 72 90, rank round(1.5)
+
+    P2Quantile lo(0.05), hi(0.95);
+    for (float x : xs) { lo.add(x); hi.add(x); }
+    TEST_ASSERT_EQUAL_FLOAT(60, lo.value());
+    TEST_ASSERT_EQUAL_FLOAT(90, hi.value());
+}
+
+void test_fifth_sample_initialises_markers() {
+    P2Quantile q(0.5);
+    const float xs[] = {5, 1, 4, 2, 3};
+    for (float x : xs) q.add(x);
+    TEST_ASSERT_EQUAL_FLOAT(3, q.value());
+}
+
+void test_uniform_heart_rate() {
+    seed = 1;
+    std::vector<float> xs;
+    for (int i = 0; i < 5000; i++) xs.push_back(50 + 70 * uniform());
+    checkSketch(xs, 0.02f);
+}
+
+// SpO2-like: mostly 95..99 with occasional desaturations
+void test_skewed_spo2() {
+    seed = 2;
+    std::vector<float> xs;
+    for (int i = 0; i < 5000; i++) {
+        float x = 95 + 4 * uniform();
+        if (uniform() < 0.08f) x = 82 + 12 * uniform();
+        xs.push_back(x);
+    }
+    checkSketch(xs, 0.03f);
+}
+
+// Beat intervals with a few missed beats (double intervals)
+void test_beat_intervals_with_outliers() {
+    seed = 3;
+    std::vector<float> xs;
+    for (int i = 0; i < 3000; i++) {
+        float ibi = 800 + 80 * (uniform() + uniform() + uniform() - 1.5f);
+        if (uniform() < 0.02f) ibi *= 2;
+        xs.push_back(ibi);
+    }
+    checkSketch(xs, 0.03f);
+}
+
+// Monotonic input keeps moving the extreme markers every sample
+void test_sorted_input() {
+    std::vector<float> up, down;
+    for (int i = 0; i < 2000; i++) {
+        up.push_back(i);
+        down.push_back(2000 - i);
+    }
+    checkSketch(up, 0.02f);
+    checkSketch(down, 0.02f);
+}
+
+void test_constant_input_stays_exact() {
+    QuantileSketch s;
+    for (int i = 0; i < 1000; i++) s.add(97);
+    TEST_ASSERT_EQUAL_FLOAT(97, s.lo.value());
+    TEST_ASSERT_EQUAL_FLOAT(97, s.mid.value());
+    TEST_ASSERT_EQUAL_FLOAT(97, s.hi.value());
+}
+
+// A window reset must forget the old markers entirely
+void test_reset_starts_a_new_window() {
+    QuantileSketch s;
+    for (int i = 0; i < 500; i++) s.add(120);
+    s.reset();
+    TEST_ASSERT_EQUAL_UINT32(0, s.count());
+    TEST_ASSERT_TRUE(isnan(s.mid.value()));
+    seed = 4;
+    std::vector<float> xs;
+    for (int i = 0; i < 1000; i++) xs.push_back(55 + 10 * uniform());
+    for (float x : xs) s.add(x);
+    TEST_ASSERT_FLOAT_WITHIN(0.5f, exact(xs, 0.95f), s.hi.value());
+    TEST_ASSERT_LESS_THAN(66, s.hi.value());
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_empty_and_first_samples_are_exact);
+    RUN_TEST(test_fifth_sample_initialises_markers);
+    RUN_TEST(test_uniform_heart_rate);
+    RUN_TEST(test_skewed_spo2);
+    RUN_TEST(test_beat_intervals_with_outliers);
+    RUN_TEST(test_sorted_input);
+    RUN_TEST(test_constant_input_stays_exact);
+    RUN_TEST(test_reset_starts_a_new_window);
+    return UNITY_END();
+}
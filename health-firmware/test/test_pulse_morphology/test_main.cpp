@@ -0,0 +1,154 @@
+// PulseMorphology on synthetic 25 sps IR pulses with known shape: the
+// features land within a sample's interpolation error, a gap with reset()
+// never yields an interval across it, a beat event on the diastolic wave
+// does not split the pulse, and held beats are numbered for the uplink.
+
+#include <unity.h>
+
+#include "Arduino.h"
+
+#define MORPH_BUF_SAMPLES 64
+#define MORPH_BEATS 16
+#include "pulse_morphology.h"
+
+static const float SAMPLE_MS = 40;
+static const float IR_DC = 100000;
+static const float IR_AC = 1000;     // perfusion index 1 %
+
+// Pulse shape over one cycle (phase 0..1): systolic peak at 0.15 and, when
+// reflected > 0, a diastolic wave at 0.45 of that relative height. Raw IR
+// falls as blood volume rises.
+struct PulseSource {
+    float periodMs;
+    float reflected;
+
+    uint32_t ir(float tMs) const {
+        float ph = fmodf(tMs, periodMs) / periodMs;
+        float sys = expf(-(ph - 0.15f) * (ph - 0.15f) / (2 * 0.06f * 0.06f));
+        float dia = reflected * expf(-(ph - 0.45f) * (ph - 0.45f) / (2 * 0.07f * 0.07f));
+        return (uint32_t)lroundf(IR_DC - IR_AC * (sys + dia));
+    }
+};
+
+// Feeds `seconds` of samples from sample index *n on, calling onBeat() on
+// each upstroke (phase 0.12, where detectBeat() fires) and, with
+// `onDiastole`, again on the diastolic wave
+static void run(PulseMorphology& m, const PulseSource& src, uint32_t& n, float seconds, bool onDiastole = false) {
+    uint32_t end = n + (uint32_t)(seconds * 1000 / SAMPLE_MS);
+    for (; n < end; n++) {
+        float t = n * SAMPLE_MS;
+        m.addSample(src.ir(t));
+        float prev = fmodf(t - SAMPLE_MS + src.periodMs, src.periodMs) / src.periodMs;
+        float ph = fmodf(t, src.periodMs) / src.periodMs;
+        if (prev < 0.12f && ph >= 0.12f) m.onBeat();
+        if (onDiastole && prev < 0.40f && ph >= 0.40f) m.onBeat();
+    }
+}
+
+void setUp() {}
+void tearDown() {}
+
+void test_features_of_a_reflected_pulse() {
+    static PulseMorphology m;
+    m = PulseMorphology();
+    PulseSource src = {1000, 0.4f};
+    uint32_t n = 0;
+    run(m, src, n, 20);
+    TEST_ASSERT_GREATER_OR_EQUAL(16, m.beatCount());
+
+    const PulseFeatures* f = m.latest();
+    TEST_ASSERT_NOT_NULL(f);
+    TEST_ASSERT_INT_WITHIN(5, 1000, f->ibiMs);
+    TEST_ASSERT_INT_WITHIN(20, 129, f->riseMs);     // foot (10 %) to peak of the systolic Gaussian
+    TEST_ASSERT_INT_WITHIN(20, 141, f->widthMs);    // its FWHM
+    TEST_ASSERT_NOT_EQUAL(0, f->notchMs);
+    TEST_ASSERT_TRUE(f->notchMs > f->riseMs && f->notchMs < 450);
+    TEST_ASSERT_INT_WITHIN(30, 300, f->dvpMs);
+    TEST_ASSERT_INT_WITHIN(6, 40, f->riPct);
+    TEST_ASSERT_INT_WITHIN(5, 100, f->piCenti);
+}
+
+void test_faster_pulse_interval() {
+    static PulseMorphology m;
+    m = PulseMorphology();
+    PulseSource src = {800, 0.4f};
+    uint32_t n = 0;
+    run(m, src, n, 20);
+    TEST_ASSERT_GREATER_OR_EQUAL(20, m.beatCount());
+    for (uint32_t b = m.firstHeld(0); b < m.beatCount(); b++) TEST_ASSERT_INT_WITHIN(5, 800, m.beat(b).ibiMs);
+}
+
+// Without a diastolic bump there is no notch to report
+void test_damped_pulse_has_no_notch() {
+    static PulseMorphology m;
+    m = PulseMorphology();
+    PulseSource src = {1000, 0};
+    uint32_t n = 0;
+    run(m, src, n, 10);
+    const PulseFeatures* f = m.latest();
+    TEST_ASSERT_NOT_NULL(f);
+    TEST_ASSERT_EQUAL(0, f->notchMs);
+    TEST_ASSERT_EQUAL(0, f->dvpMs);
+    TEST_ASSERT_EQUAL(0, f->riPct);
+    TEST_ASSERT_INT_WITHIN(20, 141, f->widthMs);
+}
+
+// Samples lost to a FIFO overflow: reset() keeps the interval that spans
+// the hole out of the record
+void test_reset_drops_the_interval_across_a_gap() {
+    static PulseMorphology m;
+    m = PulseMorphology();
+    PulseSource src = {1000, 0.4f};
+    uint32_t n = 0;
+    run(m, src, n, 6.3f);
+    uint32_t before = m.beatCount();
+    n += 12;                  // 480 ms never reach the ring
+    m.reset();
+    run(m, src, n, 10);
+    TEST_ASSERT_GREATER_THAN(before, m.beatCount());
+    for (uint32_t b = m.firstHeld(0); b < m.beatCount(); b++) TEST_ASSERT_INT_WITHIN(5, 1000, m.beat(b).ibiMs);
+}
+
+// A second event on the diastolic wave splits each cycle in two; the
+// fragment is rejected and the foot-to-foot interval is kept
+void test_event_on_the_diastolic_wave_does_not_split_the_pulse() {
+    static PulseMorphology m;
+    m = PulseMorphology();
+    PulseSource src = {1000, 0.4f};
+    uint32_t n = 0;
+    run(m, src, n, 3);
+    uint32_t settled = m.beatCount();
+    run(m, src, n, 15, true);
+    TEST_ASSERT_GREATER_OR_EQUAL(settled + 10, m.beatCount());
+    for (uint32_t b = max(settled, m.firstHeld(0)); b < m.beatCount(); b++)
+        TEST_ASSERT_INT_WITHIN(5, 1000, m.beat(b).ibiMs);
+}
+
+// Only the last MORPH_BEATS are held; the uplink is told where they start
+void test_held_beats_are_numbered() {
+    static PulseMorphology m;
+    m = PulseMorphology();
+    PulseSource src = {1000, 0.4f};
+    uint32_t n = 0;
+    TEST_ASSERT_NULL(m.latest());
+    TEST_ASSERT_EQUAL_UINT32(0, m.firstHeld(0));
+    run(m, src, n, 30);
+    uint32_t total = m.beatCount();
+    TEST_ASSERT_GREATER_THAN(MORPH_BEATS, total);
+    TEST_ASSERT_EQUAL_UINT32(total - MORPH_BEATS, m.firstHeld(0));
+    TEST_ASSERT_EQUAL_UINT32(total - 2, m.firstHeld(total - 2));
+    TEST_ASSERT_EQUAL_UINT32(total, m.firstHeld(total));
+    for (uint32_t b = m.firstHeld(0); b < total; b++) TEST_ASSERT_EQUAL_UINT32(b, m.beat(b).index);
+    TEST_ASSERT_EQUAL_UINT32(total - 1, m.latest()->index);
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_features_of_a_reflected_pulse);
+    RUN_TEST(test_faster_pulse_interval);
+    RUN_TEST(test_damped_pulse_has_no_notch);
+    RUN_TEST(test_reset_drops_the_interval_across_a_gap);
+    RUN_TEST(test_event_on_the_diastolic_wave_does_not_split_the_pulse);
+    RUN_TEST(test_held_beats_are_numbered);
+    return UNITY_END();
+}
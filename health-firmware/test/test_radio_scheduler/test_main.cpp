@@ -0,0 +1,196 @@
+// RadioScheduler with the UplinkScheduler, wired like loop() and
+// serviceUplink() in main.cpp: bursts open once per period, an alert onset
+// opens one at once, a failed alert upload is retried while the alert
+// stands, and once it clears the bursts go back to the period instead of
+// waking each other up.
+
+#include <unity.h>
+#include <vector>
+
+#include "Arduino.h"
+
+#define RADIO_BURST_MIN_MS 200
+#define RADIO_BURST_MAX_MS 3000
+#define RADIO_NTP_INTERVAL_MS 21600000
+#define RADIO_NTP_RETRY_MS 60000
+#include "radio_scheduler.h"
+
+#define UPLINK_QUEUE_DEPTH 4
+#define UPLINK_BUDGET_BPS 2048
+#define UPLINK_BUDGET_BURST 49152
+#include "uplink_scheduler.h"
+
+static const unsigned long CLOUD_SYNC_MS = 5000;
+static const unsigned long ALERT_RETRY_MS = 2000;
+static const unsigned long PASS_MS = 10;
+
+static int powerSaveCalls;
+void radioSetPowerSave(bool on) { powerSaveCalls++; }
+bool radioLinkUp() { return true; }
+void radioNtpStart() {}
+bool radioNtpSynced() { return true; }
+void radioNtpStop() {}
+
+static RadioScheduler* radio;
+static UplinkScheduler* uplink;
+static bool critical;            // currentVitals.isCriticalAlert
+static bool serverUp;
+static int posts;
+static uint32_t seq;
+static unsigned long alertRetryAt;
+static std::vector<unsigned long> opened;
+
+// runUplinkJob(), JOB_VITALS only
+static UplinkResult runJob(UplinkClass c, const UplinkJob& job) {
+    bool urgent = (c == UC_ALERT);
+    if (urgent && (long)(millis() - alertRetryAt) < 0) return UJ_WAIT;
+    posts++;
+    if (serverUp) return UJ_DONE;
+    if (urgent && critical) {
+        alertRetryAt = millis() + ALERT_RETRY_MS;
+        return UJ_KEEP;
+    }
+    return UJ_FAILED;
+}
+
+static bool serviceUplink() {
+    if (!radio->isAwake()) {
+        if (uplink->alertPending()) radio->wakeNow();
+        return false;
+    }
+    uplink->refill();
+    for (int c = 0; c < UC_COUNT; c++) {
+        UplinkClass cls = (UplinkClass)c;
+        UplinkJob* job = uplink->eligible(cls);
+        if (job == nullptr) continue;
+        UplinkResult r = runJob(cls, *job);
+        uplink->complete(cls, r, r == UJ_WAIT ? 0 : 200);
+        if (r != UJ_WAIT) return true;
+    }
+    return uplink->alertPending();
+}
+
+static void run(unsigned long ms) {
+    unsigned long end = millis() + ms;
+    while ((long)(millis() - end) < 0) {
+        if (radio->open(CLOUD_SYNC_MS)) {
+            opened.push_back(millis());
+            uplink->enqueueBurst(++seq);
+        }
+        radio->service(serviceUplink());
+        delay(PASS_MS);
+    }
+}
+
+static void alertOnset() {
+    critical = true;
+    uplink->enqueue(UC_ALERT, JOB_VITALS);
+    radio->wakeNow();
+}
+
+// Every burst opened after `from` follows the previous one by the period
+static void assertPeriodicFrom(unsigned long from) {
+    int checked = 0;
+    for (size_t i = 1; i < opened.size(); i++) {
+        if (opened[i - 1] < from) continue;
+        TEST_ASSERT_UINT32_WITHIN(PASS_MS, CLOUD_SYNC_MS, opened[i] - opened[i - 1]);
+        checked++;
+    }
+    TEST_ASSERT_GREATER_THAN(5, checked);
+}
+
+void setUp() {
+    hostclock::nowUs = 1000000;
+    static RadioScheduler r;
+    static UplinkScheduler u;
+    r = RadioScheduler();
+    u = UplinkScheduler();
+    radio = &r;
+    uplink = &u;
+    radio->begin();
+    critical = false;
+    serverUp = true;
+    posts = 0;
+    seq = 0;
+    alertRetryAt = 0;
+    powerSaveCalls = 0;
+    opened.clear();
+}
+
+void tearDown() {}
+
+void test_bursts_follow_the_period() {
+    run(60000);
+    assertPeriodicFrom(0);
+    TEST_ASSERT_EQUAL_UINT32(0, radio->getUrgentBursts());
+    TEST_ASSERT_EQUAL(uplink->queue(UC_VITALS).done, posts);
+    TEST_ASSERT_LESS_THAN(10.0f, radio->dutyPercent());
+}
+
+// An onset opens one burst at once; while the alert stands and after it
+// clears, bursts stay on the period and their uploads stay vitals class
+void test_period_returns_after_an_alert() {
+    run(12000);
+    unsigned long onset = millis();
+    alertOnset();
+    run(PASS_MS);
+    TEST_ASSERT_EQUAL_UINT32(onset, opened.back());
+    TEST_ASSERT_EQUAL_UINT32(1, radio->getUrgentBursts());
+    TEST_ASSERT_EQUAL_UINT32(1, uplink->queue(UC_ALERT).done);
+
+    run(30000);
+    critical = false;
+    unsigned long cleared = millis();
+    run(60000);
+    assertPeriodicFrom(onset + 1);
+    assertPeriodicFrom(cleared);
+    TEST_ASSERT_EQUAL_UINT32(1, radio->getUrgentBursts());
+    TEST_ASSERT_EQUAL_UINT32(1, uplink->queue(UC_ALERT).done);
+    TEST_ASSERT_EQUAL_UINT32(1, uplink->queue(UC_ALERT).coalesced);   // the onset burst's record
+    TEST_ASSERT_LESS_THAN(10.0f, radio->dutyPercent());
+}
+
+// The server is down through the alert: the alert upload is retried every
+// ALERT_RETRY_MS, burst records coalesce into it, and it is given up once
+// the alert clears
+void test_failed_alert_is_retried_until_it_clears() {
+    run(12000);
+    serverUp = false;
+    posts = 0;
+    alertOnset();
+    run(20000);
+    TEST_ASSERT_TRUE(uplink->alertPending());
+    TEST_ASSERT_INT_WITHIN(1, 20000 / ALERT_RETRY_MS, posts);
+    TEST_ASSERT_GREATER_THAN(0, uplink->queue(UC_ALERT).coalesced);
+    TEST_ASSERT_EQUAL_UINT32(0, uplink->queue(UC_VITALS).queued - uplink->queue(UC_VITALS).done);
+
+    critical = false;
+    run(ALERT_RETRY_MS);
+    TEST_ASSERT_FALSE(uplink->alertPending());
+    TEST_ASSERT_EQUAL_UINT32(1, uplink->queue(UC_ALERT).failed);
+
+    unsigned long cleared = millis();
+    uint32_t urgent = radio->getUrgentBursts();
+    run(60000);
+    assertPeriodicFrom(cleared);
+    TEST_ASSERT_EQUAL_UINT32(urgent, radio->getUrgentBursts());
+}
+
+// Queueing alone never wakes the radio
+void test_enqueue_does_not_wake() {
+    run(CLOUD_SYNC_MS + 1000);
+    TEST_ASSERT_FALSE(radio->isAwake());
+    uplink->enqueueBurst(++seq);
+    uplink->enqueue(UC_DIAG, JOB_DIAG);
+    TEST_ASSERT_FALSE(radio->open(CLOUD_SYNC_MS));
+    TEST_ASSERT_FALSE(radio->isAwake());
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_bursts_follow_the_period);
+    RUN_TEST(test_period_returns_after_an_alert);
+    RUN_TEST(test_failed_alert_is_retried_until_it_clears);
+    RUN_TEST(test_enqueue_does_not_wake);
+    return UNITY_END();
+}
@@ -0,0 +1,142 @@
+// RhythmScreen on interval sequences: sinus rhythm with the detector's
+// 40 ms sampling jitter stays regular, AF-like random intervals trip it and
+// sinus clears it again, ectopic beats alone do not, and gap() keeps
+// successive differences from spanning a break.
+
+#include <unity.h>
+
+#include "Arduino.h"
+
+#define RHYTHM_WINDOW_BEATS 64
+#define RHYTHM_BINS 16
+#define RHYTHM_NRMSSD_ON 0.10f
+#define RHYTHM_ENTROPY_ON 0.70f
+#define RHYTHM_NRMSSD_OFF 0.08f
+#define RHYTHM_ENTROPY_OFF 0.60f
+#include "rhythm_screen.h"
+
+static RhythmScreen rhythm;
+static uint32_t rng;
+
+static uint32_t nextRand() {
+    rng ^= rng << 13;
+    rng ^= rng >> 17;
+    rng ^= rng << 5;
+    return rng;
+}
+
+// Beats land on 40 ms FIFO polls, so intervals are a multiple of 40 ms
+static uint16_t quantized(float ms) { return (uint16_t)(lroundf(ms / 40) * 40); }
+
+static void sinus(int beats, float meanMs = 1000) {
+    for (int i = 0; i < beats; i++) rhythm.addBeat(quantized(meanMs + (int)(nextRand() % 41) - 20));
+}
+
+// Atrial fibrillation: intervals scattered over 450..1150 ms, no pattern
+static void fibrillation(int beats) {
+    for (int i = 0; i < beats; i++) rhythm.addBeat(quantized(450 + nextRand() % 701));
+}
+
+void setUp() {
+    rng = 0x2545F491;
+    rhythm = RhythmScreen();
+}
+
+void tearDown() {}
+
+void test_sinus_rhythm_is_regular() {
+    sinus(200);
+    TEST_ASSERT_FALSE(rhythm.isIrregular());
+    TEST_ASSERT_EQUAL(RHYTHM_WINDOW_BEATS, rhythm.windowLen());
+    TEST_ASSERT_LESS_THAN(0.05f, rhythm.getNRMSSD());
+    TEST_ASSERT_LESS_THAN(RHYTHM_ENTROPY_ON, rhythm.getEntropy());
+    TEST_ASSERT_EQUAL_UINT32(0, rhythm.episodeCount());
+}
+
+// Nothing is judged before the window holds RHYTHM_WINDOW_BEATS intervals
+void test_no_verdict_before_the_window_fills() {
+    fibrillation(RHYTHM_WINDOW_BEATS - 1);
+    TEST_ASSERT_FALSE(rhythm.isIrregular());
+    TEST_ASSERT_EQUAL_FLOAT(0, rhythm.getNRMSSD());
+    rhythm.addBeat(700);
+    TEST_ASSERT_TRUE(rhythm.isIrregular());
+}
+
+void test_fibrillation_trips_and_sinus_clears() {
+    sinus(80);
+    fibrillation(RHYTHM_WINDOW_BEATS);
+    TEST_ASSERT_TRUE(rhythm.isIrregular());
+    TEST_ASSERT_GREATER_THAN(RHYTHM_NRMSSD_ON, rhythm.getNRMSSD());
+    TEST_ASSERT_GREATER_THAN(RHYTHM_ENTROPY_ON, rhythm.getEntropy());
+    TEST_ASSERT_EQUAL_UINT32(1, rhythm.episodeCount());
+
+    // Still set while a few sinus beats are mixed in (hysteresis)
+    sinus(8);
+    TEST_ASSERT_TRUE(rhythm.isIrregular());
+
+    sinus(RHYTHM_WINDOW_BEATS);
+    TEST_ASSERT_FALSE(rhythm.isIrregular());
+    fibrillation(RHYTHM_WINDOW_BEATS);
+    TEST_ASSERT_EQUAL_UINT32(2, rhythm.episodeCount());
+}
+
+// Premature beat plus compensatory pause every 8th beat: large successive
+// differences, but the intervals sit in three bins, so entropy stays low
+void test_ectopic_beats_alone_do_not_trip() {
+    for (int i = 0; i < 200; i++) {
+        if (i % 8 == 6) rhythm.addBeat(600);
+        else if (i % 8 == 7) rhythm.addBeat(1400);
+        else rhythm.addBeat(1000);
+    }
+    TEST_ASSERT_GREATER_THAN(RHYTHM_NRMSSD_ON, rhythm.getNRMSSD());
+    TEST_ASSERT_LESS_THAN(RHYTHM_ENTROPY_ON, rhythm.getEntropy());
+    TEST_ASSERT_FALSE(rhythm.isIrregular());
+}
+
+// A slow rate change is not irregularity: bins follow the running mean
+void test_rate_drift_is_not_irregular() {
+    for (int i = 0; i < 300; i++) rhythm.addBeat(quantized(1100 - i * 1.5f));
+    TEST_ASSERT_FALSE(rhythm.isIrregular());
+    TEST_ASSERT_LESS_THAN(0.05f, rhythm.getNRMSSD());
+}
+
+// With a gap between every beat there are no successive differences at
+// all, and too few of them means no verdict
+void test_gap_breaks_successive_differences() {
+    for (int i = 0; i < 200; i++) {
+        rhythm.addBeat(i % 2 ? 600 : 1400);
+        rhythm.gap();
+    }
+    TEST_ASSERT_EQUAL(RHYTHM_WINDOW_BEATS, rhythm.windowLen());
+    TEST_ASSERT_EQUAL_FLOAT(0, rhythm.getNRMSSD());
+    TEST_ASSERT_FALSE(rhythm.isIrregular());
+
+    // The same intervals without gaps read as wildly irregular in nRMSSD
+    for (int i = 0; i < 200; i++) rhythm.addBeat(i % 2 ? 600 : 1400);
+    TEST_ASSERT_GREATER_THAN(0.5f, rhythm.getNRMSSD());
+}
+
+// Finger removed: the window restarts, the episode count is kept
+void test_reset_restarts_the_window() {
+    fibrillation(100);
+    TEST_ASSERT_TRUE(rhythm.isIrregular());
+    rhythm.reset();
+    TEST_ASSERT_FALSE(rhythm.isIrregular());
+    TEST_ASSERT_EQUAL(0, rhythm.windowLen());
+    TEST_ASSERT_EQUAL_UINT32(0, rhythm.beatCount());
+    TEST_ASSERT_EQUAL_UINT32(1, rhythm.episodeCount());
+    sinus(100);
+    TEST_ASSERT_FALSE(rhythm.isIrregular());
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_sinus_rhythm_is_regular);
+    RUN_TEST(test_no_verdict_before_the_window_fills);
+    RUN_TEST(test_fibrillation_trips_and_sinus_clears);
+    RUN_TEST(test_ectopic_beats_alone_do_not_trip);
+    RUN_TEST(test_rate_drift_is_not_irregular);
+    RUN_TEST(test_gap_breaks_successive_differences);
+    RUN_TEST(test_reset_restarts_the_window);
+    return UNITY_END();
+}
@@ -0,0 +1,311 @@
+#include "forwarder.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <curl/curl.h>
+#include <strings.h>
+
+#include "gzip.h"
+#include "http_server.h"
+#include "json_scan.h"
+
+static const int BACKOFF_MIN_MS = 1000;
+static const int BACKOFF_MAX_MS = 60000;
+static const size_t STATE_QUERY_MAX_IDS = 256;   // devices per state query
+
+// ==================== FORWARD QUEUE ====================
+void ForwardQueue::push(std::vector<WalEntry>& batch) {
+    if (batch.empty()) return;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        for (auto& e : batch) {
+            totalBytes += e.footprint();
+            entries.push_back(std::move(e));
+        }
+    }
+    batch.clear();
+    cv.notify_all();
+}
+
+size_t ForwardQueue::waitFor(size_t minBytes, int waitMs) {
+    std::unique_lock<std::mutex> lock(mutex);
+    cv.wait_for(lock, std::chrono::milliseconds(waitMs), [&] { return totalBytes >= minBytes; });
+    return totalBytes;
+}
+
+bool ForwardQueue::peekBatch(size_t maxBytes, std::vector<WalEntry>& out) {
+    std::lock_guard<std::mutex> lock(mutex);
+    out.clear();
+    size_t used = 0;
+    for (const auto& e : entries) {
+        if (!out.empty() && used + e.footprint() > maxBytes) break;
+        used += e.footprint();
+        out.push_back(e);
+    }
+    return !out.empty();
+}
+
+void ForwardQueue::pop(uint64_t index) {
+    std::lock_guard<std::mutex> lock(mutex);
+    while (!entries.empty() && entries.front().index <= index) {
+        totalBytes -= entries.front().footprint();
+        entries.pop_front();
+    }
+}
+
+size_t ForwardQueue::bytes() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return totalBytes;
+}
+
+size_t ForwardQueue::size() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return entries.size();
+}
+
+void ForwardQueue::wakeAll() {
+    cv.notify_all();
+}
+
+// ==================== PENDING STATE CACHE ====================
+void PendingStateCache::touch(const std::string& deviceId) {
+    std::lock_guard<std::mutex> lock(mutex);
+    lastSeenMs[deviceId] = monotonicMs();
+}
+
+std::vector<std::string> PendingStateCache::activeDevices(int withinMs) {
+    std::lock_guard<std::mutex> lock(mutex);
+    std::vector<std::string> out;
+    long long now = monotonicMs();
+    for (const auto& kv : lastSeenMs) {
+        if (now - kv.second <= withinMs) out.push_back(kv.first);
+    }
+    return out;
+}
+
+void PendingStateCache::put(const std::string& deviceId, const std::string& state) {
+    std::lock_guard<std::mutex> lock(mutex);
+    pending[deviceId] = state;
+}
+
+bool PendingStateCache::take(const std::string& deviceId, std::string& state) {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = pending.find(deviceId);
+    if (it == pending.end()) return false;
+    state = it->second;
+    pending.erase(it);
+    return true;
+}
+
+size_t PendingStateCache::deviceCount() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return lastSeenMs.size();
+}
+
+// ==================== BATCH FORMAT ====================
+std::string formatBatch(const std::string& gatewayId, const std::vector<WalEntry>& batch) {
+    std::string body;
+    size_t raw = 0;
+    for (const auto& e : batch) raw += e.body.size() + 96;
+    body.reserve(raw + 128);
+    
+    char head[160];
+    snprintf(head, sizeof(head), "{\"gateway_id\":\"%s\",\"first_index\":%llu,\"last_index\":%llu,\"items\":[",
+             gatewayId.c_str(), (unsigned long long)batch.front().index,
+             (unsigned long long)batch.back().index);
+    body += head;
+    
+    for (size_t i = 0; i < batch.size(); i++) {
+        const WalEntry& e = batch[i];
+        char item[160];
+        if (e.kind == WAL_HISTORY) {
+            snprintf(item, sizeof(item), "%s{\"kind\":\"history\",\"device_id\":\"%s\",\"from\":%llu,\"count\":%u,\"payload\":",
+                     i ? "," : "", e.deviceId.c_str(), (unsigned long long)e.seq, e.count);
+        } else {
+            snprintf(item, sizeof(item), "%s{\"kind\":\"vitals\",\"device_id\":\"%s\",\"seq\":%llu,\"payload\":",
+                     i ? "," : "", e.deviceId.c_str(), (unsigned long long)e.seq);
+        }
+        body += item;
+        body += e.body;
+        body += '}';
+    }
+    body += "]}";
+    return body;
+}
+
+// ==================== FORWARDER ====================
+static size_t appendToString(char* data, size_t size, size_t n, void* user) {
+    ((std::string*)user)->append(data, size * n);
+    return size * n;
+}
+
+static size_t captureRetryAfter(char* data, size_t size, size_t n, void* user) {
+    size_t len = size * n;
+    if (len > 12 && strncasecmp(data, "Retry-After:", 12) == 0) {
+        *(long*)user = strtol(data + 12, nullptr, 10);
+    }
+    return len;
+}
+
+Forwarder::Forwarder(const ForwarderConfig& c, WriteAheadLog& w, ForwardQueue& q, PendingStateCache& s)
+    : config(c), wal(w), queue(q), states(s) {}
+
+Forwarder::~Forwarder() {
+    stop();
+}
+
+void Forwarder::start() {
+    curl = curl_easy_init();
+    running = true;
+    worker = std::thread(&Forwarder::run, this);
+}
+
+void Forwarder::stop() {
+    if (!running) return;
+    running = false;
+    queue.wakeAll();
+    if (worker.joinable()) worker.join();
+    if (curl) curl_easy_cleanup((CURL*)curl);
+    curl = nullptr;
+}
+
+void Forwarder::noteFailure(long retryAfterSec) {
+    counters.failures++;
+    backoffMs = backoffMs ? std::min(backoffMs * 2, BACKOFF_MAX_MS) : BACKOFF_MIN_MS;
+    int waitMs = retryAfterSec > 0 ? (int)std::min<long>(retryAfterSec * 1000, BACKOFF_MAX_MS) : backoffMs;
+    counters.backoffUntilMs = monotonicMs() + waitMs;
+}
+
+void Forwarder::run() {
+    std::vector<WalEntry> batch;
+    long long oldestSeenMs = 0;
+    
+    while (running) {
+        long long now = monotonicMs();
+        if (config.statePollMs > 0 && now - lastStatePoll >= config.statePollMs && now >= counters.backoffUntilMs) {
+            pollStates();
+            lastStatePoll = monotonicMs();
+        }
+        
+        long long wait = counters.backoffUntilMs - now;
+        if (wait > 0) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(std::min<long long>(wait, 200)));
+            continue;
+        }
+        
+        // Wait for a full batch, but never hold the oldest entry longer than batchMs.
+        size_t queued = queue.waitFor(config.batchBytes, 100);
+        if (queued == 0) {
+            oldestSeenMs = 0;
+            continue;
+        }
+        if (oldestSeenMs == 0) oldestSeenMs = monotonicMs();
+        if (queued < config.batchBytes && monotonicMs() - oldestSeenMs < config.batchMs) continue;
+        if (!queue.peekBatch(config.batchBytes, batch)) continue;
+        
+        if (sendBatch(batch)) {
+            uint64_t last = batch.back().index;
+            if (!wal.acknowledge(last)) fprintf(stderr, "forwarder: checkpoint write failed at %llu\n", (unsigned long long)last);
+            queue.pop(last);
+            backoffMs = 0;
+            oldestSeenMs = queue.size() ? monotonicMs() : 0;
+        }
+    }
+}
+
+bool Forwarder::sendBatch(const std::vector<WalEntry>& batch) {
+    std::string body = formatBatch(config.gatewayId, batch);
+    std::string gz;
+    if (!gzipCompress(body, gz, config.gzipLevel)) return false;
+    
+    CURL* c = (CURL*)curl;
+    std::string url = config.upstreamBase + "/health/gateway/batch";
+    std::string response;
+    long retryAfter = 0;
+    
+    struct curl_slist* hdrs = nullptr;
+    hdrs = curl_slist_append(hdrs, "Content-Type: application/json");
+    hdrs = curl_slist_append(hdrs, "Content-Encoding: gzip");
+    hdrs = curl_slist_append(hdrs, "Expect:");
+    std::string gw = "X-Gateway-Id: " + config.gatewayId;
+    hdrs = curl_slist_append(hdrs, gw.c_str());
+    
+    curl_easy_reset(c);
+    curl_easy_setopt(c, CURLOPT_URL, url.c_str());
+    curl_easy_setopt(c, CURLOPT_POST, 1L);
+    curl_easy_setopt(c, CURLOPT_POSTFIELDS, gz.data());
+    curl_easy_setopt(c, CURLOPT_POSTFIELDSIZE, (long)gz.size());
+    curl_easy_setopt(c, CURLOPT_HTTPHEADER, hdrs);
+    curl_easy_setopt(c, CURLOPT_TIMEOUT_MS, (long)config.timeoutMs);
+    curl_easy_setopt(c, CURLOPT_WRITEFUNCTION, appendToString);
+    curl_easy_setopt(c, CURLOPT_WRITEDATA, &response);
+    curl_easy_setopt(c, CURLOPT_HEADERFUNCTION, captureRetryAfter);
+    curl_easy_setopt(c, CURLOPT_HEADERDATA, &retryAfter);
+    curl_easy_setopt(c, CURLOPT_NOSIGNAL, 1L);
+    
+    CURLcode rc = curl_easy_perform(c);
+    long status = 0;
+    curl_easy_getinfo(c, CURLINFO_RESPONSE_CODE, &status);
+    curl_slist_free_all(hdrs);
+    
+    if (rc != CURLE_OK || status < 200 || status >= 300) {
+        fprintf(stderr, "forwarder: batch %llu..%llu failed (%s, HTTP %ld)\n",
+                (unsigned long long)batch.front().index, (unsigned long long)batch.back().index,
+                rc != CURLE_OK ? curl_easy_strerror(rc) : "upstream refused", status);
+        noteFailure(retryAfter);
+        return false;
+    }
+    
+    counters.batches++;
+    counters.entries += batch.size();
+    counters.rawBytes += body.size();
+    counters.sentBytes += gz.size();
+    return true;
+}
+
+// The active devices' pending commands, in one POST per STATE_QUERY_MAX_IDS
+// devices over the same connection as the batches. The upstream answers
+// with an object holding only the devices that have a command; those are
+// held until that device's own state poll.
+void Forwarder::pollStates() {
+    CURL* c = (CURL*)curl;
+    std::vector<std::string> ids = states.activeDevices(config.statePollMs * 3);
+    std::string url = config.upstreamBase + "/health/gateway/state/pending";
+    for (size_t from = 0; from < ids.size(); from += STATE_QUERY_MAX_IDS) {
+        size_t to = std::min(ids.size(), from + STATE_QUERY_MAX_IDS);
+        std::string body = "{\"gateway_id\":\"" + config.gatewayId + "\",\"device_ids\":[";
+        for (size_t i = from; i < to; i++) {
+            if (i > from) body += ',';
+            body += '"';
+            body += ids[i];
+            body += '"';
+        }
+        body += "]}";
+        
+        std::string response;
+        struct curl_slist* hdrs = curl_slist_append(nullptr, "Content-Type: application/json");
+        hdrs = curl_slist_append(hdrs, "Expect:");
+        curl_easy_reset(c);
+        curl_easy_setopt(c, CURLOPT_URL, url.c_str());
+        curl_easy_setopt(c, CURLOPT_POST, 1L);
+        curl_easy_setopt(c, CURLOPT_POSTFIELDS, body.data());
+        curl_easy_setopt(c, CURLOPT_POSTFIELDSIZE, (long)body.size());
+        curl_easy_setopt(c, CURLOPT_HTTPHEADER, hdrs);
+        curl_easy_setopt(c, CURLOPT_TIMEOUT_MS, (long)config.timeoutMs);
+        curl_easy_setopt(c, CURLOPT_WRITEFUNCTION, appendToString);
+        curl_easy_setopt(c, CURLOPT_WRITEDATA, &response);
+        curl_easy_setopt(c, CURLOPT_NOSIGNAL, 1L);
+        CURLcode rc = curl_easy_perform(c);
+        long status = 0;
+        curl_easy_getinfo(c, CURLINFO_RESPONSE_CODE, &status);
+        curl_slist_free_all(hdrs);
+        if (rc != CURLE_OK || status != 200 || !isJsonObject(response)) return;
+        counters.stateQueries++;
+        
+        for (size_t i = from; i < to; i++) {
+            std::string state;
+            if (jsonFindString(response, ids[i].c_str(), state)) states.put(ids[i], state);
+        }
+    }
+}
@@ -0,0 +1,115 @@
+/**
+ * Upstream side of the gateway: committed WAL entries wait in a ForwardQueue
+ * and the Forwarder thread drains them in gzip-compressed bulk uploads over
+ * one keep-alive connection. The WAL is only acknowledged after the upstream
+ * accepts a batch, so a crash replays anything in flight.
+ *
+ * Backpressure: the queue's byte count is what the ingest side compares
+ * against its high-water mark before accepting more uploads; when the
+ * upstream is down or slow the queue grows and devices get 503 + Retry-After.
+ */
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "wal.h"
+
+class ForwardQueue {
+public:
+    void push(std::vector<WalEntry>& entries);
+    
+    // Waits up to waitMs for at least minBytes to be queued; returns the bytes queued.
+    size_t waitFor(size_t minBytes, int waitMs);
+    
+    // Copies the oldest entries, up to roughly maxBytes.
+    bool peekBatch(size_t maxBytes, std::vector<WalEntry>& out);
+    
+    // Drops entries up to and including index.
+    void pop(uint64_t index);
+    
+    size_t bytes() const;
+    size_t size() const;
+    void wakeAll();
+    
+private:
+    mutable std::mutex mutex;
+    std::condition_variable cv;
+    std::deque<WalEntry> entries;
+    size_t totalBytes = 0;
+};
+
+// Remote state commands fetched from the upstream, held until the device's
+// next state poll. Also tracks which devices are active so only those are
+// polled.
+class PendingStateCache {
+public:
+    void touch(const std::string& deviceId);
+    std::vector<std::string> activeDevices(int withinMs);
+    void put(const std::string& deviceId, const std::string& state);
+    bool take(const std::string& deviceId, std::string& state);
+    size_t deviceCount();
+    
+private:
+    std::mutex mutex;
+    std::map<std::string, long long> lastSeenMs;
+    std::map<std::string, std::string> pending;
+};
+
+struct ForwarderConfig {
+    std::string upstreamBase;          // e.g. https://api.example.com
+    std::string gatewayId = "gateway";
+    size_t batchBytes = 256 * 1024;    // send once this much is queued...
+    int batchMs = 1000;                // ...or the oldest entry is this old
+    int gzipLevel = 6;
+    int statePollMs = 10000;           // 0 disables state polling
+    int timeoutMs = 10000;
+};
+
+struct ForwarderStats {
+    std::atomic<uint64_t> batches{0};
+    std::atomic<uint64_t> entries{0};
+    std::atomic<uint64_t> rawBytes{0};
+    std::atomic<uint64_t> sentBytes{0};
+    std::atomic<uint64_t> failures{0};
+    std::atomic<uint64_t> stateQueries{0};
+    std::atomic<int64_t> backoffUntilMs{0};
+};
+
+class Forwarder {
+public:
+    Forwarder(const ForwarderConfig& config, WriteAheadLog& wal, ForwardQueue& queue, PendingStateCache& states);
+    ~Forwarder();
+    
+    void start();
+    void stop();
+    
+    const ForwarderStats& stats() const { return counters; }
+    
+private:
+    ForwarderConfig config;
+    WriteAheadLog& wal;
+    ForwardQueue& queue;
+    PendingStateCache& states;
+    ForwarderStats counters;
+    std::atomic<bool> running{false};
+    std::thread worker;
+    void* curl = nullptr;
+    int backoffMs = 0;
+    long long lastStatePoll = 0;
+    
+    void run();
+    bool sendBatch(const std::vector<WalEntry>& batch);
+    void pollStates();
+    void noteFailure(long retryAfterSec);
+};
+
+// Builds the bulk upload body; exposed for the upstream stand-in and bench.
+std::string formatBatch(const std::string& gatewayId, const std::vector<WalEntry>& batch);
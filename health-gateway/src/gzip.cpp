@@ -0,0 +1,53 @@
+#include "gzip.h"
+
+#include <zlib.h>
+
+// windowBits 15 + 16 selects the gzip wrapper instead of raw zlib.
+static const int GZIP_WINDOW_BITS = 15 + 16;
+
+bool gzipCompress(const std::string& in, std::string& out, int level) {
+    z_stream zs = {};
+    if (deflateInit2(&zs, level, Z_DEFLATED, GZIP_WINDOW_BITS, 8, Z_DEFAULT_STRATEGY) != Z_OK) return false;
+    
+    out.resize(deflateBound(&zs, in.size()));
+    zs.next_in = (Bytef*)in.data();
+    zs.avail_in = in.size();
+    zs.next_out = (Bytef*)&out[0];
+    zs.avail_out = out.size();
+    int rc = deflate(&zs, Z_FINISH);
+    out.resize(zs.total_out);
+    deflateEnd(&zs);
+    return rc == Z_STREAM_END;
+}
+
+bool gzipDecompress(const std::string& in, std::string& out, size_t maxOut) {
+    z_stream zs = {};
+    if (inflateInit2(&zs, GZIP_WINDOW_BITS) != Z_OK) return false;
+    
+    out.clear();
+    zs.next_in = (Bytef*)in.data();
+    zs.avail_in = in.size();
+    char chunk[16384];
+    int rc = Z_OK;
+    while (rc == Z_OK) {
+        zs.next_out = (Bytef*)chunk;
+        zs.avail_out = sizeof(chunk);
+        rc = inflate(&zs, Z_NO_FLUSH);
+        if (rc != Z_OK && rc != Z_STREAM_END) break;
+        out.append(chunk, sizeof(chunk) - zs.avail_out);
+        if (out.size() > maxOut) {
+            rc = Z_BUF_ERROR;
+            break;
+        }
+        if (rc == Z_OK && zs.avail_in == 0 && zs.avail_out != 0) {
+            rc = Z_DATA_ERROR;   // truncated stream
+            break;
+        }
+    }
+    inflateEnd(&zs);
+    return rc == Z_STREAM_END;
+}
+
+uint32_t crc32Of(const std::string& data) {
+    return crc32(0L, (const Bytef*)data.data(), data.size());
+}
@@ -0,0 +1,15 @@
+/**
+ * gzip (RFC 1952) helpers over zlib, plus the CRC-32 the firmware puts in
+ * X-Sync-CRC32.
+ */
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+bool gzipCompress(const std::string& in, std::string& out, int level = 6);
+
+// Fails if the stream is corrupt or inflates beyond maxOut bytes.
+bool gzipDecompress(const std::string& in, std::string& out, size_t maxOut);
+
+uint32_t crc32Of(const std::string& data);
@@ -0,0 +1,357 @@
+#include "http_server.h"
+
+#include <arpa/inet.h>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <strings.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+const std::string* HttpRequest::header(const char* name) const {
+    for (const auto& h : headers) {
+        if (h.first == name) return &h.second;
+    }
+    return nullptr;
+}
+
+const char* httpStatusText(int status) {
+    switch (status) {
+        case 100: return "Continue";
+        case 200: return "OK";
+        case 201: return "Created";
+        case 204: return "No Content";
+        case 400: return "Bad Request";
+        case 404: return "Not Found";
+        case 405: return "Method Not Allowed";
+        case 411: return "Length Required";
+        case 413: return "Payload Too Large";
+        case 422: return "Unprocessable Entity";
+        case 429: return "Too Many Requests";
+        case 500: return "Internal Server Error";
+        case 503: return "Service Unavailable";
+        default: return "Unknown";
+    }
+}
+
+long long monotonicMs() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+static void setNonBlocking(int fd) {
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
+}
+
+HttpServer::HttpServer(Handler h) : handler(std::move(h)) {}
+
+HttpServer::~HttpServer() {
+    for (auto& kv : conns) close(kv.first);
+    if (listenFd >= 0) close(listenFd);
+    if (epollFd >= 0) close(epollFd);
+    if (wakeFd >= 0) close(wakeFd);
+}
+
+bool HttpServer::listen(const std::string& host, int p) {
+    listenFd = socket(AF_INET, SOCK_STREAM, 0);
+    if (listenFd < 0) return false;
+    int one = 1;
+    setsockopt(listenFd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    
+    sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(p);
+    if (inet_pton(AF_INET, host.c_str(), &addr.sin_addr) != 1) return false;
+    if (bind(listenFd, (sockaddr*)&addr, sizeof(addr)) < 0) return false;
+    if (::listen(listenFd, 1024) < 0) return false;
+    setNonBlocking(listenFd);
+    
+    socklen_t len = sizeof(addr);
+    getsockname(listenFd, (sockaddr*)&addr, &len);
+    port = ntohs(addr.sin_port);
+    
+    epollFd = epoll_create1(0);
+    wakeFd = eventfd(0, EFD_NONBLOCK);
+    epoll_event ev = {};
+    ev.events = EPOLLIN;
+    ev.data.fd = listenFd;
+    epoll_ctl(epollFd, EPOLL_CTL_ADD, listenFd, &ev);
+    ev.data.fd = wakeFd;
+    epoll_ctl(epollFd, EPOLL_CTL_ADD, wakeFd, &ev);
+    return true;
+}
+
+void HttpServer::stop() {
+    running = false;
+    uint64_t one = 1;
+    if (write(wakeFd, &one, sizeof(one)) < 0) perror("eventfd");
+}
+
+void HttpServer::run() {
+    running = true;
+    epoll_event events[256];
+    long long lastReap = monotonicMs();
+    
+    while (running) {
+        int n = epoll_wait(epollFd, events, 256, 200);
+        if (n < 0 && errno != EINTR) {
+            perror("epoll_wait");
+            break;
+        }
+        for (int i = 0; i < n; i++) {
+            int fd = events[i].data.fd;
+            if (fd == listenFd) {
+                acceptAll();
+                continue;
+            }
+            if (fd == wakeFd) {
+                uint64_t v;
+                if (read(wakeFd, &v, sizeof(v)) < 0) {}
+                continue;
+            }
+            auto it = conns.find(fd);
+            if (it == conns.end()) continue;
+            Connection& c = it->second;
+            if (events[i].events & (EPOLLHUP | EPOLLERR)) {
+                closeConn(fd);
+                continue;
+            }
+            if (events[i].events & EPOLLOUT) writeTo(c);
+            if ((events[i].events & EPOLLIN) && conns.count(fd)) readFrom(c);
+        }
+        
+        if (beforeFlush) beforeFlush();
+        flushWrites();
+        if (tick) tick();
+        
+        if (monotonicMs() - lastReap >= 1000) {
+            reapIdle();
+            lastReap = monotonicMs();
+        }
+    }
+}
+
+void HttpServer::acceptAll() {
+    for (;;) {
+        int fd = accept(listenFd, nullptr, nullptr);
+        if (fd < 0) {
+            if (errno == EMFILE || errno == ENFILE) perror("accept");
+            return;
+        }
+        setNonBlocking(fd);
+        int one = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+        
+        epoll_event ev = {};
+        ev.events = EPOLLIN;
+        ev.data.fd = fd;
+        epoll_ctl(epollFd, EPOLL_CTL_ADD, fd, &ev);
+        Connection& c = conns[fd];
+        c = Connection();
+        c.fd = fd;
+        c.lastActiveMs = monotonicMs();
+    }
+}
+
+void HttpServer::readFrom(Connection& c) {
+    char buf[16384];
+    for (;;) {
+        ssize_t r = read(c.fd, buf, sizeof(buf));
+        if (r > 0) {
+            c.in.append(buf, r);
+            continue;
+        }
+        if (r == 0 || (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)) {
+            // Peer closed: answer what was already received, then close.
+            parseRequests(c);
+            c.closeAfterWrite = true;
+            if (c.out.size() == c.outOff) closeConn(c.fd);
+            return;
+        }
+        if (errno == EINTR) continue;
+        break;
+    }
+    c.lastActiveMs = monotonicMs();
+    if (!parseRequests(c)) c.closeAfterWrite = true;
+}
+
+static std::string lower(std::string s) {
+    for (char& ch : s) ch = tolower((unsigned char)ch);
+    return s;
+}
+
+static std::string trim(const std::string& s) {
+    size_t b = s.find_first_not_of(" \t");
+    if (b == std::string::npos) return "";
+    size_t e = s.find_last_not_of(" \t\r");
+    return s.substr(b, e - b + 1);
+}
+
+// Handles every complete request in the buffer. Returns false on a
+// protocol error (the connection is closed after the error response).
+bool HttpServer::parseRequests(Connection& c) {
+    while (!c.closeAfterWrite) {
+        size_t headerEnd = c.in.find("\r\n\r\n");
+        if (headerEnd == std::string::npos) {
+            if (c.in.size() > MAX_HEADER_BYTES) {
+                HttpResponse resp;
+                resp.status = 413;
+                queueResponse(c, resp, false);
+                return false;
+            }
+            return true;
+        }
+        
+        HttpRequest req;
+        size_t lineEnd = c.in.find("\r\n");
+        std::string line = c.in.substr(0, lineEnd);
+        size_t sp1 = line.find(' ');
+        size_t sp2 = line.find(' ', sp1 + 1);
+        if (sp1 == std::string::npos || sp2 == std::string::npos) {
+            HttpResponse resp;
+            resp.status = 400;
+            queueResponse(c, resp, false);
+            return false;
+        }
+        req.method = line.substr(0, sp1);
+        std::string target = line.substr(sp1 + 1, sp2 - sp1 - 1);
+        bool http10 = line.compare(sp2 + 1, std::string::npos, "HTTP/1.0") == 0;
+        size_t q = target.find('?');
+        req.path = target.substr(0, q);
+        if (q != std::string::npos) req.query = target.substr(q + 1);
+        
+        size_t pos = lineEnd + 2;
+        while (pos < headerEnd) {
+            size_t eol = c.in.find("\r\n", pos);
+            size_t colon = c.in.find(':', pos);
+            if (colon != std::string::npos && colon < eol) {
+                req.headers.emplace_back(lower(c.in.substr(pos, colon - pos)),
+                                         trim(c.in.substr(colon + 1, eol - colon - 1)));
+            }
+            pos = eol + 2;
+        }
+        
+        size_t contentLength = 0;
+        if (const std::string* cl = req.header("content-length")) {
+            contentLength = strtoul(cl->c_str(), nullptr, 10);
+        } else if (req.header("transfer-encoding")) {
+            HttpResponse resp;
+            resp.status = 411;
+            queueResponse(c, resp, false);
+            return false;
+        }
+        if (contentLength > MAX_BODY_BYTES) {
+            HttpResponse resp;
+            resp.status = 413;
+            queueResponse(c, resp, false);
+            return false;
+        }
+        
+        size_t total = headerEnd + 4 + contentLength;
+        if (c.in.size() < total) {
+            const std::string* expect = req.header("expect");
+            if (expect && !c.sentContinue && strcasecmp(expect->c_str(), "100-continue") == 0) {
+                c.out += "HTTP/1.1 100 Continue\r\n\r\n";
+                c.sentContinue = true;
+                pendingWrites.push_back(c.fd);
+            }
+            return true;
+        }
+        req.body = c.in.substr(headerEnd + 4, contentLength);
+        c.in.erase(0, total);
+        c.sentContinue = false;
+        
+        const std::string* conn = req.header("connection");
+        bool keepAlive = conn ? strcasecmp(conn->c_str(), "close") != 0 : !http10;
+        if (http10 && conn && strcasecmp(conn->c_str(), "keep-alive") == 0) keepAlive = true;
+        
+        HttpResponse resp;
+        handler(req, resp);
+        queueResponse(c, resp, keepAlive);
+        if (!keepAlive) c.closeAfterWrite = true;
+    }
+    return true;
+}
+
+void HttpServer::queueResponse(Connection& c, const HttpResponse& resp, bool keepAlive) {
+    char head[256];
+    snprintf(head, sizeof(head), "HTTP/1.1 %d %s\r\nContent-Type: %s\r\nContent-Length: %zu\r\nConnection: %s\r\n",
+             resp.status, httpStatusText(resp.status), resp.contentType.c_str(), resp.body.size(),
+             keepAlive ? "keep-alive" : "close");
+    c.out += head;
+    for (const auto& h : resp.headers) {
+        c.out += h.first;
+        c.out += ": ";
+        c.out += h.second;
+        c.out += "\r\n";
+    }
+    c.out += "\r\n";
+    c.out += resp.body;
+    if (!keepAlive) c.closeAfterWrite = true;
+    pendingWrites.push_back(c.fd);
+}
+
+void HttpServer::flushWrites() {
+    std::vector<int> fds;
+    fds.swap(pendingWrites);
+    for (int fd : fds) {
+        auto it = conns.find(fd);
+        if (it != conns.end() && !it->second.wantWrite) writeTo(it->second);
+    }
+}
+
+void HttpServer::writeTo(Connection& c) {
+    while (c.outOff < c.out.size()) {
+        ssize_t w = write(c.fd, c.out.data() + c.outOff, c.out.size() - c.outOff);
+        if (w > 0) {
+            c.outOff += w;
+            continue;
+        }
+        if (w < 0 && errno == EINTR) continue;
+        if (w < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            if (!c.wantWrite) {
+                epoll_event ev = {};
+                ev.events = EPOLLIN | EPOLLOUT;
+                ev.data.fd = c.fd;
+                epoll_ctl(epollFd, EPOLL_CTL_MOD, c.fd, &ev);
+                c.wantWrite = true;
+            }
+            return;
+        }
+        closeConn(c.fd);
+        return;
+    }
+    
+    c.out.clear();
+    c.outOff = 0;
+    if (c.wantWrite) {
+        epoll_event ev = {};
+        ev.events = EPOLLIN;
+        ev.data.fd = c.fd;
+        epoll_ctl(epollFd, EPOLL_CTL_MOD, c.fd, &ev);
+        c.wantWrite = false;
+    }
+    if (c.closeAfterWrite) closeConn(c.fd);
+}
+
+void HttpServer::closeConn(int fd) {
+    epoll_ctl(epollFd, EPOLL_CTL_DEL, fd, nullptr);
+    close(fd);
+    conns.erase(fd);
+}
+
+void HttpServer::reapIdle() {
+    long long now = monotonicMs();
+    std::vector<int> idle;
+    for (const auto& kv : conns) {
+        if (now - kv.second.lastActiveMs > IDLE_TIMEOUT_MS && kv.second.out.empty()) idle.push_back(kv.first);
+    }
+    for (int fd : idle) closeConn(fd);
+}
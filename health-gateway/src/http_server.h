@@ -0,0 +1,89 @@
+/**
+ * Single-threaded epoll HTTP/1.1 server: keep-alive, Content-Length bodies,
+ * pipelined requests. Responses produced during one event-loop pass are held
+ * until the beforeFlush hook has run, so a handler can queue work (e.g. WAL
+ * appends) and have it committed once for the whole pass before any client
+ * sees its acknowledgement.
+ */
+#pragma once
+
+#include <functional>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+struct HttpRequest {
+    std::string method;
+    std::string path;
+    std::string query;
+    std::vector<std::pair<std::string, std::string>> headers;   // names lower-cased
+    std::string body;
+    
+    const std::string* header(const char* name) const;
+};
+
+struct HttpResponse {
+    int status = 200;
+    std::string contentType = "application/json";
+    std::vector<std::pair<std::string, std::string>> headers;
+    std::string body;
+};
+
+class HttpServer {
+public:
+    typedef std::function<void(const HttpRequest&, HttpResponse&)> Handler;
+    
+    static const size_t MAX_HEADER_BYTES = 8192;
+    static const size_t MAX_BODY_BYTES = 1 << 20;
+    static const int IDLE_TIMEOUT_MS = 60000;
+    
+    explicit HttpServer(Handler handler);
+    ~HttpServer();
+    
+    bool listen(const std::string& host, int port);
+    void setBeforeFlush(std::function<void()> fn) { beforeFlush = std::move(fn); }
+    void setTick(std::function<void()> fn) { tick = std::move(fn); }
+    
+    // Runs the event loop until stop() is called from any thread.
+    void run();
+    void stop();
+    
+    size_t connectionCount() const { return conns.size(); }
+    int boundPort() const { return port; }
+    
+private:
+    struct Connection {
+        int fd;
+        std::string in;
+        std::string out;
+        size_t outOff = 0;
+        bool closeAfterWrite = false;
+        bool wantWrite = false;
+        bool sentContinue = false;
+        long long lastActiveMs = 0;
+    };
+    
+    Handler handler;
+    std::function<void()> beforeFlush;
+    std::function<void()> tick;
+    int listenFd = -1;
+    int epollFd = -1;
+    int wakeFd = -1;
+    int port = 0;
+    bool running = false;
+    std::unordered_map<int, Connection> conns;
+    std::vector<int> pendingWrites;
+    
+    void acceptAll();
+    void readFrom(Connection& c);
+    bool parseRequests(Connection& c);
+    void queueResponse(Connection& c, const HttpResponse& resp, bool keepAlive);
+    void flushWrites();
+    void writeTo(Connection& c);
+    void closeConn(int fd);
+    void reapIdle();
+};
+
+const char* httpStatusText(int status);
+long long monotonicMs();
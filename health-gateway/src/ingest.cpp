@@ -0,0 +1,218 @@
+#include "ingest.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <unistd.h>
+
+#include "gzip.h"
+#include "json_scan.h"
+
+static const size_t MAX_INFLATED_CHUNK = 1 << 20;
+
+static void jsonError(HttpResponse& resp, int status, const char* message) {
+    resp.status = status;
+    resp.body = std::string("{\"error\":\"") + message + "\"}";
+}
+
+DeviceIngest::DeviceIngest(const IngestConfig& c, WriteAheadLog& w, ForwardQueue& q, PendingStateCache& s)
+    : config(c), wal(w), queue(q), states(s) {}
+
+bool DeviceIngest::overHighWater() const {
+    return queue.bytes() + stagedBytes > config.highWaterBytes;
+}
+
+// The firmware's ESP32 HTTPClient honours Retry-After (noteUplinkFailure), so
+// a full queue slows every device down instead of dropping uploads.
+void DeviceIngest::throttle(HttpResponse& resp) {
+    counters.throttled++;
+    jsonError(resp, 503, "gateway backlog full");
+    resp.headers.emplace_back("Retry-After", std::to_string(config.retryAfterSec));
+}
+
+// A device restarts its seq at 1 after a reboot, and its first upload is
+// always a keyframe, so a keyframe far behind the window starts over.
+bool DeviceIngest::checkAndMarkSeq(DeviceState& dev, uint64_t seq, bool keyframe) {
+    if (seq > dev.maxSeq) {
+        uint64_t shift = seq - dev.maxSeq;
+        dev.window = shift >= 64 ? 0 : dev.window << shift;
+        dev.window |= 1;
+        dev.maxSeq = seq;
+        return true;
+    }
+    uint64_t age = dev.maxSeq - seq;
+    if (age >= 64) {
+        if (!keyframe) return false;
+        dev.maxSeq = seq;
+        dev.window = 1;
+        return true;
+    }
+    uint64_t bit = 1ull << age;
+    if (dev.window & bit) return false;
+    dev.window |= bit;
+    return true;
+}
+
+void DeviceIngest::handle(const HttpRequest& req, HttpResponse& resp) {
+    static const std::string DEVICES = "/health/devices/";
+    
+    if (req.path == "/health/vitals") {
+        if (req.method != "POST") return jsonError(resp, 405, "POST only");
+        return handleVitals(req, resp);
+    }
+    if (req.path == "/gateway/stats") return handleStats(resp);
+    
+    if (req.path.compare(0, DEVICES.size(), DEVICES) == 0) {
+        size_t slash = req.path.find('/', DEVICES.size());
+        if (slash != std::string::npos) {
+            std::string id = req.path.substr(DEVICES.size(), slash - DEVICES.size());
+            std::string rest = req.path.substr(slash);
+            if (rest == "/sync" && req.method == "POST") return handleAdvertise(id, req, resp);
+            if (rest == "/sync/chunk" && req.method == "POST") return handleChunk(id, req, resp);
+            if (rest == "/state/pending" && req.method == "GET") return handleStatePoll(id, resp);
+        }
+    }
+    jsonError(resp, 404, "not found");
+}
+
+void DeviceIngest::handleVitals(const HttpRequest& req, HttpResponse& resp) {
+    std::string deviceId;
+    uint64_t seq = 0;
+    if (!isJsonObject(req.body) || !jsonFindString(req.body, "device_id", deviceId) || deviceId.empty() ||
+        deviceId.size() > 64 || !jsonFindUint(req.body, "seq", seq)) {
+        counters.badRequests++;
+        return jsonError(resp, 400, "expected a JSON object with device_id and seq");
+    }
+    states.touch(deviceId);
+    
+    bool delta = false;
+    jsonFindBool(req.body, "delta", delta);
+    DeviceState& dev = devices[deviceId];
+    
+    // Peek first so a throttled upload is not marked as seen.
+    DeviceState probe = dev;
+    if (!checkAndMarkSeq(probe, seq, !delta)) {
+        counters.duplicates++;
+        resp.status = 200;
+        resp.body = "{\"status\":\"duplicate\",\"seq\":" + std::to_string(seq) + "}";
+        return;
+    }
+    if (overHighWater()) return throttle(resp);
+    dev = probe;
+    
+    WalEntry e;
+    e.kind = WAL_VITALS;
+    e.deviceId = deviceId;
+    e.seq = seq;
+    e.body = req.body;
+    wal.append(e);
+    stagedBytes += e.footprint();
+    staged.push_back(std::move(e));
+    counters.accepted++;
+    
+    resp.status = 201;
+    resp.body = "{\"status\":\"accepted\",\"seq\":" + std::to_string(seq) + "}";
+}
+
+// The device's own acked_through is authoritative: ask for everything after it.
+void DeviceIngest::handleAdvertise(const std::string& deviceId, const HttpRequest& req, HttpResponse& resp) {
+    uint64_t oldest = 0, newest = 0, ackedThrough = 0;
+    if (!jsonFindUint(req.body, "oldest_seq", oldest) || !jsonFindUint(req.body, "newest_seq", newest) ||
+        !jsonFindUint(req.body, "acked_through", ackedThrough)) {
+        counters.badRequests++;
+        return jsonError(resp, 400, "expected oldest_seq, newest_seq, acked_through");
+    }
+    states.touch(deviceId);
+    
+    char body[160];
+    if (newest > ackedThrough && !overHighWater()) {
+        uint64_t from = std::max(ackedThrough + 1, oldest);
+        snprintf(body, sizeof(body), "{\"acked_through\":%llu,\"from\":%llu,\"count\":%llu,\"max_chunk\":%u}",
+                 (unsigned long long)ackedThrough, (unsigned long long)from,
+                 (unsigned long long)(newest - from + 1), config.historyMaxChunk);
+    } else {
+        snprintf(body, sizeof(body), "{\"acked_through\":%llu,\"from\":0,\"count\":0}",
+                 (unsigned long long)ackedThrough);
+    }
+    resp.body = body;
+}
+
+void DeviceIngest::handleChunk(const std::string& deviceId, const HttpRequest& req, HttpResponse& resp) {
+    const std::string* fromHdr = req.header("x-sync-from");
+    const std::string* countHdr = req.header("x-sync-count");
+    const std::string* crcHdr = req.header("x-sync-crc32");
+    if (!fromHdr || !countHdr || !crcHdr || deviceId.empty() || deviceId.size() > 64) {
+        counters.badRequests++;
+        return jsonError(resp, 400, "missing X-Sync-From/X-Sync-Count/X-Sync-CRC32");
+    }
+    if (overHighWater()) return throttle(resp);
+    
+    std::string json;
+    const std::string* encoding = req.header("content-encoding");
+    if (encoding && *encoding == "gzip") {
+        if (!gzipDecompress(req.body, json, MAX_INFLATED_CHUNK)) {
+            counters.crcErrors++;
+            return jsonError(resp, 422, "corrupt gzip body");
+        }
+    } else {
+        json = req.body;
+    }
+    
+    // CRC of the uncompressed body; 422 makes the device resend the range.
+    uint32_t expected = strtoul(crcHdr->c_str(), nullptr, 16);
+    if (crc32Of(json) != expected || !isJsonObject(json)) {
+        counters.crcErrors++;
+        return jsonError(resp, 422, "crc mismatch");
+    }
+    states.touch(deviceId);
+    
+    WalEntry e;
+    e.kind = WAL_HISTORY;
+    e.deviceId = deviceId;
+    e.seq = strtoull(fromHdr->c_str(), nullptr, 10);
+    e.count = strtoul(countHdr->c_str(), nullptr, 10);
+    e.body = std::move(json);
+    wal.append(e);
+    stagedBytes += e.footprint();
+    counters.historyChunks++;
+    
+    uint64_t ackedThrough = e.count ? e.seq + e.count - 1 : (e.seq ? e.seq - 1 : 0);
+    staged.push_back(std::move(e));
+    resp.body = "{\"acked_through\":" + std::to_string(ackedThrough) + "}";
+}
+
+void DeviceIngest::handleStatePoll(const std::string& deviceId, HttpResponse& resp) {
+    states.touch(deviceId);
+    std::string state;
+    if (states.take(deviceId, state)) {
+        resp.body = "{\"has_pending\":true,\"state\":\"" + state + "\"}";
+    } else {
+        resp.body = "{\"has_pending\":false}";
+    }
+}
+
+void DeviceIngest::handleStats(HttpResponse& resp) {
+    char body[512];
+    snprintf(body, sizeof(body),
+             "{\"devices\":%zu,\"accepted\":%llu,\"duplicates\":%llu,\"throttled\":%llu,\"bad_requests\":%llu,"
+             "\"history_chunks\":%llu,\"crc_errors\":%llu,\"queued_entries\":%zu,\"queued_bytes\":%zu,"
+             "\"wal_last_index\":%llu,\"wal_acked_index\":%llu}",
+             states.deviceCount(), (unsigned long long)counters.accepted.load(),
+             (unsigned long long)counters.duplicates.load(), (unsigned long long)counters.throttled.load(),
+             (unsigned long long)counters.badRequests.load(), (unsigned long long)counters.historyChunks.load(),
+             (unsigned long long)counters.crcErrors.load(), queue.size(), queue.bytes(),
+             (unsigned long long)wal.lastIndex(), (unsigned long long)wal.ackedIndex());
+    resp.body = body;
+}
+
+void DeviceIngest::commit() {
+    if (staged.empty()) return;
+    if (!wal.commit()) {
+        // The pass's acknowledgements have not been written to any socket yet;
+        // exiting here means no device is told an unsaved upload was accepted.
+        perror("wal commit");
+        _exit(1);
+    }
+    queue.push(staged);
+    stagedBytes = 0;
+}
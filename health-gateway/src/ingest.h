@@ -0,0 +1,79 @@
+/**
+ * Device-facing side of the gateway. Speaks the firmware's cloud API so a
+ * device only needs API_BASE_URL pointed at the gateway:
+ *
+ *   POST /health/vitals                           live upload (sendToCloud)
+ *   POST /health/devices/{id}/sync                history advertise
+ *   POST /health/devices/{id}/sync/chunk          history chunk (gzip, CRC-checked)
+ *   GET  /health/devices/{id}/state/pending       remote state command
+ *   GET  /gateway/stats                           gateway counters
+ *
+ * Accepted uploads are staged, then written to the WAL in one group commit
+ * per event-loop pass (commit() runs as the server's beforeFlush hook), so a
+ * device is only acknowledged once its upload is on disk. Retries of an
+ * already accepted seq are acknowledged without being stored again.
+ */
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "forwarder.h"
+#include "http_server.h"
+#include "wal.h"
+
+struct IngestConfig {
+    size_t highWaterBytes = 64u << 20;   // queued for upstream before devices get 503
+    int retryAfterSec = 30;              // Retry-After sent with a 503
+    uint32_t historyMaxChunk = 96;       // matches BACKLOG_BATCH_RECORDS on the device
+};
+
+struct IngestStats {
+    std::atomic<uint64_t> accepted{0};
+    std::atomic<uint64_t> duplicates{0};
+    std::atomic<uint64_t> throttled{0};
+    std::atomic<uint64_t> badRequests{0};
+    std::atomic<uint64_t> historyChunks{0};
+    std::atomic<uint64_t> crcErrors{0};
+};
+
+class DeviceIngest {
+public:
+    DeviceIngest(const IngestConfig& config, WriteAheadLog& wal, ForwardQueue& queue, PendingStateCache& states);
+    
+    void handle(const HttpRequest& req, HttpResponse& resp);
+    
+    // Group commit of everything staged during this pass; hands the entries
+    // to the forwarder once durable.
+    void commit();
+    
+    const IngestStats& stats() const { return counters; }
+    
+private:
+    // Seqs seen per device: bit i of `window` is maxSeq - i.
+    struct DeviceState {
+        uint64_t maxSeq = 0;
+        uint64_t window = 0;
+    };
+    
+    IngestConfig config;
+    WriteAheadLog& wal;
+    ForwardQueue& queue;
+    PendingStateCache& states;
+    IngestStats counters;
+    std::unordered_map<std::string, DeviceState> devices;
+    std::vector<WalEntry> staged;
+    size_t stagedBytes = 0;
+    
+    bool overHighWater() const;
+    bool checkAndMarkSeq(DeviceState& dev, uint64_t seq, bool keyframe);
+    void handleVitals(const HttpRequest& req, HttpResponse& resp);
+    void handleAdvertise(const std::string& deviceId, const HttpRequest& req, HttpResponse& resp);
+    void handleChunk(const std::string& deviceId, const HttpRequest& req, HttpResponse& resp);
+    void handleStatePoll(const std::string& deviceId, HttpResponse& resp);
+    void handleStats(HttpResponse& resp);
+    void throttle(HttpResponse& resp);
+};
@@ -0,0 +1,110 @@
+#include "json_scan.h"
+
+#include <cctype>
+#include <cstring>
+
+bool isJsonObject(const std::string& body) {
+    size_t b = body.find_first_not_of(" \t\r\n");
+    size_t e = body.find_last_not_of(" \t\r\n");
+    if (b == std::string::npos || body[b] != '{' || body[e] != '}') return false;
+    
+    int depth = 0;
+    bool inString = false;
+    for (size_t i = b; i <= e; i++) {
+        char c = body[i];
+        if (inString) {
+            if (c == '\\') i++;
+            else if (c == '"') inString = false;
+            continue;
+        }
+        if (c == '"') inString = true;
+        else if (c == '{' || c == '[') depth++;
+        else if (c == '}' || c == ']') {
+            if (--depth < 0) return false;
+            if (depth == 0 && i != e) return false;   // trailing content after the object
+        }
+    }
+    return depth == 0 && !inString;
+}
+
+// Offset just past the ':' following a top-level "key", or npos.
+static size_t findTopLevelValue(const std::string& body, const char* key) {
+    size_t keyLen = strlen(key);
+    int depth = 0;
+    bool inString = false;
+    size_t strStart = 0;
+    for (size_t i = 0; i < body.size(); i++) {
+        char c = body[i];
+        if (inString) {
+            if (c == '\\') {
+                i++;
+            } else if (c == '"') {
+                inString = false;
+                if (depth != 1 || i - strStart != keyLen || body.compare(strStart, keyLen, key) != 0) continue;
+                size_t j = body.find_first_not_of(" \t\r\n", i + 1);
+                if (j != std::string::npos && body[j] == ':') return j + 1;
+            }
+            continue;
+        }
+        if (c == '"') {
+            inString = true;
+            strStart = i + 1;
+        } else if (c == '{' || c == '[') {
+            depth++;
+        } else if (c == '}' || c == ']') {
+            depth--;
+        }
+    }
+    return std::string::npos;
+}
+
+bool jsonFindString(const std::string& body, const char* key, std::string& out) {
+    size_t v = findTopLevelValue(body, key);
+    if (v == std::string::npos) return false;
+    v = body.find_first_not_of(" \t\r\n", v);
+    if (v == std::string::npos || body[v] != '"') return false;
+    size_t end = body.find('"', v + 1);
+    if (end == std::string::npos) return false;
+    out.assign(body, v + 1, end - v - 1);
+    return true;
+}
+
+bool jsonFindUint(const std::string& body, const char* key, uint64_t& out) {
+    size_t v = findTopLevelValue(body, key);
+    if (v == std::string::npos) return false;
+    v = body.find_first_not_of(" \t\r\n", v);
+    if (v == std::string::npos || !isdigit((unsigned char)body[v])) return false;
+    uint64_t n = 0;
+    while (v < body.size() && isdigit((unsigned char)body[v])) n = n * 10 + (body[v++] - '0');
+    out = n;
+    return true;
+}
+
+bool jsonFindStringArray(const std::string& body, const char* key, std::vector<std::string>& out) {
+    size_t v = findTopLevelValue(body, key);
+    if (v == std::string::npos) return false;
+    v = body.find_first_not_of(" \t\r\n", v);
+    if (v == std::string::npos || body[v] != '[') return false;
+    out.clear();
+    for (v++;;) {
+        v = body.find_first_not_of(" \t\r\n,", v);
+        if (v == std::string::npos) return false;
+        if (body[v] == ']') return true;
+        if (body[v] != '"') return false;
+        size_t end = body.find('"', v + 1);
+        if (end == std::string::npos) return false;
+        out.emplace_back(body, v + 1, end - v - 1);
+        v = end + 1;
+    }
+}
+
+bool jsonFindBool(const std::string& body, const char* key, bool& out) {
+    size_t v = findTopLevelValue(body, key);
+    if (v == std::string::npos) return false;
+    v = body.find_first_not_of(" \t\r\n", v);
+    if (v == std::string::npos) return false;
+    if (body.compare(v, 4, "true") == 0) out = true;
+    else if (body.compare(v, 5, "false") == 0) out = false;
+    else return false;
+    return true;
+}
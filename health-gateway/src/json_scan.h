@@ -0,0 +1,26 @@
+/**
+ * Minimal top-level field lookup for device payloads. The gateway forwards
+ * bodies verbatim, so it only needs device_id / seq-style scalars and a
+ * sanity check that the body is a single JSON object.
+ */
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// First and last non-space characters are '{' and '}', with balanced
+// brackets and terminated strings in between.
+bool isJsonObject(const std::string& body);
+
+// Value of a top-level "key": "string" (no unescaping; ids are plain ASCII).
+bool jsonFindString(const std::string& body, const char* key, std::string& out);
+
+// Value of a top-level "key": <unsigned integer>.
+bool jsonFindUint(const std::string& body, const char* key, uint64_t& out);
+
+// Value of a top-level "key": ["string", ...] (no unescaping).
+bool jsonFindStringArray(const std::string& body, const char* key, std::vector<std::string>& out);
+
+// Value of a top-level "key": true|false.
+bool jsonFindBool(const std::string& body, const char* key, bool& out);
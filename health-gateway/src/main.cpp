@@ -0,0 +1,152 @@
+/**
+ * health-gateway - LAN edge gateway for VitalWatch devices
+ *
+ * Devices point API_BASE_URL at the gateway instead of the cloud. Uploads
+ * are acknowledged once they are in the local write-ahead log, then
+ * forwarded upstream in gzip-compressed batches over a single connection.
+ *
+ * Usage:
+ *   health-gateway --upstream https://api.example.com [--listen 0.0.0.0:8080]
+ *                  [--wal-dir ./gateway-wal] [--gateway-id ward-3]
+ *                  [--batch-ms 1000] [--batch-kb 256] [--high-water-mb 64]
+ *                  [--retry-after 30] [--state-poll-ms 10000]
+ */
+
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <curl/curl.h>
+#include <string>
+#include <sys/resource.h>
+
+#include "forwarder.h"
+#include "http_server.h"
+#include "ingest.h"
+#include "wal.h"
+
+static HttpServer* runningServer = nullptr;
+
+static void onSignal(int) {
+    if (runningServer) runningServer->stop();
+}
+
+// 1k+ devices need more sockets than the usual soft limit of 1024.
+static void raiseFileLimit() {
+    struct rlimit rl;
+    if (getrlimit(RLIMIT_NOFILE, &rl) == 0 && rl.rlim_cur < rl.rlim_max) {
+        rl.rlim_cur = rl.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &rl);
+    }
+}
+
+static void usage(const char* argv0) {
+    fprintf(stderr,
+            "usage: %s --upstream URL [--listen HOST:PORT] [--wal-dir DIR] [--gateway-id ID]\n"
+            "          [--batch-ms N] [--batch-kb N] [--high-water-mb N] [--retry-after SEC]\n"
+            "          [--state-poll-ms N]\n", argv0);
+}
+
+int main(int argc, char** argv) {
+    std::string listenHost = "0.0.0.0";
+    int listenPort = 8080;
+    std::string walDir = "gateway-wal";
+    ForwarderConfig fwd;
+    IngestConfig ingestCfg;
+    
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        const char* val = (i + 1 < argc) ? argv[i + 1] : nullptr;
+        if (!val) {
+            usage(argv[0]);
+            return 2;
+        }
+        if (arg == "--upstream") fwd.upstreamBase = val;
+        else if (arg == "--listen") {
+            std::string hp = val;
+            size_t colon = hp.rfind(':');
+            if (colon == std::string::npos) {
+                usage(argv[0]);
+                return 2;
+            }
+            listenHost = hp.substr(0, colon);
+            listenPort = atoi(hp.c_str() + colon + 1);
+        }
+        else if (arg == "--wal-dir") walDir = val;
+        else if (arg == "--gateway-id") fwd.gatewayId = val;
+        else if (arg == "--batch-ms") fwd.batchMs = atoi(val);
+        else if (arg == "--batch-kb") fwd.batchBytes = (size_t)atoi(val) * 1024;
+        else if (arg == "--high-water-mb") ingestCfg.highWaterBytes = (size_t)atoi(val) << 20;
+        else if (arg == "--retry-after") ingestCfg.retryAfterSec = atoi(val);
+        else if (arg == "--state-poll-ms") fwd.statePollMs = atoi(val);
+        else {
+            usage(argv[0]);
+            return 2;
+        }
+        i++;
+    }
+    if (fwd.upstreamBase.empty()) {
+        usage(argv[0]);
+        return 2;
+    }
+    while (!fwd.upstreamBase.empty() && fwd.upstreamBase.back() == '/') fwd.upstreamBase.pop_back();
+    
+    raiseFileLimit();
+    signal(SIGPIPE, SIG_IGN);
+    curl_global_init(CURL_GLOBAL_DEFAULT);
+    
+    WriteAheadLog wal(walDir);
+    std::vector<WalEntry> replay;
+    if (!wal.open(replay)) {
+        fprintf(stderr, "cannot open WAL in %s\n", walDir.c_str());
+        return 1;
+    }
+    ForwardQueue queue;
+    if (!replay.empty()) printf("Replaying %zu unforwarded entries from %s\n", replay.size(), walDir.c_str());
+    queue.push(replay);
+    
+    PendingStateCache states;
+    DeviceIngest ingest(ingestCfg, wal, queue, states);
+    Forwarder forwarder(fwd, wal, queue, states);
+    
+    HttpServer server([&](const HttpRequest& req, HttpResponse& resp) { ingest.handle(req, resp); });
+    server.setBeforeFlush([&] { ingest.commit(); });
+    
+    long long lastReport = monotonicMs();
+    server.setTick([&] {
+        if (monotonicMs() - lastReport < 10000) return;
+        lastReport = monotonicMs();
+        const IngestStats& in = ingest.stats();
+        const ForwarderStats& out = forwarder.stats();
+        printf("devices=%zu conns=%zu accepted=%llu dup=%llu throttled=%llu queued=%zuKB "
+               "upstream batches=%llu entries=%llu ratio=%.1fx failures=%llu state_queries=%llu\n",
+               states.deviceCount(), server.connectionCount(), (unsigned long long)in.accepted.load(),
+               (unsigned long long)in.duplicates.load(), (unsigned long long)in.throttled.load(),
+               queue.bytes() / 1024, (unsigned long long)out.batches.load(),
+               (unsigned long long)out.entries.load(),
+               out.sentBytes ? (double)out.rawBytes / out.sentBytes : 0.0,
+               (unsigned long long)out.failures.load(), (unsigned long long)out.stateQueries.load());
+        fflush(stdout);
+    });
+    
+    if (!server.listen(listenHost, listenPort)) {
+        perror("listen");
+        return 1;
+    }
+    printf("health-gateway %s listening on %s:%d, upstream %s\n", fwd.gatewayId.c_str(), listenHost.c_str(),
+           server.boundPort(), fwd.upstreamBase.c_str());
+    fflush(stdout);
+    
+    runningServer = &server;
+    signal(SIGINT, onSignal);
+    signal(SIGTERM, onSignal);
+    
+    forwarder.start();
+    server.run();
+    
+    ingest.commit();
+    forwarder.stop();
+    curl_global_cleanup();
+    printf("stopped; %zu entries still queued (kept in the WAL)\n", queue.size());
+    return 0;
+}
@@ -0,0 +1,234 @@
+#include "wal.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cinttypes>
+#include <cstdio>
+#include <cstring>
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <zlib.h>
+
+static const size_t RECORD_HEADER = 8;          // length + crc
+static const size_t ENTRY_FIXED = 8 + 1 + 1 + 2 + 8 + 4;
+static const uint32_t MAX_RECORD = 4u << 20;
+
+static void putU16(std::string& s, uint16_t v) { s.append((const char*)&v, 2); }
+static void putU32(std::string& s, uint32_t v) { s.append((const char*)&v, 4); }
+static void putU64(std::string& s, uint64_t v) { s.append((const char*)&v, 8); }
+
+template <typename T>
+static T getLE(const char* p) {
+    T v;
+    memcpy(&v, p, sizeof(T));
+    return v;
+}
+
+static bool writeAll(int fd, const char* data, size_t len) {
+    while (len > 0) {
+        ssize_t w = write(fd, data, len);
+        if (w < 0) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        data += w;
+        len -= w;
+    }
+    return true;
+}
+
+static void syncDir(const std::string& dir) {
+    int fd = ::open(dir.c_str(), O_RDONLY | O_DIRECTORY);
+    if (fd < 0) return;
+    fsync(fd);
+    close(fd);
+}
+
+WriteAheadLog::WriteAheadLog(const std::string& d, size_t segBytes) : dir(d), segmentBytes(segBytes) {}
+
+WriteAheadLog::~WriteAheadLog() {
+    if (activeFd >= 0) close(activeFd);
+}
+
+std::string WriteAheadLog::segmentPath(uint64_t firstIndex) const {
+    char name[48];
+    snprintf(name, sizeof(name), "/wal-%016" PRIx64 ".log", firstIndex);
+    return dir + name;
+}
+
+bool WriteAheadLog::open(std::vector<WalEntry>& pending) {
+    std::lock_guard<std::mutex> lock(mutex);
+    mkdir(dir.c_str(), 0755);
+    
+    FILE* cp = fopen((dir + "/checkpoint").c_str(), "rb");
+    if (cp) {
+        if (fread(&acked, sizeof(acked), 1, cp) != 1) acked = 0;
+        fclose(cp);
+    }
+    nextIndex = acked + 1;
+    
+    DIR* dp = opendir(dir.c_str());
+    if (!dp) return false;
+    while (dirent* de = readdir(dp)) {
+        uint64_t first;
+        if (sscanf(de->d_name, "wal-%16" SCNx64 ".log", &first) == 1) {
+            segments.push_back({first, dir + "/" + de->d_name});
+        }
+    }
+    closedir(dp);
+    std::sort(segments.begin(), segments.end(),
+              [](const Segment& a, const Segment& b) { return a.firstIndex < b.firstIndex; });
+    
+    for (size_t i = 0; i < segments.size(); i++) {
+        bool torn = false;
+        if (!replaySegment(segments[i], pending, torn)) return false;
+        if (torn) {
+            // Only the newest segment can legitimately end mid-record; anything
+            // written after a damaged record cannot be trusted to be in order.
+            for (size_t j = i + 1; j < segments.size(); j++) {
+                fprintf(stderr, "wal: dropping %s after damaged record\n", segments[j].path.c_str());
+                unlink(segments[j].path.c_str());
+            }
+            segments.resize(i + 1);
+            break;
+        }
+    }
+    
+    if (segments.empty()) return openActive(nextIndex);
+    activeFd = ::open(segments.back().path.c_str(), O_WRONLY | O_APPEND);
+    if (activeFd < 0) return false;
+    struct stat st;
+    fstat(activeFd, &st);
+    activeSize = st.st_size;
+    return true;
+}
+
+bool WriteAheadLog::replaySegment(const Segment& seg, std::vector<WalEntry>& pending, bool& torn) {
+    FILE* f = fopen(seg.path.c_str(), "rb");
+    if (!f) return false;
+    
+    std::string rec;
+    long goodEnd = 0;
+    char hdr[RECORD_HEADER];
+    while (fread(hdr, 1, RECORD_HEADER, f) == RECORD_HEADER) {
+        uint32_t len = getLE<uint32_t>(hdr);
+        uint32_t crc = getLE<uint32_t>(hdr + 4);
+        if (len < ENTRY_FIXED || len > MAX_RECORD) break;
+        rec.resize(len);
+        if (fread(&rec[0], 1, len, f) != len) break;
+        if (crc32(0L, (const Bytef*)rec.data(), len) != crc) break;
+        
+        WalEntry e;
+        const char* p = rec.data();
+        e.index = getLE<uint64_t>(p);
+        e.kind = (uint8_t)p[8];
+        uint8_t idLen = (uint8_t)p[9];
+        e.seq = getLE<uint64_t>(p + 12);
+        e.count = getLE<uint32_t>(p + 20);
+        if (ENTRY_FIXED + idLen > len) break;
+        e.deviceId.assign(p + ENTRY_FIXED, idLen);
+        e.body.assign(p + ENTRY_FIXED + idLen, len - ENTRY_FIXED - idLen);
+        
+        goodEnd = ftell(f);
+        if (e.index >= nextIndex) nextIndex = e.index + 1;
+        if (e.index > acked) pending.push_back(std::move(e));
+    }
+    
+    fseek(f, 0, SEEK_END);
+    long size = ftell(f);
+    fclose(f);
+    if (size != goodEnd) {
+        fprintf(stderr, "wal: truncating %s at %ld (was %ld)\n", seg.path.c_str(), goodEnd, size);
+        if (truncate(seg.path.c_str(), goodEnd) != 0) return false;
+        torn = true;
+    }
+    return true;
+}
+
+bool WriteAheadLog::openActive(uint64_t firstIndex) {
+    if (activeFd >= 0) close(activeFd);
+    Segment seg = {firstIndex, segmentPath(firstIndex)};
+    activeFd = ::open(seg.path.c_str(), O_WRONLY | O_CREAT | O_APPEND, 0644);
+    if (activeFd < 0) return false;
+    activeSize = 0;
+    segments.push_back(seg);
+    syncDir(dir);
+    return true;
+}
+
+uint64_t WriteAheadLog::append(WalEntry& e) {
+    std::lock_guard<std::mutex> lock(mutex);
+    e.index = nextIndex++;
+    if (buffer.empty()) bufferFirstIndex = e.index;
+    
+    uint8_t idLen = (uint8_t)std::min<size_t>(e.deviceId.size(), 255);
+    std::string rec;
+    rec.reserve(ENTRY_FIXED + idLen + e.body.size());
+    putU64(rec, e.index);
+    rec.push_back((char)e.kind);
+    rec.push_back((char)idLen);
+    putU16(rec, 0);
+    putU64(rec, e.seq);
+    putU32(rec, e.count);
+    rec.append(e.deviceId, 0, idLen);
+    rec.append(e.body);
+    
+    putU32(buffer, rec.size());
+    putU32(buffer, crc32(0L, (const Bytef*)rec.data(), rec.size()));
+    buffer += rec;
+    return e.index;
+}
+
+bool WriteAheadLog::commit() {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (buffer.empty()) return true;
+    if (activeSize >= segmentBytes && !openActive(bufferFirstIndex)) return false;
+    if (!writeAll(activeFd, buffer.data(), buffer.size())) return false;
+    if (fdatasync(activeFd) != 0) return false;
+    activeSize += buffer.size();
+    totalCommitted += buffer.size();
+    buffer.clear();
+    return true;
+}
+
+bool WriteAheadLog::writeCheckpoint(uint64_t index) {
+    std::string tmp = dir + "/checkpoint.tmp";
+    int fd = ::open(tmp.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) return false;
+    bool ok = writeAll(fd, (const char*)&index, sizeof(index)) && fdatasync(fd) == 0;
+    close(fd);
+    if (!ok || rename(tmp.c_str(), (dir + "/checkpoint").c_str()) != 0) return false;
+    syncDir(dir);
+    return true;
+}
+
+bool WriteAheadLog::acknowledge(uint64_t index) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (index <= acked) return true;
+    if (!writeCheckpoint(index)) return false;
+    acked = index;
+    
+    // A segment is done once the next one starts at or below acked + 1.
+    while (segments.size() > 1 && segments[1].firstIndex <= acked + 1) {
+        unlink(segments.front().path.c_str());
+        segments.erase(segments.begin());
+    }
+    return true;
+}
+
+uint64_t WriteAheadLog::lastIndex() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return nextIndex - 1;
+}
+
+uint64_t WriteAheadLog::ackedIndex() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return acked;
+}
+
+uint64_t WriteAheadLog::committedBytes() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return totalCommitted;
+}
@@ -0,0 +1,80 @@
+/**
+ * Write-ahead log for accepted device uploads.
+ *
+ * Entries are appended to size-capped segment files (wal-<first index>.log)
+ * and made durable in groups: append() buffers, commit() writes the buffer
+ * with a single fdatasync. A separate checkpoint file holds the highest index
+ * the upstream has accepted; segments wholly below it are deleted. On open,
+ * entries past the checkpoint are replayed and a torn tail is truncated.
+ *
+ * Record layout (little-endian):
+ *   u32 length, u32 crc32, then `length` bytes of
+ *   u64 index, u8 kind, u8 idLen, u16 reserved, u64 seq, u32 count, id, body
+ */
+#pragma once
+
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+enum WalKind : uint8_t {
+    WAL_VITALS = 1,     // live upload, body as sent by sendToCloud()
+    WAL_HISTORY = 2     // history chunk, body inflated
+};
+
+struct WalEntry {
+    uint64_t index = 0;
+    uint8_t kind = WAL_VITALS;
+    std::string deviceId;
+    uint64_t seq = 0;       // upload seq, or first record seq of a history chunk
+    uint32_t count = 0;     // records covered by a history chunk
+    std::string body;
+    
+    size_t footprint() const { return body.size() + deviceId.size() + 32; }
+};
+
+class WriteAheadLog {
+public:
+    explicit WriteAheadLog(const std::string& dir, size_t segmentBytes = 16u << 20);
+    ~WriteAheadLog();
+    
+    // Replays entries past the checkpoint into `pending`.
+    bool open(std::vector<WalEntry>& pending);
+    
+    // Assigns the entry its index and buffers it until commit().
+    uint64_t append(WalEntry& entry);
+    
+    // Writes and syncs everything appended since the last commit.
+    bool commit();
+    
+    // Everything up to and including `index` was accepted upstream.
+    bool acknowledge(uint64_t index);
+    
+    uint64_t lastIndex() const;
+    uint64_t ackedIndex() const;
+    uint64_t committedBytes() const;
+    
+private:
+    struct Segment {
+        uint64_t firstIndex;
+        std::string path;
+    };
+    
+    std::string dir;
+    size_t segmentBytes;
+    mutable std::mutex mutex;
+    std::vector<Segment> segments;
+    int activeFd = -1;
+    size_t activeSize = 0;
+    std::string buffer;
+    uint64_t bufferFirstIndex = 0;
+    uint64_t nextIndex = 1;
+    uint64_t acked = 0;
+    uint64_t totalCommitted = 0;
+    
+    std::string segmentPath(uint64_t firstIndex) const;
+    bool openActive(uint64_t firstIndex);
+    bool replaySegment(const Segment& seg, std::vector<WalEntry>& pending, bool& torn);
+    bool writeCheckpoint(uint64_t index);
+};
@@ -0,0 +1,365 @@
+/**
+ * gateway-test - unit and loopback tests for gateway_core, run by ctest.
+ *
+ * Covers the JSON scanner, gzip helpers, batch format, WAL replay and
+ * checkpointing, device ingest (dedup, backpressure) and the forwarder
+ * against an in-process upstream: batch upload, and batched state queries.
+ */
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+#include "forwarder.h"
+#include "gzip.h"
+#include "http_server.h"
+#include "ingest.h"
+#include "json_scan.h"
+#include "wal.h"
+
+static int failures = 0;
+
+#define CHECK(cond)                                                        \
+    do {                                                                   \
+        if (!(cond)) {                                                     \
+            fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #cond); \
+            failures++;                                                    \
+        }                                                                  \
+    } while (0)
+
+static std::string tempDir() {
+    char path[] = "/tmp/gateway-test-XXXXXX";
+    return mkdtemp(path) ? path : "";
+}
+
+static void removeDir(const std::string& dir) {
+    std::string cmd = "rm -rf '" + dir + "'";
+    if (system(cmd.c_str()) != 0) fprintf(stderr, "could not remove %s\n", dir.c_str());
+}
+
+static bool waitUntil(std::function<bool()> done, int timeoutMs) {
+    long long end = monotonicMs() + timeoutMs;
+    while (monotonicMs() < end) {
+        if (done()) return true;
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    return done();
+}
+
+// ==================== JSON SCAN ====================
+static void testJsonScan() {
+    std::string body = "{\"device_id\":\"DEV-1\",\"seq\":42,\"delta\":true,\"nested\":{\"seq\":7},"
+                       "\"ids\":[\"a\", \"b\",\"c\"],\"empty\":[]}";
+    CHECK(isJsonObject(body));
+    CHECK(!isJsonObject("{\"a\":1}{}"));
+    CHECK(!isJsonObject("{\"a\":\"unterminated}"));
+    CHECK(!isJsonObject("[1,2]"));
+    
+    std::string s;
+    uint64_t n = 0;
+    bool b = false;
+    CHECK(jsonFindString(body, "device_id", s) && s == "DEV-1");
+    CHECK(jsonFindUint(body, "seq", n) && n == 42);   // top level, not nested.seq
+    CHECK(jsonFindBool(body, "delta", b) && b);
+    CHECK(!jsonFindString(body, "missing", s));
+    
+    std::vector<std::string> ids;
+    CHECK(jsonFindStringArray(body, "ids", ids) && ids.size() == 3 && ids[0] == "a" && ids[2] == "c");
+    CHECK(jsonFindStringArray(body, "empty", ids) && ids.empty());
+    CHECK(!jsonFindStringArray(body, "seq", ids));
+}
+
+// ==================== GZIP ====================
+static void testGzip() {
+    std::string plain;
+    for (int i = 0; i < 2000; i++) plain += "{\"seq\":" + std::to_string(i) + ",\"heart_rate\":61}";
+    std::string gz, back;
+    CHECK(gzipCompress(plain, gz, 6));
+    CHECK(gz.size() < plain.size() / 5);
+    CHECK(gzipDecompress(gz, back, 1 << 20) && back == plain);
+    CHECK(!gzipDecompress(gz, back, plain.size() - 1));   // inflates past the cap
+    gz[gz.size() / 2] ^= 0x55;
+    CHECK(!gzipDecompress(gz, back, 1 << 20));
+    CHECK(crc32Of("The quick brown fox jumps over the lazy dog") == 0x414FA339u);
+}
+
+// ==================== BATCH FORMAT ====================
+static WalEntry vitalsEntry(const std::string& id, uint64_t seq) {
+    WalEntry e;
+    e.kind = WAL_VITALS;
+    e.deviceId = id;
+    e.seq = seq;
+    e.body = "{\"device_id\":\"" + id + "\",\"seq\":" + std::to_string(seq) + "}";
+    return e;
+}
+
+static void testFormatBatch() {
+    std::vector<WalEntry> batch = {vitalsEntry("A", 1), vitalsEntry("B", 9)};
+    batch[0].index = 10;
+    batch[1].index = 11;
+    batch[1].kind = WAL_HISTORY;
+    batch[1].count = 96;
+    std::string body = formatBatch("ward-3", batch);
+    uint64_t first = 0, last = 0;
+    std::string gw;
+    CHECK(isJsonObject(body));
+    CHECK(jsonFindUint(body, "first_index", first) && first == 10);
+    CHECK(jsonFindUint(body, "last_index", last) && last == 11);
+    CHECK(jsonFindString(body, "gateway_id", gw) && gw == "ward-3");
+    CHECK(body.find("{\"kind\":\"vitals\",\"device_id\":\"A\",\"seq\":1,\"payload\":{") != std::string::npos);
+    CHECK(body.find("{\"kind\":\"history\",\"device_id\":\"B\",\"from\":9,\"count\":96,\"payload\":{") !=
+          std::string::npos);
+}
+
+// ==================== WAL ====================
+static void testWalReplay() {
+    std::string dir = tempDir();
+    {
+        WriteAheadLog wal(dir, 4096);   // small segments so several are written
+        std::vector<WalEntry> pending;
+        CHECK(wal.open(pending) && pending.empty());
+        for (int i = 1; i <= 100; i++) {
+            WalEntry e = vitalsEntry("DEV", i);
+            CHECK(wal.append(e) == (uint64_t)i);
+            if (i % 10 == 0) CHECK(wal.commit());
+        }
+        WalEntry uncommitted = vitalsEntry("DEV", 101);
+        wal.append(uncommitted);   // never committed: lost, like a crash before fdatasync
+        CHECK(wal.acknowledge(60));
+    }
+    {
+        WriteAheadLog wal(dir, 4096);
+        std::vector<WalEntry> pending;
+        CHECK(wal.open(pending));
+        CHECK(pending.size() == 40);
+        CHECK(!pending.empty() && pending.front().index == 61 && pending.back().index == 100);
+        CHECK(!pending.empty() && pending.front().seq == 61 && pending.front().deviceId == "DEV");
+        CHECK(wal.ackedIndex() == 60 && wal.lastIndex() == 100);
+        WalEntry next = vitalsEntry("DEV", 102);
+        CHECK(wal.append(next) == 101);
+    }
+    removeDir(dir);
+}
+
+// ==================== INGEST ====================
+static HttpRequest vitalsRequest(const std::string& id, uint64_t seq, bool delta) {
+    HttpRequest req;
+    req.method = "POST";
+    req.path = "/health/vitals";
+    req.body = "{\"device_id\":\"" + id + "\",\"seq\":" + std::to_string(seq) + (delta ? ",\"delta\":true}" : "}");
+    return req;
+}
+
+static void testIngestDedupAndBackpressure() {
+    std::string dir = tempDir();
+    WriteAheadLog wal(dir);
+    std::vector<WalEntry> pending;
+    CHECK(wal.open(pending));
+    ForwardQueue queue;
+    PendingStateCache states;
+    IngestConfig cfg;
+    cfg.highWaterBytes = 600;
+    DeviceIngest ingest(cfg, wal, queue, states);
+    
+    HttpResponse r1, r2, r3, r4;
+    ingest.handle(vitalsRequest("DEV", 5, false), r1);
+    ingest.handle(vitalsRequest("DEV", 5, true), r2);    // retry of an accepted seq
+    ingest.handle(vitalsRequest("DEV", 4, true), r3);    // late but inside the window
+    ingest.commit();
+    CHECK(r1.status == 201 && r2.status == 200 && r3.status == 201);
+    CHECK(ingest.stats().accepted == 2 && ingest.stats().duplicates == 1);
+    CHECK(queue.size() == 2);
+    
+    // Past the high-water mark devices are throttled, and the throttled seq
+    // is accepted once the queue drains
+    for (uint64_t seq = 6; queue.bytes() < cfg.highWaterBytes; seq++) {
+        HttpResponse r;
+        ingest.handle(vitalsRequest("DEV", seq, true), r);
+        ingest.commit();
+    }
+    ingest.handle(vitalsRequest("DEV", 100, true), r4);
+    CHECK(r4.status == 503);
+    CHECK(!r4.headers.empty() && r4.headers[0].first == "Retry-After");
+    queue.pop(wal.lastIndex());
+    HttpResponse r5;
+    ingest.handle(vitalsRequest("DEV", 100, true), r5);
+    CHECK(r5.status == 201);
+    
+    HttpRequest bad;
+    bad.method = "POST";
+    bad.path = "/health/vitals";
+    bad.body = "{\"seq\":1}";
+    HttpResponse r6;
+    ingest.handle(bad, r6);
+    CHECK(r6.status == 400);
+    removeDir(dir);
+}
+
+// ==================== FORWARDER ====================
+// In-process upstream on an ephemeral port
+struct FakeUpstream {
+    std::mutex mutex;
+    std::vector<std::string> stateQueries;     // bodies received
+    std::vector<std::pair<uint64_t, uint64_t>> batches;
+    std::map<std::string, std::string> pending;
+    HttpServer server;
+    std::thread thread;
+    
+    FakeUpstream()
+        : server([this](const HttpRequest& req, HttpResponse& resp) { handle(req, resp); }) {
+        if (!server.listen("127.0.0.1", 0)) perror("listen");
+        thread = std::thread([this] { server.run(); });
+    }
+    
+    ~FakeUpstream() {
+        server.stop();
+        thread.join();
+    }
+    
+    std::string base() { return "http://127.0.0.1:" + std::to_string(server.boundPort()); }
+    
+    void handle(const HttpRequest& req, HttpResponse& resp) {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (req.method == "POST" && req.path == "/health/gateway/batch") {
+            std::string json;
+            uint64_t first = 0, last = 0;
+            if (!gzipDecompress(req.body, json, 64u << 20) || !jsonFindUint(json, "first_index", first) ||
+                !jsonFindUint(json, "last_index", last)) {
+                resp.status = 400;
+                return;
+            }
+            batches.emplace_back(first, last);
+            resp.body = "{\"accepted_through\":" + std::to_string(last) + "}";
+            return;
+        }
+        if (req.method == "POST" && req.path == "/health/gateway/state/pending") {
+            stateQueries.push_back(req.body);
+            std::vector<std::string> ids;
+            if (!jsonFindStringArray(req.body, "device_ids", ids)) {
+                resp.status = 400;
+                return;
+            }
+            resp.body = "{";
+            for (const std::string& id : ids) {
+                auto it = pending.find(id);
+                if (it == pending.end()) continue;
+                if (resp.body.size() > 1) resp.body += ',';
+                resp.body += "\"" + id + "\":\"" + it->second + "\"";
+                pending.erase(it);
+            }
+            resp.body += "}";
+            return;
+        }
+        resp.status = 404;
+    }
+};
+
+static void testForwarderBatches() {
+    FakeUpstream upstream;
+    std::string dir = tempDir();
+    WriteAheadLog wal(dir);
+    std::vector<WalEntry> pending;
+    CHECK(wal.open(pending));
+    ForwardQueue queue;
+    PendingStateCache states;
+    
+    std::vector<WalEntry> entries;
+    for (int i = 1; i <= 50; i++) {
+        entries.push_back(vitalsEntry("DEV", i));
+        wal.append(entries.back());
+    }
+    CHECK(wal.commit());
+    queue.push(entries);
+    
+    ForwarderConfig cfg;
+    cfg.upstreamBase = upstream.base();
+    cfg.batchBytes = 1024;
+    cfg.batchMs = 20;
+    cfg.statePollMs = 0;
+    Forwarder forwarder(cfg, wal, queue, states);
+    forwarder.start();
+    CHECK(waitUntil([&] { return wal.ackedIndex() == 50; }, 5000));
+    forwarder.stop();
+    
+    CHECK(queue.size() == 0);
+    std::lock_guard<std::mutex> lock(upstream.mutex);
+    CHECK(upstream.batches.size() > 1);   // 1 KB batches
+    uint64_t next = 1;
+    for (const auto& b : upstream.batches) {
+        CHECK(b.first == next);
+        next = b.second + 1;
+    }
+    CHECK(next == 51);
+    removeDir(dir);
+}
+
+static void testStatePollIsBatched() {
+    FakeUpstream upstream;
+    std::string dir = tempDir();
+    WriteAheadLog wal(dir);
+    std::vector<WalEntry> pending;
+    CHECK(wal.open(pending));
+    ForwardQueue queue;
+    PendingStateCache states;
+    
+    const int DEVICES = 600;
+    for (int i = 0; i < DEVICES; i++) states.touch("DEV" + std::to_string(i));
+    {
+        std::lock_guard<std::mutex> lock(upstream.mutex);
+        upstream.pending["DEV7"] = "monitoring";
+        upstream.pending["DEV599"] = "idle";
+        upstream.pending["NOT_ACTIVE"] = "idle";
+    }
+    
+    ForwarderConfig cfg;
+    cfg.upstreamBase = upstream.base();
+    cfg.statePollMs = 60000;   // one cycle during the test
+    Forwarder forwarder(cfg, wal, queue, states);
+    forwarder.start();
+    CHECK(waitUntil([&] { return forwarder.stats().stateQueries.load() == 3; }, 5000));
+    forwarder.stop();
+    
+    // 600 devices: 256 + 256 + 88 ids, not 600 GETs
+    std::lock_guard<std::mutex> lock(upstream.mutex);
+    CHECK(upstream.stateQueries.size() == 3);
+    size_t ids = 0;
+    for (const std::string& body : upstream.stateQueries) {
+        std::vector<std::string> got;
+        std::string gw;
+        CHECK(jsonFindStringArray(body, "device_ids", got) && got.size() <= 256);
+        CHECK(jsonFindString(body, "gateway_id", gw) && gw == "gateway");
+        ids += got.size();
+    }
+    CHECK(ids == (size_t)DEVICES);
+    
+    std::string state;
+    CHECK(states.take("DEV7", state) && state == "monitoring");
+    CHECK(states.take("DEV599", state) && state == "idle");
+    CHECK(!states.take("DEV8", state));
+    CHECK(upstream.pending.count("NOT_ACTIVE") == 1);
+    removeDir(dir);
+}
+
+int main() {
+    testJsonScan();
+    testGzip();
+    testFormatBatch();
+    testWalReplay();
+    testIngestDedupAndBackpressure();
+    testForwarderBatches();
+    testStatePollIsBatched();
+    if (failures) {
+        fprintf(stderr, "%d check(s) failed\n", failures);
+        return 1;
+    }
+    printf("gateway-test: all checks passed\n");
+    return 0;
+}
@@ -0,0 +1,271 @@
+/**
+ * gateway-bench - throughput benchmark with simulated devices.
+ *
+ * Each simulated device keeps its own connection and posts firmware-shaped
+ * uploads (a keyframe every 12th seq, deltas in between) to /health/vitals.
+ * Worker threads round-robin over their devices as fast as the gateway
+ * answers, so the result is the gateway's sustained acknowledged rate with
+ * every device connected at once. --reconnect opens a new connection per
+ * request, as the ESP32 HTTPClient does.
+ *
+ * Usage:
+ *   gateway-bench [--target 127.0.0.1:8080] [--devices 1000] [--threads 4]
+ *                 [--seconds 10] [--reconnect]
+ */
+
+#include <algorithm>
+#include <arpa/inet.h>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <string>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+#include "http_server.h"
+
+struct SimDevice {
+    std::string id;
+    int fd = -1;
+    uint64_t seq = 0;
+};
+
+struct WorkerResult {
+    std::vector<uint32_t> latencyUs;
+    uint64_t ok = 0;
+    uint64_t duplicate = 0;
+    uint64_t throttled = 0;
+    uint64_t failed = 0;
+    uint64_t bytesSent = 0;
+};
+
+static sockaddr_in target;
+
+static int connectTarget() {
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0) return -1;
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    if (connect(fd, (sockaddr*)&target, sizeof(target)) < 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+// Roughly what sendToCloud() produces: ~700 B keyframes, ~250 B deltas.
+static std::string makePayload(const SimDevice& dev) {
+    char buf[1024];
+    int hr = 60 + (int)(dev.seq * 7 % 40);
+    int spo2 = 94 + (int)(dev.seq % 5);
+    if (dev.seq % 12 == 1) {
+        snprintf(buf, sizeof(buf),
+                 "{\"device_id\":\"%s\",\"seq\":%llu,\"timestamp\":\"2026-10-18T10:00:00Z\","
+                 "\"vitals\":{\"heart_rate\":{\"bpm\":%d,\"signal_quality\":92,\"source\":\"MAX30102\",\"is_valid\":true},"
+                 "\"spo2\":{\"percent\":%d,\"signal_quality\":88,\"is_valid\":true,\"source\":\"MAX30102\"},"
+                 "\"temperature\":{\"celsius\":36.8,\"source\":\"DS18B20\",\"is_estimated\":false,\"is_predicted\":false}},"
+                 "\"system\":{\"wifi_rssi\":-61,\"uptime_seconds\":%llu,\"monitoring_state\":\"monitoring\","
+                 "\"free_heap\":182344,\"firmware_version\":\"4.1\",\"battery_percent\":78,\"battery_voltage\":3.97,"
+                 "\"power_tier\":\"normal\",\"uplink\":{\"acked\":%llu,\"transport_errors\":0,\"server_errors\":0,"
+                 "\"rejected\":0,\"backlog\":0}},"
+                 "\"trace\":{\"sample_age_ms\":41,\"beat_age_ms\":312,\"serialize_ms\":3,\"prev_rtt_ms\":87}}",
+                 dev.id.c_str(), (unsigned long long)dev.seq, hr, spo2, (unsigned long long)dev.seq * 5,
+                 (unsigned long long)dev.seq - 1);
+    } else {
+        snprintf(buf, sizeof(buf),
+                 "{\"device_id\":\"%s\",\"seq\":%llu,\"delta\":true,\"base_seq\":%llu,"
+                 "\"timestamp\":\"2026-10-18T10:00:05Z\",\"vitals\":{\"heart_rate\":{\"bpm\":%d,\"signal_quality\":92}},"
+                 "\"trace\":{\"sample_age_ms\":38,\"beat_age_ms\":290,\"serialize_ms\":2,\"prev_rtt_ms\":85}}",
+                 dev.id.c_str(), (unsigned long long)dev.seq, (unsigned long long)dev.seq - 1, hr);
+    }
+    return buf;
+}
+
+// Sends one upload and reads the response; returns the status or -1.
+static int postOnce(int fd, const std::string& body, uint64_t& sent) {
+    char head[160];
+    int n = snprintf(head, sizeof(head),
+                     "POST /health/vitals HTTP/1.1\r\nHost: gateway\r\nContent-Type: application/json\r\n"
+                     "Content-Length: %zu\r\n\r\n", body.size());
+    std::string req(head, n);
+    req += body;
+    size_t off = 0;
+    while (off < req.size()) {
+        ssize_t w = write(fd, req.data() + off, req.size() - off);
+        if (w <= 0) return -1;
+        off += w;
+    }
+    sent += req.size();
+    
+    std::string in;
+    char buf[4096];
+    size_t headerEnd = std::string::npos;
+    size_t need = 0;
+    for (;;) {
+        ssize_t r = read(fd, buf, sizeof(buf));
+        if (r <= 0) return -1;
+        in.append(buf, r);
+        if (headerEnd == std::string::npos) {
+            headerEnd = in.find("\r\n\r\n");
+            if (headerEnd == std::string::npos) continue;
+            size_t cl = in.find("Content-Length: ");
+            need = headerEnd + 4 + (cl != std::string::npos ? strtoul(in.c_str() + cl + 16, nullptr, 10) : 0);
+        }
+        if (in.size() >= need) break;
+    }
+    return atoi(in.c_str() + 9);
+}
+
+static void runWorker(std::vector<SimDevice>& devices, bool reconnect, std::atomic<bool>& running,
+                      WorkerResult& res) {
+    res.latencyUs.reserve(1 << 20);
+    size_t i = 0;
+    while (running) {
+        SimDevice& dev = devices[i];
+        i = (i + 1) % devices.size();
+        
+        if (dev.fd < 0) dev.fd = connectTarget();
+        if (dev.fd < 0) {
+            res.failed++;
+            continue;
+        }
+        dev.seq++;
+        std::string body = makePayload(dev);
+        
+        auto t0 = std::chrono::steady_clock::now();
+        int status = postOnce(dev.fd, body, res.bytesSent);
+        auto us = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - t0).count();
+        
+        if (status == 201) res.ok++;
+        else if (status == 200) res.duplicate++;
+        else if (status == 503) res.throttled++;
+        else res.failed++;
+        if (status > 0) res.latencyUs.push_back((uint32_t)us);
+        
+        if (status < 0 || reconnect) {
+            close(dev.fd);
+            dev.fd = -1;
+        }
+    }
+    for (auto& d : devices) {
+        if (d.fd >= 0) close(d.fd);
+    }
+}
+
+static std::string fetchStats() {
+    int fd = connectTarget();
+    if (fd < 0) return "";
+    const char* req = "GET /gateway/stats HTTP/1.1\r\nHost: gateway\r\nConnection: close\r\n\r\n";
+    if (write(fd, req, strlen(req)) < 0) {
+        close(fd);
+        return "";
+    }
+    std::string in;
+    char buf[4096];
+    ssize_t r;
+    while ((r = read(fd, buf, sizeof(buf))) > 0) in.append(buf, r);
+    close(fd);
+    size_t body = in.find("\r\n\r\n");
+    return body == std::string::npos ? "" : in.substr(body + 4);
+}
+
+int main(int argc, char** argv) {
+    std::string host = "127.0.0.1";
+    int port = 8080;
+    int deviceCount = 1000;
+    int threads = 4;
+    int seconds = 10;
+    bool reconnect = false;
+    
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--reconnect") {
+            reconnect = true;
+            continue;
+        }
+        if (i + 1 >= argc) break;
+        std::string val = argv[++i];
+        if (arg == "--target") {
+            size_t colon = val.rfind(':');
+            host = val.substr(0, colon);
+            port = atoi(val.c_str() + colon + 1);
+        } else if (arg == "--devices") {
+            deviceCount = atoi(val.c_str());
+        } else if (arg == "--threads") {
+            threads = std::max(1, atoi(val.c_str()));
+        } else if (arg == "--seconds") {
+            seconds = atoi(val.c_str());
+        }
+    }
+    
+    struct rlimit rl;
+    if (getrlimit(RLIMIT_NOFILE, &rl) == 0) {
+        rl.rlim_cur = rl.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &rl);
+    }
+    target.sin_family = AF_INET;
+    target.sin_port = htons(port);
+    inet_pton(AF_INET, host.c_str(), &target.sin_addr);
+    
+    // Unique ids per run so the gateway's dedup window starts fresh.
+    std::vector<std::vector<SimDevice>> shards(threads);
+    unsigned runTag = (unsigned)time(nullptr) % 100000;
+    for (int d = 0; d < deviceCount; d++) {
+        SimDevice dev;
+        char id[32];
+        snprintf(id, sizeof(id), "BENCH_%05u_%04d", runTag, d);
+        dev.id = id;
+        if (!reconnect) dev.fd = connectTarget();
+        shards[d % threads].push_back(dev);
+    }
+    int connected = 0;
+    for (auto& shard : shards)
+        for (auto& d : shard) connected += d.fd >= 0;
+    printf("%d devices (%d connected up front), %d threads, %d s, %s\n", deviceCount, connected, threads, seconds,
+           reconnect ? "new connection per upload" : "keep-alive");
+    
+    std::atomic<bool> running(true);
+    std::vector<WorkerResult> results(threads);
+    std::vector<std::thread> workers;
+    auto start = std::chrono::steady_clock::now();
+    for (int t = 0; t < threads; t++) {
+        workers.emplace_back(runWorker, std::ref(shards[t]), reconnect, std::ref(running), std::ref(results[t]));
+    }
+    std::this_thread::sleep_for(std::chrono::seconds(seconds));
+    running = false;
+    for (auto& w : workers) w.join();
+    double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    
+    WorkerResult total;
+    for (auto& r : results) {
+        total.ok += r.ok;
+        total.duplicate += r.duplicate;
+        total.throttled += r.throttled;
+        total.failed += r.failed;
+        total.bytesSent += r.bytesSent;
+        total.latencyUs.insert(total.latencyUs.end(), r.latencyUs.begin(), r.latencyUs.end());
+    }
+    std::sort(total.latencyUs.begin(), total.latencyUs.end());
+    auto pct = [&](double p) -> double {
+        if (total.latencyUs.empty()) return 0;
+        return total.latencyUs[std::min(total.latencyUs.size() - 1, (size_t)(p * total.latencyUs.size()))] / 1000.0;
+    };
+    
+    uint64_t answered = total.ok + total.duplicate + total.throttled;
+    printf("uploads: %llu accepted, %llu duplicate, %llu throttled (503), %llu failed\n",
+           (unsigned long long)total.ok, (unsigned long long)total.duplicate,
+           (unsigned long long)total.throttled, (unsigned long long)total.failed);
+    printf("throughput: %.0f uploads/s (%.1f MB/s in); at 1 upload per device every 5 s that is %.0f devices\n",
+           answered / elapsed, total.bytesSent / elapsed / 1e6, answered / elapsed * 5);
+    printf("latency ms: p50 %.2f  p95 %.2f  p99 %.2f  max %.2f\n", pct(0.50), pct(0.95), pct(0.99), pct(1.0));
+    std::string stats = fetchStats();
+    if (!stats.empty()) printf("gateway: %s\n", stats.c_str());
+    return 0;
+}
@@ -0,0 +1,159 @@
+/**
+ * upstream-stub - local stand-in for the cloud API behind health-gateway.
+ *
+ * Accepts POST /health/gateway/batch (gzip), checks the batch shape and
+ * index continuity, and answers batched state queries. Failure injection exercises the
+ * gateway's backoff and backpressure paths.
+ *
+ * Usage:
+ *   upstream-stub [--listen 127.0.0.1:9090] [--fail-pct N] [--delay-ms N]
+ *                 [--pending DEVICE_ID=STATE ...]
+ */
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "gzip.h"
+#include "http_server.h"
+#include "json_scan.h"
+
+struct StubStats {
+    uint64_t batches = 0;
+    uint64_t vitals = 0;
+    uint64_t history = 0;
+    uint64_t wireBytes = 0;
+    uint64_t rawBytes = 0;
+    uint64_t replayed = 0;      // batches starting at or below an already accepted index
+    uint64_t gaps = 0;          // batches starting past lastIndex + 1
+    uint64_t rejected = 0;      // malformed batches
+    uint64_t injected = 0;      // 503s from --fail-pct
+    uint64_t stateQueries = 0;
+    uint64_t lastIndex = 0;
+};
+
+static size_t countOf(const std::string& s, const char* needle) {
+    size_t n = 0, pos = 0, len = strlen(needle);
+    while ((pos = s.find(needle, pos)) != std::string::npos) {
+        n++;
+        pos += len;
+    }
+    return n;
+}
+
+int main(int argc, char** argv) {
+    std::string host = "127.0.0.1";
+    int port = 9090;
+    int failPct = 0;
+    int delayMs = 0;
+    std::map<std::string, std::string> pending;
+    
+    for (int i = 1; i + 1 < argc; i += 2) {
+        std::string arg = argv[i];
+        std::string val = argv[i + 1];
+        if (arg == "--listen") {
+            size_t colon = val.rfind(':');
+            host = val.substr(0, colon);
+            port = atoi(val.c_str() + colon + 1);
+        } else if (arg == "--fail-pct") {
+            failPct = atoi(val.c_str());
+        } else if (arg == "--delay-ms") {
+            delayMs = atoi(val.c_str());
+        } else if (arg == "--pending") {
+            size_t eq = val.find('=');
+            if (eq != std::string::npos) pending[val.substr(0, eq)] = val.substr(eq + 1);
+        }
+    }
+    
+    StubStats st;
+    std::mt19937 rng(1234);
+    
+    HttpServer server([&](const HttpRequest& req, HttpResponse& resp) {
+        if (req.method == "POST" && req.path == "/health/gateway/batch") {
+            if (failPct > 0 && (int)(rng() % 100) < failPct) {
+                st.injected++;
+                resp.status = 503;
+                resp.headers.emplace_back("Retry-After", "1");
+                resp.body = "{\"error\":\"injected\"}";
+                return;
+            }
+            if (delayMs > 0) std::this_thread::sleep_for(std::chrono::milliseconds(delayMs));
+            
+            std::string json;
+            const std::string* enc = req.header("content-encoding");
+            bool ok = (enc && *enc == "gzip") ? gzipDecompress(req.body, json, 64u << 20) : (json = req.body, true);
+            uint64_t first = 0, last = 0;
+            if (!ok || !isJsonObject(json) || !jsonFindUint(json, "first_index", first) ||
+                !jsonFindUint(json, "last_index", last) || last < first) {
+                st.rejected++;
+                resp.status = 400;
+                resp.body = "{\"error\":\"malformed batch\"}";
+                return;
+            }
+            
+            if (first <= st.lastIndex) st.replayed++;
+            else if (st.lastIndex && first > st.lastIndex + 1) st.gaps++;
+            if (last > st.lastIndex) st.lastIndex = last;
+            
+            st.batches++;
+            st.vitals += countOf(json, "{\"kind\":\"vitals\"");
+            st.history += countOf(json, "{\"kind\":\"history\"");
+            st.wireBytes += req.body.size();
+            st.rawBytes += json.size();
+            resp.body = "{\"accepted_through\":" + std::to_string(last) + "}";
+            return;
+        }
+        
+        if (req.method == "POST" && req.path == "/health/gateway/state/pending") {
+            std::vector<std::string> ids;
+            if (!isJsonObject(req.body) || !jsonFindStringArray(req.body, "device_ids", ids)) {
+                resp.status = 400;
+                resp.body = "{\"error\":\"malformed state query\"}";
+                return;
+            }
+            st.stateQueries++;
+            resp.body = "{";
+            for (const std::string& id : ids) {
+                auto it = pending.find(id);
+                if (it == pending.end()) continue;
+                if (resp.body.size() > 1) resp.body += ',';
+                resp.body += "\"" + id + "\":\"" + it->second + "\"";
+                pending.erase(it);
+            }
+            resp.body += "}";
+            return;
+        }
+        
+        resp.status = 404;
+        resp.body = "{\"error\":\"not found\"}";
+    });
+    
+    long long lastReport = monotonicMs();
+    server.setTick([&] {
+        if (monotonicMs() - lastReport < 5000) return;
+        lastReport = monotonicMs();
+        printf("batches=%llu vitals=%llu history=%llu last_index=%llu wire=%lluKB raw=%lluKB ratio=%.1fx "
+               "replayed=%llu gaps=%llu rejected=%llu injected=%llu state_queries=%llu\n",
+               (unsigned long long)st.batches, (unsigned long long)st.vitals, (unsigned long long)st.history,
+               (unsigned long long)st.lastIndex, (unsigned long long)st.wireBytes / 1024,
+               (unsigned long long)st.rawBytes / 1024, st.wireBytes ? (double)st.rawBytes / st.wireBytes : 0.0,
+               (unsigned long long)st.replayed, (unsigned long long)st.gaps, (unsigned long long)st.rejected,
+               (unsigned long long)st.injected, (unsigned long long)st.stateQueries);
+        fflush(stdout);
+    });
+    
+    if (!server.listen(host, port)) {
+        perror("listen");
+        return 1;
+    }
+    printf("upstream-stub listening on %s:%d\n", host.c_str(), server.boundPort());
+    fflush(stdout);
+    server.run();
+    return 0;
+}
@@ -0,0 +1,141 @@
+// Native vs. Dart history analytics benchmark.
+//
+// Build the library, then run from health_app/:
+//   cmake -S linux/analytics -B build/analytics -DCMAKE_BUILD_TYPE=Release
+//   cmake --build build/analytics
+//   HEALTH_ANALYTICS_LIB=build/analytics/libhealth_analytics.so \
+//     dart run benchmark/analytics_benchmark.dart [days]
+//
+// Synthesizes one reading per minute for [days] (default 90, a clinic
+// desktop's "months of history"), then times both engines on the same
+// columns and checks that they agree. Finally it appends the history to a
+// throwaway HistoryCache file and times opening a 30-day view from it.
+
+import 'dart:io';
+import 'dart:math' as math;
+
+import 'package:health_app/models/vitals_model.dart';
+import 'package:health_app/services/history_analytics.dart';
+import 'package:health_app/services/history_cache.dart';
+import 'package:health_app/services/native_analytics.dart';
+
+const _runs = 10;
+
+List<VitalSigns> _synthesize(int days) {
+  final rnd = math.Random(42);
+  final start = DateTime.utc(2025, 1, 1);
+  final n = days * 24 * 60;
+  return List.generate(n, (i) {
+    final circadian = math.sin(2 * math.pi * i / (24 * 60));
+    final dropout = rnd.nextInt(40) == 0; // finger off / no reading
+    return VitalSigns(
+      heartRate: dropout
+          ? 0
+          : (68 + 8 * circadian + rnd.nextInt(9) - 4).round(),
+      hrQuality: 40 + rnd.nextInt(60),
+      spo2: dropout ? 0 : 93 + rnd.nextInt(7),
+      spo2Quality: 40 + rnd.nextInt(60),
+      temperature: 36.4 + 0.4 * circadian + rnd.nextDouble() * 0.3,
+      tempEstimated: false,
+      tempSource: 'DS18B20',
+      timestamp: start.add(Duration(minutes: i)),
+      batteryPercent: 80,
+      batteryVoltage: 3.9,
+      wifiRssi: -60,
+    );
+  });
+}
+
+double _timeMs(void Function() body) {
+  body(); // warm-up (JIT, page faults)
+  final sw = Stopwatch()..start();
+  for (int r = 0; r < _runs; r++) {
+    body();
+  }
+  return sw.elapsedMicroseconds / 1000 / _runs;
+}
+
+double _maxDiff(List<double> a, List<double> b) {
+  double worst = 0;
+  for (int i = 0; i < a.length; i++) {
+    if (a[i].isNaN && b[i].isNaN) continue;
+    worst = math.max(worst, (a[i] - b[i]).abs());
+  }
+  return worst;
+}
+
+void main(List<String> args) {
+  final days = args.isNotEmpty ? int.parse(args.first) : 90;
+  final history = _synthesize(days);
+  const window = Duration(hours: 1);
+  print('${history.length} readings ($days days @ 1/min)');
+
+  final columnsMs = _timeMs(() => HistoryColumns.fromVitals(history));
+  final cols = HistoryColumns.fromVitals(history);
+  print('columns   ${columnsMs.toStringAsFixed(2)} ms (shared by both)');
+
+  late HistoryAnalytics viaDart;
+  final dartMs = _timeMs(() {
+    viaDart = HistoryAnalytics.analyzeColumnsDart(cols, window, null);
+  });
+  print('dart      ${dartMs.toStringAsFixed(2)} ms');
+
+  final native = NativeAnalytics.instance;
+  if (native == null) {
+    print('native    unavailable (set HEALTH_ANALYTICS_LIB)');
+    return;
+  }
+  late HistoryAnalytics nat;
+  final nativeMs = _timeMs(() {
+    nat = HistoryAnalytics.analyzeColumnsNative(native, cols, window, null);
+  });
+  print(
+    'native    ${nativeMs.toStringAsFixed(2)} ms '
+    '(${(dartMs / nativeMs).toStringAsFixed(1)}x)',
+  );
+
+  print(
+    'agreement scores ${_maxDiff(viaDart.healthScores, nat.healthScores)}, '
+    'trend ${_maxDiff(viaDart.heartRateTrend.mean, nat.heartRateTrend.mean)}, '
+    'rmssd ${(viaDart.hrv.rmssdMs - nat.hrv.rmssdMs).abs()}, '
+    'sdnn ${(viaDart.hrv.sdnnMs - nat.hrv.sdnnMs).abs()}',
+  );
+
+  _benchmarkCache(cols, window);
+}
+
+void _benchmarkCache(HistoryColumns cols, Duration window) {
+  final dir = Directory.systemTemp.createTempSync('hcol_bench');
+  try {
+    final path = '${dir.path}/bench.hcol';
+    final writer = HistoryCache.open(path)!;
+    final sw = Stopwatch()..start();
+    final added = writer.append(cols);
+    writer.flush();
+    print(
+      'cache     append $added rows in ${sw.elapsedMilliseconds} ms, '
+      '${File(path).lengthSync() ~/ 1024} KiB',
+    );
+
+    final end = cols.timestampAt(cols.length - 1);
+    final start = end.subtract(const Duration(days: 30));
+    HistoryCache? reader;
+    late HistoryColumns view;
+    final openMs = _timeMs(() {
+      reader?.close();
+      reader = HistoryCache.open(path)!;
+      view = reader!.view(start: start, end: end);
+    });
+    final analyzeMs = _timeMs(() {
+      HistoryAnalytics.analyze(view, trendWindow: window);
+    });
+    print(
+      'cache     open 30-day view (${view.length} rows) '
+      '${openMs.toStringAsFixed(3)} ms, analyze ${analyzeMs.toStringAsFixed(2)} ms',
+    );
+    reader?.close();
+    writer.close();
+  } finally {
+    dir.deleteSync(recursive: true);
+  }
+}
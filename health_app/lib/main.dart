@@ -1,6 +1,9 @@
 import 'package:flutter/material.dart';
 
 import 'screens/home_screen.dart';
+import 'screens/ward_screen.dart';
+import 'services/live_stream_stub.dart'
+    if (dart.library.ffi) 'services/live_stream.dart';
 
 void main() {
   runApp(const MyApp());
@@ -119,6 +122,25 @@ class _DeviceSetupScreenState extends State<DeviceSetupScreen> {
                     ),
                   ),
                 ),
+                if (LiveStream.isSupported) ...[
+                  const SizedBox(height: 12),
+                  SizedBox(
+                    width: double.infinity,
+                    child: OutlinedButton.icon(
+                      onPressed: () => Navigator.of(context).push(
+                        MaterialPageRoute(builder: (_) => const WardScreen()),
+                      ),
+                      icon: const Icon(Icons.grid_view),
+                      label: const Text('Ward View (LAN)'),
+                      style: OutlinedButton.styleFrom(
+                        padding: const EdgeInsets.all(16),
+                        shape: RoundedRectangleBorder(
+                          borderRadius: BorderRadius.circular(12),
+                        ),
+                      ),
+                    ),
+                  ),
+                ],
                 const SizedBox(height: 24),
                 Container(
                   padding: const EdgeInsets.all(16),
@@ -0,0 +1,69 @@
+/// Live LAN stream models (Linux desktop ward view)
+
+import 'dart:typed_data';
+
+/// Latest live state of one bed
+class LiveBed {
+  /// Rate the device's sensor FIFO delivers IR samples at (wave_rate)
+  static const int waveformRate = 25;
+
+  /// Waveform samples kept for display (4 s)
+  static const int waveformCapacity = 4 * waveformRate;
+
+  final String deviceId;
+  int heartRate = 0;
+  int hrQuality = 0;
+  int spo2 = 0;
+  int spo2Quality = 0;
+  double temperature = 0;
+  int batteryPercent = 0;
+  int wifiRssi = 0;
+  String monitoringState = 'idle';
+  bool hasAlert = false;
+  bool isCritical = false;
+  DateTime lastUpdate = DateTime.fromMillisecondsSinceEpoch(0);
+
+  /// Ring of raw IR samples; [waveformHead] is the next write position.
+  /// NaN marks samples lost on the device.
+  final Float64List waveform = Float64List(waveformCapacity);
+  int waveformHead = 0;
+  int waveformLength = 0;
+
+  LiveBed(this.deviceId);
+
+  void addSample(double ir) {
+    waveform[waveformHead] = ir;
+    waveformHead = (waveformHead + 1) % waveformCapacity;
+    if (waveformLength < waveformCapacity) waveformLength++;
+  }
+
+  /// Waveform samples oldest-first
+  Iterable<double> get samples sync* {
+    final start =
+        (waveformHead - waveformLength + waveformCapacity) % waveformCapacity;
+    for (int i = 0; i < waveformLength; i++) {
+      yield waveform[(start + i) % waveformCapacity];
+    }
+  }
+
+  Duration get age => DateTime.now().difference(lastUpdate);
+}
+
+/// Receiver counters from ls_stats()
+class LiveStreamStats {
+  final int datagrams;
+  final int frames;
+  final int malformed;
+  final int dropped;
+  final int seqGaps;
+  final int devices;
+
+  const LiveStreamStats({
+    required this.datagrams,
+    required this.frames,
+    required this.malformed,
+    required this.dropped,
+    required this.seqGaps,
+    required this.devices,
+  });
+}
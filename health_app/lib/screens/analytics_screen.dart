@@ -1,10 +1,13 @@
 import 'dart:math' as math;
 
 import 'package:fl_chart/fl_chart.dart';
+import 'package:flutter/foundation.dart' show compute;
 import 'package:flutter/material.dart';
 
-import '../models/vitals_model.dart';
 import '../services/health_api_service.dart';
+import '../services/health_calculator.dart';
+import '../services/history_analytics.dart';
+import '../services/history_store.dart';
 
 class AnalyticsScreen extends StatefulWidget {
   final String deviceId;
@@ -16,10 +19,15 @@ class AnalyticsScreen extends StatefulWidget {
 }
 
 class _AnalyticsScreenState extends State<AnalyticsScreen> {
+  // Charts are thinned to this many points; metrics use every reading
+  static const int _maxChartPoints = 500;
+
   final HealthApiService _apiService = HealthApiService();
-  List<VitalSigns> _history = [];
+  late final HistoryStore _historyStore = HistoryStore(_apiService);
+  HistoryColumns _history = HistoryColumns.fromVitals(const []);
   Map<String, dynamic>? _summaryStats;
   Map<String, dynamic>? _correlationData;
+  HistoryAnalytics? _metrics;
   bool _isLoading = true;
   String _selectedPeriod = '24h';
 
@@ -39,10 +47,10 @@ class _AnalyticsScreenState extends State<AnalyticsScreen> {
         ? endDate.subtract(const Duration(days: 7))
         : endDate.subtract(const Duration(days: 30));
 
-    final history = await _apiService.getVitalsHistory(
+    final history = await _historyStore.load(
       widget.deviceId,
-      startDate: startDate,
-      endDate: endDate,
+      start: startDate,
+      end: endDate,
       limit: _selectedPeriod == '24h' ? 288 : 1000, // 5min intervals for 24h
     );
 
@@ -62,9 +70,16 @@ class _AnalyticsScreenState extends State<AnalyticsScreen> {
           : (_selectedPeriod == '7d' ? 168 : 720),
     );
 
+    // Native library on the Linux desktop build; elsewhere the Dart path runs
+    // off the UI isolate so long histories don't freeze the tab
+    final metrics = HistoryAnalytics.nativeAvailable
+        ? HistoryAnalytics.analyze(history, trendWindow: _trendWindow)
+        : await compute(HistoryAnalytics.analyzeDart, history);
+
     if (mounted) {
       setState(() {
         _history = history;
+        _metrics = metrics;
         _summaryStats = stats;
         _correlationData = correlation;
         _isLoading = false;
@@ -72,6 +87,12 @@ class _AnalyticsScreenState extends State<AnalyticsScreen> {
     }
   }
 
+  Duration get _trendWindow => _selectedPeriod == '24h'
+      ? const Duration(minutes: 30)
+      : _selectedPeriod == '7d'
+      ? const Duration(hours: 6)
+      : const Duration(hours: 24);
+
   @override
   Widget build(BuildContext context) {
     return Scaffold(
@@ -105,19 +126,19 @@ class _AnalyticsScreenState extends State<AnalyticsScreen> {
                     const SizedBox(height: 24),
                   ],
 
+                  // Derived metrics over the loaded history
+                  if (_metrics != null && _metrics!.records > 0) ...[
+                    _buildHistoryMetricsSection(),
+                    const SizedBox(height: 24),
+                  ],
+
                   // Heart Rate Chart
                   _buildChartCard(
                     title: 'Heart Rate Trend',
                     unit: 'BPM',
                     color: Colors.red,
-                    data: _history
-                        .map(
-                          (v) => FlSpot(
-                            v.timestamp.millisecondsSinceEpoch.toDouble(),
-                            v.heartRate.toDouble(),
-                          ),
-                        )
-                        .toList(),
+                    data: _chartSpots(_history.heartRate),
+                    trend: _heartRateTrendSpots(),
                   ),
                   const SizedBox(height: 16),
 
@@ -126,15 +147,7 @@ class _AnalyticsScreenState extends State<AnalyticsScreen> {
                     title: 'Blood Oxygen (SpO2)',
                     unit: '%',
                     color: Colors.blue,
-                    data: _history
-                        .where((v) => v.spo2 > 0)
-                        .map(
-                          (v) => FlSpot(
-                            v.timestamp.millisecondsSinceEpoch.toDouble(),
-                            v.spo2.toDouble(),
-                          ),
-                        )
-                        .toList(),
+                    data: _chartSpots(_history.spo2, skipZero: true),
                     minY: 85,
                     maxY: 100,
                   ),
@@ -145,14 +158,7 @@ class _AnalyticsScreenState extends State<AnalyticsScreen> {
                     title: 'Body Temperature',
                     unit: '°C',
                     color: Colors.orange,
-                    data: _history
-                        .map(
-                          (v) => FlSpot(
-                            v.timestamp.millisecondsSinceEpoch.toDouble(),
-                            v.temperature,
-                          ),
-                        )
-                        .toList(),
+                    data: _chartSpots(_history.temperature),
                     minY: 35,
                     maxY: 40,
                   ),
@@ -241,6 +247,105 @@ class _AnalyticsScreenState extends State<AnalyticsScreen> {
     );
   }
 
+  Widget _buildHistoryMetricsSection() {
+    final m = _metrics!;
+    String fmt(double v, int digits) =>
+        v.isFinite ? v.toStringAsFixed(digits) : '-';
+
+    return Card(
+      child: Padding(
+        padding: const EdgeInsets.all(16),
+        child: Column(
+          crossAxisAlignment: CrossAxisAlignment.start,
+          children: [
+            Text(
+              'History Metrics',
+              style: Theme.of(
+                context,
+              ).textTheme.titleLarge?.copyWith(fontWeight: FontWeight.bold),
+            ),
+            const SizedBox(height: 16),
+            Row(
+              children: [
+                Expanded(
+                  child: _buildStatBox(
+                    'HRV (RMSSD)',
+                    fmt(m.hrv.rmssdMs, 0),
+                    'ms, SDNN ${fmt(m.hrv.sdnnMs, 0)} ms',
+                    Colors.purple,
+                  ),
+                ),
+                const SizedBox(width: 12),
+                Expanded(
+                  child: _buildStatBox(
+                    'Health Score',
+                    fmt(m.healthScore.mean, 0),
+                    m.healthScore.mean.isFinite
+                        ? 'avg, ${HealthCalculator.getHealthStatus(m.healthScore.mean)}'
+                        : 'avg',
+                    Colors.green,
+                    min: fmt(m.healthScore.min, 0),
+                    max: fmt(m.healthScore.max, 0),
+                  ),
+                ),
+              ],
+            ),
+            const SizedBox(height: 12),
+            Row(
+              children: [
+                Expanded(
+                  child: _buildStatBox(
+                    'Heart Rate',
+                    fmt(m.heartRate.mean, 0),
+                    'BPM ± ${fmt(m.heartRate.sd, 1)}',
+                    Colors.red,
+                  ),
+                ),
+                const SizedBox(width: 12),
+                Expanded(
+                  child: _buildStatBox(
+                    'SpO2',
+                    fmt(m.spo2.mean, 1),
+                    '% ± ${fmt(m.spo2.sd, 1)}',
+                    Colors.blue,
+                  ),
+                ),
+              ],
+            ),
+            const SizedBox(height: 8),
+            Text(
+              '${m.records} readings, computed ${m.engine == 'native' ? 'natively' : 'in Dart'}',
+              style: TextStyle(fontSize: 10, color: Colors.grey.shade600),
+            ),
+          ],
+        ),
+      ),
+    );
+  }
+
+  List<FlSpot> _chartSpots(List<num> values, {bool skipZero = false}) {
+    final stride = (values.length / _maxChartPoints).ceil().clamp(1, 1 << 30);
+    final spots = <FlSpot>[];
+    for (int i = 0; i < values.length; i += stride) {
+      final v = values[i].toDouble();
+      if (!v.isFinite || (skipZero && v <= 0)) continue;
+      spots.add(FlSpot(_history.timestampMs[i], v));
+    }
+    return spots;
+  }
+
+  List<FlSpot>? _heartRateTrendSpots() {
+    final m = _metrics;
+    if (m == null || m.records == 0) return null;
+    final stride = (m.records / _maxChartPoints).ceil().clamp(1, 1 << 30);
+    final spots = <FlSpot>[];
+    for (int i = 0; i < m.records; i += stride) {
+      final v = m.heartRateTrend.mean[i];
+      if (v.isFinite) spots.add(FlSpot(m.timestampMs[i], v));
+    }
+    return spots;
+  }
+
   Widget _buildStatBox(
     String title,
     String value,
@@ -292,6 +397,7 @@ class _AnalyticsScreenState extends State<AnalyticsScreen> {
     required List<FlSpot> data,
     double? minY,
     double? maxY,
+    List<FlSpot>? trend,
   }) {
     if (data.isEmpty) {
       return Card(
@@ -379,6 +485,13 @@ class _AnalyticsScreenState extends State<AnalyticsScreen> {
                         color: color.withOpacity(0.2),
                       ),
                     ),
+                    if (trend != null && trend.isNotEmpty)
+                      LineChartBarData(
+                        spots: trend,
+                        color: Colors.black54,
+                        barWidth: 2,
+                        dotData: const FlDotData(show: false),
+                      ),
                   ],
                 ),
               ),
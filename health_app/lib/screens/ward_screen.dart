@@ -0,0 +1,230 @@
+import 'dart:async';
+import 'dart:math' as math;
+
+import 'package:flutter/material.dart';
+
+import '../models/live_vitals_model.dart';
+import '../services/live_stream_stub.dart'
+    if (dart.library.ffi) '../services/live_stream.dart';
+
+/// Nurse-station view of every bed streaming on the LAN, updated straight
+/// from the devices (sub-second) instead of polling the cloud
+class WardScreen extends StatefulWidget {
+  const WardScreen({super.key});
+
+  @override
+  State<WardScreen> createState() => _WardScreenState();
+}
+
+class _WardScreenState extends State<WardScreen> {
+  // A bed that has been silent this long is shown as offline
+  static const Duration _staleAfter = Duration(seconds: 3);
+
+  LiveStream? _stream;
+  StreamSubscription<void>? _subscription;
+  Timer? _staleTimer;
+
+  @override
+  void initState() {
+    super.initState();
+    _stream = LiveStream.start();
+    _subscription = _stream?.updates.listen((_) {
+      if (mounted) setState(() {});
+    });
+    // Repaint occasionally even without traffic so silent beds go stale
+    _staleTimer = Timer.periodic(const Duration(seconds: 1), (_) {
+      if (mounted) setState(() {});
+    });
+  }
+
+  @override
+  void dispose() {
+    _staleTimer?.cancel();
+    _subscription?.cancel();
+    _stream?.stop();
+    super.dispose();
+  }
+
+  @override
+  Widget build(BuildContext context) {
+    final stream = _stream;
+    return Scaffold(
+      appBar: AppBar(
+        title: const Text('Ward View'),
+        actions: [
+          if (stream != null)
+            Padding(
+              padding: const EdgeInsets.symmetric(horizontal: 16),
+              child: Center(child: _buildStats(stream.stats)),
+            ),
+        ],
+      ),
+      body: stream == null
+          ? const Center(
+              child: Text(
+                'LAN live stream unavailable\n'
+                '(Linux desktop build, UDP port 47800)',
+                textAlign: TextAlign.center,
+              ),
+            )
+          : stream.beds.isEmpty
+          ? const Center(child: Text('Waiting for devices on the LAN...'))
+          : _buildGrid(stream),
+    );
+  }
+
+  Widget _buildStats(LiveStreamStats s) {
+    return Text(
+      '${s.devices} beds · ${s.frames} frames · '
+      '${s.seqGaps} lost · ${s.dropped} dropped',
+      style: const TextStyle(fontSize: 12),
+    );
+  }
+
+  Widget _buildGrid(LiveStream stream) {
+    final beds = stream.beds.values.toList()
+      ..sort((a, b) => a.deviceId.compareTo(b.deviceId));
+    return GridView.builder(
+      padding: const EdgeInsets.all(12),
+      gridDelegate: const SliverGridDelegateWithMaxCrossAxisExtent(
+        maxCrossAxisExtent: 280,
+        mainAxisSpacing: 12,
+        crossAxisSpacing: 12,
+        childAspectRatio: 1.4,
+      ),
+      itemCount: beds.length,
+      itemBuilder: (context, i) => _buildBedCard(beds[i]),
+    );
+  }
+
+  Widget _buildBedCard(LiveBed bed) {
+    final stale = bed.age > _staleAfter;
+    final color = stale
+        ? Colors.grey
+        : bed.isCritical
+        ? Colors.red
+        : bed.hasAlert
+        ? Colors.orange
+        : Colors.green;
+
+    return Card(
+      shape: RoundedRectangleBorder(
+        borderRadius: BorderRadius.circular(12),
+        side: BorderSide(color: color, width: bed.isCritical ? 3 : 1),
+      ),
+      child: Padding(
+        padding: const EdgeInsets.all(12),
+        child: Column(
+          crossAxisAlignment: CrossAxisAlignment.start,
+          children: [
+            Row(
+              children: [
+                Icon(Icons.bed, size: 16, color: color),
+                const SizedBox(width: 6),
+                Expanded(
+                  child: Text(
+                    bed.deviceId,
+                    style: const TextStyle(fontWeight: FontWeight.bold),
+                    overflow: TextOverflow.ellipsis,
+                  ),
+                ),
+                Text(
+                  stale ? 'offline' : bed.monitoringState,
+                  style: TextStyle(fontSize: 11, color: color),
+                ),
+              ],
+            ),
+            const SizedBox(height: 8),
+            Row(
+              mainAxisAlignment: MainAxisAlignment.spaceBetween,
+              children: [
+                _buildValue('${bed.heartRate}', 'BPM', Colors.red),
+                _buildValue('${bed.spo2}', '%', Colors.blue),
+                _buildValue(
+                  bed.temperature.toStringAsFixed(1),
+                  '°C',
+                  Colors.orange,
+                ),
+              ],
+            ),
+            const SizedBox(height: 8),
+            Expanded(
+              child: CustomPaint(
+                size: Size.infinite,
+                painter: _WaveformPainter(
+                  bed.samples.toList(growable: false),
+                  stale ? Colors.grey : Colors.red.shade300,
+                ),
+              ),
+            ),
+          ],
+        ),
+      ),
+    );
+  }
+
+  Widget _buildValue(String value, String unit, Color color) {
+    return Column(
+      children: [
+        Text(
+          value,
+          style: TextStyle(
+            fontSize: 22,
+            fontWeight: FontWeight.bold,
+            color: color,
+          ),
+        ),
+        Text(unit, style: const TextStyle(fontSize: 10)),
+      ],
+    );
+  }
+}
+
+/// Autoscaled IR sparkline; NaN samples (device FIFO gaps) break the line
+class _WaveformPainter extends CustomPainter {
+  final List<double> samples;
+  final Color color;
+
+  _WaveformPainter(this.samples, this.color);
+
+  @override
+  void paint(Canvas canvas, Size size) {
+    if (samples.length < 2) return;
+    double lo = double.infinity, hi = double.negativeInfinity;
+    for (final v in samples) {
+      if (v.isNaN) continue;
+      lo = math.min(lo, v);
+      hi = math.max(hi, v);
+    }
+    if (lo > hi) return;
+    final span = hi > lo ? hi - lo : 1.0;
+    final dx = size.width / (samples.length - 1);
+
+    final path = Path();
+    bool penDown = false;
+    for (int i = 0; i < samples.length; i++) {
+      if (samples[i].isNaN) {
+        penDown = false;
+        continue;
+      }
+      final y = size.height * (1 - (samples[i] - lo) / span);
+      if (penDown) {
+        path.lineTo(i * dx, y);
+      } else {
+        path.moveTo(i * dx, y);
+        penDown = true;
+      }
+    }
+    canvas.drawPath(
+      path,
+      Paint()
+        ..color = color
+        ..style = PaintingStyle.stroke
+        ..strokeWidth = 1.5,
+    );
+  }
+
+  // Samples are a fresh list on every rebuild
+  @override
+  bool shouldRepaint(_WaveformPainter old) => true;
+}
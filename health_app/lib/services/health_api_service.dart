@@ -76,11 +76,13 @@ class HealthApiService {
     DateTime? startDate,
     DateTime? endDate,
     int limit = 100,
+    bool oldestFirst = false,
   }) async {
     final queryParams = {
       'limit': limit.toString(),
       if (startDate != null) 'start_date': startDate.toIso8601String(),
       if (endDate != null) 'end_date': endDate.toIso8601String(),
+      if (oldestFirst) 'order': 'asc',
     };
 
     final url = Uri.parse(
@@ -1,3 +1,24 @@
+import 'dart:math' as math;
+
+/// Time-domain HRV over normal-to-normal intervals (ms)
+class HrvMetrics {
+  final int beats;
+  final double meanNnMs;
+  final double sdnnMs;
+  final double rmssdMs;
+  final double pnn50;
+
+  const HrvMetrics({
+    required this.beats,
+    required this.meanNnMs,
+    required this.sdnnMs,
+    required this.rmssdMs,
+    required this.pnn50,
+  });
+
+  bool get isValid => beats >= 2 && rmssdMs.isFinite;
+}
+
 /// Health Calculator Service
 /// Calculates derived metrics from vital signs
 class HealthCalculator {
@@ -63,28 +84,62 @@ class HealthCalculator {
     return score.clamp(0, 100);
   }
 
-  /// Calculate Heart Rate Variability (simplified RMSSD)
+  /// Calculate Heart Rate Variability (RMSSD)
   /// Returns HRV in ms (higher is better)
-  /// Note: Requires beat-to-beat intervals, simplified here
+  /// Note: readings carry rates, not beat-to-beat intervals, so intervals
+  /// are derived as 60000 / BPM per reading
   static double? calculateHRV(List<int> recentHeartRates) {
     if (recentHeartRates.length < 3) return null;
+    final hrv = calculateHrvMetrics(recentHeartRates);
+    return hrv.isValid ? hrv.rmssdMs : null;
+  }
 
-    // Simplified HRV: variability in HR over recent readings
-    final diffs = <double>[];
-    for (int i = 1; i < recentHeartRates.length; i++) {
-      diffs.add((recentHeartRates[i] - recentHeartRates[i - 1]).toDouble());
+  /// Time-domain HRV (mean NN, SDNN, RMSSD, pNN50) from heart rates.
+  /// Zero readings and intervals outside 300-2000 ms are skipped and break
+  /// the successive-difference chain.
+  static HrvMetrics calculateHrvMetrics(List<int> heartRates) {
+    double sum = 0, sumSq = 0;
+    int beats = 0, pairs = 0, over50 = 0;
+    double? prev;
+    for (final bpm in heartRates) {
+      final nn = bpm > 0 ? 60000.0 / bpm : 0.0;
+      if (nn < 300 || nn > 2000) {
+        prev = null;
+        continue;
+      }
+      sum += nn;
+      beats++;
+      if (prev != null) {
+        final d = nn - prev;
+        sumSq += d * d;
+        pairs++;
+        if (d.abs() > 50) over50++;
+      }
+      prev = nn;
+    }
+    if (beats < 2) {
+      return HrvMetrics(
+        beats: beats,
+        meanNnMs: beats > 0 ? sum : double.nan,
+        sdnnMs: double.nan,
+        rmssdMs: double.nan,
+        pnn50: double.nan,
+      );
     }
 
-    // Calculate RMSSD (root mean square of successive differences)
-    final squaredDiffs = diffs.map((d) => d * d).toList();
-    final meanSquared =
-        squaredDiffs.reduce((a, b) => a + b) / squaredDiffs.length;
-    final rmssd = meanSquared.isFinite
-        ? squaredDiffs.reduce((a, b) => a + b) / squaredDiffs.length
-        : 0.0;
-
-    // Convert to pseudo-ms (scale for display)
-    return rmssd * 10; // Scaled for visibility
+    final mean = sum / beats;
+    double dev = 0;
+    for (final bpm in heartRates) {
+      final nn = bpm > 0 ? 60000.0 / bpm : 0.0;
+      if (nn >= 300 && nn <= 2000) dev += (nn - mean) * (nn - mean);
+    }
+    return HrvMetrics(
+      beats: beats,
+      meanNnMs: mean,
+      sdnnMs: math.sqrt(dev / (beats - 1)),
+      rmssdMs: pairs > 0 ? math.sqrt(sumSq / pairs) : double.nan,
+      pnn50: pairs > 0 ? over50 / pairs : double.nan,
+    );
   }
 
   /// Calculate Oxygen Delivery Index
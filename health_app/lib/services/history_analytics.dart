@@ -0,0 +1,313 @@
+import 'dart:math' as math;
+import 'dart:typed_data';
+
+import '../models/vitals_model.dart';
+import 'health_calculator.dart';
+import 'native_analytics_stub.dart'
+    if (dart.library.ffi) 'native_analytics.dart';
+
+/// Mean / standard deviation / range of one vital over a history.
+/// Zero readings ("no reading" in the device payload) are skipped.
+class SeriesSummary {
+  final int count;
+  final double mean;
+  final double sd;
+  final double min;
+  final double max;
+
+  const SeriesSummary({
+    required this.count,
+    required this.mean,
+    required this.sd,
+    required this.min,
+    required this.max,
+  });
+
+  static const empty = SeriesSummary(
+    count: 0,
+    mean: double.nan,
+    sd: double.nan,
+    min: double.nan,
+    max: double.nan,
+  );
+}
+
+/// Trailing time-window statistics, one slot per record (NaN = empty window)
+class RollingStats {
+  final Float64List mean;
+  final Float64List sd;
+  final Float64List min;
+  final Float64List max;
+
+  const RollingStats({
+    required this.mean,
+    required this.sd,
+    required this.min,
+    required this.max,
+  });
+}
+
+/// A history split into typed columns, sorted by timestamp.
+/// Both engines work on these so neither pays for the object graph.
+class HistoryColumns {
+  final Float64List timestampMs;
+  final Int32List heartRate;
+  final Int32List hrQuality;
+  final Int32List spo2;
+  final Int32List spo2Quality;
+  final Float64List temperature;
+
+  /// Wraps existing columns (e.g. views over the on-disk cache) without
+  /// copying; all lists must have the same length
+  HistoryColumns.views({
+    required this.timestampMs,
+    required this.heartRate,
+    required this.hrQuality,
+    required this.spo2,
+    required this.spo2Quality,
+    required this.temperature,
+  });
+
+  HistoryColumns._(int n)
+    : timestampMs = Float64List(n),
+      heartRate = Int32List(n),
+      hrQuality = Int32List(n),
+      spo2 = Int32List(n),
+      spo2Quality = Int32List(n),
+      temperature = Float64List(n);
+
+  factory HistoryColumns.fromVitals(List<VitalSigns> history) {
+    final sorted = List<VitalSigns>.of(history)
+      ..sort((a, b) => a.timestamp.compareTo(b.timestamp));
+    final cols = HistoryColumns._(sorted.length);
+    for (int i = 0; i < sorted.length; i++) {
+      final v = sorted[i];
+      cols.timestampMs[i] = v.timestamp.millisecondsSinceEpoch.toDouble();
+      cols.heartRate[i] = v.heartRate;
+      cols.hrQuality[i] = v.hrQuality;
+      cols.spo2[i] = v.spo2;
+      cols.spo2Quality[i] = v.spo2Quality;
+      cols.temperature[i] = v.temperature;
+    }
+    return cols;
+  }
+
+  int get length => timestampMs.length;
+
+  bool get isEmpty => timestampMs.isEmpty;
+
+  DateTime timestampAt(int i) =>
+      DateTime.fromMillisecondsSinceEpoch(timestampMs[i].toInt());
+
+  Float64List toDoubles(Int32List column) {
+    final out = Float64List(column.length);
+    for (int i = 0; i < column.length; i++) {
+      out[i] = column[i].toDouble();
+    }
+    return out;
+  }
+}
+
+/// Analytics over a whole vitals history
+class HistoryAnalytics {
+  final String engine; // 'native' or 'dart'
+  final int records;
+  final SeriesSummary heartRate;
+  final SeriesSummary spo2;
+  final SeriesSummary temperature;
+  final HrvMetrics hrv;
+  final SeriesSummary healthScore;
+  final Float64List healthScores;
+  final RollingStats heartRateTrend;
+  final Float64List timestampMs;
+
+  const HistoryAnalytics({
+    required this.engine,
+    required this.records,
+    required this.heartRate,
+    required this.spo2,
+    required this.temperature,
+    required this.hrv,
+    required this.healthScore,
+    required this.healthScores,
+    required this.heartRateTrend,
+    required this.timestampMs,
+  });
+
+  /// Whether the native library is loaded (Linux desktop build only)
+  static bool get nativeAvailable => NativeAnalytics.instance != null;
+
+  /// Analyze with the native library when present, Dart otherwise
+  static HistoryAnalytics analyze(
+    HistoryColumns cols, {
+    Duration trendWindow = const Duration(hours: 1),
+    int? restingHR,
+  }) {
+    final native = NativeAnalytics.instance;
+    return native != null
+        ? analyzeColumnsNative(native, cols, trendWindow, restingHR)
+        : analyzeColumnsDart(cols, trendWindow, restingHR);
+  }
+
+  /// Pure-Dart path with default options, shaped for `compute()`
+  static HistoryAnalytics analyzeDart(HistoryColumns cols) {
+    return analyzeColumnsDart(cols, const Duration(hours: 1), null);
+  }
+
+  static HistoryAnalytics analyzeColumnsNative(
+    NativeAnalytics native,
+    HistoryColumns cols,
+    Duration trendWindow,
+    int? restingHR,
+  ) {
+    final scores = native.healthScores(cols, restingHR: restingHR);
+    return HistoryAnalytics(
+      engine: 'native',
+      records: cols.length,
+      heartRate: native.summary(cols.toDoubles(cols.heartRate)),
+      spo2: native.summary(cols.toDoubles(cols.spo2)),
+      temperature: native.summary(cols.temperature),
+      hrv: native.hrvFromBpm(cols.heartRate),
+      healthScore: native.summary(scores),
+      healthScores: scores,
+      heartRateTrend: native.rolling(
+        cols.timestampMs,
+        cols.toDoubles(cols.heartRate),
+        trendWindow.inMilliseconds.toDouble(),
+      ),
+      timestampMs: cols.timestampMs,
+    );
+  }
+
+  static HistoryAnalytics analyzeColumnsDart(
+    HistoryColumns cols,
+    Duration trendWindow,
+    int? restingHR,
+  ) {
+    final scores = Float64List(cols.length);
+    for (int i = 0; i < cols.length; i++) {
+      scores[i] = HealthCalculator.calculateHealthScore(
+        heartRate: cols.heartRate[i],
+        spo2: cols.spo2[i],
+        temperature: cols.temperature[i],
+        hrQuality: cols.hrQuality[i],
+        spo2Quality: cols.spo2Quality[i],
+        restingHR: restingHR,
+      );
+    }
+    return HistoryAnalytics(
+      engine: 'dart',
+      records: cols.length,
+      heartRate: summarize(cols.toDoubles(cols.heartRate)),
+      spo2: summarize(cols.toDoubles(cols.spo2)),
+      temperature: summarize(cols.temperature),
+      hrv: HealthCalculator.calculateHrvMetrics(cols.heartRate),
+      healthScore: summarize(scores),
+      healthScores: scores,
+      heartRateTrend: rolling(
+        cols.timestampMs,
+        cols.toDoubles(cols.heartRate),
+        trendWindow.inMilliseconds.toDouble(),
+      ),
+      timestampMs: cols.timestampMs,
+    );
+  }
+
+  /// Dart reference for ha_summary()
+  static SeriesSummary summarize(Float64List x) {
+    double sum = 0, lo = double.infinity, hi = double.negativeInfinity;
+    int count = 0;
+    for (final v in x) {
+      if (v <= 0) continue;
+      sum += v;
+      count++;
+      if (v < lo) lo = v;
+      if (v > hi) hi = v;
+    }
+    if (count == 0) return SeriesSummary.empty;
+    final mean = sum / count;
+    double dev = 0;
+    for (final v in x) {
+      if (v > 0) dev += (v - mean) * (v - mean);
+    }
+    return SeriesSummary(
+      count: count,
+      mean: mean,
+      sd: math.sqrt(dev / count),
+      min: lo,
+      max: hi,
+    );
+  }
+
+  /// Dart reference for ha_rolling_stats(): same O(n) two-pointer window
+  /// with monotonic min/max queues
+  static RollingStats rolling(Float64List t, Float64List x, double windowMs) {
+    final n = x.length;
+    final mean = Float64List(n), sd = Float64List(n);
+    final mins = Float64List(n), maxs = Float64List(n);
+    final lo = Int32List(n), hi = Int32List(n);
+    int loHead = 0, loTail = 0, hiHead = 0, hiTail = 0;
+
+    double shift = 0;
+    for (final v in x) {
+      if (v > 0) {
+        shift = v;
+        break;
+      }
+    }
+
+    double s = 0, ss = 0;
+    int count = 0, first = 0;
+    for (int i = 0; i < n; i++) {
+      final v = x[i];
+      if (v > 0) {
+        final d = v - shift;
+        s += d;
+        ss += d * d;
+        count++;
+        while (loTail > loHead && x[lo[loTail - 1]] >= v) {
+          loTail--;
+        }
+        lo[loTail++] = i;
+        while (hiTail > hiHead && x[hi[hiTail - 1]] <= v) {
+          hiTail--;
+        }
+        hi[hiTail++] = i;
+      }
+
+      final start = t[i] - windowMs;
+      for (; first < i && t[first] <= start; first++) {
+        final u = x[first];
+        if (u > 0) {
+          final d = u - shift;
+          s -= d;
+          ss -= d * d;
+          count--;
+        }
+      }
+      while (loTail > loHead && lo[loHead] < first) {
+        loHead++;
+      }
+      while (hiTail > hiHead && hi[hiHead] < first) {
+        hiHead++;
+      }
+
+      if (count == 0) {
+        s = 0;
+        ss = 0;
+        mean[i] = double.nan;
+        sd[i] = double.nan;
+        mins[i] = double.nan;
+        maxs[i] = double.nan;
+        continue;
+      }
+      final m = s / count;
+      final variance = ss / count - m * m;
+      mean[i] = shift + m;
+      sd[i] = variance > 0 ? math.sqrt(variance) : 0.0;
+      mins[i] = x[lo[loHead]];
+      maxs[i] = x[hi[hiHead]];
+    }
+    return RollingStats(mean: mean, sd: sd, min: mins, max: maxs);
+  }
+}
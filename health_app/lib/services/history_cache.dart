@@ -0,0 +1,183 @@
+import 'dart:convert';
+import 'dart:ffi';
+import 'dart:typed_data';
+
+import 'history_analytics.dart';
+import 'native_analytics.dart';
+
+final class _HcCache extends Opaque {}
+
+typedef _OpenNative = Pointer<_HcCache> Function(Pointer<Uint8>);
+typedef _OpenDart = Pointer<_HcCache> Function(Pointer<Uint8>);
+typedef _CountNative = Int32 Function(Pointer<_HcCache>);
+typedef _CountDart = int Function(Pointer<_HcCache>);
+typedef _LastNative = Double Function(Pointer<_HcCache>);
+typedef _LastDart = double Function(Pointer<_HcCache>);
+typedef _ColumnNative = Pointer<Void> Function(Pointer<_HcCache>, Int32);
+typedef _ColumnDart = Pointer<Void> Function(Pointer<_HcCache>, int);
+typedef _AppendNative =
+    Int32 Function(
+      Pointer<_HcCache>,
+      Pointer<Double>,
+      Pointer<Int32>,
+      Pointer<Int32>,
+      Pointer<Int32>,
+      Pointer<Int32>,
+      Pointer<Double>,
+      Int32,
+    );
+typedef _AppendDart =
+    int Function(
+      Pointer<_HcCache>,
+      Pointer<Double>,
+      Pointer<Int32>,
+      Pointer<Int32>,
+      Pointer<Int32>,
+      Pointer<Int32>,
+      Pointer<Double>,
+      int,
+    );
+typedef _LowerBoundNative = Int32 Function(Pointer<_HcCache>, Double);
+typedef _LowerBoundDart = int Function(Pointer<_HcCache>, double);
+
+// Column ids from linux/analytics/history_cache.h
+const _colTimestamp = 0;
+const _colHeartRate = 1;
+const _colHrQuality = 2;
+const _colSpo2 = 3;
+const _colSpo2Quality = 4;
+const _colTemperature = 5;
+
+/// Memory-mapped columnar vitals cache for one device
+/// (linux/analytics/history_cache.h). [view] returns typed lists that point
+/// straight into the mapping, so opening a long range costs a binary search
+/// rather than a fetch and a JSON parse.
+///
+/// Caches are meant to stay open for the life of the app: views taken
+/// before an [append] remain valid (they just don't grow), but not after
+/// [close].
+class HistoryCache {
+  final Pointer<_HcCache> _handle;
+  final _Api _api;
+
+  HistoryCache._(this._handle, this._api);
+
+  /// Opens or creates the cache file; null without the native library
+  static HistoryCache? open(String path) {
+    final native = NativeAnalytics.instance;
+    if (native == null) return null;
+    final api = _Api.of(native.library);
+
+    final utf8Path = Uint8List.fromList([...utf8.encode(path), 0]);
+    final p = native.stageBytes(utf8Path);
+    try {
+      final handle = api.open(p);
+      return handle == nullptr ? null : HistoryCache._(handle, api);
+    } finally {
+      native.release(p);
+    }
+  }
+
+  int get length => _api.count(_handle);
+
+  /// Newest cached reading, or null when empty
+  DateTime? get lastTimestamp {
+    if (length == 0) return null;
+    return DateTime.fromMillisecondsSinceEpoch(
+      _api.lastTimestamp(_handle).toInt(),
+    );
+  }
+
+  /// Appends readings newer than [lastTimestamp]; returns how many were new
+  int append(HistoryColumns cols) {
+    final native = NativeAnalytics.instance!;
+    final n = cols.length;
+    if (n == 0) return 0;
+    final ts = native.stageDoubles(cols.timestampMs);
+    final hr = native.stageInts(cols.heartRate);
+    final hrq = native.stageInts(cols.hrQuality);
+    final spo2 = native.stageInts(cols.spo2);
+    final spo2q = native.stageInts(cols.spo2Quality);
+    final temp = native.stageDoubles(cols.temperature);
+    try {
+      final added = _api.append(_handle, ts, hr, hrq, spo2, spo2q, temp, n);
+      if (added < 0) throw StateError('hc_append failed');
+      return added;
+    } finally {
+      for (final p in <Pointer>[ts, hr, hrq, spo2, spo2q, temp]) {
+        native.release(p);
+      }
+    }
+  }
+
+  /// Zero-copy views over readings in [start, end)
+  HistoryColumns view({DateTime? start, DateTime? end}) {
+    final lo = start == null
+        ? 0
+        : _api.lowerBound(_handle, start.millisecondsSinceEpoch.toDouble());
+    final hi = end == null
+        ? length
+        : _api.lowerBound(_handle, end.millisecondsSinceEpoch.toDouble());
+    final n = hi > lo ? hi - lo : 0;
+
+    Pointer<Double> doubles(int column) =>
+        _api.column(_handle, column).cast<Double>() + lo;
+    Pointer<Int32> ints(int column) =>
+        _api.column(_handle, column).cast<Int32>() + lo;
+
+    return HistoryColumns.views(
+      timestampMs: doubles(_colTimestamp).asTypedList(n),
+      heartRate: ints(_colHeartRate).asTypedList(n),
+      hrQuality: ints(_colHrQuality).asTypedList(n),
+      spo2: ints(_colSpo2).asTypedList(n),
+      spo2Quality: ints(_colSpo2Quality).asTypedList(n),
+      temperature: doubles(_colTemperature).asTypedList(n),
+    );
+  }
+
+  /// Writes dirty pages back to disk
+  void flush() => _api.flush(_handle);
+
+  void close() => _api.close(_handle);
+}
+
+class _Api {
+  final _OpenDart open;
+  final void Function(Pointer<_HcCache>) close;
+  final _CountDart count;
+  final _LastDart lastTimestamp;
+  final _ColumnDart column;
+  final _AppendDart append;
+  final _LowerBoundDart lowerBound;
+  final _CountDart flush;
+
+  static _Api? _cached;
+
+  _Api._(DynamicLibrary lib)
+    : open = lib.lookupFunction<_OpenNative, _OpenDart>('hc_open'),
+      close = lib
+          .lookupFunction<
+            Void Function(Pointer<_HcCache>),
+            void Function(Pointer<_HcCache>)
+          >('hc_close'),
+      count = lib.lookupFunction<_CountNative, _CountDart>(
+        'hc_count',
+        isLeaf: true,
+      ),
+      lastTimestamp = lib.lookupFunction<_LastNative, _LastDart>(
+        'hc_last_timestamp',
+        isLeaf: true,
+      ),
+      column = lib.lookupFunction<_ColumnNative, _ColumnDart>(
+        'hc_column',
+        isLeaf: true,
+      ),
+      append = lib.lookupFunction<_AppendNative, _AppendDart>('hc_append'),
+      lowerBound = lib.lookupFunction<_LowerBoundNative, _LowerBoundDart>(
+        'hc_lower_bound',
+        isLeaf: true,
+      ),
+      flush = lib.lookupFunction<_CountNative, _CountDart>('hc_flush');
+
+  static _Api of(DynamicLibrary lib) => _cached ??= _Api._(lib);
+}
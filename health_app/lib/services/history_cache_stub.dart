@@ -0,0 +1,20 @@
+import 'history_analytics.dart';
+
+/// Stand-in for platforms without dart:ffi (web); there is no on-disk cache
+/// and HistoryStore always fetches from the backend.
+class HistoryCache {
+  static HistoryCache? open(String path) => null;
+
+  int get length => 0;
+
+  DateTime? get lastTimestamp => null;
+
+  int append(HistoryColumns cols) => throw UnsupportedError('ffi');
+
+  HistoryColumns view({DateTime? start, DateTime? end}) =>
+      throw UnsupportedError('ffi');
+
+  void flush() {}
+
+  void close() {}
+}
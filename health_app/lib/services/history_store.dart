@@ -0,0 +1,125 @@
+import 'package:path_provider/path_provider.dart';
+
+import '../models/vitals_model.dart';
+import 'health_api_service.dart';
+import 'history_analytics.dart';
+import 'history_cache_stub.dart' if (dart.library.ffi) 'history_cache.dart';
+
+/// Vitals history as typed columns, served from the on-disk cache when the
+/// native library is available (Linux desktop) and from the backend
+/// otherwise.
+///
+/// With the cache, each load first pulls only readings newer than the last
+/// cached one (paging forward from it, oldest first; backwards if the
+/// backend answers newest first), then answers from the mapped file.
+/// If the backend is unreachable the cached range is still returned, so the
+/// history views work offline.
+class HistoryStore {
+  /// How far back the first sync for a device reaches
+  static const Duration retention = Duration(days: 30);
+
+  /// Page size for incremental sync requests
+  static const int syncPageSize = 1000;
+
+  static final Map<String, Future<HistoryCache?>> _caches = {};
+
+  final HealthApiService _apiService;
+
+  HistoryStore([HealthApiService? apiService])
+    : _apiService = apiService ?? HealthApiService();
+
+  /// Readings in [start, end); [limit] only applies without the cache
+  Future<HistoryColumns> load(
+    String deviceId, {
+    required DateTime start,
+    DateTime? end,
+    int limit = 100,
+  }) async {
+    final cache = await _cacheFor(deviceId);
+    if (cache == null) {
+      final history = await _apiService.getVitalsHistory(
+        deviceId,
+        startDate: start,
+        endDate: end,
+        limit: limit,
+      );
+      return HistoryColumns.fromVitals(history);
+    }
+
+    await _sync(deviceId, cache);
+    return cache.view(start: start, end: end);
+  }
+
+  Future<void> _sync(String deviceId, HistoryCache cache) async {
+    final now = DateTime.now();
+    final floor = now.subtract(retention);
+    var since = cache.lastTimestamp ?? floor;
+    if (since.isBefore(floor)) since = floor;
+
+    int added = 0;
+    while (true) {
+      // Oldest first, so each page continues where the last one ended
+      final List<VitalSigns> page = await _apiService.getVitalsHistory(
+        deviceId,
+        startDate: since.add(const Duration(milliseconds: 1)),
+        endDate: now,
+        limit: syncPageSize,
+        oldestFirst: true,
+      );
+      if (page.isEmpty) break;
+
+      if (_newestFirst(page)) {
+        // The backend ignored order=asc: a full page holds the newest
+        // readings, and paging forward from it would skip everything older
+        final all = await _pageBackwards(deviceId, since, page);
+        added += cache.append(HistoryColumns.fromVitals(all));
+        break;
+      }
+
+      final appended = cache.append(HistoryColumns.fromVitals(page));
+      added += appended;
+      final last = cache.lastTimestamp;
+      if (appended == 0 || last == null || page.length < syncPageSize) break;
+      since = last;
+    }
+    if (added > 0) cache.flush();
+  }
+
+  static bool _newestFirst(List<VitalSigns> page) =>
+      page.length > 1 && page.first.timestamp.isAfter(page.last.timestamp);
+
+  /// Pages back from the oldest reading of a newest-first [page] until
+  /// [since] is reached; the caller sorts the result
+  Future<List<VitalSigns>> _pageBackwards(
+    String deviceId,
+    DateTime since,
+    List<VitalSigns> page,
+  ) async {
+    final all = List<VitalSigns>.of(page);
+    var oldest = page.last.timestamp;
+    while (page.length >= syncPageSize) {
+      page = await _apiService.getVitalsHistory(
+        deviceId,
+        startDate: since.add(const Duration(milliseconds: 1)),
+        endDate: oldest,
+        limit: syncPageSize,
+      );
+      final older = page.where((v) => v.timestamp.isBefore(oldest)).toList();
+      if (older.isEmpty) break;
+      all.addAll(older);
+      oldest = older
+          .map((v) => v.timestamp)
+          .reduce((a, b) => a.isBefore(b) ? a : b);
+    }
+    return all;
+  }
+
+  static Future<HistoryCache?> _cacheFor(String deviceId) {
+    if (!HistoryAnalytics.nativeAvailable) return Future.value(null);
+    return _caches.putIfAbsent(deviceId, () async {
+      final dir = await getApplicationSupportDirectory();
+      final name = deviceId.replaceAll(RegExp(r'[^A-Za-z0-9_-]'), '_');
+      return HistoryCache.open('${dir.path}/history_$name.hcol');
+    });
+  }
+}
@@ -0,0 +1,237 @@
+import 'dart:async';
+import 'dart:ffi';
+import 'dart:typed_data';
+
+import '../models/live_vitals_model.dart';
+import 'native_analytics.dart';
+
+/// Layout of LsFrame in linux/analytics/live_stream.h
+final class _LsFrame extends Struct {
+  @Double()
+  external double receivedMs;
+  @Uint32()
+  external int seq;
+  @Uint32()
+  external int deviceMs;
+  @Int32()
+  external int device;
+  @Uint8()
+  external int type;
+  @Uint8()
+  external int flags;
+  @Uint8()
+  external int heartRate;
+  @Uint8()
+  external int hrQuality;
+  @Uint8()
+  external int spo2;
+  @Uint8()
+  external int spo2Quality;
+  @Uint8()
+  external int battery;
+  @Uint8()
+  external int state;
+  @Int16()
+  external int temperatureCenti;
+  @Int8()
+  external int rssi;
+  @Uint8()
+  external int reserved;
+  @Uint16()
+  external int waveRate;
+  @Uint16()
+  external int waveCount;
+  @Array(64)
+  external Array<Uint32> wave;
+}
+
+/// Layout of LsStats in linux/analytics/live_stream.h
+final class _LsStats extends Struct {
+  @Uint64()
+  external int datagrams;
+  @Uint64()
+  external int frames;
+  @Uint64()
+  external int malformed;
+  @Uint64()
+  external int dropped;
+  @Uint64()
+  external int seqGaps;
+  @Int32()
+  external int devices;
+}
+
+final class _LsReceiver extends Opaque {}
+
+typedef _StartNative = Pointer<_LsReceiver> Function(Pointer<Uint8>, Uint16);
+typedef _StartDart = Pointer<_LsReceiver> Function(Pointer<Uint8>, int);
+typedef _StopNative = Void Function(Pointer<_LsReceiver>);
+typedef _StopDart = void Function(Pointer<_LsReceiver>);
+typedef _PollNative =
+    Int32 Function(Pointer<_LsReceiver>, Pointer<_LsFrame>, Int32);
+typedef _PollDart = int Function(Pointer<_LsReceiver>, Pointer<_LsFrame>, int);
+typedef _DeviceIdNative =
+    Int32 Function(Pointer<_LsReceiver>, Int32, Pointer<Uint8>, Int32);
+typedef _DeviceIdDart =
+    int Function(Pointer<_LsReceiver>, int, Pointer<Uint8>, int);
+typedef _StatsNative = Void Function(Pointer<_LsReceiver>, Pointer<_LsStats>);
+typedef _StatsDart = void Function(Pointer<_LsReceiver>, Pointer<_LsStats>);
+
+const _typeVitals = 1;
+const _typeWaveform = 2;
+const _flagAlert = 1 << 0;
+const _flagCritical = 1 << 1;
+const _flagGap = 1 << 3;
+const _monitoringStates = ['idle', 'monitoring', 'paused'];
+
+/// Direct LAN stream from bedside devices (UDP multicast, see
+/// linux/analytics/live_stream.h). A native thread decodes datagrams into a
+/// lock-free ring; this class drains it every [pollInterval] on the UI
+/// isolate and keeps the latest state per bed.
+class LiveStream {
+  static const String defaultGroup = '239.255.72.83';
+  static const int defaultPort = 47800;
+  static const Duration pollInterval = Duration(milliseconds: 100);
+  static const int _batch = 256;
+
+  final NativeAnalytics _native;
+  final Pointer<_LsReceiver> _rx;
+  final Pointer<_LsFrame> _frames;
+  final Pointer<_LsStats> _stats;
+  final Pointer<Uint8> _idBuf;
+  final _Api _api;
+  final Map<int, LiveBed> _bySlot = {};
+  final Map<String, LiveBed> beds = {};
+  final StreamController<void> _updates = StreamController<void>.broadcast();
+  Timer? _timer;
+
+  LiveStream._(this._native, this._rx, this._api)
+    : _frames = _native.allocate<_LsFrame>(_batch * sizeOf<_LsFrame>()),
+      _stats = _native.allocate<_LsStats>(sizeOf<_LsStats>()),
+      _idBuf = _native.allocate<Uint8>(32);
+
+  /// Whether this build can receive the stream (Linux desktop)
+  static bool get isSupported => NativeAnalytics.instance != null;
+
+  /// Joins the group (empty for unicast only); null if unsupported or the
+  /// port cannot be bound
+  static LiveStream? start({
+    String group = defaultGroup,
+    int port = defaultPort,
+  }) {
+    final native = NativeAnalytics.instance;
+    if (native == null) return null;
+    final api = _Api.of(native.library);
+    final groupBuf = native.stageBytes(
+      Uint8List.fromList([...group.codeUnits, 0]),
+    );
+    final rx = api.start(groupBuf, port);
+    native.release(groupBuf);
+    if (rx == nullptr) return null;
+
+    final stream = LiveStream._(native, rx, api);
+    stream._timer = Timer.periodic(pollInterval, (_) => stream._poll());
+    return stream;
+  }
+
+  /// Fires after each poll that changed any bed
+  Stream<void> get updates => _updates.stream;
+
+  LiveStreamStats get stats {
+    _api.stats(_rx, _stats);
+    final s = _stats.ref;
+    return LiveStreamStats(
+      datagrams: s.datagrams,
+      frames: s.frames,
+      malformed: s.malformed,
+      dropped: s.dropped,
+      seqGaps: s.seqGaps,
+      devices: s.devices,
+    );
+  }
+
+  void _poll() {
+    bool changed = false;
+    int n;
+    do {
+      n = _api.poll(_rx, _frames, _batch);
+      for (int i = 0; i < n; i++) {
+        _apply((_frames + i).ref);
+      }
+      changed |= n > 0;
+    } while (n == _batch);
+    if (changed) _updates.add(null);
+  }
+
+  LiveBed _bedFor(int slot) {
+    return _bySlot.putIfAbsent(slot, () {
+      final len = _api.deviceId(_rx, slot, _idBuf, 32);
+      final id = len > 0
+          ? String.fromCharCodes(_idBuf.asTypedList(len))
+          : 'slot $slot';
+      return beds.putIfAbsent(id, () => LiveBed(id));
+    });
+  }
+
+  void _apply(_LsFrame f) {
+    final bed = _bedFor(f.device);
+    bed.lastUpdate = DateTime.fromMillisecondsSinceEpoch(f.receivedMs.toInt());
+    if (f.type == _typeVitals) {
+      bed.heartRate = f.heartRate;
+      bed.hrQuality = f.hrQuality;
+      bed.spo2 = f.spo2;
+      bed.spo2Quality = f.spo2Quality;
+      bed.temperature = f.temperatureCenti / 100.0;
+      bed.batteryPercent = f.battery;
+      bed.wifiRssi = f.rssi;
+      bed.monitoringState = f.state < _monitoringStates.length
+          ? _monitoringStates[f.state]
+          : 'idle';
+      bed.hasAlert = (f.flags & _flagAlert) != 0;
+      bed.isCritical = (f.flags & _flagCritical) != 0;
+    } else if (f.type == _typeWaveform) {
+      // Samples were lost on the device: a NaN breaks the trace there
+      if ((f.flags & _flagGap) != 0) bed.addSample(double.nan);
+      for (int i = 0; i < f.waveCount; i++) {
+        bed.addSample(f.wave[i].toDouble());
+      }
+    }
+  }
+
+  void stop() {
+    _timer?.cancel();
+    _api.stop(_rx);
+    _native.release(_frames);
+    _native.release(_stats);
+    _native.release(_idBuf);
+    _updates.close();
+  }
+}
+
+class _Api {
+  final _StartDart start;
+  final _StopDart stop;
+  final _PollDart poll;
+  final _DeviceIdDart deviceId;
+  final _StatsDart stats;
+
+  static _Api? _cached;
+
+  _Api._(DynamicLibrary lib)
+    : start = lib.lookupFunction<_StartNative, _StartDart>('ls_start'),
+      stop = lib.lookupFunction<_StopNative, _StopDart>('ls_stop'),
+      poll = lib.lookupFunction<_PollNative, _PollDart>(
+        'ls_poll',
+        isLeaf: true,
+      ),
+      deviceId = lib.lookupFunction<_DeviceIdNative, _DeviceIdDart>(
+        'ls_device_id',
+        isLeaf: true,
+      ),
+      stats = lib.lookupFunction<_StatsNative, _StatsDart>(
+        'ls_stats',
+        isLeaf: true,
+      );
+
+  static _Api of(DynamicLibrary lib) => _cached ??= _Api._(lib);
+}
@@ -0,0 +1,30 @@
+import '../models/live_vitals_model.dart';
+
+/// Stand-in for platforms without dart:ffi (web); the LAN stream needs the
+/// native receiver in the Linux runner.
+class LiveStream {
+  static const String defaultGroup = '239.255.72.83';
+  static const int defaultPort = 47800;
+
+  static bool get isSupported => false;
+
+  static LiveStream? start({
+    String group = defaultGroup,
+    int port = defaultPort,
+  }) => null;
+
+  final Map<String, LiveBed> beds = {};
+
+  Stream<void> get updates => const Stream.empty();
+
+  LiveStreamStats get stats => const LiveStreamStats(
+    datagrams: 0,
+    frames: 0,
+    malformed: 0,
+    dropped: 0,
+    seqGaps: 0,
+    devices: 0,
+  );
+
+  void stop() {}
+}
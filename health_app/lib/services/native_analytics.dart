@@ -0,0 +1,279 @@
+import 'dart:ffi';
+import 'dart:io';
+import 'dart:typed_data';
+
+import 'health_calculator.dart';
+import 'history_analytics.dart';
+
+/// Layout of HaSummary in linux/analytics/health_analytics.h
+final class _HaSummary extends Struct {
+  @Int32()
+  external int count;
+  @Double()
+  external double mean;
+  @Double()
+  external double sd;
+  @Double()
+  external double min;
+  @Double()
+  external double max;
+}
+
+/// Layout of HaHrv in linux/analytics/health_analytics.h
+final class _HaHrv extends Struct {
+  @Int32()
+  external int beats;
+  @Double()
+  external double meanNnMs;
+  @Double()
+  external double sdnnMs;
+  @Double()
+  external double rmssdMs;
+  @Double()
+  external double pnn50;
+}
+
+typedef _AllocNative = Pointer<Void> Function(Size);
+typedef _AllocDart = Pointer<Void> Function(int);
+typedef _FreeNative = Void Function(Pointer<Void>);
+typedef _FreeDart = void Function(Pointer<Void>);
+typedef _SummaryNative =
+    Int32 Function(Pointer<Double>, Int32, Pointer<_HaSummary>);
+typedef _SummaryDart = int Function(Pointer<Double>, int, Pointer<_HaSummary>);
+typedef _RollingNative =
+    Int32 Function(
+      Pointer<Double>,
+      Pointer<Double>,
+      Int32,
+      Double,
+      Pointer<Double>,
+      Pointer<Double>,
+      Pointer<Double>,
+      Pointer<Double>,
+    );
+typedef _RollingDart =
+    int Function(
+      Pointer<Double>,
+      Pointer<Double>,
+      int,
+      double,
+      Pointer<Double>,
+      Pointer<Double>,
+      Pointer<Double>,
+      Pointer<Double>,
+    );
+typedef _HrvNative = Int32 Function(Pointer<Int32>, Int32, Pointer<_HaHrv>);
+typedef _HrvDart = int Function(Pointer<Int32>, int, Pointer<_HaHrv>);
+typedef _ScoresNative =
+    Int32 Function(
+      Pointer<Int32>,
+      Pointer<Int32>,
+      Pointer<Double>,
+      Pointer<Int32>,
+      Pointer<Int32>,
+      Int32,
+      Double,
+      Pointer<Double>,
+    );
+typedef _ScoresDart =
+    int Function(
+      Pointer<Int32>,
+      Pointer<Int32>,
+      Pointer<Double>,
+      Pointer<Int32>,
+      Pointer<Int32>,
+      int,
+      double,
+      Pointer<Double>,
+    );
+
+/// FFI binding to libhealth_analytics.so (Linux desktop build)
+class NativeAnalytics {
+  /// Must match HA_ABI_VERSION in health_analytics.h
+  static const int abiVersion = 2;
+  static const String libraryName = 'libhealth_analytics.so';
+
+  static NativeAnalytics? _instance;
+  static bool _probed = false;
+
+  /// The loaded library, or null when it is not bundled with this build
+  static NativeAnalytics? get instance {
+    if (!_probed) {
+      _probed = true;
+      _instance = _load();
+    }
+    return _instance;
+  }
+
+  /// The opened library, shared with HistoryCache
+  final DynamicLibrary library;
+
+  final _AllocDart _alloc;
+  final _FreeDart _free;
+  final _SummaryDart _summary;
+  final _RollingDart _rolling;
+  final _HrvDart _hrvFromBpm;
+  final _ScoresDart _healthScores;
+
+  NativeAnalytics._(DynamicLibrary lib)
+    : library = lib,
+      _alloc = lib.lookupFunction<_AllocNative, _AllocDart>('ha_alloc'),
+      _free = lib.lookupFunction<_FreeNative, _FreeDart>('ha_free'),
+      _summary = lib.lookupFunction<_SummaryNative, _SummaryDart>(
+        'ha_summary',
+        isLeaf: true,
+      ),
+      _rolling = lib.lookupFunction<_RollingNative, _RollingDart>(
+        'ha_rolling_stats',
+        isLeaf: true,
+      ),
+      _hrvFromBpm = lib.lookupFunction<_HrvNative, _HrvDart>(
+        'ha_hrv_from_bpm',
+        isLeaf: true,
+      ),
+      _healthScores = lib.lookupFunction<_ScoresNative, _ScoresDart>(
+        'ha_health_scores',
+        isLeaf: true,
+      );
+
+  /// Candidate paths: HEALTH_ANALYTICS_LIB override (benchmarks), the
+  /// bundle's lib/ directory next to the executable, then the loader path
+  static List<String> _candidates() {
+    final exeDir = File(Platform.resolvedExecutable).parent.path;
+    return [
+      if (Platform.environment['HEALTH_ANALYTICS_LIB'] != null)
+        Platform.environment['HEALTH_ANALYTICS_LIB']!,
+      '$exeDir/lib/$libraryName',
+      libraryName,
+    ];
+  }
+
+  static NativeAnalytics? _load() {
+    if (!Platform.isLinux) return null;
+    for (final path in _candidates()) {
+      try {
+        final lib = DynamicLibrary.open(path);
+        final version = lib.lookupFunction<Int32 Function(), int Function()>(
+          'ha_abi_version',
+        )();
+        if (version != abiVersion) {
+          print('⚠️ $path has analytics ABI $version, expected $abiVersion');
+          continue;
+        }
+        return NativeAnalytics._(lib);
+      } on ArgumentError {
+        // Not at this path; try the next one
+      }
+    }
+    return null;
+  }
+
+  /// Native buffer from ha_alloc(); pair with [release]
+  Pointer<T> allocate<T extends NativeType>(int bytes) {
+    final p = _alloc(bytes);
+    if (p == nullptr) throw StateError('ha_alloc($bytes) failed');
+    return p.cast<T>();
+  }
+
+  /// Copies values into a native buffer; pair with [release]
+  Pointer<Double> stageDoubles(Float64List values) {
+    final p = allocate<Double>(values.length * sizeOf<Double>());
+    p.asTypedList(values.length).setAll(0, values);
+    return p;
+  }
+
+  Pointer<Int32> stageInts(Int32List values) {
+    final p = allocate<Int32>(values.length * sizeOf<Int32>());
+    p.asTypedList(values.length).setAll(0, values);
+    return p;
+  }
+
+  Pointer<Uint8> stageBytes(Uint8List values) {
+    final p = allocate<Uint8>(values.length);
+    p.asTypedList(values.length).setAll(0, values);
+    return p;
+  }
+
+  void release(Pointer p) => _free(p.cast());
+
+  void _check(int rc, String fn) {
+    if (rc != 0) throw StateError('$fn failed ($rc)');
+  }
+
+  // The bulk arrays below are passed with TypedData.address, which the VM
+  // allows for leaf calls: native code reads the Dart lists (or the mmap
+  // views from HistoryCache) in place and writes results straight into
+  // Dart-allocated outputs. Only the small result structs are malloc'd.
+
+  SeriesSummary summary(Float64List x) {
+    final out = allocate<_HaSummary>(sizeOf<_HaSummary>());
+    try {
+      _check(_summary(x.address, x.length, out), 'ha_summary');
+      final r = out.ref;
+      return SeriesSummary(
+        count: r.count,
+        mean: r.mean,
+        sd: r.sd,
+        min: r.min,
+        max: r.max,
+      );
+    } finally {
+      _free(out.cast());
+    }
+  }
+
+  RollingStats rolling(Float64List t, Float64List x, double windowMs) {
+    final n = x.length;
+    final mean = Float64List(n), sd = Float64List(n);
+    final min = Float64List(n), max = Float64List(n);
+    _check(
+      _rolling(
+        t.address,
+        x.address,
+        n,
+        windowMs,
+        mean.address,
+        sd.address,
+        min.address,
+        max.address,
+      ),
+      'ha_rolling_stats',
+    );
+    return RollingStats(mean: mean, sd: sd, min: min, max: max);
+  }
+
+  HrvMetrics hrvFromBpm(Int32List bpm) {
+    final out = allocate<_HaHrv>(sizeOf<_HaHrv>());
+    try {
+      _check(_hrvFromBpm(bpm.address, bpm.length, out), 'ha_hrv_from_bpm');
+      final r = out.ref;
+      return HrvMetrics(
+        beats: r.beats,
+        meanNnMs: r.meanNnMs,
+        sdnnMs: r.sdnnMs,
+        rmssdMs: r.rmssdMs,
+        pnn50: r.pnn50,
+      );
+    } finally {
+      _free(out.cast());
+    }
+  }
+
+  Float64List healthScores(HistoryColumns cols, {int? restingHR}) {
+    final scores = Float64List(cols.length);
+    _check(
+      _healthScores(
+        cols.heartRate.address,
+        cols.spo2.address,
+        cols.temperature.address,
+        cols.hrQuality.address,
+        cols.spo2Quality.address,
+        cols.length,
+        (restingHR ?? 0).toDouble(),
+        scores.address,
+      ),
+      'ha_health_scores',
+    );
+    return scores;
+  }
+}
@@ -0,0 +1,20 @@
+import 'dart:typed_data';
+
+import 'health_calculator.dart';
+import 'history_analytics.dart';
+
+/// Stand-in for platforms without dart:ffi (web); the native library is
+/// never available there and HistoryAnalytics uses the Dart path.
+class NativeAnalytics {
+  static NativeAnalytics? get instance => null;
+
+  SeriesSummary summary(Float64List x) => throw UnsupportedError('ffi');
+
+  RollingStats rolling(Float64List t, Float64List x, double windowMs) =>
+      throw UnsupportedError('ffi');
+
+  HrvMetrics hrvFromBpm(Int32List bpm) => throw UnsupportedError('ffi');
+
+  Float64List healthScores(HistoryColumns cols, {int? restingHR}) =>
+      throw UnsupportedError('ffi');
+}
@@ -2,8 +2,8 @@ import 'package:fl_chart/fl_chart.dart';
 import 'package:flutter/material.dart';
 import 'package:intl/intl.dart';
 
-import '../models/vitals_model.dart';
-import '../services/health_api_service.dart';
+import '../services/history_analytics.dart';
+import '../services/history_store.dart';
 
 /// Detailed history modal for a specific vital sign
 class VitalHistoryModal extends StatefulWidget {
@@ -25,8 +25,11 @@ class VitalHistoryModal extends StatefulWidget {
 }
 
 class _VitalHistoryModalState extends State<VitalHistoryModal> {
-  final HealthApiService _apiService = HealthApiService();
-  List<VitalSigns> _history = [];
+  // Chart is thinned to this many points; statistics use every reading
+  static const int _maxChartPoints = 300;
+
+  final HistoryStore _historyStore = HistoryStore();
+  HistoryColumns _history = HistoryColumns.fromVitals(const []);
   bool _isLoading = true;
   String _timeRange = '1h'; // 1h, 6h, 24h
 
@@ -46,10 +49,10 @@ class _VitalHistoryModalState extends State<VitalHistoryModal> {
         : 24;
     final startDate = DateTime.now().subtract(Duration(hours: hours));
 
-    final history = await _apiService.getVitalsHistory(
+    final history = await _historyStore.load(
       widget.deviceId,
+      start: startDate,
       limit: 100,
-      startDate: startDate,
     );
 
     if (mounted) {
@@ -150,7 +153,7 @@ class _VitalHistoryModalState extends State<VitalHistoryModal> {
                                 if (index < 0 || index >= _history.length) {
                                   return const Text('');
                                 }
-                                final time = _history[index].timestamp;
+                                final time = _history.timestampAt(index);
                                 return Text(
                                   DateFormat('HH:mm').format(time),
                                   style: const TextStyle(fontSize: 10),
@@ -203,28 +206,27 @@ class _VitalHistoryModalState extends State<VitalHistoryModal> {
     );
   }
 
-  List<FlSpot> _getSpots() {
-    return _history.asMap().entries.map((entry) {
-      final index = entry.key;
-      final vital = entry.value;
-      double value;
-
-      switch (widget.vitalType) {
-        case 'hr':
-          value = vital.heartRate.toDouble();
-          break;
-        case 'spo2':
-          value = vital.spo2.toDouble();
-          break;
-        case 'temp':
-          value = vital.temperature;
-          break;
-        default:
-          value = 0;
-      }
+  List<num> _values() {
+    switch (widget.vitalType) {
+      case 'hr':
+        return _history.heartRate;
+      case 'spo2':
+        return _history.spo2;
+      case 'temp':
+        return _history.temperature;
+      default:
+        return List<num>.filled(_history.length, 0);
+    }
+  }
 
-      return FlSpot(index.toDouble(), value);
-    }).toList();
+  List<FlSpot> _getSpots() {
+    final values = _values();
+    final stride = (values.length / _maxChartPoints).ceil().clamp(1, 1 << 30);
+    final spots = <FlSpot>[];
+    for (int i = 0; i < values.length; i += stride) {
+      spots.add(FlSpot(i.toDouble(), values[i].toDouble()));
+    }
+    return spots;
   }
 
   double _getInterval() {
@@ -243,22 +245,16 @@ class _VitalHistoryModalState extends State<VitalHistoryModal> {
   Widget _buildStatistics() {
     if (_history.isEmpty) return const SizedBox.shrink();
 
-    final values = _history.map((v) {
-      switch (widget.vitalType) {
-        case 'hr':
-          return v.heartRate.toDouble();
-        case 'spo2':
-          return v.spo2.toDouble();
-        case 'temp':
-          return v.temperature;
-        default:
-          return 0.0;
-      }
-    }).toList();
-
-    final avg = values.reduce((a, b) => a + b) / values.length;
-    final max = values.reduce((a, b) => a > b ? a : b);
-    final min = values.reduce((a, b) => a < b ? a : b);
+    final values = _values();
+    double sum = 0;
+    double max = double.negativeInfinity, min = double.infinity;
+    for (final v in values) {
+      final d = v.toDouble();
+      sum += d;
+      if (d > max) max = d;
+      if (d < min) min = d;
+    }
+    final avg = sum / values.length;
 
     return Row(
       mainAxisAlignment: MainAxisAlignment.spaceAround,
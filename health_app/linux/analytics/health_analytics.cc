@@ -0,0 +1,341 @@
+#include "health_analytics.h"
+
+#include <cmath>
+#include <cstdlib>
+#include <limits>
+#include <vector>
+
+// The bulk loops are written branch-free over __restrict pointers with a
+// fixed number of independent accumulators so that -O3 can vectorise them
+// without -ffast-math: each accumulator is its own lane, and the lanes are
+// only combined once at the end, so the result does not depend on the
+// vector width.
+
+namespace {
+
+constexpr int kLanes = 4;
+constexpr double kNaN = std::numeric_limits<double>::quiet_NaN();
+constexpr double kInf = std::numeric_limits<double>::infinity();
+
+constexpr double kMinNnMs = 300.0;   // 200 BPM
+constexpr double kMaxNnMs = 2000.0;  // 30 BPM
+
+// kMinNnMs <= v <= kMaxNnMs as a single compare, which keeps the lane loops
+// free of the short-circuit branches two compares turn into.
+inline bool NnInRange(double v) {
+  return std::fabs(v - (kMinNnMs + kMaxNnMs) / 2) <= (kMaxNnMs - kMinNnMs) / 2;
+}
+
+inline double HorizontalSum(const double (&lane)[kLanes]) {
+  return (lane[0] + lane[1]) + (lane[2] + lane[3]);
+}
+
+// Two-pass summary: the second pass accumulates squared deviations from the
+// mean, which stays accurate for long, nearly constant series where the
+// sum-of-squares shortcut cancels badly.
+void Summarize(const double* __restrict x, int32_t n, HaSummary* out) {
+  double sum[kLanes] = {0, 0, 0, 0};
+  double cnt[kLanes] = {0, 0, 0, 0};
+  double lo[kLanes] = {kInf, kInf, kInf, kInf};
+  double hi[kLanes] = {-kInf, -kInf, -kInf, -kInf};
+
+  int32_t i = 0;
+  for (; i + kLanes <= n; i += kLanes) {
+    for (int l = 0; l < kLanes; l++) {
+      const double v = x[i + l];
+      const bool ok = v > 0.0;
+      sum[l] += ok ? v : 0.0;
+      cnt[l] += ok ? 1.0 : 0.0;
+      const double vlo = ok ? v : kInf;
+      const double vhi = ok ? v : -kInf;
+      lo[l] = vlo < lo[l] ? vlo : lo[l];
+      hi[l] = vhi > hi[l] ? vhi : hi[l];
+    }
+  }
+  for (; i < n; i++) {
+    const double v = x[i];
+    if (v > 0.0) {
+      sum[0] += v;
+      cnt[0] += 1.0;
+      if (v < lo[0]) lo[0] = v;
+      if (v > hi[0]) hi[0] = v;
+    }
+  }
+
+  const double count = HorizontalSum(cnt);
+  out->count = static_cast<int32_t>(count);
+  if (count == 0) {
+    out->mean = out->sd = out->min = out->max = kNaN;
+    return;
+  }
+  const double mean = HorizontalSum(sum) / count;
+
+  double dev[kLanes] = {0, 0, 0, 0};
+  i = 0;
+  for (; i + kLanes <= n; i += kLanes) {
+    for (int l = 0; l < kLanes; l++) {
+      const double v = x[i + l];
+      const double d = v - mean;
+      dev[l] += v > 0.0 ? d * d : 0.0;
+    }
+  }
+  for (; i < n; i++) {
+    const double d = x[i] - mean;
+    if (x[i] > 0.0) dev[0] += d * d;
+  }
+
+  out->mean = mean;
+  out->sd = std::sqrt(HorizontalSum(dev) / count);
+  out->min = std::fmin(std::fmin(lo[0], lo[1]), std::fmin(lo[2], lo[3]));
+  out->max = std::fmax(std::fmax(hi[0], hi[1]), std::fmax(hi[2], hi[3]));
+}
+
+// Monotonic deque of sample indices over a caller-provided buffer. Indices
+// only ever enter at the back and leave from either end, so a flat array of
+// n slots with head/tail cursors never wraps.
+struct MonoDeque {
+  int32_t* idx;
+  int32_t head = 0;
+  int32_t tail = 0;
+
+  bool Empty() const { return head == tail; }
+  int32_t Front() const { return idx[head]; }
+  int32_t Back() const { return idx[tail - 1]; }
+  void PushBack(int32_t i) { idx[tail++] = i; }
+  void PopBack() { tail--; }
+  void PopFront() { head++; }
+};
+
+void HrvFromIntervals(const double* __restrict nn, int32_t n, HaHrv* out) {
+  // Pass 1: accepted intervals (mean) and successive differences between
+  // neighbouring accepted intervals.
+  double sum[kLanes] = {0, 0, 0, 0};
+  double cnt[kLanes] = {0, 0, 0, 0};
+  double sq[kLanes] = {0, 0, 0, 0};
+  double pairs[kLanes] = {0, 0, 0, 0};
+  double over50[kLanes] = {0, 0, 0, 0};
+
+  // The first interval has no predecessor; peel it so the main loop can
+  // load nn[k - 1] unconditionally.
+  if (n > 0 && NnInRange(nn[0])) {
+    sum[0] += nn[0];
+    cnt[0] += 1.0;
+  }
+  int32_t i = 1;
+  for (; i + kLanes <= n; i += kLanes) {
+    for (int l = 0; l < kLanes; l++) {
+      const double v = nn[i + l];
+      const double p = nn[i + l - 1];
+      const double ok = NnInRange(v) ? 1.0 : 0.0;
+      const double pair = NnInRange(p) ? ok : 0.0;
+      const double d = v - p;
+      const double d2 = d * d * pair;
+      sum[l] += v * ok;
+      cnt[l] += ok;
+      sq[l] += d2;
+      pairs[l] += pair;
+      over50[l] += d2 > 2500.0 ? 1.0 : 0.0;  // |d| > 50 ms
+    }
+  }
+  for (; i < n; i++) {
+    const double v = nn[i];
+    if (!NnInRange(v)) continue;
+    sum[0] += v;
+    cnt[0] += 1.0;
+    const double p = nn[i - 1];
+    if (!NnInRange(p)) continue;
+    const double d = v - p;
+    sq[0] += d * d;
+    pairs[0] += 1.0;
+    if (std::fabs(d) > 50.0) over50[0] += 1.0;
+  }
+
+  const double count = HorizontalSum(cnt);
+  const double npairs = HorizontalSum(pairs);
+  out->beats = static_cast<int32_t>(count);
+  if (count < 2) {
+    out->mean_nn_ms = count > 0 ? HorizontalSum(sum) : kNaN;
+    out->sdnn_ms = out->rmssd_ms = out->pnn50 = kNaN;
+    return;
+  }
+  const double mean = HorizontalSum(sum) / count;
+
+  // Pass 2: SDNN around the mean (sample standard deviation, as in the
+  // Task Force definition).
+  double dev[kLanes] = {0, 0, 0, 0};
+  i = 0;
+  for (; i + kLanes <= n; i += kLanes) {
+    for (int l = 0; l < kLanes; l++) {
+      const double v = nn[i + l];
+      const double d = v - mean;
+      dev[l] += NnInRange(v) ? d * d : 0.0;
+    }
+  }
+  for (; i < n; i++) {
+    const double v = nn[i];
+    if (NnInRange(v)) dev[0] += (v - mean) * (v - mean);
+  }
+
+  out->mean_nn_ms = mean;
+  out->sdnn_ms = std::sqrt(HorizontalSum(dev) / (count - 1));
+  out->rmssd_ms = npairs > 0 ? std::sqrt(HorizontalSum(sq) / npairs) : kNaN;
+  out->pnn50 = npairs > 0 ? HorizontalSum(over50) / npairs : kNaN;
+}
+
+}  // namespace
+
+int32_t ha_abi_version(void) { return HA_ABI_VERSION; }
+
+void* ha_alloc(size_t bytes) { return std::malloc(bytes ? bytes : 1); }
+
+void ha_free(void* ptr) { std::free(ptr); }
+
+int32_t ha_summary(const double* x, int32_t n, HaSummary* out) {
+  if (out == nullptr || n < 0 || (n > 0 && x == nullptr)) return -1;
+  Summarize(x, n, out);
+  return 0;
+}
+
+int32_t ha_rolling_stats(const double* t_ms, const double* x, int32_t n,
+                         double window_ms, double* out_mean, double* out_sd,
+                         double* out_min, double* out_max) {
+  if (n < 0 || window_ms <= 0) return -1;
+  if (n == 0) return 0;
+  if (t_ms == nullptr || x == nullptr) return -1;
+
+  // Running sums are kept relative to the first valid value so that months
+  // of add/remove updates do not lose precision to the absolute level.
+  double shift = 0;
+  for (int32_t i = 0; i < n; i++) {
+    if (x[i] > 0.0) {
+      shift = x[i];
+      break;
+    }
+  }
+
+  const bool want_extrema = out_min != nullptr || out_max != nullptr;
+  std::vector<int32_t> buf(want_extrema ? 2 * static_cast<size_t>(n) : 0);
+  MonoDeque lo{want_extrema ? buf.data() : nullptr};
+  MonoDeque hi{want_extrema ? buf.data() + n : nullptr};
+
+  double s = 0, ss = 0;
+  int32_t count = 0;
+  int32_t first = 0;  // oldest index still inside the window
+  for (int32_t i = 0; i < n; i++) {
+    const double v = x[i];
+    if (v > 0.0) {
+      const double d = v - shift;
+      s += d;
+      ss += d * d;
+      count++;
+      if (want_extrema) {
+        while (!lo.Empty() && x[lo.Back()] >= v) lo.PopBack();
+        lo.PushBack(i);
+        while (!hi.Empty() && x[hi.Back()] <= v) hi.PopBack();
+        hi.PushBack(i);
+      }
+    }
+
+    const double start = t_ms[i] - window_ms;
+    for (; first < i && t_ms[first] <= start; first++) {
+      const double u = x[first];
+      if (u > 0.0) {
+        const double d = u - shift;
+        s -= d;
+        ss -= d * d;
+        count--;
+      }
+    }
+    if (want_extrema) {
+      while (!lo.Empty() && lo.Front() < first) lo.PopFront();
+      while (!hi.Empty() && hi.Front() < first) hi.PopFront();
+    }
+
+    if (count == 0) {
+      // Resynchronise: the window is empty, so any drift is discarded.
+      s = ss = 0;
+      if (out_mean) out_mean[i] = kNaN;
+      if (out_sd) out_sd[i] = kNaN;
+      if (out_min) out_min[i] = kNaN;
+      if (out_max) out_max[i] = kNaN;
+      continue;
+    }
+    const double m = s / count;
+    if (out_mean) out_mean[i] = shift + m;
+    if (out_sd) {
+      const double var = ss / count - m * m;
+      out_sd[i] = var > 0 ? std::sqrt(var) : 0.0;
+    }
+    if (out_min) out_min[i] = x[lo.Front()];
+    if (out_max) out_max[i] = x[hi.Front()];
+  }
+  return 0;
+}
+
+int32_t ha_hrv(const double* nn_ms, int32_t n, HaHrv* out) {
+  if (out == nullptr || n < 0 || (n > 0 && nn_ms == nullptr)) return -1;
+  HrvFromIntervals(nn_ms, n, out);
+  return 0;
+}
+
+int32_t ha_hrv_from_bpm(const int32_t* bpm, int32_t n, HaHrv* out) {
+  if (out == nullptr || n < 0 || (n > 0 && bpm == nullptr)) return -1;
+  std::vector<double> nn(static_cast<size_t>(n));
+  double* __restrict dst = nn.data();
+  for (int32_t i = 0; i < n; i++) {
+    // 0 BPM (no reading) maps to 0 ms, which the interval gate rejects.
+    const double r = static_cast<double>(bpm[i]);
+    dst[i] = r > 0 ? 60000.0 / r : 0.0;
+  }
+  HrvFromIntervals(dst, n, out);
+  return 0;
+}
+
+int32_t ha_health_scores(const int32_t* heart_rate, const int32_t* spo2,
+                         const double* temperature, const int32_t* hr_quality,
+                         const int32_t* spo2_quality, int32_t n,
+                         double resting_hr, double* out_score) {
+  if (n < 0) return -1;
+  if (n == 0) return 0;
+  if (!heart_rate || !spo2 || !temperature || !hr_quality || !spo2_quality ||
+      !out_score) {
+    return -1;
+  }
+  const int32_t* __restrict hr = heart_rate;
+  const int32_t* __restrict ox = spo2;
+  const double* __restrict tc = temperature;
+  const int32_t* __restrict hq = hr_quality;
+  const int32_t* __restrict oq = spo2_quality;
+  double* __restrict score = out_score;
+  const double target = resting_hr > 0 ? resting_hr : 70.0;
+
+  // Same piecewise penalties as HealthCalculator.calculateHealthScore,
+  // expressed as selects so the loop if-converts and vectorises.
+  for (int32_t i = 0; i < n; i++) {
+    const double s = ox[i];
+    const double p_spo2 = s >= 98   ? 0.0
+                          : s >= 95 ? (98 - s) * 2
+                          : s >= 90 ? 6 + (95 - s) * 4
+                                    : 40.0;
+
+    const double h = hr[i];
+    const double diff = std::fabs(h - target);
+    const double p_hr_reading = diff <= 10   ? 0.0
+                                : diff <= 20 ? (diff - 10) * 1.5
+                                : diff <= 40 ? 15 + (diff - 20)
+                                             : 30.0;
+    const double p_hr = h == 0 ? 30.0 : p_hr_reading;
+
+    const double t = tc[i];
+    const bool normal = (t >= 36.5) & (t <= 37.5);
+    const bool mild = (t >= 35.5) & (t <= 38.0);
+    const double p_temp = normal ? 0.0 : mild ? std::fabs(t - 37.0) * 10 : 20.0;
+
+    const double q = (static_cast<double>(hq[i]) + oq[i]) / 2;
+    const double p_quality = q < 50 ? 10.0 : q < 70 ? (70 - q) / 2 : 0.0;
+
+    const double v = 100.0 - p_spo2 - p_hr - p_temp - p_quality;
+    score[i] = v < 0 ? 0.0 : (v > 100 ? 100.0 : v);
+  }
+  return 0;
+}
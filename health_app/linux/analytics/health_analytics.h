@@ -0,0 +1,80 @@
+#ifndef HEALTH_ANALYTICS_H_
+#define HEALTH_ANALYTICS_H_
+
+// Native history analytics for the Linux desktop build.
+//
+// Plain C ABI so Dart can bind it with dart:ffi without code generation. All
+// array arguments are caller-owned; ha_alloc/ha_free are exported so the Dart
+// side can stage typed data without depending on package:ffi. Samples that
+// are zero (or negative) mean "no reading" in the device payload and are
+// skipped by every statistic, the same way the app treats them.
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define HA_EXPORT __attribute__((visibility("default"))) __attribute__((used))
+
+// Bumped whenever a struct layout or signature below changes; the Dart
+// binding refuses to use a library with a different version.
+#define HA_ABI_VERSION 2
+
+typedef struct {
+  int32_t count;  // valid (non-zero) samples
+  double mean;
+  double sd;      // population standard deviation
+  double min;
+  double max;
+} HaSummary;
+
+typedef struct {
+  int32_t beats;  // intervals used
+  double mean_nn_ms;
+  double sdnn_ms;
+  double rmssd_ms;
+  double pnn50;   // fraction of successive differences > 50 ms
+} HaHrv;
+
+HA_EXPORT int32_t ha_abi_version(void);
+
+HA_EXPORT void* ha_alloc(size_t bytes);
+HA_EXPORT void ha_free(void* ptr);
+
+// Mean/sd/min/max over the valid samples of x[0..n).
+HA_EXPORT int32_t ha_summary(const double* x, int32_t n, HaSummary* out);
+
+// Trailing time-window statistics: for each i, the valid samples j <= i with
+// t[j] > t[i] - window_ms. t must be non-decreasing. Any output pointer may
+// be null. Slots with no valid sample in the window are written as NaN.
+// Returns 0, or -1 on bad arguments.
+HA_EXPORT int32_t ha_rolling_stats(const double* t_ms, const double* x,
+                                   int32_t n, double window_ms,
+                                   double* out_mean, double* out_sd,
+                                   double* out_min, double* out_max);
+
+// Time-domain HRV over normal-to-normal intervals in milliseconds. Intervals
+// outside 300..2000 ms are treated as artefacts and break the successive-
+// difference chain instead of contributing a bogus jump.
+HA_EXPORT int32_t ha_hrv(const double* nn_ms, int32_t n, HaHrv* out);
+
+// Same, with intervals derived as 60000 / bpm from a heart-rate series (the
+// history endpoint only carries per-record rates, not beat intervals).
+HA_EXPORT int32_t ha_hrv_from_bpm(const int32_t* bpm, int32_t n, HaHrv* out);
+
+// HealthCalculator.calculateHealthScore for every record. resting_hr <= 0
+// uses the default target of 70 BPM.
+HA_EXPORT int32_t ha_health_scores(const int32_t* heart_rate,
+                                   const int32_t* spo2,
+                                   const double* temperature,
+                                   const int32_t* hr_quality,
+                                   const int32_t* spo2_quality, int32_t n,
+                                   double resting_hr, double* out_score);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // HEALTH_ANALYTICS_H_
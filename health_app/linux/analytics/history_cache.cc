@@ -0,0 +1,255 @@
+#include "history_cache.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstring>
+#include <string>
+#include <vector>
+
+namespace {
+
+constexpr char kMagic[8] = {'H', 'C', 'O', 'L', 'v', '1', '\0', '\0'};
+constexpr uint32_t kVersion = 1;
+constexpr size_t kHeaderBytes = 4096;
+constexpr uint64_t kInitialCapacity = 8192;  // ~11 h at one reading per 5 s
+constexpr size_t kColumnAlign = 64;
+constexpr size_t kWidth[HC_COLUMNS] = {8, 4, 4, 4, 4, 8};
+
+// First page of the file. Columns follow at the recorded offsets, each
+// capacity * width bytes, so a reader needs nothing but this header.
+struct Header {
+  char magic[8];
+  uint32_t version;
+  uint32_t columns;
+  uint64_t capacity;
+  uint64_t count;  // published last on append
+  double last_timestamp_ms;
+  uint64_t offset[HC_COLUMNS];
+};
+static_assert(sizeof(Header) <= kHeaderBytes, "header must fit one page");
+
+size_t Layout(uint64_t capacity, uint64_t* offset) {
+  size_t at = kHeaderBytes;
+  for (int k = 0; k < HC_COLUMNS; k++) {
+    offset[k] = at;
+    at += capacity * kWidth[k];
+    at = (at + kColumnAlign - 1) & ~(kColumnAlign - 1);
+  }
+  return at;
+}
+
+struct Mapping {
+  void* base = nullptr;
+  size_t bytes = 0;
+};
+
+Mapping MapFile(int fd, size_t bytes) {
+  Mapping m;
+  void* p = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  if (p != MAP_FAILED) {
+    m.base = p;
+    m.bytes = bytes;
+  }
+  return m;
+}
+
+// Sizes fd for capacity rows, maps it and writes an empty header.
+Mapping CreateLayout(int fd, uint64_t capacity) {
+  uint64_t offset[HC_COLUMNS];
+  const size_t bytes = Layout(capacity, offset);
+  if (ftruncate(fd, 0) != 0 || ftruncate(fd, bytes) != 0) return Mapping();
+  Mapping m = MapFile(fd, bytes);
+  if (m.base == nullptr) return m;
+
+  Header* h = static_cast<Header*>(m.base);
+  std::memcpy(h->magic, kMagic, sizeof(kMagic));
+  h->version = kVersion;
+  h->columns = HC_COLUMNS;
+  h->capacity = capacity;
+  h->count = 0;
+  h->last_timestamp_ms = 0;
+  std::memcpy(h->offset, offset, sizeof(offset));
+  return m;
+}
+
+bool Valid(const Mapping& m) {
+  if (m.bytes < kHeaderBytes) return false;
+  const Header* h = static_cast<const Header*>(m.base);
+  if (std::memcmp(h->magic, kMagic, sizeof(kMagic)) != 0) return false;
+  if (h->version != kVersion || h->columns != HC_COLUMNS) return false;
+  if (h->capacity == 0 || h->count > h->capacity) return false;
+  uint64_t offset[HC_COLUMNS];
+  if (Layout(h->capacity, offset) > m.bytes) return false;
+  return std::memcmp(offset, h->offset, sizeof(offset)) == 0;
+}
+
+}  // namespace
+
+struct HcCache {
+  std::string path;
+  int fd = -1;
+  Mapping map;
+  std::vector<Mapping> retired;  // kept alive for outstanding Dart views
+  uint32_t generation = 0;
+
+  Header* header() const { return static_cast<Header*>(map.base); }
+
+  char* column(int k) const {
+    return static_cast<char*>(map.base) + header()->offset[k];
+  }
+
+  // Relays the file out for at least `rows` rows: builds the new layout in
+  // a sibling temp file and renames it over the original, so a crash leaves
+  // either the old or the new file intact.
+  bool Grow(uint64_t rows) {
+    const Header* old = header();
+    const uint64_t capacity = std::max<uint64_t>(old->capacity * 2, rows);
+    const std::string tmp = path + ".tmp";
+    const int nfd = open(tmp.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC,
+                         0644);
+    if (nfd < 0) return false;
+    Mapping next = CreateLayout(nfd, capacity);
+    if (next.base == nullptr) {
+      close(nfd);
+      unlink(tmp.c_str());
+      return false;
+    }
+
+    Header* h = static_cast<Header*>(next.base);
+    for (int k = 0; k < HC_COLUMNS; k++) {
+      std::memcpy(static_cast<char*>(next.base) + h->offset[k], column(k),
+                  old->count * kWidth[k]);
+    }
+    h->last_timestamp_ms = old->last_timestamp_ms;
+    h->count = old->count;
+
+    if (msync(next.base, next.bytes, MS_SYNC) != 0 ||
+        rename(tmp.c_str(), path.c_str()) != 0) {
+      munmap(next.base, next.bytes);
+      close(nfd);
+      unlink(tmp.c_str());
+      return false;
+    }
+    close(fd);
+    fd = nfd;
+    retired.push_back(map);
+    map = next;
+    generation++;
+    return true;
+  }
+};
+
+HcCache* hc_open(const char* path) {
+  if (path == nullptr) return nullptr;
+  const int fd = open(path, O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+  if (fd < 0) return nullptr;
+
+  struct stat st;
+  Mapping m;
+  if (fstat(fd, &st) == 0 && static_cast<size_t>(st.st_size) >= kHeaderBytes) {
+    m = MapFile(fd, static_cast<size_t>(st.st_size));
+    if (m.base != nullptr && !Valid(m)) {
+      munmap(m.base, m.bytes);
+      m = Mapping();
+    }
+  }
+  if (m.base == nullptr) m = CreateLayout(fd, kInitialCapacity);
+  if (m.base == nullptr) {
+    close(fd);
+    return nullptr;
+  }
+
+  HcCache* cache = new HcCache();
+  cache->path = path;
+  cache->fd = fd;
+  cache->map = m;
+  return cache;
+}
+
+void hc_close(HcCache* cache) {
+  if (cache == nullptr) return;
+  hc_flush(cache);
+  munmap(cache->map.base, cache->map.bytes);
+  for (const Mapping& m : cache->retired) munmap(m.base, m.bytes);
+  close(cache->fd);
+  delete cache;
+}
+
+int32_t hc_count(const HcCache* cache) {
+  return cache ? static_cast<int32_t>(cache->header()->count) : 0;
+}
+
+double hc_last_timestamp(const HcCache* cache) {
+  return cache ? cache->header()->last_timestamp_ms : 0;
+}
+
+const void* hc_column(const HcCache* cache, int32_t column) {
+  if (cache == nullptr || column < 0 || column >= HC_COLUMNS) return nullptr;
+  return cache->column(column);
+}
+
+uint32_t hc_generation(const HcCache* cache) {
+  return cache ? cache->generation : 0;
+}
+
+int32_t hc_append(HcCache* cache, const double* timestamp_ms,
+                  const int32_t* heart_rate, const int32_t* hr_quality,
+                  const int32_t* spo2, const int32_t* spo2_quality,
+                  const double* temperature, int32_t n) {
+  if (cache == nullptr || n < 0) return -1;
+  if (n == 0) return 0;
+  if (!timestamp_ms || !heart_rate || !hr_quality || !spo2 || !spo2_quality ||
+      !temperature) {
+    return -1;
+  }
+
+  const uint64_t count = cache->header()->count;
+  if (count + n > cache->header()->capacity && !cache->Grow(count + n)) {
+    return -1;
+  }
+
+  Header* h = cache->header();
+  double* ts = reinterpret_cast<double*>(cache->column(HC_COL_TIMESTAMP_MS));
+  int32_t* hr = reinterpret_cast<int32_t*>(cache->column(HC_COL_HEART_RATE));
+  int32_t* hrq = reinterpret_cast<int32_t*>(cache->column(HC_COL_HR_QUALITY));
+  int32_t* ox = reinterpret_cast<int32_t*>(cache->column(HC_COL_SPO2));
+  int32_t* oxq = reinterpret_cast<int32_t*>(cache->column(HC_COL_SPO2_QUALITY));
+  double* tc = reinterpret_cast<double*>(cache->column(HC_COL_TEMPERATURE));
+
+  uint64_t at = count;
+  double last = count > 0 ? h->last_timestamp_ms : -1;
+  for (int32_t i = 0; i < n; i++) {
+    if (!(timestamp_ms[i] > last)) continue;  // already cached / unsorted
+    last = timestamp_ms[i];
+    ts[at] = last;
+    hr[at] = heart_rate[i];
+    hrq[at] = hr_quality[i];
+    ox[at] = spo2[i];
+    oxq[at] = spo2_quality[i];
+    tc[at] = temperature[i];
+    at++;
+  }
+  if (at == count) return 0;
+
+  // Rows first, then the count that makes them visible.
+  h->last_timestamp_ms = last;
+  h->count = at;
+  return static_cast<int32_t>(at - count);
+}
+
+int32_t hc_lower_bound(const HcCache* cache, double t_ms) {
+  if (cache == nullptr) return 0;
+  const double* ts =
+      reinterpret_cast<const double*>(cache->column(HC_COL_TIMESTAMP_MS));
+  const double* end = ts + cache->header()->count;
+  return static_cast<int32_t>(std::lower_bound(ts, end, t_ms) - ts);
+}
+
+int32_t hc_flush(HcCache* cache) {
+  if (cache == nullptr) return -1;
+  return msync(cache->map.base, cache->map.bytes, MS_SYNC) == 0 ? 0 : -1;
+}
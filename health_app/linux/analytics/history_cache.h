@@ -0,0 +1,75 @@
+#ifndef HISTORY_CACHE_H_
+#define HISTORY_CACHE_H_
+
+// Memory-mapped columnar vitals history, one file per device.
+//
+// Each column is a flat array inside the mapping, so Dart can wrap it in a
+// typed-list view (Pointer.asTypedList) and hand the same memory to the
+// ha_* analytics functions without copying. Records are append-only in
+// timestamp order: hc_append() drops anything not newer than the last
+// stored timestamp, which makes re-syncing an overlapping range harmless.
+//
+// Growing the file relays it out into a new mapping. Earlier mappings stay
+// mapped until hc_close(), so views taken before an append remain readable
+// (they just don't see the new rows). Not thread-safe; the app drives each
+// cache from the UI isolate.
+
+#include <stdint.h>
+
+#include "health_analytics.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct HcCache HcCache;
+
+// Column ids for hc_column(). Timestamps are epoch milliseconds stored as
+// doubles so they feed ha_rolling_stats() directly.
+enum {
+  HC_COL_TIMESTAMP_MS = 0,  // double
+  HC_COL_HEART_RATE = 1,    // int32
+  HC_COL_HR_QUALITY = 2,    // int32
+  HC_COL_SPO2 = 3,          // int32
+  HC_COL_SPO2_QUALITY = 4,  // int32
+  HC_COL_TEMPERATURE = 5,   // double
+  HC_COLUMNS = 6
+};
+
+// Opens (creating if needed) the cache file at path. A file that fails
+// validation is reset to empty: the cache can always be refetched.
+// Returns null on I/O failure.
+HA_EXPORT HcCache* hc_open(const char* path);
+HA_EXPORT void hc_close(HcCache* cache);
+
+HA_EXPORT int32_t hc_count(const HcCache* cache);
+
+// Newest stored timestamp, or 0 when empty.
+HA_EXPORT double hc_last_timestamp(const HcCache* cache);
+
+// Base address of a column in the current mapping; valid for hc_count()
+// elements. Re-fetch after hc_append() to see new rows.
+HA_EXPORT const void* hc_column(const HcCache* cache, int32_t column);
+
+// Incremented whenever hc_append() moves the columns to a new mapping.
+HA_EXPORT uint32_t hc_generation(const HcCache* cache);
+
+// Appends the rows whose timestamp is newer than everything stored (input
+// must be sorted ascending). Returns the number of rows written, or -1.
+HA_EXPORT int32_t hc_append(HcCache* cache, const double* timestamp_ms,
+                            const int32_t* heart_rate,
+                            const int32_t* hr_quality, const int32_t* spo2,
+                            const int32_t* spo2_quality,
+                            const double* temperature, int32_t n);
+
+// Index of the first row with timestamp >= t_ms (hc_count() if none).
+HA_EXPORT int32_t hc_lower_bound(const HcCache* cache, double t_ms);
+
+// Writes dirty pages back to the file. Returns 0 or -1.
+HA_EXPORT int32_t hc_flush(HcCache* cache);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // HISTORY_CACHE_H_
@@ -0,0 +1,282 @@
+#include "live_stream.h"
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <unordered_map>
+
+namespace {
+
+constexpr char kMagic[4] = {'H', 'L', 'S', '1'};
+constexpr int kHeaderBytes = 36;
+constexpr int kVitalsBytes = 12;
+constexpr int kIdBytes = 20;
+constexpr uint32_t kRingSize = 2048;  // power of two
+constexpr int kPollMs = 100;          // stop-flag latency
+constexpr uint32_t kMaxSeqGap = 1000;  // larger jumps are a device restart
+
+uint16_t Get16(const uint8_t* p) { return p[0] | (p[1] << 8); }
+
+uint32_t Get32(const uint8_t* p) {
+  return p[0] | (p[1] << 8) | (p[2] << 16) | (static_cast<uint32_t>(p[3]) << 24);
+}
+
+void Put16(uint8_t* p, uint16_t v) {
+  p[0] = v & 0xFF;
+  p[1] = v >> 8;
+}
+
+void Put32(uint8_t* p, uint32_t v) {
+  for (int i = 0; i < 4; i++) p[i] = (v >> (8 * i)) & 0xFF;
+}
+
+double WallMs() {
+  using namespace std::chrono;
+  return duration_cast<microseconds>(system_clock::now().time_since_epoch())
+             .count() /
+         1000.0;
+}
+
+}  // namespace
+
+struct LsReceiver {
+  int fd = -1;
+  std::thread thread;
+  std::atomic<bool> stop{false};
+
+  // SPSC ring: the receiver thread owns head, ls_poll() owns tail.
+  LsFrame ring[kRingSize];
+  std::atomic<uint32_t> head{0};
+  std::atomic<uint32_t> tail{0};
+
+  // Device table: slots are written once by the receiver thread and then
+  // published through device_count, so readers never see a partial id.
+  char ids[LS_MAX_DEVICES][kIdBytes + 1] = {};
+  std::atomic<int32_t> device_count{0};
+  std::unordered_map<std::string, int32_t> slot_of;  // receiver thread only
+  uint32_t last_seq[LS_MAX_DEVICES] = {};
+
+  std::atomic<uint64_t> datagrams{0};
+  std::atomic<uint64_t> frames{0};
+  std::atomic<uint64_t> malformed{0};
+  std::atomic<uint64_t> dropped{0};
+  std::atomic<uint64_t> seq_gaps{0};
+
+  int32_t SlotFor(const char* id) {
+    auto it = slot_of.find(id);
+    if (it != slot_of.end()) return it->second;
+    const int32_t n = device_count.load(std::memory_order_relaxed);
+    if (n >= LS_MAX_DEVICES) return -1;
+    std::memcpy(ids[n], id, std::strlen(id) + 1);  // id is <= kIdBytes
+    slot_of.emplace(id, n);
+    device_count.store(n + 1, std::memory_order_release);
+    return n;
+  }
+
+  bool Decode(const uint8_t* p, int len, LsFrame* f) {
+    if (len < kHeaderBytes || std::memcmp(p, kMagic, 4) != 0) return false;
+    const int payload = Get16(p + 6);
+    if (payload != len - kHeaderBytes) return false;
+
+    std::memset(f, 0, sizeof(*f));
+    f->type = p[4];
+    f->flags = p[5];
+    f->seq = Get32(p + 8);
+    f->device_ms = Get32(p + 12);
+    const uint8_t* body = p + kHeaderBytes;
+
+    if (f->type == LS_TYPE_VITALS) {
+      if (payload < kVitalsBytes) return false;
+      f->heart_rate = body[0];
+      f->hr_quality = body[1];
+      f->spo2 = body[2];
+      f->spo2_quality = body[3];
+      f->temperature_centi = static_cast<int16_t>(Get16(body + 4));
+      f->battery = body[6];
+      f->state = body[7];
+      f->rssi = static_cast<int8_t>(body[8]);
+    } else if (f->type == LS_TYPE_WAVEFORM) {
+      if (payload < 4) return false;
+      f->wave_rate = Get16(body);
+      f->wave_count = Get16(body + 2);
+      if (f->wave_count > LS_WAVE_MAX || payload < 4 + 4 * f->wave_count) {
+        return false;
+      }
+      for (int i = 0; i < f->wave_count; i++) {
+        f->wave[i] = Get32(body + 4 + 4 * i);
+      }
+    } else {
+      return false;
+    }
+
+    char id[kIdBytes + 1];
+    std::memcpy(id, p + 16, kIdBytes);
+    id[kIdBytes] = '\0';
+    if (id[0] == '\0') return false;
+    f->device = SlotFor(id);
+    return true;
+  }
+
+  void Run() {
+    uint8_t buf[1500];
+    pollfd pfd = {fd, POLLIN, 0};
+    while (!stop.load(std::memory_order_relaxed)) {
+      if (poll(&pfd, 1, kPollMs) <= 0) continue;
+      // Drain everything that arrived before going back to poll().
+      for (;;) {
+        const ssize_t len = recv(fd, buf, sizeof(buf), MSG_DONTWAIT);
+        if (len < 0) break;
+        datagrams.fetch_add(1, std::memory_order_relaxed);
+
+        const uint32_t h = head.load(std::memory_order_relaxed);
+        if (h - tail.load(std::memory_order_acquire) >= kRingSize) {
+          dropped.fetch_add(1, std::memory_order_relaxed);
+          continue;
+        }
+        LsFrame* f = &ring[h & (kRingSize - 1)];
+        if (!Decode(buf, static_cast<int>(len), f)) {
+          malformed.fetch_add(1, std::memory_order_relaxed);
+          continue;
+        }
+        if (f->device < 0) {
+          dropped.fetch_add(1, std::memory_order_relaxed);
+          continue;
+        }
+        f->received_ms = WallMs();
+
+        uint32_t& last = last_seq[f->device];
+        const uint32_t gap = f->seq - last - 1;
+        if (last != 0 && f->seq > last && gap > 0 && gap < kMaxSeqGap) {
+          seq_gaps.fetch_add(gap, std::memory_order_relaxed);
+        }
+        last = f->seq;
+
+        head.store(h + 1, std::memory_order_release);
+        frames.fetch_add(1, std::memory_order_relaxed);
+      }
+    }
+  }
+};
+
+LsReceiver* ls_start(const char* group, uint16_t port) {
+  const int fd = socket(AF_INET, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+  if (fd < 0) return nullptr;
+  const int one = 1;
+  setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+  // Dozens of beds arrive in bursts; give the kernel room.
+  const int rcvbuf = 1 << 20;
+  setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf));
+
+  sockaddr_in addr = {};
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = htonl(INADDR_ANY);
+  addr.sin_port = htons(port);
+  if (bind(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0) {
+    close(fd);
+    return nullptr;
+  }
+  if (group != nullptr && group[0] != '\0') {
+    ip_mreq mreq = {};
+    if (inet_pton(AF_INET, group, &mreq.imr_multiaddr) != 1 ||
+        setsockopt(fd, IPPROTO_IP, IP_ADD_MEMBERSHIP, &mreq, sizeof(mreq)) !=
+            0) {
+      close(fd);
+      return nullptr;
+    }
+  }
+
+  LsReceiver* rx = new LsReceiver();
+  rx->fd = fd;
+  rx->thread = std::thread([rx] { rx->Run(); });
+  return rx;
+}
+
+void ls_stop(LsReceiver* rx) {
+  if (rx == nullptr) return;
+  rx->stop.store(true);
+  rx->thread.join();
+  close(rx->fd);
+  delete rx;
+}
+
+int32_t ls_poll(LsReceiver* rx, LsFrame* out, int32_t max) {
+  if (rx == nullptr || out == nullptr || max <= 0) return 0;
+  const uint32_t t = rx->tail.load(std::memory_order_relaxed);
+  const uint32_t h = rx->head.load(std::memory_order_acquire);
+  uint32_t n = h - t;
+  if (n > static_cast<uint32_t>(max)) n = max;
+  for (uint32_t i = 0; i < n; i++) {
+    out[i] = rx->ring[(t + i) & (kRingSize - 1)];
+  }
+  rx->tail.store(t + n, std::memory_order_release);
+  return static_cast<int32_t>(n);
+}
+
+int32_t ls_device_id(LsReceiver* rx, int32_t device, char* out, int32_t cap) {
+  if (rx == nullptr || out == nullptr || cap <= 0) return -1;
+  if (device < 0 || device >= rx->device_count.load(std::memory_order_acquire)) {
+    return -1;
+  }
+  const int32_t len = static_cast<int32_t>(std::strlen(rx->ids[device]));
+  if (len >= cap) return -1;
+  std::memcpy(out, rx->ids[device], len + 1);
+  return len;
+}
+
+void ls_stats(LsReceiver* rx, LsStats* out) {
+  if (rx == nullptr || out == nullptr) return;
+  out->datagrams = rx->datagrams.load(std::memory_order_relaxed);
+  out->frames = rx->frames.load(std::memory_order_relaxed);
+  out->malformed = rx->malformed.load(std::memory_order_relaxed);
+  out->dropped = rx->dropped.load(std::memory_order_relaxed);
+  out->seq_gaps = rx->seq_gaps.load(std::memory_order_relaxed);
+  out->devices = rx->device_count.load(std::memory_order_acquire);
+}
+
+int32_t ls_encode(const LsFrame* f, const char* device_id, uint8_t* out,
+                  int32_t cap) {
+  if (f == nullptr || device_id == nullptr || out == nullptr) return 0;
+  int payload;
+  if (f->type == LS_TYPE_VITALS) {
+    payload = kVitalsBytes;
+  } else if (f->type == LS_TYPE_WAVEFORM && f->wave_count <= LS_WAVE_MAX) {
+    payload = 4 + 4 * f->wave_count;
+  } else {
+    return 0;
+  }
+  if (cap < kHeaderBytes + payload) return 0;
+
+  std::memset(out, 0, kHeaderBytes + payload);
+  std::memcpy(out, kMagic, 4);
+  out[4] = f->type;
+  out[5] = f->flags;
+  Put16(out + 6, static_cast<uint16_t>(payload));
+  Put32(out + 8, f->seq);
+  Put32(out + 12, f->device_ms);
+  std::strncpy(reinterpret_cast<char*>(out + 16), device_id, kIdBytes);
+
+  uint8_t* body = out + kHeaderBytes;
+  if (f->type == LS_TYPE_VITALS) {
+    body[0] = f->heart_rate;
+    body[1] = f->hr_quality;
+    body[2] = f->spo2;
+    body[3] = f->spo2_quality;
+    Put16(body + 4, static_cast<uint16_t>(f->temperature_centi));
+    body[6] = f->battery;
+    body[7] = f->state;
+    body[8] = static_cast<uint8_t>(f->rssi);
+  } else {
+    Put16(body, f->wave_rate);
+    Put16(body + 2, f->wave_count);
+    for (int i = 0; i < f->wave_count; i++) Put32(body + 4 + 4 * i, f->wave[i]);
+  }
+  return kHeaderBytes + payload;
+}
@@ -0,0 +1,115 @@
+#ifndef LIVE_STREAM_H_
+#define LIVE_STREAM_H_
+
+// Receiver for the devices' LAN live stream (firmware LIVE STREAM section).
+//
+// Devices send UDP datagrams to a multicast group (or unicast to a station).
+// A receiver thread decodes them into fixed-size LsFrame records in a
+// single-producer/single-consumer lock-free ring. The Dart UI isolate is the
+// only consumer and drains it with ls_poll(). When the ring is full, new
+// frames are dropped and counted rather than blocking the socket.
+//
+// Frames are not authenticated: anything on the LAN can send datagrams that
+// decode as a bed, and the device id in the header is only a label. Treat
+// the stream as a convenience display on a trusted network, never as the
+// alerting path.
+//
+// Wire format v1, little-endian:
+//   0  char[4]  "HLS1"
+//   4  u8       type: 1 = vitals, 2 = waveform
+//   5  u8       flags: LS_FLAG_*
+//   6  u16      payload bytes
+//   8  u32      sequence number (per device, all types)
+//   12 u32      device millis() at send (vitals) / first sample (waveform)
+//   16 char[20] device id, NUL padded
+//   36 payload
+// Vitals payload (12 bytes):
+//   u8 heart_rate, u8 hr_quality, u8 spo2, u8 spo2_quality,
+//   i16 temperature (centi-degC), u8 battery %, u8 monitoring state
+//   (0 idle, 1 monitoring, 2 paused), i8 wifi rssi, u8[3] reserved
+// Waveform payload:
+//   u16 sample rate (the FIFO's samples/s, 25), u16 count (<= LS_WAVE_MAX), u32 ir[count]
+//   LS_FLAG_GAP: the sensor FIFO overflowed and samples were lost between
+//   the previous waveform frame and this one
+
+#include <stdint.h>
+
+#include "health_analytics.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define LS_DEFAULT_GROUP "239.255.72.83"
+#define LS_DEFAULT_PORT 47800
+#define LS_WAVE_MAX 64
+#define LS_MAX_DEVICES 128
+
+enum {
+  LS_TYPE_VITALS = 1,
+  LS_TYPE_WAVEFORM = 2,
+};
+
+enum {
+  LS_FLAG_ALERT = 1 << 0,
+  LS_FLAG_CRITICAL = 1 << 1,
+  LS_FLAG_TEMP_ESTIMATED = 1 << 2,
+  LS_FLAG_GAP = 1 << 3,
+};
+
+typedef struct LsReceiver LsReceiver;
+
+typedef struct {
+  double received_ms;  // wall clock at receipt
+  uint32_t seq;
+  uint32_t device_ms;
+  int32_t device;      // slot for ls_device_id()
+  uint8_t type;
+  uint8_t flags;
+  uint8_t heart_rate;
+  uint8_t hr_quality;
+  uint8_t spo2;
+  uint8_t spo2_quality;
+  uint8_t battery;
+  uint8_t state;
+  int16_t temperature_centi;
+  int8_t rssi;
+  uint8_t reserved;
+  uint16_t wave_rate;
+  uint16_t wave_count;
+  uint32_t wave[LS_WAVE_MAX];
+} LsFrame;
+
+typedef struct {
+  uint64_t datagrams;  // received from the socket
+  uint64_t frames;     // decoded and queued
+  uint64_t malformed;  // bad magic/length/type
+  uint64_t dropped;    // ring full
+  uint64_t seq_gaps;   // frames missing between consecutive sequence numbers
+  int32_t devices;
+} LsStats;
+
+// Binds port on all interfaces and, when group is non-empty, joins that
+// multicast group. Returns null if the socket cannot be set up.
+HA_EXPORT LsReceiver* ls_start(const char* group, uint16_t port);
+HA_EXPORT void ls_stop(LsReceiver* rx);
+
+// Moves up to max queued frames into out; returns the number moved.
+HA_EXPORT int32_t ls_poll(LsReceiver* rx, LsFrame* out, int32_t max);
+
+// Copies the NUL-terminated id of a device slot; returns its length or -1.
+HA_EXPORT int32_t ls_device_id(LsReceiver* rx, int32_t device, char* out,
+                               int32_t cap);
+
+HA_EXPORT void ls_stats(LsReceiver* rx, LsStats* out);
+
+// Encodes a frame in the wire format above (used by the simulator and
+// tests). Returns the datagram length, or 0 if cap is too small.
+HA_EXPORT int32_t ls_encode(const LsFrame* frame, const char* device_id,
+                            uint8_t* out, int32_t cap);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // LIVE_STREAM_H_
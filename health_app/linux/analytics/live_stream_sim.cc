@@ -0,0 +1,142 @@
+// Simulated bedside devices for the LAN live stream.
+//
+//   live_stream_sim [--beds N] [--seconds S] [--addr A] [--port P]
+//
+// Each bed sends a vitals frame every 500 ms and a 25-sample IR waveform
+// frame every second (the 25/s the device FIFO delivers), in the wire
+// format from live_stream.h, to
+// the multicast group (default) or a unicast address such as 127.0.0.1.
+// Run the desktop app's ward view, or any ls_start() receiver, alongside.
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "live_stream.h"
+
+namespace {
+
+constexpr int kSampleRate = 25;
+constexpr int kWaveSamples = 25;
+constexpr int kWaveMs = kWaveSamples * 1000 / kSampleRate;
+constexpr int kTickMs = 500;  // vitals period
+
+struct Bed {
+  std::string id;
+  double hr;
+  double spo2;
+  double phase = 0;
+  uint32_t seq = 0;
+};
+
+// Crude PPG: a sharp systolic upstroke, exponential run-off and a small
+// dicrotic bump, on a slowly breathing baseline.
+uint32_t Ppg(double phase, double t) {
+  const double systolic = std::exp(-std::pow((phase - 0.15) / 0.07, 2));
+  const double dicrotic = 0.25 * std::exp(-std::pow((phase - 0.45) / 0.06, 2));
+  const double baseline = 100000 + 800 * std::sin(2 * M_PI * 0.25 * t);
+  return static_cast<uint32_t>(baseline + 3000 * (systolic + dicrotic));
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  int beds = 30;
+  int seconds = 60;
+  std::string addr = LS_DEFAULT_GROUP;
+  int port = LS_DEFAULT_PORT;
+  for (int i = 1; i + 1 < argc; i += 2) {
+    if (!std::strcmp(argv[i], "--beds")) beds = std::atoi(argv[i + 1]);
+    else if (!std::strcmp(argv[i], "--seconds")) seconds = std::atoi(argv[i + 1]);
+    else if (!std::strcmp(argv[i], "--addr")) addr = argv[i + 1];
+    else if (!std::strcmp(argv[i], "--port")) port = std::atoi(argv[i + 1]);
+  }
+
+  const int fd = socket(AF_INET, SOCK_DGRAM, 0);
+  const unsigned char ttl = 1, loop = 1;
+  setsockopt(fd, IPPROTO_IP, IP_MULTICAST_TTL, &ttl, sizeof(ttl));
+  setsockopt(fd, IPPROTO_IP, IP_MULTICAST_LOOP, &loop, sizeof(loop));
+  sockaddr_in to = {};
+  to.sin_family = AF_INET;
+  to.sin_port = htons(port);
+  if (inet_pton(AF_INET, addr.c_str(), &to.sin_addr) != 1) {
+    std::fprintf(stderr, "bad address %s\n", addr.c_str());
+    return 1;
+  }
+
+  std::vector<Bed> ward;
+  for (int b = 0; b < beds; b++) {
+    char id[24];
+    std::snprintf(id, sizeof(id), "ESP32_SIM%04d", b + 1);
+    ward.push_back({id, 60.0 + (b * 7) % 50, 94.0 + b % 6});
+  }
+
+  std::printf("%d beds -> %s:%d for %d s\n", beds, addr.c_str(), port, seconds);
+  uint8_t buf[512];
+  uint64_t sent = 0;
+  const auto start = std::chrono::steady_clock::now();
+  auto next = start;
+  for (int tick = 0; tick * kTickMs < seconds * 1000; tick++) {
+    const double t = tick * kTickMs / 1000.0;
+    for (Bed& bed : ward) {
+      // Wander a little so the display has something to show.
+      bed.hr += (std::rand() % 3 - 1) * 0.5;
+      bed.hr = std::fmin(std::fmax(bed.hr, 45), 140);
+      if (std::rand() % 50 == 0) bed.spo2 = 88 + std::rand() % 12;
+
+      const bool send_wave = (tick * kTickMs) % kWaveMs == 0;
+      LsFrame wave = {};
+      if (send_wave) {
+        wave.type = LS_TYPE_WAVEFORM;
+        wave.seq = ++bed.seq;
+        wave.device_ms = static_cast<uint32_t>(t * 1000);
+        wave.wave_rate = kSampleRate;
+        wave.wave_count = kWaveSamples;
+        for (int i = 0; i < kWaveSamples; i++) {
+          bed.phase += bed.hr / 60.0 / kSampleRate;
+          bed.phase -= std::floor(bed.phase);
+          wave.wave[i] = Ppg(bed.phase, t + i / double(kSampleRate));
+        }
+      }
+
+      LsFrame vitals = {};
+      vitals.type = LS_TYPE_VITALS;
+      vitals.seq = ++bed.seq;
+      vitals.device_ms = static_cast<uint32_t>(t * 1000);
+      vitals.heart_rate = static_cast<uint8_t>(bed.hr);
+      vitals.hr_quality = 90;
+      vitals.spo2 = static_cast<uint8_t>(bed.spo2);
+      vitals.spo2_quality = 85;
+      vitals.temperature_centi = 3660 + (std::rand() % 40);
+      vitals.battery = 80;
+      vitals.state = 1;
+      vitals.rssi = -55;
+      if (bed.spo2 < 95) vitals.flags |= LS_FLAG_ALERT;
+      if (bed.spo2 < 90) vitals.flags |= LS_FLAG_CRITICAL;
+
+      for (const LsFrame* f : {&wave, &vitals}) {
+        if (f->type == 0) continue;
+        const int len = ls_encode(f, bed.id.c_str(), buf, sizeof(buf));
+        if (sendto(fd, buf, len, 0, reinterpret_cast<sockaddr*>(&to),
+                   sizeof(to)) == len) {
+          sent++;
+        }
+      }
+    }
+    next += std::chrono::milliseconds(kTickMs);
+    std::this_thread::sleep_until(next);
+  }
+  std::printf("sent %llu frames\n", static_cast<unsigned long long>(sent));
+  close(fd);
+  return 0;
+}
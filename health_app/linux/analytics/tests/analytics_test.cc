@@ -0,0 +1,296 @@
+// Unit tests for the native analytics and the mmap history cache, run by
+// ctest when this directory is configured on its own. The vectorised
+// kernels are checked against plain scalar references on random series
+// with gaps (zero = no reading).
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <cmath>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "health_analytics.h"
+#include "history_cache.h"
+
+namespace {
+
+int failures = 0;
+
+#define CHECK(cond)                                                   \
+  do {                                                                \
+    if (!(cond)) {                                                    \
+      fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, \
+              #cond);                                                 \
+      failures++;                                                     \
+    }                                                                 \
+  } while (0)
+
+bool Near(double a, double b, double tol = 1e-9) {
+  if (std::isnan(a) || std::isnan(b)) return std::isnan(a) && std::isnan(b);
+  return std::fabs(a - b) <= tol * (1 + std::fabs(b));
+}
+
+std::vector<double> RandomSeries(int n, double gap_fraction, uint32_t seed) {
+  std::mt19937 rng(seed);
+  std::uniform_real_distribution<double> u(0, 1);
+  std::vector<double> x(n);
+  for (int i = 0; i < n; i++) x[i] = u(rng) < gap_fraction ? 0 : 55 + 40 * u(rng);
+  return x;
+}
+
+// ==================== SUMMARY / ROLLING ====================
+void TestSummary() {
+  for (int n : {0, 1, 3, 4, 7, 1001}) {
+    std::vector<double> x = RandomSeries(n, 0.2, n);
+    HaSummary s;
+    CHECK(ha_summary(x.data(), n, &s) == 0);
+    int count = 0;
+    double sum = 0, lo = INFINITY, hi = -INFINITY;
+    for (double v : x) {
+      if (v <= 0) continue;
+      count++;
+      sum += v;
+      lo = std::fmin(lo, v);
+      hi = std::fmax(hi, v);
+    }
+    CHECK(s.count == count);
+    if (count == 0) {
+      CHECK(std::isnan(s.mean) && std::isnan(s.sd));
+      continue;
+    }
+    double mean = sum / count, dev = 0;
+    for (double v : x) {
+      if (v > 0) dev += (v - mean) * (v - mean);
+    }
+    CHECK(Near(s.mean, mean) && Near(s.sd, std::sqrt(dev / count)));
+    CHECK(s.min == lo && s.max == hi);
+  }
+}
+
+void TestRollingStats() {
+  const int n = 500;
+  std::vector<double> x = RandomSeries(n, 0.15, 7);
+  std::vector<double> t(n);
+  std::mt19937 rng(3);
+  double now = 1.7e12;
+  for (int i = 0; i < n; i++) {
+    now += (rng() % 4) * 1000.0;  // repeated timestamps included
+    t[i] = now;
+  }
+  const double window = 30000;
+  std::vector<double> mean(n), sd(n), lo(n), hi(n);
+  CHECK(ha_rolling_stats(t.data(), x.data(), n, window, mean.data(), sd.data(),
+                         lo.data(), hi.data()) == 0);
+  for (int i = 0; i < n; i++) {
+    int count = 0;
+    double sum = 0, mn = INFINITY, mx = -INFINITY;
+    for (int j = 0; j <= i; j++) {
+      if (t[j] <= t[i] - window || x[j] <= 0) continue;
+      count++;
+      sum += x[j];
+      mn = std::fmin(mn, x[j]);
+      mx = std::fmax(mx, x[j]);
+    }
+    if (count == 0) {
+      CHECK(std::isnan(mean[i]) && std::isnan(lo[i]));
+      continue;
+    }
+    double m = sum / count, dev = 0;
+    for (int j = 0; j <= i; j++) {
+      if (t[j] > t[i] - window && x[j] > 0) dev += (x[j] - m) * (x[j] - m);
+    }
+    CHECK(Near(mean[i], m, 1e-9));
+    CHECK(Near(sd[i], std::sqrt(dev / count), 1e-6));
+    CHECK(lo[i] == mn && hi[i] == mx);
+  }
+  // Null outputs are allowed; bad arguments are not
+  CHECK(ha_rolling_stats(t.data(), x.data(), n, window, mean.data(), nullptr,
+                         nullptr, nullptr) == 0);
+  CHECK(ha_rolling_stats(t.data(), x.data(), -1, window, nullptr, nullptr,
+                         nullptr, nullptr) == -1);
+}
+
+// ==================== HRV ====================
+void TestHrv() {
+  // 800, 810, 790, [artefact], 805: the artefact breaks the chain, so the
+  // successive differences are |810-800| and |790-810| only
+  const double nn[] = {800, 810, 790, 2500, 805};
+  HaHrv h;
+  CHECK(ha_hrv(nn, 5, &h) == 0);
+  CHECK(h.beats == 4);
+  CHECK(Near(h.mean_nn_ms, (800 + 810 + 790 + 805) / 4.0));
+  CHECK(Near(h.rmssd_ms, std::sqrt((100.0 + 400.0) / 2)));
+  CHECK(Near(h.pnn50, 0.0));
+  double mean = h.mean_nn_ms, dev = 0;
+  for (double v : {800.0, 810.0, 790.0, 805.0}) dev += (v - mean) * (v - mean);
+  CHECK(Near(h.sdnn_ms, std::sqrt(dev / 3), 1e-6));  // sample SD
+
+  const double jumpy[] = {700, 800, 700, 800};
+  CHECK(ha_hrv(jumpy, 4, &h) == 0);
+  CHECK(Near(h.pnn50, 1.0) && Near(h.rmssd_ms, 100));
+
+  // 60 and 75 BPM are 1000 and 800 ms; 0 BPM is a gap
+  const int32_t bpm[] = {60, 75, 0, 60};
+  CHECK(ha_hrv_from_bpm(bpm, 4, &h) == 0);
+  CHECK(h.beats == 3 && Near(h.mean_nn_ms, (1000 + 800 + 1000) / 3.0));
+  CHECK(ha_hrv(nullptr, 3, &h) == -1);
+}
+
+// ==================== HEALTH SCORE ====================
+double ReferenceScore(int hr, int spo2, double temp, int hq, int oq,
+                      double target) {
+  double score = 100;
+  if (spo2 < 90) score -= 40;
+  else if (spo2 < 95) score -= 6 + (95 - spo2) * 4;
+  else if (spo2 < 98) score -= (98 - spo2) * 2;
+  if (hr == 0) {
+    score -= 30;
+  } else {
+    double diff = std::fabs(hr - target);
+    if (diff > 40) score -= 30;
+    else if (diff > 20) score -= 15 + (diff - 20);
+    else if (diff > 10) score -= (diff - 10) * 1.5;
+  }
+  if (temp < 35.5 || temp > 38.0) score -= 20;
+  else if (temp < 36.5 || temp > 37.5) score -= std::fabs(temp - 37.0) * 10;
+  double q = (hq + oq) / 2.0;
+  if (q < 50) score -= 10;
+  else if (q < 70) score -= (70 - q) / 2;
+  return score < 0 ? 0 : (score > 100 ? 100 : score);
+}
+
+void TestHealthScores() {
+  std::mt19937 rng(11);
+  const int n = 2000;
+  std::vector<int32_t> hr(n), spo2(n), hq(n), oq(n);
+  std::vector<double> temp(n), score(n);
+  for (int i = 0; i < n; i++) {
+    hr[i] = rng() % 10 == 0 ? 0 : 30 + rng() % 150;
+    spo2[i] = 80 + rng() % 21;
+    temp[i] = 34.5 + (rng() % 50) / 10.0;
+    hq[i] = rng() % 101;
+    oq[i] = rng() % 101;
+  }
+  CHECK(ha_health_scores(hr.data(), spo2.data(), temp.data(), hq.data(),
+                         oq.data(), n, 62, score.data()) == 0);
+  for (int i = 0; i < n; i++) {
+    CHECK(Near(score[i],
+               ReferenceScore(hr[i], spo2[i], temp[i], hq[i], oq[i], 62)));
+  }
+  // Default target of 70 BPM
+  int32_t h = 70, o = 98, q = 100;
+  double t = 37.0, s = 0;
+  CHECK(ha_health_scores(&h, &o, &t, &q, &q, 1, 0, &s) == 0 && s == 100);
+}
+
+// ==================== HISTORY CACHE ====================
+struct Rows {
+  std::vector<double> ts, temp;
+  std::vector<int32_t> hr, hq, spo2, oq;
+
+  void Add(double t) {
+    ts.push_back(t);
+    hr.push_back(60 + static_cast<int>(t / 1000) % 40);
+    hq.push_back(90);
+    spo2.push_back(97);
+    oq.push_back(85);
+    temp.push_back(36.6);
+  }
+  int32_t AppendTo(HcCache* c, size_t from = 0) const {
+    return hc_append(c, ts.data() + from, hr.data() + from, hq.data() + from,
+                     spo2.data() + from, oq.data() + from, temp.data() + from,
+                     static_cast<int32_t>(ts.size() - from));
+  }
+};
+
+void TestHistoryCache() {
+  char dir[] = "/tmp/hc-test-XXXXXX";
+  CHECK(mkdtemp(dir) != nullptr);
+  const std::string path = std::string(dir) + "/dev.hcol";
+
+  HcCache* c = hc_open(path.c_str());
+  CHECK(c != nullptr);
+  if (c == nullptr) return;
+  CHECK(hc_count(c) == 0 && hc_last_timestamp(c) == 0);
+
+  Rows rows;
+  for (int i = 0; i < 50000; i++) rows.Add(1.7e12 + i * 5000.0);
+  const uint32_t gen0 = hc_generation(c);
+  CHECK(rows.AppendTo(c) == 50000);
+  CHECK(hc_count(c) == 50000 && hc_generation(c) != gen0);
+
+  // Overlapping re-sync: only rows newer than the last stored one land
+  Rows more;
+  for (int i = 49990; i < 50010; i++) more.Add(1.7e12 + i * 5000.0);
+  CHECK(more.AppendTo(c) == 10);
+  CHECK(hc_count(c) == 50010);
+  CHECK(hc_last_timestamp(c) == 1.7e12 + 50009 * 5000.0);
+
+  // Views taken before a growing append stay readable
+  const double* ts =
+      static_cast<const double*>(hc_column(c, HC_COL_TIMESTAMP_MS));
+  const int32_t* hr =
+      static_cast<const int32_t*>(hc_column(c, HC_COL_HEART_RATE));
+  Rows tail;
+  for (int i = 50010; i < 120000; i++) tail.Add(1.7e12 + i * 5000.0);
+  CHECK(tail.AppendTo(c) == 120000 - 50010);
+  CHECK(ts[123] == rows.ts[123] && hr[123] == rows.hr[123]);
+
+  CHECK(hc_lower_bound(c, 1.7e12) == 0);
+  CHECK(hc_lower_bound(c, 1.7e12 + 1) == 1);
+  CHECK(hc_lower_bound(c, 1.7e12 + 100 * 5000.0) == 100);
+  CHECK(hc_lower_bound(c, 2e12) == hc_count(c));
+
+  // Analytics run straight on the mapped columns
+  HaSummary s;
+  CHECK(ha_summary(static_cast<const double*>(
+                       hc_column(c, HC_COL_TEMPERATURE)),
+                   hc_count(c), &s) == 0);
+  CHECK(s.count == 120000 && Near(s.mean, 36.6));
+  CHECK(hc_flush(c) == 0);
+  hc_close(c);
+
+  // Reopened from disk
+  c = hc_open(path.c_str());
+  CHECK(c != nullptr && hc_count(c) == 120000);
+  if (c != nullptr) {
+    const int32_t* spo2 =
+        static_cast<const int32_t*>(hc_column(c, HC_COL_SPO2));
+    CHECK(spo2[119999] == 97);
+    hc_close(c);
+  }
+
+  // A corrupt file is reset to empty, not trusted
+  FILE* f = fopen(path.c_str(), "r+b");
+  CHECK(f != nullptr);
+  if (f != nullptr) {
+    fputs("garbage!", f);
+    fclose(f);
+  }
+  c = hc_open(path.c_str());
+  CHECK(c != nullptr && hc_count(c) == 0);
+  if (c != nullptr) hc_close(c);
+
+  unlink(path.c_str());
+  rmdir(dir);
+}
+
+}  // namespace
+
+int main() {
+  CHECK(ha_abi_version() == HA_ABI_VERSION);
+  TestSummary();
+  TestRollingStats();
+  TestHrv();
+  TestHealthScores();
+  TestHistoryCache();
+  if (failures) {
+    fprintf(stderr, "%d check(s) failed\n", failures);
+    return 1;
+  }
+  printf("analytics_test: all checks passed\n");
+  return 0;
+}